@@ -98,11 +98,7 @@ void usage(char *const argv[]) {
 class GenDefUseEntry {
  public:
   GenDefUseEntry(char *op_str) :
-    op_str_(op_str) {
-    flags.CF = flags.PF = flags.AF = flags.ZF = flags.SF =
-    flags.TP = flags.IF = flags.DF = flags.OF = flags.IOPL =
-    flags.NT = flags.RF = flags.VM = flags.AC = flags.VIF =
-    flags.VIP = flags.ID = false;
+    op_mask(0), flag_mask(0), op_str_(op_str) {
     found = false;
   }
   char *op_str() { return op_str_; }
@@ -112,25 +108,7 @@ class GenDefUseEntry {
   BitString reg_mask16;
   BitString reg_mask32;
   BitString reg_mask64;
-  struct flags_ {
-    bool  CF :1;
-    bool  PF :1;
-    bool  AF :1;
-    bool  ZF :1;
-    bool  SF :1;
-    bool  TP :1;
-    bool  IF :1;
-    bool  DF :1;
-    bool  OF :1;
-    bool  IOPL :1;
-    bool  NT :1;
-    bool  RF :1;
-    bool  VM :1;
-    bool  AC :1;
-    bool  VIF:1;
-    bool  VIP :1;
-    bool  ID :1;
-  } flags;
+  unsigned int       flag_mask;
   bool found :1;
   char *op_str_;
 };
@@ -199,7 +177,6 @@ void ReadSideEffects(const char *fname, MnemMap &mnem_map) {
 
     BitString *mask = &e->reg_mask;
 
-    bool eflags=false;
     while (p && *p && (p < end)) {
       char *q = next_field(p, ' ', &p);
       if (!*q) break;
@@ -209,45 +186,28 @@ void ReadSideEffects(const char *fname, MnemMap &mnem_map) {
       if (!strcasecmp(q, "addr32:")) mask = &e->reg_mask32; else
       if (!strcasecmp(q, "addr64:")) mask = &e->reg_mask64; else
 
-      if (!strcasecmp(q, "flags:"))  /* TODO(rhundt): refine */; else
-      if (!strcasecmp(q, "clear:"))  /* TODO(rhundt): refine */; else
-      if (!strcasecmp(q, "undef:"))  /* TODO(rhundt): refine */; else
-
-      if (!strcasecmp(q, "CF")) eflags = true; else
-      if (!strcasecmp(q, "PF")) eflags = true; else
-      if (!strcasecmp(q, "AF")) eflags = true; else
-      if (!strcasecmp(q, "ZF")) eflags = true; else
-      if (!strcasecmp(q, "SF")) eflags = true; else
-      if (!strcasecmp(q, "TP")) eflags = true; else
-      if (!strcasecmp(q, "IF")) eflags = true; else
-      if (!strcasecmp(q, "DF")) eflags = true; else
-      if (!strcasecmp(q, "OF")) eflags = true; else
-      if (!strcasecmp(q, "IOPL")) eflags = true; else
-      if (!strcasecmp(q, "NT")) eflags = true; else
-      if (!strcasecmp(q, "RF")) eflags = true; else
-      if (!strcasecmp(q, "VM")) eflags = true; else
-      if (!strcasecmp(q, "AC")) eflags = true; else
-      if (!strcasecmp(q, "VIF")) eflags = true; else
-      if (!strcasecmp(q, "VIP")) eflags = true; else
-      if (!strcasecmp(q, "ID")) eflags = true; else 
-      /*
-      if (!strcasecmp(q, "CF")) e->flags.CF = true; else
-      if (!strcasecmp(q, "PF")) e->flags.PF = true; else
-      if (!strcasecmp(q, "AF")) e->flags.AF = true; else
-      if (!strcasecmp(q, "ZF")) e->flags.ZF = true; else
-      if (!strcasecmp(q, "SF")) e->flags.SF = true; else
-      if (!strcasecmp(q, "TP")) e->flags.TP = true; else
-      if (!strcasecmp(q, "IF")) e->flags.IF = true; else
-      if (!strcasecmp(q, "DF")) e->flags.DF = true; else
-      if (!strcasecmp(q, "OF")) e->flags.OF = true; else
-      if (!strcasecmp(q, "IOPL")) e->flags.IOPL = true; else
-      if (!strcasecmp(q, "NT")) e->flags.NT = true; else
-      if (!strcasecmp(q, "RF")) e->flags.RF = true; else
-      if (!strcasecmp(q, "VM")) e->flags.VM = true; else
-      if (!strcasecmp(q, "AC")) e->flags.AC = true; else
-      if (!strcasecmp(q, "VIF")) e->flags.VIF = true; else
-      if (!strcasecmp(q, "VIP")) e->flags.VIP = true; else
-      if (!strcasecmp(q, "ID")) e->flags.ID = true; else */
+      // Flags that are cleared or left undefined are written, too.
+      if (!strcasecmp(q, "flags:")) ; else
+      if (!strcasecmp(q, "clear:")) ; else
+      if (!strcasecmp(q, "undef:")) ; else
+
+      if (!strcasecmp(q, "CF")) e->flag_mask |= FLAG_CF; else
+      if (!strcasecmp(q, "PF")) e->flag_mask |= FLAG_PF; else
+      if (!strcasecmp(q, "AF")) e->flag_mask |= FLAG_AF; else
+      if (!strcasecmp(q, "ZF")) e->flag_mask |= FLAG_ZF; else
+      if (!strcasecmp(q, "SF")) e->flag_mask |= FLAG_SF; else
+      if (!strcasecmp(q, "TP")) e->flag_mask |= FLAG_TP; else
+      if (!strcasecmp(q, "IF")) e->flag_mask |= FLAG_IF; else
+      if (!strcasecmp(q, "DF")) e->flag_mask |= FLAG_DF; else
+      if (!strcasecmp(q, "OF")) e->flag_mask |= FLAG_OF; else
+      if (!strcasecmp(q, "IOPL")) e->flag_mask |= FLAG_IOPL; else
+      if (!strcasecmp(q, "NT")) e->flag_mask |= FLAG_NT; else
+      if (!strcasecmp(q, "RF")) e->flag_mask |= FLAG_RF; else
+      if (!strcasecmp(q, "VM")) e->flag_mask |= FLAG_VM; else
+      if (!strcasecmp(q, "AC")) e->flag_mask |= FLAG_AC; else
+      if (!strcasecmp(q, "VIF")) e->flag_mask |= FLAG_VIF; else
+      if (!strcasecmp(q, "VIP")) e->flag_mask |= FLAG_VIP; else
+      if (!strcasecmp(q, "ID")) e->flag_mask |= FLAG_ID; else
 
       if (!strcasecmp(q, "op0"))  e->op_mask |= REG_OP0; else
       if (!strcasecmp(q, "src"))  e->op_mask |= REG_OP0; else
@@ -270,10 +230,13 @@ void ReadSideEffects(const char *fname, MnemMap &mnem_map) {
       }
       if (p > end) break;
     }
-    if (eflags)
-      e->reg_mask.Set(FindRegister("eflags")->num_);
-
-
+    // Naming the eflags register, as popf and pushf do, stands for all
+    // flags, unless the flags are listed.
+    int eflags = FindRegister("eflags")->num_;
+    if (e->reg_mask.Get(eflags) && e->flag_mask == 0)
+      e->flag_mask = FLAGS_ALL;
+    if (e->flag_mask != 0)
+      e->reg_mask.Set(eflags);
   }
 
   fclose(f);
@@ -283,6 +246,20 @@ static void PrintRegMask(FILE *def, BitString &mask) {
   mask.PrintInitializer(def);
 }
 
+static void PrintFlagMask(FILE *def, unsigned int mask) {
+  static const char *const names[NUM_FLAGS] = {
+    "CF", "PF", "AF", "ZF", "SF", "TP", "IF", "DF", "OF", "IOPL",
+    "NT", "RF", "VM", "AC", "VIF", "VIP", "ID"
+  };
+  if (mask == FLAGS_ALL) {
+    fprintf(def, "FLAGS_ALL");
+    return;
+  }
+  fprintf(def, "0");
+  for (int i = 0; i < NUM_FLAGS; i++)
+    if (mask & (1 << i)) fprintf(def, " | FLAG_%s", names[i]);
+}
+
 int fail_on_open(char *const argv[], const char *filename)
     __attribute__ ((noreturn));
 
@@ -425,7 +402,7 @@ int main(int argc, char *const argv[]) {
           "#define BNULL BitString(256, 4, 0x0ull, 0x0ull, 0x0ull, 0x0ull)\n"
           "#define BALL  BitString(256, 4, -1ull, -1ull, -1ull, -1ull)\n"
           "DefEntry def_entries [] = {\n"
-          "  { OP_invalid, 0, BNULL, BNULL, BNULL, BNULL, BNULL },\n");
+          "  { OP_invalid, 0, BNULL, BNULL, BNULL, BNULL, BNULL, 0 },\n");
 
   fprintf(use,
           "// DO NOT EDIT - this file is automatically "
@@ -435,7 +412,7 @@ int main(int argc, char *const argv[]) {
           "#define BNULL BitString(256, 4, 0x0ull, 0x0ull, 0x0ull, 0x0ull)\n"
           "#define BALL  BitString(256, 4, -1ull, -1ull, -1ull, -1ull)\n"
           "UseEntry use_entries [] = {\n"
-          "  { OP_invalid, 0, BNULL, BNULL, BNULL, BNULL, BNULL },\n");
+          "  { OP_invalid, 0, BNULL, BNULL, BNULL, BNULL, BNULL, 0 },\n");
   // Read through the instruction description file, isolate the first
   // field, which contains the opcode, and generate an
   //   OP_... into the gen-opcodes.h file.
@@ -491,7 +468,7 @@ int main(int argc, char *const argv[]) {
       /* Emit def entry */
       MnemMap::iterator def_it = mnem_def_map.find(sanitized_name);
       if (def_it == mnem_def_map.end()) {
-        fprintf(def, "  { OP_%s, DEF_OP_ALL, BALL, BALL, BALL, BALL, BALL },\n", sanitized_name);
+        fprintf(def, "  { OP_%s, DEF_OP_ALL, BALL, BALL, BALL, BALL, BALL, FLAGS_ALL },\n", sanitized_name);
         if (emit_warnings)
           fprintf(stderr, "Warning: No side-effects for: %s\n", sanitized_name);
       } else {
@@ -516,13 +493,15 @@ int main(int argc, char *const argv[]) {
         PrintRegMask(def, e->reg_mask32);
         fprintf(def, ", ");
         PrintRegMask(def, e->reg_mask64);
+        fprintf(def, ", ");
+        PrintFlagMask(def, e->flag_mask);
         fprintf(def, " },\n");
       }
 
       /* Emit use entry */
       MnemMap::iterator use_it = mnem_use_map.find(sanitized_name);
       if (use_it == mnem_use_map.end()) {
-        fprintf(use, "  { OP_%s, USE_OP_ALL, BALL, BALL, BALL, BALL, BALL },\n", sanitized_name);
+        fprintf(use, "  { OP_%s, USE_OP_ALL, BALL, BALL, BALL, BALL, BALL, FLAGS_ALL },\n", sanitized_name);
         if (emit_warnings)
           fprintf(stderr, "Warning: No side-effects for: %s\n", sanitized_name);
       } else {
@@ -554,6 +533,8 @@ int main(int argc, char *const argv[]) {
         PrintRegMask(use, e->reg_mask32);
         fprintf(use, ", ");
         PrintRegMask(use, e->reg_mask64);
+        fprintf(use, ", ");
+        PrintFlagMask(use, e->flag_mask);
         fprintf(use, " },\n");
       }
     }
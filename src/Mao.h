@@ -31,6 +31,7 @@
 #include "MaoPasses.h"
 #include "MaoCFG.h"
 #include "MaoDefs.h"
+#include "MaoDominators.h"
 #include "MaoLoops.h"
 #include "MaoRelax.h"
 #include "MaoPlugin.h"
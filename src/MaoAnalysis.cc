@@ -0,0 +1,122 @@
+//
+// Copyright 2010 Google Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the
+//   Free Software Foundation Inc.,
+//   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "Mao.h"
+#include "MaoAnalysis.h"
+
+__thread long MaoAnalysisManager::changes_ = 0;
+MaoMutex MaoAnalysisManager::size_map_mutex_(true);
+
+CFG *MaoAnalysisManager::GetCFG(Function *function, bool conservative) {
+  return CFG::GetCFG(unit_, function, conservative);
+}
+
+LoopStructureGraph *MaoAnalysisManager::GetLSG(Function *function,
+                                               bool conservative) {
+  return LoopStructureGraph::GetLSG(unit_, function, conservative);
+}
+
+Liveness *MaoAnalysisManager::GetLiveness(Function *function) {
+  // Getting the CFG first drops a liveness solution computed on an
+  // outdated CFG.
+  CFG *cfg = GetCFG(function);
+  if (function->liveness() == NULL) {
+    Liveness *liveness = new Liveness(unit_, function, cfg);
+    MAO_RASSERT(liveness->Solve());
+    liveness->BuildIndex();
+    function->set_liveness(liveness);
+  }
+  return function->liveness();
+}
+
+ReachingDefs *MaoAnalysisManager::GetReachingDefs(Function *function) {
+  CFG *cfg = GetCFG(function);
+  if (function->reaching_defs() == NULL) {
+    ReachingDefs *reaching_defs = new ReachingDefs(unit_, function, cfg);
+    MAO_RASSERT(reaching_defs->Solve());
+    function->set_reaching_defs(reaching_defs);
+  }
+  return function->reaching_defs();
+}
+
+FlagsLiveness *MaoAnalysisManager::GetFlagsLiveness(Function *function) {
+  CFG *cfg = GetCFG(function);
+  if (function->flags_liveness() == NULL) {
+    FlagsLiveness *flags_liveness = new FlagsLiveness(unit_, function, cfg);
+    MAO_RASSERT(flags_liveness->Solve());
+    flags_liveness->BuildIndex();
+    function->set_flags_liveness(flags_liveness);
+  }
+  return function->flags_liveness();
+}
+
+DominatorTree *MaoAnalysisManager::GetDominatorTree(Function *function) {
+  CFG *cfg = GetCFG(function);
+  if (function->dominators() == NULL)
+    function->set_dominators(new DominatorTree(cfg));
+  return function->dominators();
+}
+
+PostDominatorTree *MaoAnalysisManager::GetPostDominatorTree(
+    Function *function) {
+  CFG *cfg = GetCFG(function);
+  if (function->post_dominators() == NULL)
+    function->set_post_dominators(new PostDominatorTree(cfg));
+  return function->post_dominators();
+}
+
+MaoEntryIntMap *MaoAnalysisManager::GetSizeMap(Section *section) {
+  return MaoRelaxer::GetSizeMap(unit_, section);
+}
+
+void MaoAnalysisManager::Invalidate(Function *function,
+                                    MaoAnalysisSet preserved) {
+  // Dropping the CFG drops everything computed from it.
+  if (!(preserved & ANALYSIS_CFG)) {
+    CFG::InvalidateCFG(function);
+  } else {
+    if (!(preserved & ANALYSIS_LSG))
+      function->set_lsg(NULL);
+    if (!(preserved & ANALYSIS_LIVENESS))
+      function->set_liveness(NULL);
+    if (!(preserved & ANALYSIS_REACHING_DEFS))
+      function->set_reaching_defs(NULL);
+    if (!(preserved & ANALYSIS_FLAGS_LIVENESS))
+      function->set_flags_liveness(NULL);
+    if (!(preserved & ANALYSIS_DOMINATORS)) {
+      function->set_dominators(NULL);
+      function->set_post_dominators(NULL);
+    }
+  }
+
+  if (!(preserved & ANALYSIS_SIZE_MAP))
+    MaoRelaxer::InvalidateSizeMap(function->GetSection());
+}
+
+void MaoAnalysisManager::InvalidateAll(MaoAnalysisSet preserved) {
+  for (MaoUnit::FunctionIterator iter = unit_->FunctionBegin();
+       iter != unit_->FunctionEnd(); ++iter) {
+    Invalidate(*iter, preserved | ANALYSIS_SIZE_MAP);
+  }
+  if (!(preserved & ANALYSIS_SIZE_MAP)) {
+    for (SectionIterator iter = unit_->SectionBegin();
+         iter != unit_->SectionEnd(); ++iter) {
+      MaoRelaxer::InvalidateSizeMap(*iter);
+    }
+  }
+}
@@ -0,0 +1,118 @@
+//
+// Copyright 2010 Google Inc.
+//
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301, USA.
+
+// The analysis manager hands out the cached analyses of a function
+// (CFG, loop structure graph, liveness, reaching definitions, flags
+// liveness, dominator trees) and the size maps of the sections, and
+// drops them once a pass has changed the IR they were computed from.
+//
+// Each pass declares the analyses it keeps valid with
+// MaoPass::Preserve(). When a pass has modified the IR, the pass
+// manager invalidates all other analyses of the function (or of the
+// whole unit, for unit passes). Passes that do not change the IR keep
+// all analyses. Analysis and output passes say so with
+// Preserve(ANALYSIS_ALL), so that e.g. the labels the CFG builder
+// inserts do not drop anything.
+//
+// Dependencies are honored: the loop structure graph, liveness,
+// reaching definitions, flags liveness and the dominator trees are
+// computed from the CFG and are dropped together with it.
+//
+// Usage:
+//   CFG *cfg = unit_->GetAnalyses()->GetCFG(function_);
+//   Liveness *liveness = unit_->GetAnalyses()->GetLiveness(function_);
+//   BitString live = liveness->GetLive(*bb, *insn);
+
+#ifndef MAOANALYSIS_H_
+#define MAOANALYSIS_H_
+
+#include "MaoThreads.h"
+
+class CFG;
+class DominatorTree;
+class FlagsLiveness;
+class Function;
+class Liveness;
+class LoopStructureGraph;
+class MaoEntryIntMap;
+class MaoUnit;
+class PostDominatorTree;
+class ReachingDefs;
+class Section;
+
+// The analyses known to the manager. A MaoAnalysisSet is a bitwise or
+// of these.
+enum MaoAnalysisKind {
+  ANALYSIS_NONE           = 0,
+  ANALYSIS_CFG            = 1 << 0,
+  ANALYSIS_LSG            = 1 << 1,
+  ANALYSIS_LIVENESS       = 1 << 2,
+  ANALYSIS_REACHING_DEFS  = 1 << 3,
+  ANALYSIS_SIZE_MAP       = 1 << 4,
+  ANALYSIS_FLAGS_LIVENESS = 1 << 5,
+  ANALYSIS_DOMINATORS     = 1 << 6,  // Both the dominator trees.
+  ANALYSIS_ALL            = (1 << 7) - 1
+};
+typedef unsigned int MaoAnalysisSet;
+
+class MaoAnalysisManager {
+ public:
+  explicit MaoAnalysisManager(MaoUnit *unit) : unit_(unit) { }
+
+  // Returns the analyses for the function, computing them if they are
+  // not cached. The data-flow problems are returned solved, liveness
+  // and flags liveness with their per-instruction index built.
+  CFG *GetCFG(Function *function, bool conservative = false);
+  LoopStructureGraph *GetLSG(Function *function, bool conservative = false);
+  Liveness *GetLiveness(Function *function);
+  ReachingDefs *GetReachingDefs(Function *function);
+  FlagsLiveness *GetFlagsLiveness(Function *function);
+  DominatorTree *GetDominatorTree(Function *function);
+  PostDominatorTree *GetPostDominatorTree(Function *function);
+  // Returns the size map of the section, see MaoRelaxer::GetSizeMap().
+  MaoEntryIntMap *GetSizeMap(Section *section);
+
+  // Drops the cached analyses of the function that are not in
+  // preserved, and the ones that depend on them.
+  void Invalidate(Function *function, MaoAnalysisSet preserved);
+  // Same as above, for all functions and sections of the unit.
+  void InvalidateAll(MaoAnalysisSet preserved);
+
+  // IR change tracking. The IR mutators (see MaoEntry) call
+  // NoteChange(). The counter is kept per thread, so a function pass
+  // running on a worker thread only sees its own changes.
+  static void NoteChange() { ++changes_; }
+  static long changes() { return changes_; }
+  // Drops the changes noted since changes() returned count, for edits
+  // that keep all analyses valid.
+  static void ForgetChanges(long count) { changes_ = count; }
+
+  // Guards the size and offset maps and the fragment chains of all
+  // sections, which are shared by the functions of a section. Taken by
+  // MaoRelaxer and MaoUnit::DeleteEntry(). Recursive. When both are
+  // needed, it is taken before the entry mutex of the unit.
+  static MaoMutex *size_map_mutex() { return &size_map_mutex_; }
+
+ private:
+  MaoUnit *const unit_;
+
+  static MaoMutex size_map_mutex_;
+  static __thread long changes_;
+};
+
+#endif  // MAOANALYSIS_H_
@@ -0,0 +1,103 @@
+//
+// Copyright 2010 Google Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the
+//   Free Software Foundation Inc.,
+//   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <stdlib.h>
+
+#include "MaoArena.h"
+#include "MaoDebug.h"
+
+MaoArena::MaoArena()
+    : next_(NULL), end_(NULL), bytes_reserved_(0) {
+  for (int i = 0; i < kNumSizeClasses; ++i)
+    free_lists_[i] = NULL;
+}
+
+MaoArena::~MaoArena() {
+  for (std::vector<char *>::iterator iter = chunks_.begin();
+       iter != chunks_.end(); ++iter) {
+    free(*iter);
+  }
+}
+
+char *MaoArena::NewChunk(size_t size) {
+  // malloc() aligns to at least kAlignment on the supported hosts.
+  char *chunk = static_cast<char *>(malloc(size));
+  MAO_RASSERT_MSG(chunk != NULL, "Out of memory.");
+  chunks_.push_back(chunk);
+  bytes_reserved_ += size;
+  return chunk;
+}
+
+void *MaoArena::Allocate(size_t size) {
+  size = RoundUp(size == 0 ? 1 : size);
+  MaoMutexLock lock(&mutex_);
+
+  if (size <= kMaxPooledSize) {
+    FreeBlock **free_list = &free_lists_[size / kAlignment - 1];
+    if (*free_list != NULL) {
+      FreeBlock *block = *free_list;
+      *free_list = block->next;
+      return block;
+    }
+  } else {
+    return NewChunk(size);
+  }
+
+  // Strings are packed, so next_ may be unaligned.
+  size_t misalignment = reinterpret_cast<size_t>(next_) % kAlignment;
+  char *block = next_ + (misalignment ? kAlignment - misalignment : 0);
+  if (next_ == NULL || block + size > end_) {
+    // The rest of the current chunk is abandoned.
+    next_ = NewChunk(kChunkSize);
+    end_ = next_ + kChunkSize;
+    block = next_;
+  }
+  next_ = block + size;
+  return block;
+}
+
+void MaoArena::Free(void *block, size_t size) {
+  if (block == NULL)
+    return;
+  size = RoundUp(size == 0 ? 1 : size);
+  if (size > kMaxPooledSize)
+    return;
+  MaoMutexLock lock(&mutex_);
+  FreeBlock *free_block = static_cast<FreeBlock *>(block);
+  free_block->next = free_lists_[size / kAlignment - 1];
+  free_lists_[size / kAlignment - 1] = free_block;
+}
+
+char *MaoArena::StrDup(const char *str) {
+  // Strings need no alignment, so they are packed.
+  size_t length = strlen(str) + 1;
+  if (length > kMaxPooledSize) {
+    char *copy = static_cast<char *>(Allocate(length));
+    memcpy(copy, str, length);
+    return copy;
+  }
+  MaoMutexLock lock(&mutex_);
+  if (next_ == NULL || next_ + length > end_) {
+    next_ = NewChunk(kChunkSize);
+    end_ = next_ + kChunkSize;
+  }
+  char *copy = next_;
+  memcpy(copy, str, length);
+  next_ += length;
+  return copy;
+}
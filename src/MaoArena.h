@@ -0,0 +1,111 @@
+//
+// Copyright 2010 Google Inc.
+//
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301, USA.
+
+// MaoArena is a bump allocator for the many small objects that live as
+// long as the MaoUnit: the verbatim source lines and label names of the
+// entries, and the instruction copies and expressions of instructions.
+//
+// Memory is carved from large chunks, which are only released when the
+// arena is destroyed. Blocks given back with Free() are kept on free
+// lists (one per size class) and handed out again by Allocate(), so
+// passes that repeatedly replace operands do not grow the arena.
+//
+// Usage:
+//   MaoArena *arena = unit->GetArena();
+//   char *name = arena->StrDup("foo");
+//   expressionS *expr = arena->Copy(in_expr);
+//   arena->Free(expr, sizeof(*expr));
+
+#ifndef MAOARENA_H_
+#define MAOARENA_H_
+
+#include <stddef.h>
+#include <string.h>
+
+#include <vector>
+
+#include "MaoThreads.h"
+
+class MaoArena {
+ public:
+  MaoArena();
+  ~MaoArena();
+
+  // Returns size bytes of memory, aligned to kAlignment.
+  void *Allocate(size_t size);
+  // Gives back a block returned by Allocate(size).
+  void Free(void *block, size_t size);
+
+  // Returns a copy of the string str, allocated in the arena.
+  char *StrDup(const char *str);
+  // Returns a bitwise copy of the plain old data object obj, allocated
+  // in the arena.
+  template <class T>
+  T *Copy(const T *obj) {
+    T *copy = static_cast<T *>(Allocate(sizeof(T)));
+    memcpy(copy, obj, sizeof(T));
+    return copy;
+  }
+  // Returns a zero initialized plain old data object.
+  template <class T>
+  T *NewZeroed() {
+    T *obj = static_cast<T *>(Allocate(sizeof(T)));
+    memset(obj, 0, sizeof(T));
+    return obj;
+  }
+
+  // Returns the number of bytes reserved from the system.
+  size_t bytes_reserved() const { return bytes_reserved_; }
+
+ private:
+  static const size_t kAlignment = 16;
+  static const size_t kChunkSize = 64 * 1024;
+  // Blocks up to this size are kept on free lists. Larger blocks get a
+  // chunk of their own, and are not reused.
+  static const size_t kMaxPooledSize = 1024;
+  static const int kNumSizeClasses = kMaxPooledSize / kAlignment;
+
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+
+  static size_t RoundUp(size_t size) {
+    return (size + kAlignment - 1) & ~(kAlignment - 1);
+  }
+
+  // Starts a new chunk of at least size bytes.
+  char *NewChunk(size_t size);
+
+  std::vector<char *> chunks_;
+  // The unused part of the current chunk.
+  char *next_;
+  char *end_;
+  // Free lists, indexed by size / kAlignment - 1.
+  FreeBlock *free_lists_[kNumSizeClasses];
+  size_t bytes_reserved_;
+
+  // Entries may be created by several threads at once, see
+  // MaoFunctionPassManager.
+  MaoMutex mutex_;
+
+  // Not copyable.
+  MaoArena(const MaoArena &);
+  void operator=(const MaoArena &);
+};
+
+#endif  // MAOARENA_H_
@@ -0,0 +1,149 @@
+//
+// Copyright 2010 Google Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the
+//   Free Software Foundation Inc.,
+//   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Mao.h"
+#include "MaoBatch.h"
+
+MAO_DEFINE_OPTIONS(BATCH, "Runs mao on every input of a list, "
+                   "in parallel", 3) {
+  OPTION_STR("i", "", "File with the inputs, one per line."),
+  OPTION_STR("o", ".mao.s", "Suffix of the outputs, replacing the .s of "
+             "the inputs."),
+  OPTION_INT("jobs", 0, "Number of inputs to process at a time. "
+             "0 uses one per online processor."),
+};
+
+// Set in the runs of a batch.
+static bool in_batch_run = false;
+
+static bool IsInput(const char *arg) {
+  size_t length = strlen(arg);
+  return arg[0] != '-' && length > 2 && strcmp(arg + length - 2, ".s") == 0;
+}
+
+// Appends the inputs in the list file to inputs. Empty lines and lines
+// starting with '#' are skipped.
+static void ReadInputList(const char *list_name,
+                          std::vector<std::string> *inputs) {
+  FILE *list = fopen(list_name, "r");
+  MAO_RASSERT_MSG(list, "Unable to open input list %s: %s", list_name,
+                  strerror(errno));
+  char *line = NULL;
+  size_t capacity = 0;
+  ssize_t length;
+  while ((length = getline(&line, &capacity, list)) >= 0) {
+    while (length > 0 && isspace(line[length - 1]))
+      line[--length] = '\0';
+    if (length > 0 && line[0] != '#')
+      inputs->push_back(line);
+  }
+  free(line);
+  fclose(list);
+}
+
+// Returns the output name for the input: the suffix replaces a trailing
+// .s, or is appended.
+static std::string OutputName(const std::string &input, const char *suffix) {
+  size_t length = input.size();
+  if (length > 2 && input.compare(length - 2, 2, ".s") == 0)
+    length -= 2;
+  return input.substr(0, length) + suffix;
+}
+
+bool MaoBatchRequested(MaoOptionMap *options) {
+  return !in_batch_run && (*options)["i"].cval_[0] != '\0';
+}
+
+int RunMaoBatch(int argc, const char *argv[], MaoOptionMap *options,
+                MaoRequestHandler handler) {
+  std::vector<std::string> inputs;
+  ReadInputList((*options)["i"].cval_, &inputs);
+
+  // The arguments shared by all runs.
+  std::vector<const char *> common_argv;
+  for (int i = 0; i < argc; ++i) {
+    if (i > 0 && IsInput(argv[i]))
+      inputs.push_back(argv[i]);
+    else
+      common_argv.push_back(argv[i]);
+  }
+
+  int jobs = (*options)["jobs"].ival_;
+  if (jobs <= 0)
+    jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  if (jobs <= 0)
+    jobs = 1;
+
+  const char *suffix = (*options)["o"].cval_;
+  std::map<pid_t, size_t> running;
+  size_t next = 0;
+  int failures = 0;
+  while (next < inputs.size() || !running.empty()) {
+    if (next < inputs.size() && static_cast<int>(running.size()) < jobs) {
+      // Nothing buffered here may show up in the output of a run.
+      fflush(stdout);
+      fflush(stderr);
+      pid_t pid = fork();
+      MAO_RASSERT_MSG(pid >= 0, "Unable to fork: %s", strerror(errno));
+      if (pid == 0) {
+        in_batch_run = true;
+        std::string output = "--mao=ASM=o[" +
+            OutputName(inputs[next], suffix) + "]";
+        std::vector<const char *> run_argv(common_argv);
+        run_argv.push_back(inputs[next].c_str());
+        run_argv.push_back(output.c_str());
+        run_argv.push_back(NULL);
+        // exit() flushes the stdio buffers of the run.
+        exit(handler(run_argv.size() - 1, &run_argv[0]));
+      }
+      running[pid] = next++;
+      continue;
+    }
+
+    int status;
+    pid_t pid = wait(&status);
+    if (pid < 0) {
+      MAO_RASSERT_MSG(errno == EINTR, "Unable to wait for a run: %s",
+                      strerror(errno));
+      continue;
+    }
+    std::map<pid_t, size_t>::iterator run = running.find(pid);
+    if (run == running.end())
+      continue;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      fprintf(stderr, "mao: Processing %s failed\n",
+              inputs[run->second].c_str());
+      ++failures;
+    }
+    running.erase(run);
+  }
+  return failures ? 1 : 0;
+}
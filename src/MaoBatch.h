@@ -0,0 +1,50 @@
+//
+// Copyright 2010 Google Inc.
+//
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301, USA.
+
+// Batch mode. With --mao=BATCH=i[list], one mao process handles many
+// input files: the inputs named in the list file (one per line), and
+// the arguments ending in .s (use i[/dev/null] if all inputs are given
+// as arguments). Each input is handled by a run on the rest of the
+// command line, which writes the assembly of input foo.s to foo.mao.s
+// (see the option "o").
+//
+// gas keeps its parser state in globals, so the runs can not share an
+// address space. Every run is a child process forked after the passes,
+// the register tables and the plugins are initialized, and up to "jobs"
+// runs are active at a time.
+//
+// Usage:
+//   mao --mao=BATCH=i[files.txt]+jobs[8] --mao=ZEE a.s b.s
+
+#ifndef MAOBATCH_H_
+#define MAOBATCH_H_
+
+#include "MaoOptions.h"
+#include "MaoServer.h"
+
+// Returns true if the options of the static option pass BATCH ask for
+// batch mode. Always false in the runs of a batch.
+bool MaoBatchRequested(MaoOptionMap *options);
+
+// Runs handler once for every input of the batch. argv is the command
+// line of mao, the --mao= arguments included. Returns 0 if all the runs
+// succeed, 1 otherwise.
+int RunMaoBatch(int argc, const char *argv[], MaoOptionMap *options,
+                MaoRequestHandler handler);
+
+#endif  // MAOBATCH_H_
@@ -179,6 +179,7 @@ CFGBuilder::CFGBuilder(MaoUnit *mao_unit, Function *function, CFG *CFG,
     respect_orig_labels_ = true;
   if (GetOptionBool("collect_stats")) {
     // check if a stat object already exists?
+    MaoMutexLock lock(unit_->GetStats()->mutex());
     if (unit_->GetStats()->HasStat("CFG")) {
       cfg_stat_ = static_cast<CFGStat *>(unit_->GetStats()->GetStat("CFG"));
     } else {
@@ -187,6 +188,7 @@ CFGBuilder::CFGBuilder(MaoUnit *mao_unit, Function *function, CFG *CFG,
     }
   }
   CFG_->set_conservative(conservative);
+  Preserve(ANALYSIS_ALL);
 }
 
 
@@ -249,7 +251,7 @@ bool CFGBuilder::Go() {
 
         label = static_cast<LabelEntry *>(entry)->name();
       } else {
-        label = MaoUnit::BBNameGen::GetUniqueName();
+        label = MaoUnit::BBNameGen::GetUniqueName(function_);
       }
 
       if ((current = CFG_->FindBasicBlock(label)) == NULL) {
@@ -267,7 +269,7 @@ bool CFGBuilder::Go() {
 
     // If the current entry is a label, update the map of labels
     if (entry->Type() == MaoEntry::LABEL)
-      label_to_bb_map_[static_cast<LabelEntry *>(entry)->name()] = current;
+      label_to_bb_map_.Set(static_cast<LabelEntry *>(entry)->name(), current);
 
     // Check to see if this operation creates out edges
     int inserted_edges = 0;
@@ -282,7 +284,9 @@ bool CFGBuilder::Go() {
                  &va_arg_targets);
       for (LabelVector::iterator iter = targets.begin(); iter != targets.end();
            ++iter) {
-        Label label = *iter;
+        // Interned, so that labels can be compared by address.
+        Label label = *iter == NULL ? NULL :
+            unit_->GetStringPool()->Intern(*iter);
         BasicBlock *target = NULL;
 
         // A NULL label means unknown target
@@ -291,9 +295,8 @@ bool CFGBuilder::Go() {
         } else {
           target = CFG_->FindBasicBlock(label);
           if (target == NULL) {
-            CFG::LabelToBBMap::iterator target_ptr =
-                label_to_bb_map_.find(label);
-            if (target_ptr == label_to_bb_map_.end()) {
+            BasicBlock *label_bb = label_to_bb_map_.Find(label);
+            if (label_bb == NULL) {
               // Create a new basic block for the label found as a jump target.
               // Here we can check if this label is defined in this basic block
               // Check if the label_entry exists in MAO UNIT
@@ -309,8 +312,8 @@ bool CFGBuilder::Go() {
               target = CreateBasicBlock(label);
               CFG_->MapBasicBlock(target);
             } else {
-              target = target_ptr->second;
-              if (strcmp(label, target->label())) {
+              target = label_bb;
+              if (label != target->label()) {
                 bool current_is_target = (target == current);
                 target = BreakUpBBAtLabel(target,
                                           unit_->GetLabelEntry(label));
@@ -323,7 +326,7 @@ bool CFGBuilder::Go() {
                   if (temp_entry->Type() == MaoEntry::LABEL) {
                     LabelEntry *temp_label =
                         static_cast<LabelEntry *>(temp_entry);
-                    label_to_bb_map_[temp_label->name()] = target;
+                    label_to_bb_map_.Set(temp_label->name(), target);
                   }
                 }
 
@@ -886,13 +889,16 @@ void CFGBuilder::GetTargets(MaoEntry *entry, OutputIterator iter,
           (*p_iter)->prev()->IsLabel()) {
         *iter++ = (*p_iter)->prev()->AsLabel()->name();
       } else {
-        // Add a label before p_iter if necessary
+        // Add a label before p_iter if necessary. The label does not
+        // change the code, so it is not counted as a change of the IR.
+        long changes = MaoAnalysisManager::changes();
         LabelEntry *l = unit_->CreateLabel(
-            MaoUnit::BBNameGen::GetUniqueName(),
+            MaoUnit::BBNameGen::GetUniqueName(function_),
             function_,
             function_->GetSubSection());
         l->set_from_assembly(false);
         (*p_iter)->LinkBefore(l);
+        MaoAnalysisManager::ForgetChanges(changes);
         *iter++ = l->name();
       }
       processed = true;
@@ -58,6 +58,7 @@
 #include "MaoPasses.h"
 #include "MaoUtil.h"
 #include "MaoStats.h"
+#include "MaoStringMap.h"
 
 class MaoEntry;
 class InstructionEntry;
@@ -239,8 +240,9 @@ class BasicBlock {
 
 // Control Flow Graph
 // Use CFG::GetCFG() to get the CFG for a function. The CFG is cached,
-// and using this method avoids unnecessary regenerations. Invalidate
-// the CFG using CFG::InvalidateCFG() if necessary.
+// and using this method avoids unnecessary regenerations. The CFG is
+// invalidated after a pass that changed the IR (see MaoAnalysis.h),
+// or explicitly using CFG::InvalidateCFG().
 //
 // All CFGs also have two special blocks called "<SOURCE>" and
 // "<SINK>". The source is always the first basic block of the CFG and
@@ -249,7 +251,8 @@ class BasicBlock {
 class CFG {
  public:
   typedef std::vector<BasicBlock *> BBVector;
-  typedef std::map<const char *, BasicBlock *, ltstr> LabelToBBMap;
+  // Maps interned labels (see MaoStringPool) to basic blocks.
+  typedef MaoStringMap<BasicBlock *> LabelToBBMap;
   explicit CFG(MaoUnit *mao_unit) : mao_unit_(mao_unit),
                                     num_external_jumps_(0),
                                     num_unresolved_indirect_jumps_(0) {
@@ -287,11 +290,11 @@ class CFG {
 
   // Adds a basic block to the CFG.
   void AddBasicBlock(BasicBlock *bb) { basic_blocks_.push_back(bb); }
-  // Puts the basic block in the map from label to basic block.
+  // Puts the basic block in the map from label to basic block. The label
+  // of the basic block must be interned.
   // TODO(martint): Should be done automatically when creating a basic block.
   void MapBasicBlock(BasicBlock *bb) {
-    MAO_RASSERT(basic_block_map_.insert(std::make_pair(bb->label(),
-                                                       bb)).second);
+    MAO_RASSERT(basic_block_map_.Insert(bb->label(), bb));
   }
 
   // Returns the basic block of a given id. Assumes that an basic block with
@@ -300,10 +303,7 @@ class CFG {
   // Finds a basic block for a given label, or returns NULL if one has not
   // already exists.
   BasicBlock *FindBasicBlock(const char *label) {
-    LabelToBBMap::iterator bb = basic_block_map_.find(label);
-    if (bb == basic_block_map_.end())
-      return NULL;
-    return bb->second;
+    return basic_block_map_.Find(mao_unit_->GetStringPool()->Find(label));
   }
 
   // Iterators for the basic blocks.
@@ -421,7 +421,8 @@ class CFGBuilder : public MaoFunctionPass {
 
  private:
   BasicBlock *CreateBasicBlock(const char *label) {
-    BasicBlock *bb = new BasicBlock(next_id_, label);
+    BasicBlock *bb = new BasicBlock(next_id_,
+                                    unit_->GetStringPool()->Intern(label));
     CFG_->AddBasicBlock(bb);
     next_id_++;
     return bb;
@@ -474,16 +475,20 @@ class CFGBuilder : public MaoFunctionPass {
                 number_of_tail_calls_(0), number_of_unresolved_jumps_(0)
     {;}
     ~CFGStat() {;}
-    void FoundDirectJump()        { ++number_of_direct_jumps_; }
-    void FoundIndirectJump()      { ++number_of_indirect_jumps_; }
-    void FoundJumpTablePattern()  { ++number_of_jump_table_patterns_; }
-    void FoundVaargPattern()      { ++number_of_vaarg_patterns_; }
-    void FoundTailCall()          { ++number_of_tail_calls_; }
-    void FoundUnresolvedJump()    { ++number_of_unresolved_jumps_; }
+    // CFGs may be built concurrently by the function pass manager,
+    // so the counters are updated atomically.
+    void FoundDirectJump()        { Inc(&number_of_direct_jumps_); }
+    void FoundIndirectJump()      { Inc(&number_of_indirect_jumps_); }
+    void FoundJumpTablePattern()  { Inc(&number_of_jump_table_patterns_); }
+    void FoundVaargPattern()      { Inc(&number_of_vaarg_patterns_); }
+    void FoundTailCall()          { Inc(&number_of_tail_calls_); }
+    void FoundUnresolvedJump()    { Inc(&number_of_unresolved_jumps_); }
 
     virtual void Print(FILE *out);
 
    private:
+    static void Inc(int *counter) { __sync_fetch_and_add(counter, 1); }
+
     int number_of_direct_jumps_;
     int number_of_indirect_jumps_;
     int number_of_jump_table_patterns_;
@@ -0,0 +1,367 @@
+//
+// Copyright 2010 Google Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the
+//   Free Software Foundation Inc.,
+//   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Mao.h"
+#include "MaoCache.h"
+#include "md5.h"
+
+MAO_DEFINE_OPTIONS(CACHE, "Reuses the assembly output of earlier runs "
+                   "on the same input and options", 2) {
+  OPTION_STR("d", "", "Directory of the cache. The cache is off if empty."),
+  OPTION_INT("size", 1024, "Size limit of the cache in megabytes."),
+};
+
+// Suffix of the entry files.
+static const char kEntrySuffix[] = ".s";
+
+static bool CopyFile(const char *from, const char *to) {
+  int in = open(from, O_RDONLY);
+  if (in < 0)
+    return false;
+  int out = open(to, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (out < 0) {
+    close(in);
+    return false;
+  }
+
+  bool ok = true;
+  char buffer[64 * 1024];
+  for (;;) {
+    ssize_t got = read(in, buffer, sizeof(buffer));
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got <= 0) {
+      ok = got == 0;
+      break;
+    }
+    for (char *next = buffer; got > 0; ) {
+      ssize_t written = write(out, next, got);
+      if (written < 0 && errno == EINTR)
+        continue;
+      if (written <= 0) {
+        ok = false;
+        break;
+      }
+      next += written;
+      got -= written;
+    }
+    if (!ok)
+      break;
+  }
+  close(in);
+  return close(out) == 0 && ok;
+}
+
+// Adds the data to the hash, preceded by its length so that the fields
+// of the key can not run into each other.
+static void HashField(const void *data, size_t length, struct md5_ctx *ctx) {
+  md5_process_bytes(&length, sizeof(length), ctx);
+  md5_process_bytes(data, length, ctx);
+}
+
+static void HashString(const std::string &str, struct md5_ctx *ctx) {
+  HashField(str.data(), str.size(), ctx);
+}
+
+// Adds the size and modification time of the file to the hash.
+static void HashFileStat(const char *path, struct md5_ctx *ctx) {
+  struct stat st;
+  if (stat(path, &st) != 0)
+    memset(&st, 0, sizeof(st));
+  long long fields[2] = { st.st_size, st.st_mtime };
+  HashField(fields, sizeof(fields), ctx);
+}
+
+static bool ReadFileContents(const char *path, std::string *contents) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+  char buffer[64 * 1024];
+  ssize_t got;
+  while ((got = read(fd, buffer, sizeof(buffer))) != 0) {
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got < 0) {
+      close(fd);
+      return false;
+    }
+    contents->append(buffer, got);
+  }
+  close(fd);
+  return true;
+}
+
+// Passes that write output of their own, files, dumps or reports.
+static const char *const kOutputPasses[] = {
+  "DCE", "DOT", "IR", "IRSAVE", "LFIND", "OBJ", "PREFALIAS", "RATFINDER",
+  "SYMBOLTABLE", "TEST", "TESTDF", "TESTPLUG",
+};
+
+// Returns true if the assembly of a single ASM pass is the only output
+// of the pipeline, the only one a hit restores.
+static bool WritesOnlyAsm(const MaoOptions &options) {
+  int asm_passes = 0;
+  const MaoOptions::Pipeline &pipeline = options.pipeline();
+  for (MaoOptions::Pipeline::const_iterator iter = pipeline.begin();
+       iter != pipeline.end(); ++iter) {
+    const char *name = iter->first.c_str();
+    MaoOptionMap *pass_options = iter->second;
+    if (!strcasecmp(name, "ASM")) {
+      ++asm_passes;
+      continue;
+    }
+    for (size_t i = 0; i < sizeof(kOutputPasses) / sizeof(*kOutputPasses);
+         ++i) {
+      if (!strcasecmp(name, kOutputPasses[i]))
+        return false;
+    }
+    MaoOptionMap::iterator trace = pass_options->find("trace");
+    if (trace != pass_options->end() && trace->second.ival_ > 0)
+      return false;
+    MaoOptionMap::iterator vcg = pass_options->find("vcg");
+    if (vcg != pass_options->end() && vcg->second.bval_)
+      return false;
+  }
+  return asm_passes == 1;
+}
+
+// Options that name a file read by the pass. The option value alone
+// does not tell whether the file changed.
+static const struct {
+  const char *pass;
+  const char *option;
+} kInputFileOptions[] = {
+  { "PROFILE", "sample_profile" },
+  { "INSPREFNTA", "instn_list" },
+  { "SCHEDULER", "functions_file" },
+};
+
+// Adds the contents of the files named by kInputFileOptions to the
+// hash. Returns false if one of them can not be read.
+static bool HashInputFiles(const MaoOptions &options, struct md5_ctx *ctx) {
+  const MaoOptions::Pipeline &pipeline = options.pipeline();
+  for (MaoOptions::Pipeline::const_iterator iter = pipeline.begin();
+       iter != pipeline.end(); ++iter) {
+    for (size_t i = 0;
+         i < sizeof(kInputFileOptions) / sizeof(*kInputFileOptions); ++i) {
+      if (strcasecmp(iter->first.c_str(), kInputFileOptions[i].pass))
+        continue;
+      MaoOptionMap::iterator file =
+          iter->second->find(kInputFileOptions[i].option);
+      if (file == iter->second->end() || file->second.cval_ == NULL ||
+          file->second.cval_[0] == '\0')
+        continue;
+      std::string contents;
+      if (!ReadFileContents(file->second.cval_, &contents))
+        return false;
+      HashString(contents, ctx);
+    }
+  }
+  return true;
+}
+
+// Returns true if the assembly may pull in other files, which are not
+// part of the key.
+static bool MayIncludeFiles(const std::string &contents) {
+  return contents.find(".include") != std::string::npos ||
+      contents.find(".incbin") != std::string::npos;
+}
+
+// Reports whether the cache was hit.
+class CacheStat : public Stat {
+ public:
+  CacheStat(bool hit, int total_hits, int total_lookups)
+      : hit_(hit), total_hits_(total_hits), total_lookups_(total_lookups) {}
+
+  virtual void Print(FILE *out) {
+    fprintf(out, "CACHE: %s\n", hit_ ? "hit" : "miss");
+    if (total_lookups_ > 0)
+      fprintf(out, "CACHE: Hit rate: %7.1f%% (%d of %d lookups)\n",
+              100.0 * total_hits_ / total_lookups_, total_hits_,
+              total_lookups_);
+  }
+
+ private:
+  const bool hit_;
+  const int total_hits_;
+  const int total_lookups_;
+};
+
+MaoResultCache::MaoResultCache(MaoOptionMap *options)
+    : directory_((*options)["d"].cval_),
+      size_limit_((*options)["size"].ival_ * 1024LL * 1024LL),
+      hit_(false), total_hits_(0), total_lookups_(0) { }
+
+bool MaoResultCache::ComputeKey(int argc, const char *argv[],
+                                const MaoOptions &options) {
+  if (!WritesOnlyAsm(options))
+    return false;
+
+  struct md5_ctx ctx;
+  md5_init_ctx(&ctx);
+
+  HashString(MAO_VERSION, &ctx);
+  HashFileStat("/proc/self/exe", &ctx);
+  const std::vector<LoadedPlugin> &plugins = GetLoadedPlugins();
+  for (std::vector<LoadedPlugin>::const_iterator iter = plugins.begin();
+       iter != plugins.end(); ++iter) {
+    HashString(iter->path, &ctx);
+    HashField(&iter->version, sizeof(iter->version), &ctx);
+    HashFileStat(iter->path.c_str(), &ctx);
+  }
+
+  // The input files are hashed by contents, so that the same input
+  // under another name hits.
+  bool has_input = false;
+  for (int i = 1; i < argc; ++i) {
+    struct stat st;
+    if (argv[i][0] != '-' && stat(argv[i], &st) == 0 && S_ISREG(st.st_mode)) {
+      std::string contents;
+      if (!ReadFileContents(argv[i], &contents) || MayIncludeFiles(contents))
+        return false;
+      HashString(contents, &ctx);
+      has_input = true;
+    } else {
+      HashString(argv[i], &ctx);
+    }
+  }
+  if (!has_input)
+    return false;
+
+  HashString(options.PipelineKey(), &ctx);
+  if (!HashInputFiles(options, &ctx))
+    return false;
+
+  unsigned char digest[16];
+  md5_finish_ctx(&ctx, digest);
+  char hex[sizeof(digest) * 2 + 1];
+  for (size_t i = 0; i < sizeof(digest); ++i)
+    sprintf(hex + 2 * i, "%02x", digest[i]);
+  key_ = hex;
+  return true;
+}
+
+std::string MaoResultCache::EntryPath() const {
+  return std::string(directory_) + "/" + key_ + kEntrySuffix;
+}
+
+bool MaoResultCache::Lookup(const char *output_file) {
+  MAO_ASSERT(!key_.empty());
+  std::string entry = EntryPath();
+  hit_ = CopyFile(entry.c_str(), output_file);
+  if (hit_) {
+    // Marks the entry as recently used.
+    utime(entry.c_str(), NULL);
+  }
+  CountLookup(hit_);
+  return hit_;
+}
+
+void MaoResultCache::Store(const char *output_file) {
+  MAO_ASSERT(!key_.empty());
+  // Outputs like /dev/stdout can not be read back.
+  struct stat st;
+  if (stat(output_file, &st) != 0 || !S_ISREG(st.st_mode))
+    return;
+
+  mkdir(directory_, 0777);
+  // Concurrent runs may store the same entry, each writes its own
+  // temporary file and renames it into place.
+  char suffix[32];
+  sprintf(suffix, ".tmp.%d", static_cast<int>(getpid()));
+  std::string entry = EntryPath();
+  std::string temporary = entry + suffix;
+  if (!CopyFile(output_file, temporary.c_str()) ||
+      rename(temporary.c_str(), entry.c_str()) != 0) {
+    unlink(temporary.c_str());
+    return;
+  }
+  Evict();
+}
+
+void MaoResultCache::CountLookup(bool hit) {
+  mkdir(directory_, 0777);
+  std::string path = std::string(directory_) + "/stats";
+  int fd = open(path.c_str(), O_RDWR | O_CREAT, 0666);
+  if (fd < 0)
+    return;
+  if (flock(fd, LOCK_EX) == 0) {
+    char buffer[64];
+    ssize_t got = pread(fd, buffer, sizeof(buffer) - 1, 0);
+    buffer[got > 0 ? got : 0] = '\0';
+    if (sscanf(buffer, "%d %d", &total_hits_, &total_lookups_) != 2)
+      total_hits_ = total_lookups_ = 0;
+    total_hits_ += hit ? 1 : 0;
+    total_lookups_ += 1;
+    int length = sprintf(buffer, "%d %d\n", total_hits_, total_lookups_);
+    if (ftruncate(fd, 0) != 0 || pwrite(fd, buffer, length, 0) != length)
+      total_lookups_ = 0;
+  }
+  close(fd);
+}
+
+void MaoResultCache::Evict() {
+  DIR *dir = opendir(directory_);
+  if (!dir)
+    return;
+
+  // The entries as (modification time, path), and their total size.
+  std::vector<std::pair<std::pair<time_t, off_t>, std::string> > entries;
+  long long total = 0;
+  size_t suffix_length = strlen(kEntrySuffix);
+  while (struct dirent *dirent = readdir(dir)) {
+    size_t length = strlen(dirent->d_name);
+    if (length <= suffix_length ||
+        strcmp(dirent->d_name + length - suffix_length, kEntrySuffix) != 0)
+      continue;
+    std::string path = std::string(directory_) + "/" + dirent->d_name;
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+      continue;
+    entries.push_back(std::make_pair(std::make_pair(st.st_mtime, st.st_size),
+                                     path));
+    total += st.st_size;
+  }
+  closedir(dir);
+
+  std::sort(entries.begin(), entries.end());
+  for (size_t i = 0; i < entries.size() && total > size_limit_; ++i) {
+    if (unlink(entries[i].second.c_str()) == 0)
+      total -= entries[i].first.second;
+  }
+}
+
+void MaoResultCache::AddStat(Stats *stats) const {
+  stats->Add("CACHE", new CacheStat(hit_, total_hits_, total_lookups_));
+}
@@ -0,0 +1,101 @@
+//
+// Copyright 2010 Google Inc.
+//
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301, USA.
+
+// Result cache. With --mao=CACHE=d[dir], the assembly output of a run
+// is kept in the directory dir, under the MD5 of
+//   - the contents of the input files, and the other gas arguments,
+//   - the pass pipeline and all options (see MaoOptions::PipelineKey()),
+//     and the contents of the files that options name as pass inputs,
+//     e.g. the sample profile of PROFILE,
+//   - the MAO version and binary, and the version and file of every
+//     loaded plugin.
+// A later run with the same key copies the output from the cache, and
+// neither parses the input nor runs a pass.
+//
+// A hit restores only the assembly, so runs with other output are not
+// cached: runs with more than one ASM pass, with passes that write
+// files, dumps or reports, or with traces. Neither are inputs that use
+// .include or .incbin, since the included files are not part of the
+// key.
+//
+// The entries are files named after the key. A hit updates the
+// modification time of the entry, and when the entries exceed the size
+// limit, the least recently used ones are removed. The file "stats" in
+// the directory counts hits and lookups over all runs.
+//
+// Usage:
+//   MaoResultCache cache(GetStaticOptionPass("CACHE"));
+//   if (cache.enabled() && cache.ComputeKey(argc, argv, options)) {
+//     if (!cache.Lookup(output)) {
+//       ... run, writing output ...
+//       cache.Store(output);
+//     }
+//   }
+
+#ifndef MAOCACHE_H_
+#define MAOCACHE_H_
+
+#include <string>
+
+#include "MaoOptions.h"
+
+class Stats;
+
+class MaoResultCache {
+ public:
+  // options are the options of the static option pass CACHE.
+  explicit MaoResultCache(MaoOptionMap *options);
+
+  // Returns true if a cache directory is given.
+  bool enabled() const { return directory_[0] != '\0'; }
+
+  // Computes the key of a run on the gas command line argv, i.e.
+  // without the --mao= arguments. Returns false if the run can not be
+  // cached, because it reads standard input, includes files, writes
+  // more than the assembly or names a pass input that can not be read
+  // (see above).
+  bool ComputeKey(int argc, const char *argv[], const MaoOptions &options);
+
+  // On a hit, copies the cached output to output_file and returns true.
+  bool Lookup(const char *output_file);
+
+  // Adds output_file, written by the run, to the cache.
+  void Store(const char *output_file);
+
+  // Adds the result of the lookup to the stats.
+  void AddStat(Stats *stats) const;
+
+ private:
+  std::string EntryPath() const;
+  // Counts the lookup in the stats file, and reads the totals.
+  void CountLookup(bool hit);
+  // Removes the least recently used entries beyond the size limit.
+  void Evict();
+
+  const char *directory_;
+  const long long size_limit_;
+
+  // The key in hex, empty until computed.
+  std::string key_;
+
+  bool hit_;
+  int total_hits_;
+  int total_lookups_;
+};
+
+#endif  // MAOCACHE_H_
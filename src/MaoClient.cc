@@ -0,0 +1,155 @@
+//
+// Copyright 2010 Google Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the
+//   Free Software Foundation Inc.,
+//   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// mao-client sends its command line to a MAO server (see MaoServer.h)
+// and exits with the exit status of the run. The run uses the working
+// directory, MAOOPTS and the standard input, output and error of the
+// client.
+//
+//   mao-client SOCKET [mao arguments]
+//
+// If the server can not be reached, the client exits with
+// EX_UNAVAILABLE, so that callers can run mao directly instead.
+//
+// The client does not link with the rest of MAO, so that it starts fast.
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sysexits.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "MaoServer.h"
+
+static void Fail(const char *message) {
+  fprintf(stderr, "mao-client: %s: %s\n", message, strerror(errno));
+  exit(1);
+}
+
+static int Connect(const char *socket_path) {
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (strlen(socket_path) >= sizeof(address.sun_path))
+    return -1;
+  strcpy(address.sun_path, socket_path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  if (connect(fd, reinterpret_cast<struct sockaddr *>(&address),
+              sizeof(address)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// Sends the size of the request together with the standard descriptors.
+static void SendHeader(int fd, int size) {
+  static const int kStandardFds[3] = { 0, 1, 2 };
+  char control[CMSG_SPACE(sizeof(kStandardFds))];
+  memset(control, 0, sizeof(control));
+  struct iovec iov;
+  iov.iov_base = &size;
+  iov.iov_len = sizeof(size);
+  struct msghdr message;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+  header->cmsg_level = SOL_SOCKET;
+  header->cmsg_type = SCM_RIGHTS;
+  header->cmsg_len = CMSG_LEN(sizeof(kStandardFds));
+  memcpy(CMSG_DATA(header), kStandardFds, sizeof(kStandardFds));
+
+  ssize_t sent;
+  do {
+    sent = sendmsg(fd, &message, 0);
+  } while (sent < 0 && errno == EINTR);
+  if (sent != sizeof(size))
+    Fail("Unable to send request");
+}
+
+int main(int argc, const char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s SOCKET [mao arguments]\n", argv[0]);
+    return 1;
+  }
+
+  std::string request;
+  char cwd[PATH_MAX];
+  if (getcwd(cwd, sizeof(cwd)) == NULL)
+    Fail("Unable to get the working directory");
+  request.append(cwd, strlen(cwd) + 1);
+  const char *mao_opts = getenv("MAOOPTS");
+  if (mao_opts != NULL) {
+    request.append("=");
+    request.append(mao_opts);
+  }
+  request.append(1, '\0');
+  for (int i = 2; i < argc; ++i)
+    request.append(argv[i], strlen(argv[i]) + 1);
+  if (request.size() > static_cast<size_t>(kMaoMaxRequestSize)) {
+    fprintf(stderr, "mao-client: Command line too long\n");
+    return 1;
+  }
+
+  int fd = Connect(argv[1]);
+  if (fd < 0)
+    return EX_UNAVAILABLE;
+
+  SendHeader(fd, request.size());
+  const char *data = request.data();
+  size_t length = request.size();
+  while (length > 0) {
+    ssize_t written = write(fd, data, length);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written <= 0)
+      Fail("Unable to send request");
+    data += written;
+    length -= written;
+  }
+
+  int status;
+  char *next = reinterpret_cast<char *>(&status);
+  size_t left = sizeof(status);
+  while (left > 0) {
+    ssize_t got = read(fd, next, left);
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got <= 0) {
+      fprintf(stderr, "mao-client: Server closed the connection\n");
+      return 1;
+    }
+    next += got;
+    left -= got;
+  }
+  close(fd);
+  return status;
+}
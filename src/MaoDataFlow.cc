@@ -15,8 +15,9 @@
 // along with this program; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301, USA.
 
-#include <map>
-#include <set>
+#include <algorithm>
+#include <utility>
+#include <vector>
 
 #include "Mao.h"
 
@@ -28,9 +29,6 @@ DFProblem::DFProblem(MaoUnit *unit,
       direction_(direction) {}
 
 bool DFProblem::Solve() {
-  // TODO(martint): Updated code to use Trace() if possible.
-  fprintf(stderr, "Inside DFProblem::Solve\n");
-
   // Terminology used inside this function:
   //    In order to create names that work in both forward
   //    and backwards problem the names "entry" and "exit" are used
@@ -40,98 +38,168 @@ bool DFProblem::Solve() {
 
   // Algorithm used to solve the DF problem:
   // for i <- 1 to N
-  //    initialize node i
-  // while (sets are still changing)
-  //   for i <- 1 to N
-  //     recompute sets at node i
+  //    initialize node i and put it on the worklist
+  // while (worklist is not empty)
+  //   for i in visit order
+  //     if node i is on the worklist
+  //       recompute sets at node i
+  //       if the exit set changed, put the nodes depending on it
+  //       on the worklist
+  //
+  // The visit order (see GetVisitOrder()) makes a node see the new
+  // states of most of its neighbors in the same sweep, so only a few
+  // sweeps are needed.
 
   MAO_ASSERT_MSG(!solved_, "Problem is already solved.");
   MAO_ASSERT(function_);
   MAO_ASSERT(cfg_);
 
-  // TODO(martint): Only one is actually needed if we are low on memory.
-  std::map<const BasicBlock *, BitString> entry_map;
-  std::map<const BasicBlock *, BitString> exit_map;
-
-  std::map<const BasicBlock *, BitString> gen_map;
-  std::map<const BasicBlock *, BitString> kill_map;
+  // The sets are indexed by basic block id.
+  int num_blocks = cfg_->GetNumOfNodes();
+  std::vector<BitString> entry_sets;
+  std::vector<BitString> exit_sets;
+  std::vector<BitString> gen_sets;
+  std::vector<BitString> kill_sets;
 
   // Do not try to solve a problem that has zero-length bit sets.
   if (num_bits_ > 0) {
-    bool dirty;
-    int num_iterations = 0;
+    entry_sets.resize(num_blocks, BitString(num_bits_));
+    exit_sets.resize(num_blocks, BitString(num_bits_));
+    gen_sets.resize(num_blocks, BitString(num_bits_));
+    kill_sets.resize(num_blocks, BitString(num_bits_));
 
-    // Initialize all to empty sets.
+    // Generate initial values for our states and gen/kill sets.
     FORALL_CFG_BB(cfg_, it) {
       const BasicBlock *bb = *it;
-      // Generate initial values for our states and gen/kill sets.
-      entry_map[bb] = GetInitialEntryState();
-      gen_map[bb] = CreateGenSet(*bb);
-      kill_map[bb] = CreateKillSet(*bb);
-      exit_map[bb] = Transfer(entry_map[bb],
-                              gen_map[bb],
-                              kill_map[bb]);
+      BasicBlockID id = bb->id();
+      MAO_ASSERT(id >= 0 && id < num_blocks);
+      entry_sets[id] = GetInitialEntryState();
+      gen_sets[id] = CreateGenSet(*bb);
+      kill_sets[id] = CreateKillSet(*bb);
+      exit_sets[id] = Transfer(entry_sets[id], gen_sets[id], kill_sets[id]);
     }
 
+    std::vector<const BasicBlock *> order;
+    GetVisitOrder(&order);
+    std::vector<bool> on_worklist(num_blocks, true);
+    int worklist_size = num_blocks;
+    int num_iterations = 0;
+    BitString entry_new(num_bits_);
+
     // Loop until convergance.
-    do {
-      dirty = false;
-      // TODO(martint): Think about the order you iterate on.
-      FORALL_CFG_BB(cfg_, it) {
+    while (worklist_size > 0) {
+      for (std::vector<const BasicBlock *>::const_iterator it = order.begin();
+           it != order.end(); ++it) {
         const BasicBlock *bb = *it;
-        std::set<BitString *> confluence_set;
+        BasicBlockID id = bb->id();
+        if (!on_worklist[id])
+          continue;
+        on_worklist[id] = false;
+        --worklist_size;
+
+        // For backwards problems, the confluence is over the
+        // successors, for forward problems over the predecessors.
+        BasicBlock::ConstEdgeIterator eiter, eend;
         if (direction_ == DF_Backward) {
-          // For backwards problems, confluence_set = successors.
-          for (BasicBlock::ConstEdgeIterator eiter = bb->BeginOutEdges();
-               eiter != bb->EndOutEdges(); ++eiter) {
-            MAO_ASSERT((*eiter)->source() == *it);
-            MAO_ASSERT((*eiter)->dest() != NULL);
-            confluence_set.insert(&exit_map[(*eiter)->dest()]);
-          }
-        } else if (direction_ == DF_Forward) {
-          // For forward problems, confluence_set = predecessors.
-          for (BasicBlock::ConstEdgeIterator eiter = bb->BeginInEdges();
-               eiter != bb->EndInEdges(); ++eiter) {
-            MAO_ASSERT((*eiter)->dest() == *it);
-            MAO_ASSERT((*eiter)->source() != NULL);
-            confluence_set.insert(&exit_map[(*eiter)->source()]);
-          }
+          eiter = bb->BeginOutEdges();
+          eend = bb->EndOutEdges();
         } else {
-          // Problem should either be DF_Backward or DF_Forward.
-          MAO_ASSERT(false);
+          eiter = bb->BeginInEdges();
+          eend = bb->EndInEdges();
+        }
+        if (eiter == eend)
+          continue;
+        for (bool first = true; eiter != eend; ++eiter, first = false) {
+          const BasicBlock *neighbor = direction_ == DF_Backward ?
+              (*eiter)->dest() : (*eiter)->source();
+          MAO_ASSERT(neighbor != NULL);
+          if (first)
+            entry_new = exit_sets[neighbor->id()];
+          else
+            Confluence(&entry_new, exit_sets[neighbor->id()]);
         }
-        if (confluence_set.size() > 0) {
-          BitString entry_new = Confluence(confluence_set);
-          // Update if changed.
-          if (!(entry_new == entry_map[bb])) {
-            entry_map[bb] = entry_new;
-            dirty = true;
-
-            // Calculate the new exit state.
-            BitString exit_new = Transfer(entry_map[bb],
-                                          gen_map[bb],
-                                          kill_map[bb]);
-            // No need to compare the new value, just overwrite the old
-            // value even if its identical to the previous value.
-            exit_map[bb] = exit_new;
+
+        // Update if changed.
+        if (entry_new == entry_sets[id])
+          continue;
+        entry_sets[id] = entry_new;
+        BitString exit_new = Transfer(entry_sets[id],
+                                      gen_sets[id],
+                                      kill_sets[id]);
+        if (exit_new == exit_sets[id])
+          continue;
+        exit_sets[id] = exit_new;
+
+        // The blocks merging this exit set have to be revisited.
+        if (direction_ == DF_Backward) {
+          eiter = bb->BeginInEdges();
+          eend = bb->EndInEdges();
+        } else {
+          eiter = bb->BeginOutEdges();
+          eend = bb->EndOutEdges();
+        }
+        for (; eiter != eend; ++eiter) {
+          BasicBlockID dependent = direction_ == DF_Backward ?
+              (*eiter)->source()->id() : (*eiter)->dest()->id();
+          if (!on_worklist[dependent]) {
+            on_worklist[dependent] = true;
+            ++worklist_size;
           }
         }
       }
       ++num_iterations;
       MAO_ASSERT(num_iterations <= kMaxNumberOfIterations);
-    } while (dirty);
-
-    fprintf(stderr, "Num iterations :%d\n", num_iterations);
+    }
   }
   // Save the result.
-  df_solution_ = entry_map;
+  df_solution_.swap(entry_sets);
   solved_ = true;
   return solved_;
 }
 
+void DFProblem::GetVisitOrder(std::vector<const BasicBlock *> *order) const {
+  // Iterative depth first search from the source, following the
+  // forward edges, recording the blocks in post-order.
+  int num_blocks = cfg_->GetNumOfNodes();
+  std::vector<bool> visited(num_blocks, false);
+  std::vector<std::pair<const BasicBlock *,
+                        BasicBlock::ConstEdgeIterator> > stack;
+  order->clear();
+  order->reserve(num_blocks);
+
+  const BasicBlock *source = cfg_->Source();
+  visited[source->id()] = true;
+  stack.push_back(std::make_pair(source, source->BeginOutEdges()));
+  while (!stack.empty()) {
+    const BasicBlock *bb = stack.back().first;
+    BasicBlock::ConstEdgeIterator &eiter = stack.back().second;
+    if (eiter == bb->EndOutEdges()) {
+      order->push_back(bb);
+      stack.pop_back();
+      continue;
+    }
+    const BasicBlock *dest = (*eiter)->dest();
+    ++eiter;
+    MAO_ASSERT(dest != NULL);
+    if (!visited[dest->id()]) {
+      visited[dest->id()] = true;
+      stack.push_back(std::make_pair(dest, dest->BeginOutEdges()));
+    }
+  }
+
+  if (direction_ == DF_Forward)
+    std::reverse(order->begin(), order->end());
+
+  // Blocks not reachable from the source still get a solution.
+  FORALL_CFG_BB(cfg_, it) {
+    if (!visited[(*it)->id()])
+      order->push_back(*it);
+  }
+}
+
 // Debug function to print out internal state on stderr.
-void DFProblem::DumpState(std::map<const BasicBlock *, BitString> in_map,
-                          std::map<const BasicBlock *, BitString> out_map) {
+void DFProblem::DumpState(const std::vector<BitString> &in_sets,
+                          const std::vector<BitString> &out_sets) {
   // Print out the state at a given moment:
   //  - function name
   // Loop over basic blocks and print
@@ -142,18 +210,19 @@ void DFProblem::DumpState(std::map<const BasicBlock *, BitString> in_map,
   // Loop over function and generate gen sets
   FORALL_CFG_BB(cfg_, it) {
     const BasicBlock *bb = *it;
-    if (!in_map.find(bb)->second.IsNull()
-        || !out_map.find(bb)->second.IsNull()) {
+    const BitString &in_set = in_sets[bb->id()];
+    const BitString &out_set = out_sets[bb->id()];
+    if (!in_set.IsNull() || !out_set.IsNull()) {
       fprintf(stderr, "bb: %s\n", bb->label());
     }
-    if (!in_map.find(bb)->second.IsNull()) {
+    if (!in_set.IsNull()) {
       fprintf(stderr, "in : ");
-      in_map.find(bb)->second.Print();
+      in_set.Print();
       fprintf(stderr, "\n");
     }
-    if (!out_map.find(bb)->second.IsNull()) {
+    if (!out_set.IsNull()) {
       fprintf(stderr, "out: ");
-      out_map.find(bb)->second.Print();
+      out_set.Print();
       fprintf(stderr, "\n");
     }
   }
@@ -165,31 +234,3 @@ BitString DFProblem::Transfer(const BitString& inset,
   // out = gen U ( in - kill)
   return gen | (inset - kill);
 }
-
-// Dataset holds the successors.
-BitString DFProblem::Union(const std::set<BitString *> &dataset) const {
-  // out = U{p=succ()} live[p]
-  MAO_ASSERT(dataset.size() > 0);
-  std::set<BitString *>::const_iterator iter = dataset.begin();
-  BitString out_set = **iter;
-  ++iter;
-  while (iter != dataset.end()) {
-    out_set = out_set | **iter;
-    ++iter;
-  }
-  return out_set;
-}
-
-// Dataset holds the successors.
-BitString DFProblem::Intersect(const std::set<BitString *> &dataset) const {
-  // out = I{p=succ()} live[p]
-  MAO_ASSERT(dataset.size() > 0);
-  std::set<BitString *>::const_iterator iter = dataset.begin();
-  BitString out_set = **iter;
-  ++iter;
-  while (iter != dataset.end()) {
-    out_set = out_set & **iter;
-    ++iter;
-  }
-  return out_set;
-}
@@ -23,8 +23,7 @@
 #ifndef MAODATAFLOW_H_
 #define MAODATAFLOW_H_
 
-#include <map>
-#include <set>
+#include <vector>
 
 #include "MaoCFG.h"
 #include "MaoUnit.h"
@@ -55,12 +54,12 @@ class DFProblem {
   // The in-set is only available for forward problems.
   BitString GetInSet(const BasicBlock& bb) const {
     MAO_ASSERT(direction_ == DF_Forward);
-    return df_solution_.find(&bb)->second;
+    return df_solution_[bb.id()];
   }
   // The out-set is only available for backward problems.
   BitString GetOutSet(const BasicBlock& bb) const {
     MAO_ASSERT(direction_ == DF_Backward);
-    return df_solution_.find(&bb)->second;
+    return df_solution_[bb.id()];
   };
 
   // Functions needed by the solver. Must be implemented
@@ -73,12 +72,18 @@ class DFProblem {
                              const BitString& gen,
                              const BitString& kill) const;
 
-  // Confluence function.
-  virtual BitString Confluence(const std::set<BitString *> &dataset) const = 0;
+  // Confluence function. Merges the exit state of one more neighbor
+  // into result, which holds the merged state of the neighbors seen
+  // so far (initially the exit state of the first neighbor).
+  virtual void Confluence(BitString *result, const BitString &exit) const = 0;
   // Utility functions that can be used in problem instance to implement
   // Confluence()
-  BitString Union(const std::set<BitString *> &dataset) const;
-  BitString Intersect(const std::set<BitString *> &dataset) const;
+  void Union(BitString *result, const BitString &exit) const {
+    *result |= exit;
+  }
+  void Intersect(BitString *result, const BitString &exit) const {
+    *result &= exit;
+  }
 
   // The number of bits (size) each bitstring has.
   // Should be set in the constructor.
@@ -97,7 +102,8 @@ class DFProblem {
  private:
   // For backwards problem, save the output sets.
   // For forward problems, save the input sets.
-  std::map<const BasicBlock *, BitString> df_solution_;
+  // Indexed by basic block id.
+  std::vector<BitString> df_solution_;
 
   // Forward or backward problem?
   enum DFProblemDirection direction_;
@@ -105,9 +111,14 @@ class DFProblem {
   // Max number of iterations to try when looking for convergence.
   static const int kMaxNumberOfIterations = 1000;
 
+  // Returns the basic blocks in the order the solver visits them:
+  // reverse post-order for forward problems, post-order for backward
+  // problems. Blocks not reachable from the source come last.
+  void GetVisitOrder(std::vector<const BasicBlock *> *order) const;
+
   // Helper functions to help debugging.
-  void DumpState(std::map<const BasicBlock *, BitString> in_map,
-                 std::map<const BasicBlock *, BitString> out_map);
+  void DumpState(const std::vector<BitString> &in_sets,
+                 const std::vector<BitString> &out_sets);
 };
 
 
@@ -346,8 +346,8 @@ BitString GetMaskForRegister(const reg_entry *reg) {
 //
 // If expand_mask is true, the mask includes all parent and child registers
 // of the defined registers.
-BitString GetRegisterDefMask(const InstructionEntry *insn,
-                             bool expand_mask) {
+static BitString ComputeRegisterDefMask(const InstructionEntry *insn,
+                                        bool expand_mask) {
   DefEntry *e = &def_entries[insn->op()];
   MAO_ASSERT(e->opcode == insn->op());
 
@@ -407,8 +407,8 @@ BitString GetRegisterDefMask(const InstructionEntry *insn,
 //
 // If expand_mask is true, the mask includes all parent and child registers
 // of the defined registers.
-BitString GetRegisterUseMask(const InstructionEntry *insn,
-                             bool expand_mask) {
+static BitString ComputeRegisterUseMask(const InstructionEntry *insn,
+                                        bool expand_mask) {
   UseEntry *e = &use_entries[insn->op()];
   MAO_ASSERT(e->opcode == insn->op());
 
@@ -455,6 +455,85 @@ BitString GetRegisterUseMask(const InstructionEntry *insn,
   return mask;
 }
 
+// The masks are cached in the instruction, since the analyses ask for
+// them over and over again.
+BitString GetRegisterDefMask(const InstructionEntry *insn,
+                             bool expand_mask) {
+  InstructionEntry::RegisterMaskKind kind = expand_mask ?
+      InstructionEntry::DEF_MASK_EXPANDED : InstructionEntry::DEF_MASK;
+  const BitString *cached = insn->GetCachedRegisterMask(kind);
+  if (cached != NULL)
+    return *cached;
+  BitString mask = ComputeRegisterDefMask(insn, expand_mask);
+  insn->SetCachedRegisterMask(kind, mask);
+  return mask;
+}
+
+BitString GetRegisterUseMask(const InstructionEntry *insn,
+                             bool expand_mask) {
+  InstructionEntry::RegisterMaskKind kind = expand_mask ?
+      InstructionEntry::USE_MASK_EXPANDED : InstructionEntry::USE_MASK;
+  const BitString *cached = insn->GetCachedRegisterMask(kind);
+  if (cached != NULL)
+    return *cached;
+  BitString mask = ComputeRegisterUseMask(insn, expand_mask);
+  insn->SetCachedRegisterMask(kind, mask);
+  return mask;
+}
+
+// Returns true for the shifts and rotates, which leave the flags alone
+// if the count is 0.
+static bool IsShiftOrRotate(MaoOpcode op) {
+  return op == OP_sal || op == OP_sar || op == OP_shl || op == OP_shr ||
+      op == OP_rcl || op == OP_rcr || op == OP_rol || op == OP_ror ||
+      op == OP_shld || op == OP_shrd;
+}
+
+// Returns true if the count of a shift or rotate may be 0. The count
+// is operand 0, unless it is the only operand, then the count is 1.
+// The hardware masks the count to 5 bits, or 6 bits for 64-bit
+// operands, checking 5 bits is on the safe side.
+static bool MayShiftByZero(const InstructionEntry *insn) {
+  if (insn->NumOperands() < 2)
+    return false;
+  if (!insn->IsImmediateIntOperand(0))
+    return true;
+  return (insn->GetImmediateIntValue(0) & 0x1f) == 0;
+}
+
+unsigned int GetFlagsDefMask(const InstructionEntry *insn) {
+  DefEntry *e = &def_entries[insn->op()];
+  MAO_ASSERT(e->opcode == insn->op());
+
+  unsigned int mask = e->flag_mask;
+  if (insn->HasPrefix(REPE_PREFIX_OPCODE))
+    mask |= def_entries[OP_repe].flag_mask;
+  else if (insn->HasPrefix(REPNE_PREFIX_OPCODE))
+    mask |= def_entries[OP_repne].flag_mask;
+  return mask;
+}
+
+unsigned int GetFlagsUseMask(const InstructionEntry *insn) {
+  UseEntry *e = &use_entries[insn->op()];
+  MAO_ASSERT(e->opcode == insn->op());
+
+  unsigned int mask = e->flag_mask;
+  bool has_rep = true;
+  if (insn->HasPrefix(REPE_PREFIX_OPCODE))
+    mask |= use_entries[OP_repe].flag_mask;
+  else if (insn->HasPrefix(REPNE_PREFIX_OPCODE))
+    mask |= use_entries[OP_repne].flag_mask;
+  else
+    has_rep = false;
+
+  // A flag that may or may not be written keeps its old value live:
+  // shifts by zero, and repeated string instructions (cmps, scas) with
+  // a count of zero leave the flags alone.
+  if ((IsShiftOrRotate(insn->op()) && MayShiftByZero(insn)) ||
+      (has_rep && insn->IsStringOperation()))
+    mask |= GetFlagsDefMask(insn);
+  return mask;
+}
 
 // Returns the set of defined registers from the list of operands.
 // TODO(martint): Add implicit registers.
@@ -42,6 +42,31 @@
 
 #define  USE_OP_ALL (REG_OP0 | REG_OP1 | REG_OP2 | REG_OP3 | REG_OP4 | REG_OP5 | REG_OP_BASE | REG_OP_INDEX)
 
+// Bitmasks for the flags in eflags, in the order of the side-effect
+// tables.
+#define  FLAG_CF    (1 << 0)
+#define  FLAG_PF    (1 << 1)
+#define  FLAG_AF    (1 << 2)
+#define  FLAG_ZF    (1 << 3)
+#define  FLAG_SF    (1 << 4)
+#define  FLAG_TP    (1 << 5)
+#define  FLAG_IF    (1 << 6)
+#define  FLAG_DF    (1 << 7)
+#define  FLAG_OF    (1 << 8)
+#define  FLAG_IOPL  (1 << 9)
+#define  FLAG_NT    (1 << 10)
+#define  FLAG_RF    (1 << 11)
+#define  FLAG_VM    (1 << 12)
+#define  FLAG_AC    (1 << 13)
+#define  FLAG_VIF   (1 << 14)
+#define  FLAG_VIP   (1 << 15)
+#define  FLAG_ID    (1 << 16)
+
+#define  NUM_FLAGS  17
+#define  FLAGS_ALL  ((1 << NUM_FLAGS) - 1)
+// The flags set by the arithmetic instructions.
+#define  FLAGS_STATUS (FLAG_CF | FLAG_PF | FLAG_AF | FLAG_ZF | FLAG_SF | FLAG_OF)
+
 // more are possible...
 struct DefEntry {
   int           opcode;      // matches table gen-opcodes.h
@@ -51,6 +76,7 @@ struct DefEntry {
   BitString     reg_mask16;  //   for 16-bit addressing modes
   BitString     reg_mask32;  //   for 32-bit addressing modes
   BitString     reg_mask64;  //   for 64-bit addressing modes
+  unsigned int  flag_mask;   // if insn defs flag(s), FLAG_xx bits
 };
 
 // Should possibly using the same struct for both.
@@ -63,6 +89,7 @@ struct UseEntry {
   BitString     reg_mask16;  //   for 16-bit addressing modes
   BitString     reg_mask32;  //   for 32-bit addressing modes
   BitString     reg_mask64;  //   for 64-bit addressing modes
+  unsigned int  flag_mask;   // if insn uses flag(s), FLAG_xx bits
 };
 
 extern DefEntry def_entries[];
@@ -78,6 +105,12 @@ BitString  GetRegisterDefMask(const InstructionEntry *insn,
 BitString  GetRegisterUseMask(const InstructionEntry *insn,
                               bool expand_mask = false);
 
+// Returns the flags the instruction defines and uses, as FLAG_xx bits.
+// Flags that are only defined in some cases, e.g. by shifts by %cl,
+// which leave the flags alone for a count of 0, are in both masks.
+unsigned int GetFlagsDefMask(const InstructionEntry *insn);
+unsigned int GetFlagsUseMask(const InstructionEntry *insn);
+
 std::set<const reg_entry *> GetDefinedRegisters(InstructionEntry *insn);
 std::set<const reg_entry *> GetUsedRegisters(InstructionEntry *insn);
 
@@ -0,0 +1,269 @@
+//
+// Copyright 2010 Google Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the
+//   Free Software Foundation Inc.,
+//   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <utility>
+#include <vector>
+
+#include "Mao.h"
+#include "MaoDominators.h"
+
+const int DominatorTree::kNone;
+
+namespace {
+// Flattened adjacency lists: the neighbors of block i are
+// [start[i], start[i + 1]) in blocks.
+struct FlatGraph {
+  std::vector<BasicBlockID> blocks;
+  std::vector<int> start;
+};
+}  // namespace
+
+// Fills succs and preds with the edges of the CFG, reversed if post is
+// true. For the post-dominators, a block without successors, e.g. one
+// ending in a tail call to another function, gets an edge to the sink,
+// so that it is not taken for an endless loop.
+static void BuildFlatGraph(const CFG *cfg, bool post,
+                           FlatGraph *succs, FlatGraph *preds) {
+  int num_blocks = cfg->GetNumOfNodes();
+  BasicBlockID sink = cfg->Sink()->id();
+  std::vector<std::pair<BasicBlockID, BasicBlockID> > edges;
+  for (CFG::BBVector::const_iterator it = cfg->Begin();
+       it != cfg->End(); ++it) {
+    BasicBlockID id = (*it)->id();
+    MAO_ASSERT(id >= 0 && id < num_blocks);
+    for (BasicBlock::EdgeIterator edge = (*it)->BeginOutEdges();
+         edge != (*it)->EndOutEdges(); ++edge)
+      edges.push_back(std::make_pair(id, (*edge)->dest()->id()));
+    if (post && id != sink && (*it)->BeginOutEdges() == (*it)->EndOutEdges())
+      edges.push_back(std::make_pair(id, sink));
+  }
+  if (post) {
+    for (size_t i = 0; i < edges.size(); ++i)
+      std::swap(edges[i].first, edges[i].second);
+  }
+
+  succs->start.assign(num_blocks + 1, 0);
+  preds->start.assign(num_blocks + 1, 0);
+  for (size_t i = 0; i < edges.size(); ++i) {
+    ++succs->start[edges[i].first + 1];
+    ++preds->start[edges[i].second + 1];
+  }
+  for (int i = 0; i < num_blocks; ++i) {
+    succs->start[i + 1] += succs->start[i];
+    preds->start[i + 1] += preds->start[i];
+  }
+
+  // Place the edges by source, and by destination.
+  succs->blocks.resize(edges.size());
+  preds->blocks.resize(edges.size());
+  std::vector<int> succ_next(succs->start.begin(), succs->start.end() - 1);
+  std::vector<int> pred_next(preds->start.begin(), preds->start.end() - 1);
+  for (size_t i = 0; i < edges.size(); ++i) {
+    BasicBlockID from = edges[i].first, to = edges[i].second;
+    succs->blocks[succ_next[from]++] = to;
+    preds->blocks[pred_next[to]++] = from;
+  }
+}
+
+// Numbers the blocks reachable from root in reverse postorder. Blocks
+// that are not reachable get kNone.
+static void ComputeReversePostorder(const FlatGraph &succs, BasicBlockID root,
+                                    int none,
+                                    std::vector<BasicBlockID> *order,
+                                    std::vector<int> *number) {
+  int num_blocks = succs.start.size() - 1;
+  std::vector<bool> visited(num_blocks, false);
+  // Iterative depth-first search. Each stack element is a block and
+  // the index of the next successor to visit.
+  std::vector<std::pair<BasicBlockID, int> > stack;
+  std::vector<BasicBlockID> postorder;
+  stack.push_back(std::make_pair(root, succs.start[root]));
+  visited[root] = true;
+  while (!stack.empty()) {
+    BasicBlockID block = stack.back().first;
+    int next = stack.back().second;
+    if (next == succs.start[block + 1]) {
+      postorder.push_back(block);
+      stack.pop_back();
+      continue;
+    }
+    ++stack.back().second;
+    BasicBlockID succ = succs.blocks[next];
+    if (!visited[succ]) {
+      visited[succ] = true;
+      stack.push_back(std::make_pair(succ, succs.start[succ]));
+    }
+  }
+
+  order->assign(postorder.rbegin(), postorder.rend());
+  number->assign(num_blocks, none);
+  for (size_t i = 0; i < order->size(); ++i)
+    (*number)[(*order)[i]] = i;
+}
+
+// Walks up from a and b to their nearest common dominator, using the
+// reverse postorder numbers of the blocks.
+static BasicBlockID Intersect(BasicBlockID a, BasicBlockID b,
+                              const std::vector<BasicBlockID> &idom,
+                              const std::vector<int> &rpo_number) {
+  while (a != b) {
+    while (rpo_number[a] > rpo_number[b])
+      a = idom[a];
+    while (rpo_number[b] > rpo_number[a])
+      b = idom[b];
+  }
+  return a;
+}
+
+DominatorTree::DominatorTree(const CFG *cfg) {
+  Build(cfg, false);
+}
+
+DominatorTree::DominatorTree(const CFG *cfg, bool post) {
+  Build(cfg, post);
+}
+
+void DominatorTree::Build(const CFG *cfg, bool post) {
+  post_ = post;
+  root_ = post ? cfg->Sink()->id() : cfg->Source()->id();
+  int num_blocks = cfg->GetNumOfNodes();
+
+  FlatGraph succs, preds;
+  BuildFlatGraph(cfg, post, &succs, &preds);
+  std::vector<BasicBlockID> rpo;
+  std::vector<int> rpo_number;
+  ComputeReversePostorder(succs, root_, kNone, &rpo, &rpo_number);
+
+  // Iterate to the fixed point, visiting the blocks in reverse
+  // postorder. The root is its own immediate dominator while solving.
+  idom_.assign(num_blocks, kNone);
+  idom_[root_] = root_;
+  for (bool changed = true; changed; ) {
+    changed = false;
+    for (size_t i = 1; i < rpo.size(); ++i) {
+      BasicBlockID block = rpo[i];
+      BasicBlockID new_idom = kNone;
+      for (int p = preds.start[block]; p < preds.start[block + 1]; ++p) {
+        BasicBlockID pred = preds.blocks[p];
+        if (idom_[pred] == kNone)
+          continue;
+        new_idom = new_idom == kNone ? pred :
+            Intersect(pred, new_idom, idom_, rpo_number);
+      }
+      if (idom_[block] != new_idom) {
+        idom_[block] = new_idom;
+        changed = true;
+      }
+    }
+  }
+  idom_[root_] = kNone;
+
+  // The children, ordered by block id.
+  children_start_.assign(num_blocks + 1, 0);
+  for (BasicBlockID block = 0; block < num_blocks; ++block) {
+    if (idom_[block] != kNone)
+      ++children_start_[idom_[block] + 1];
+  }
+  for (int i = 0; i < num_blocks; ++i)
+    children_start_[i + 1] += children_start_[i];
+  children_.resize(children_start_[num_blocks]);
+  std::vector<int> next(children_start_.begin(), children_start_.end() - 1);
+  for (BasicBlockID block = 0; block < num_blocks; ++block) {
+    if (idom_[block] != kNone)
+      children_[next[idom_[block]]++] = block;
+  }
+
+  // Number the tree in depth-first preorder.
+  preorder_.assign(num_blocks, kNone);
+  last_.assign(num_blocks, kNone);
+  std::vector<std::pair<BasicBlockID, int> > stack;
+  int number = 0;
+  preorder_[root_] = number++;
+  stack.push_back(std::make_pair(root_, children_start_[root_]));
+  while (!stack.empty()) {
+    BasicBlockID block = stack.back().first;
+    int child = stack.back().second;
+    if (child == children_start_[block + 1]) {
+      last_[block] = number - 1;
+      stack.pop_back();
+      continue;
+    }
+    ++stack.back().second;
+    BasicBlockID next_block = children_[child];
+    preorder_[next_block] = number++;
+    stack.push_back(std::make_pair(next_block, children_start_[next_block]));
+  }
+
+  // The dominance frontiers. For a join point, walk up from each
+  // predecessor to the immediate dominator of the join point. The
+  // blocks passed have the join point in their frontier. A block is
+  // only added once per join point, since the walks for one join
+  // point are done one after the other.
+  std::vector<std::vector<BasicBlockID> > frontiers(num_blocks);
+  for (size_t i = 0; i < rpo.size(); ++i) {
+    BasicBlockID block = rpo[i];
+    if (preds.start[block + 1] - preds.start[block] < 2)
+      continue;
+    for (int p = preds.start[block]; p < preds.start[block + 1]; ++p) {
+      BasicBlockID runner = preds.blocks[p];
+      if (!IsReachable(runner))
+        continue;
+      while (runner != idom_[block]) {
+        std::vector<BasicBlockID> &frontier = frontiers[runner];
+        if (frontier.empty() || frontier.back() != block)
+          frontier.push_back(block);
+        // A back edge to the root walks up to the root.
+        if (runner == root_)
+          break;
+        runner = idom_[runner];
+      }
+    }
+  }
+  frontier_start_.assign(num_blocks + 1, 0);
+  for (BasicBlockID block = 0; block < num_blocks; ++block) {
+    frontier_start_[block + 1] = frontier_start_[block] +
+        frontiers[block].size();
+    frontier_.insert(frontier_.end(), frontiers[block].begin(),
+                     frontiers[block].end());
+  }
+}
+
+BasicBlockID DominatorTree::NearestCommonDominator(BasicBlockID a,
+                                                   BasicBlockID b) const {
+  if (!IsReachable(a) || !IsReachable(b))
+    return kNone;
+  while (!Dominates(a, b))
+    a = idom_[a];
+  return a;
+}
+
+void DominatorTree::Print(FILE *out) const {
+  const char *kind = post_ ? "post-dominator" : "dominator";
+  fprintf(out, "%s tree, root: %d\n", kind, root_);
+  for (BasicBlockID block = 0; block < NumBlocks(); ++block) {
+    if (!IsReachable(block)) {
+      fprintf(out, "  bb%d: unreachable\n", block);
+      continue;
+    }
+    fprintf(out, "  bb%d: idom: %d, frontier:", block, idom_[block]);
+    for (BlockIterator iter = FrontierBegin(block);
+         iter != FrontierEnd(block); ++iter)
+      fprintf(out, " bb%d", *iter);
+    fprintf(out, "\n");
+  }
+}
@@ -0,0 +1,148 @@
+//
+// Copyright 2010 Google Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301, USA.
+
+// Dominator and post-dominator trees of a CFG.
+//
+// A basic block A dominates B if every path from the source of the CFG
+// to B goes through A. A post-dominates B if every path from B to the
+// sink goes through A. Every block dominates and post-dominates itself.
+//
+// The trees are built with the algorithm of Cooper, Harvey and Kennedy
+// ("A Simple, Fast Dominance Algorithm"), and kept in flat arrays
+// indexed by BasicBlockID. The tree is numbered in depth-first order,
+// so that Dominates() is answered in constant time. The dominance
+// frontier of a block are the blocks where its dominance ends: B is
+// in the frontier of A if A dominates a predecessor of B, but does not
+// strictly dominate B.
+//
+// Blocks that can not be reached from the root, i.e. unreachable code
+// for the dominators, and e.g. endless loops for the post-dominators,
+// are not in the tree. They have no immediate dominator, and neither
+// dominate nor are dominated by any block.
+//
+// The trees refer to the basic block ids of the CFG they were built
+// from. Get them from the analysis manager, which drops them together
+// with the CFG.
+//
+// Usage:
+//   DominatorTree *dom = unit_->GetAnalyses()->GetDominatorTree(function_);
+//   if (dom->Dominates(bb1->id(), bb2->id())) ...
+
+#ifndef MAODOMINATORS_H_
+#define MAODOMINATORS_H_
+
+#include <stdio.h>
+
+#include <vector>
+
+#include "MaoCFG.h"
+
+class DominatorTree {
+ public:
+  explicit DominatorTree(const CFG *cfg);
+  virtual ~DominatorTree() { }
+
+  // Returns the root of the tree, the source of the CFG for the
+  // dominators, the sink for the post-dominators.
+  BasicBlockID Root() const { return root_; }
+  // Returns the number of basic blocks the tree was built for.
+  int NumBlocks() const { return idom_.size(); }
+
+  // Returns true if the block can be reached from the root.
+  bool IsReachable(BasicBlockID id) const {
+    return preorder_[Checked(id)] != kNone;
+  }
+  // Returns the immediate dominator of the block, or -1 for the root
+  // and for unreachable blocks.
+  BasicBlockID ImmediateDominator(BasicBlockID id) const {
+    return idom_[Checked(id)];
+  }
+  // Returns true if a dominates b. Constant time.
+  bool Dominates(BasicBlockID a, BasicBlockID b) const {
+    return IsReachable(a) && IsReachable(b) &&
+        preorder_[a] <= preorder_[b] && preorder_[b] <= last_[a];
+  }
+  bool StrictlyDominates(BasicBlockID a, BasicBlockID b) const {
+    return a != b && Dominates(a, b);
+  }
+  // Returns the nearest block that dominates both a and b, or -1 if
+  // either is unreachable.
+  BasicBlockID NearestCommonDominator(BasicBlockID a, BasicBlockID b) const;
+
+  // The children of the block in the tree, i.e. the blocks it
+  // immediately dominates.
+  typedef std::vector<BasicBlockID>::const_iterator BlockIterator;
+  BlockIterator ChildrenBegin(BasicBlockID id) const {
+    return children_.begin() + children_start_[Checked(id)];
+  }
+  BlockIterator ChildrenEnd(BasicBlockID id) const {
+    return children_.begin() + children_start_[Checked(id) + 1];
+  }
+  // The dominance frontier of the block, in no particular order.
+  BlockIterator FrontierBegin(BasicBlockID id) const {
+    return frontier_.begin() + frontier_start_[Checked(id)];
+  }
+  BlockIterator FrontierEnd(BasicBlockID id) const {
+    return frontier_.begin() + frontier_start_[Checked(id) + 1];
+  }
+
+  // Prints the immediate dominators and frontiers, for tracing.
+  void Print(FILE *out) const;
+
+ protected:
+  // Builds the tree on the reversed CFG if post is true.
+  DominatorTree(const CFG *cfg, bool post);
+
+ private:
+  static const int kNone = -1;
+
+  BasicBlockID Checked(BasicBlockID id) const {
+    MAO_ASSERT(id >= 0 && id < NumBlocks());
+    return id;
+  }
+
+  void Build(const CFG *cfg, bool post);
+
+  // The kind of tree, for Print().
+  bool post_;
+  BasicBlockID root_;
+
+  // The immediate dominator of each block, or kNone.
+  std::vector<BasicBlockID> idom_;
+  // The position of each block in a depth-first preorder walk of the
+  // tree, and the largest position in its subtree. kNone for the
+  // unreachable blocks.
+  std::vector<int> preorder_;
+  std::vector<int> last_;
+
+  // The children and dominance frontiers of all blocks. The ones of
+  // block i are at [start[i], start[i + 1]).
+  std::vector<BasicBlockID> children_;
+  std::vector<int> children_start_;
+  std::vector<BasicBlockID> frontier_;
+  std::vector<int> frontier_start_;
+};
+
+// The post-dominator tree, the dominator tree of the reversed CFG
+// rooted at the sink. The dominance frontiers are the post-dominance
+// frontiers, i.e. the blocks a block is control dependent on.
+class PostDominatorTree : public DominatorTree {
+ public:
+  explicit PostDominatorTree(const CFG *cfg) : DominatorTree(cfg, true) { }
+};
+
+#endif  // MAODOMINATORS_H_
@@ -97,6 +97,7 @@ DotPass::DotPass(MaoOptionMap *options, MaoUnit *mao, Function *function)
   } else {
     output_format_ = kInvalid;
   }
+  Preserve(ANALYSIS_ALL);
 }
 
 // Return the full filename for the output file.
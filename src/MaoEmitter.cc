@@ -0,0 +1,99 @@
+//
+// Copyright 2010 Google Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the
+//   Free Software Foundation Inc.,
+//   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "MaoDebug.h"
+#include "MaoEmitter.h"
+
+MaoEmitter::MaoEmitter(int fd, bool source_info)
+    : fd_(fd), source_info_(source_info), broken_pipe_(false),
+      buffer_(static_cast<char *>(malloc(kBufferSize))),
+      next_(buffer_), end_(buffer_ + kBufferSize) {
+  MAO_RASSERT_MSG(buffer_ != NULL, "Out of memory.");
+}
+
+MaoEmitter::MaoEmitter(bool source_info)
+    : fd_(-1), source_info_(source_info), broken_pipe_(false),
+      buffer_(static_cast<char *>(malloc(kBufferSize))),
+      next_(buffer_), end_(buffer_ + kBufferSize) {
+  MAO_RASSERT_MSG(buffer_ != NULL, "Out of memory.");
+}
+
+MaoEmitter::~MaoEmitter() {
+  Flush();
+  free(buffer_);
+}
+
+void MaoEmitter::Write(const char *data, size_t length) {
+  if (fd_ < 0) {
+    output_.append(data, length);
+    return;
+  }
+  while (length > 0 && !broken_pipe_) {
+    ssize_t written = write(fd_, data, length);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written < 0 && errno == EPIPE) {
+      broken_pipe_ = true;
+      break;
+    }
+    MAO_RASSERT_MSG(written > 0, "Unable to write assembly output.");
+    data += written;
+    length -= written;
+  }
+}
+
+void MaoEmitter::Flush() {
+  Write(buffer_, next_ - buffer_);
+  next_ = buffer_;
+}
+
+void MaoEmitter::TakeOutput(std::string *text) {
+  MAO_ASSERT(fd_ < 0);
+  Flush();
+  text->swap(output_);
+  output_.clear();
+}
+
+void MaoEmitter::AppendSlow(const char *str, size_t length) {
+  Flush();
+  if (length >= kBufferSize) {
+    // Too large to be buffered, write it directly.
+    Write(str, length);
+    return;
+  }
+  memcpy(next_, str, length);
+  next_ += length;
+}
+
+void MaoEmitter::AppendNumber(long number) {
+  char digits[24];
+  char *digit = digits + sizeof(digits);
+  // Works on the negative value, which can hold LONG_MIN.
+  long value = number < 0 ? number : -number;
+  do {
+    *--digit = '0' - value % 10;
+    value /= 10;
+  } while (value != 0);
+  if (number < 0)
+    *--digit = '-';
+  Append(digit, digits + sizeof(digits) - digit);
+}
@@ -0,0 +1,118 @@
+//
+// Copyright 2010 Google Inc.
+//
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301, USA.
+
+// MaoEmitter writes the assembly output of a unit. The entries format
+// themselves straight into a large output buffer (see
+// MaoEntry::EmitEntry()), which is written to the file descriptor with
+// write() whenever it fills up, bypassing stdio.
+//
+// Parts of an entry that are still produced as a std::string (e.g.
+// instruction operands) are formatted into a scratch string that is
+// reused for all entries, so emitting allocates no memory per entry.
+//
+// An emitter can also collect its output in memory, which is used to
+// render parts of a unit on several threads (see
+// MaoUnit::EmitMaoUnit()).
+//
+// Usage:
+//   MaoEmitter emitter(fd, true);
+//   unit->EmitMaoUnit(&emitter);
+//   emitter.Flush();
+
+#ifndef MAOEMITTER_H_
+#define MAOEMITTER_H_
+
+#include <stddef.h>
+#include <string.h>
+
+#include <string>
+
+class MaoEmitter {
+ public:
+  // Writes to the file descriptor fd, which is not closed. Without
+  // source_info, the comments giving entry id and line number of each
+  // entry are left out.
+  MaoEmitter(int fd, bool source_info);
+  // Collects the output in memory, see TakeOutput().
+  explicit MaoEmitter(bool source_info);
+  // Flushes the remaining output.
+  ~MaoEmitter();
+
+  void Append(const char *str, size_t length) {
+    if (length > static_cast<size_t>(end_ - next_)) {
+      AppendSlow(str, length);
+      return;
+    }
+    memcpy(next_, str, length);
+    next_ += length;
+  }
+  void Append(const char *str) { Append(str, strlen(str)); }
+  void Append(const std::string &str) { Append(str.data(), str.size()); }
+  void Append(char c) {
+    if (next_ == end_)
+      Flush();
+    *next_++ = c;
+  }
+  // Appends the number in decimal, as printf("%ld") does.
+  void AppendNumber(long number);
+
+  // Writes the buffered output to the file descriptor, or to the
+  // collected output.
+  void Flush();
+  // Moves the output collected so far into text. Only for emitters
+  // that collect their output in memory.
+  void TakeOutput(std::string *text);
+
+  // Returns true if the source info comments should be emitted.
+  bool source_info() const { return source_info_; }
+  // Returns true if writing failed with EPIPE, which needs SIGPIPE to
+  // be ignored. The output after that is dropped.
+  bool broken_pipe() const { return broken_pipe_; }
+
+  // Returns an empty string to format parts of an entry into. The
+  // string keeps its capacity between entries.
+  std::string *scratch() {
+    scratch_.clear();
+    return &scratch_;
+  }
+
+ private:
+  static const size_t kBufferSize = 1 << 20;
+
+  // Appends a string that does not fit into the rest of the buffer.
+  void AppendSlow(const char *str, size_t length);
+
+  // Writes the length bytes at data to fd_, or appends them to output_.
+  void Write(const char *data, size_t length);
+
+  // -1 if the output is collected in output_.
+  const int fd_;
+  const bool source_info_;
+  bool broken_pipe_;
+  char *const buffer_;
+  char *next_;
+  char *const end_;
+  std::string output_;
+  std::string scratch_;
+
+  // Not copyable.
+  MaoEmitter(const MaoEmitter &);
+  void operator=(const MaoEmitter &);
+};
+
+#endif  // MAOEMITTER_H_
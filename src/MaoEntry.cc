@@ -21,6 +21,7 @@
 #include <string>
 
 #include "Mao.h"
+#include "MaoEmitter.h"
 
 // Needed for macros (OPERAND_TYPE_IMM64, ..) in gotrel[]
 #include "opcodes/i386-init.h"
@@ -33,11 +34,11 @@
 
 MaoEntry::MaoEntry(unsigned int line_number, const char *line_verbatim,
                    MaoUnit *maounit) :
-    maounit_(maounit), id_(0), next_(NULL), prev_(NULL),
+    maounit_(maounit), id_(0), source_id_(0), next_(NULL), prev_(NULL),
     line_number_(line_number) {
   if (line_verbatim) {
     MAO_ASSERT(strlen(line_verbatim) < MAX_VERBATIM_ASSEMBLY_STRING_LENGTH);
-    line_verbatim_ = strdup(line_verbatim);
+    line_verbatim_ = InternString(line_verbatim);
   } else {
     line_verbatim_ = 0;
   }
@@ -46,6 +47,10 @@ MaoEntry::MaoEntry(unsigned int line_number, const char *line_verbatim,
 MaoEntry::~MaoEntry() {
 }
 
+const char *MaoEntry::InternString(const char *str) const {
+  return maounit_->GetStringPool()->Intern(str);
+}
+
 // Returns the flag code of the closest instruction entry that precedes this
 // entry. This is a virtual method which is overridden by the InstructionEntry
 // class and so if the entry is an instruction entry, it simply returns the flag
@@ -428,7 +433,7 @@ void MaoEntry::Spaces(unsigned int n, FILE *outfile) const {
 std::string &MaoEntry::SourceInfoToString(std::string *out) const {
   std::ostringstream stream;
   stream << "\t# id: "
-         << id()
+         << source_id()
          << ", l: "
          << line_number()
          << "\t";
@@ -438,7 +443,18 @@ std::string &MaoEntry::SourceInfoToString(std::string *out) const {
   return *out;
 }
 
+void MaoEntry::EmitSourceInfo(MaoEmitter *out) const {
+  if (!out->source_info())
+    return;
+  out->Append("\t# id: ");
+  out->AppendNumber(source_id());
+  out->Append(", l: ");
+  out->AppendNumber(line_number());
+  out->Append('\t');
+}
+
 void MaoEntry::Unlink() {
+  MaoAnalysisManager::NoteChange();
   MaoEntry *prev = prev_, *next = next_;
   if (prev != NULL) {
     prev->set_next(next);
@@ -469,6 +485,7 @@ void MaoEntry::Unlink() {
 }
 
 void MaoEntry::Unlink(MaoEntry *last_in_chain) {
+  MaoAnalysisManager::NoteChange();
   MaoEntry *prev = prev_, *next = last_in_chain->next();
   MAO_RASSERT(last_in_chain != NULL);
   Function *function = maounit_->GetFunction(this);
@@ -517,8 +534,13 @@ MaoEntry *MaoEntry::GetLastEntry(MaoEntry *entry) const {
 // Function and subsection pointers are updated in case the instructions
 // are inserted at the beginning of such a unit.
 void MaoEntry::LinkBefore(MaoEntry *entry) {
+  MaoAnalysisManager::NoteChange();
   MAO_ASSERT(entry != NULL);
 
+  // At a function boundary, the links are shared with the neighboring
+  // function, which may be changed by another thread in a parallel run.
+  MaoMutexLock lock(maounit_->entry_mutex());
+
   // Find the last entry in the chain.
   MaoEntry *last_entry = GetLastEntry(entry);
 
@@ -550,8 +572,12 @@ void MaoEntry::LinkBefore(MaoEntry *entry) {
 // Function and subsection pointers are updated in case the instructions
 // are inserted at the end of such a unit.
 void MaoEntry::LinkAfter(MaoEntry *entry) {
+  MaoAnalysisManager::NoteChange();
   MAO_ASSERT(entry != NULL);
 
+  // See LinkBefore().
+  MaoMutexLock lock(maounit_->entry_mutex());
+
   // Find the last entry in the chain.
   MaoEntry *last_entry = GetLastEntry(entry);
 
@@ -601,7 +627,8 @@ void MaoEntry::AlignTo(int power_of_2_alignment,
 }
 
 
-const char *MaoEntry::GetSymbolnameFromExpression(expressionS *expr) const {
+const char *MaoEntry::GetSymbolnameFromExpression(
+    const expressionS *expr) const {
   const char *label_name = NULL;
   // TODO(martint): support all expression
 
@@ -673,6 +700,14 @@ void LabelEntry::PrintEntry(FILE *out) const {
 }
 
 
+void LabelEntry::EmitEntry(MaoEmitter *out) const {
+  MAO_ASSERT(name_);
+  out->Append(name_);
+  out->Append(':');
+  EmitSourceInfo(out);
+  out->Append('\n');
+}
+
 std::string &LabelEntry::ToString(std::string *out) const {
   out->append(name_);
   out->append(":");
@@ -789,6 +824,15 @@ void DirectiveEntry::PrintEntry(::FILE *out) const {
   fprintf(out, "%s\n", s.c_str());
 }
 
+void DirectiveEntry::EmitEntry(MaoEmitter *out) const {
+  out->Append('\t');
+  out->Append(GetOpcodeName());
+  out->Append('\t');
+  out->Append(OperandsToString(out->scratch(), GetOperandSeparator()));
+  EmitSourceInfo(out);
+  out->Append('\n');
+}
+
 std::string &DirectiveEntry::ToString(std::string *out) const {
   //  std::ostringstream stream;
   out->append(GetOpcodeName());
@@ -965,14 +1009,15 @@ bool DirectiveEntry::IsAlignDirective() const {
 /* Returns 0 if attempting to add a prefix where one from the same
    class already exists, 1 if non rep/repne added, 2 if rep/repne
    added.  */
-int InstructionEntry::AddPrefix(unsigned int prefix) {
+static int AddPrefixTo(i386_insn *instruction, enum flag_code code_flag,
+                       unsigned int prefix) {
   int ret = 1;
   unsigned int q;
   if (prefix >= REX_OPCODE && prefix < REX_OPCODE + 16
-      && code_flag_ == CODE_64BIT) {
-    if ((instruction_->prefix[X86InstructionSizeHelper::REX_PREFIX] &
+      && code_flag == CODE_64BIT) {
+    if ((instruction->prefix[X86InstructionSizeHelper::REX_PREFIX] &
          prefix & REX_W)
-        || ((instruction_->prefix[X86InstructionSizeHelper::REX_PREFIX] &
+        || ((instruction->prefix[X86InstructionSizeHelper::REX_PREFIX] &
              (REX_R | REX_X | REX_B))
             && (prefix & (REX_R | REX_X | REX_B))))
       ret = 0;
@@ -1013,15 +1058,15 @@ int InstructionEntry::AddPrefix(unsigned int prefix) {
         q = X86InstructionSizeHelper::DATA_PREFIX;
         break;
     }
-    if (instruction_->prefix[q] != 0) {
+    if (instruction->prefix[q] != 0) {
       ret = 0;
     }
   }
 
   if (ret) {
-    if (!instruction_->prefix[q])
-      ++instruction_->prefixes;
-    instruction_->prefix[q] |= prefix;
+    if (!instruction->prefix[q])
+      ++instruction->prefixes;
+    instruction->prefix[q] |= prefix;
   } else {
     MAO_ASSERT_MSG(false, "same type of prefix used twice");
   }
@@ -1029,39 +1074,47 @@ int InstructionEntry::AddPrefix(unsigned int prefix) {
   return ret;
 }
 
+int InstructionEntry::AddPrefix(unsigned int prefix) {
+  return AddPrefixTo(mutable_instruction(), code_flag_, prefix);
+}
+
 InstructionEntry::InstructionEntry(i386_insn *instruction,
                                    enum flag_code code_flag,
                                    unsigned int line_number,
                                    const char* line_verbatim,
-                                   MaoUnit *maounit) :
+                                   MaoUnit *maounit,
+                                   bool add_implied_prefixes) :
     MaoEntry(line_number, line_verbatim, maounit), code_flag_(code_flag),
-    execution_count_valid_(false), execution_count_(0) {
+    execution_count_valid_(false), execution_count_(0),
+    register_masks_(NULL), register_masks_valid_(0), summary_valid_(false),
+    private_instruction_(NULL) {
   op_ = GetOpcode(instruction->tm.name);
   MAO_ASSERT(op_ != OP_invalid);
   MAO_ASSERT(instruction);
-  instruction_ = CreateInstructionCopy(instruction);
 
-  // Here we can make sure that the prefixes are correct!
+  // Here we can make sure that the prefixes are correct! They are added
+  // before the instruction is shared.
+  i386_insn parsed = *instruction;
   unsigned int prefix;
-  if (!instruction_->tm.opcode_modifier.vex) {
-    switch (instruction_->tm.opcode_length) {
+  if (add_implied_prefixes && !parsed.tm.opcode_modifier.vex) {
+    switch (parsed.tm.opcode_length) {
       case 3:
-        if (instruction_->tm.base_opcode & 0xff000000) {
-          prefix = (instruction_->tm.base_opcode >> 24) & 0xff;
+        if (parsed.tm.base_opcode & 0xff000000) {
+          prefix = (parsed.tm.base_opcode >> 24) & 0xff;
           goto check_prefix;
         }
         break;
       case 2:
-        if ((instruction_->tm.base_opcode & 0xff0000) != 0) {
-          prefix = (instruction_->tm.base_opcode >> 16) & 0xff;
-          if (instruction_->tm.cpu_flags.bitfield.cpupadlock) {
+        if ((parsed.tm.base_opcode & 0xff0000) != 0) {
+          prefix = (parsed.tm.base_opcode >> 16) & 0xff;
+          if (parsed.tm.cpu_flags.bitfield.cpupadlock) {
          check_prefix:
             if (prefix != REPE_PREFIX_OPCODE ||
-                (instruction_->prefix[X86InstructionSizeHelper::REP_PREFIX]
+                (parsed.prefix[X86InstructionSizeHelper::REP_PREFIX]
                  != REPE_PREFIX_OPCODE))
-              AddPrefix(prefix);
+              AddPrefixTo(&parsed, code_flag_, prefix);
           } else {
-            AddPrefix(prefix);
+            AddPrefixTo(&parsed, code_flag_, prefix);
           }
         }
         break;
@@ -1071,11 +1124,29 @@ InstructionEntry::InstructionEntry(i386_insn *instruction,
         MAO_ASSERT(false);
     }
   }
+  instruction_ = maounit->GetInstructionPool()->Intern(&parsed);
+  ComputeSummary();
 }
 
 InstructionEntry::~InstructionEntry() {
   MAO_ASSERT(instruction_);
   FreeInstruction();
+  delete [] register_masks_;
+}
+
+const BitString *InstructionEntry::GetCachedRegisterMask(
+    RegisterMaskKind kind) const {
+  if (!(register_masks_valid_ & (1 << kind)))
+    return NULL;
+  return &register_masks_[kind];
+}
+
+void InstructionEntry::SetCachedRegisterMask(RegisterMaskKind kind,
+                                             const BitString &mask) const {
+  if (register_masks_ == NULL)
+    register_masks_ = new BitString[NUM_REGISTER_MASKS];
+  register_masks_[kind] = mask;
+  register_masks_valid_ |= 1 << kind;
 }
 
 void InstructionEntry::PrintEntry(FILE *out) const {
@@ -1087,6 +1158,16 @@ void InstructionEntry::PrintEntry(FILE *out) const {
 }
 
 
+void InstructionEntry::EmitEntry(MaoEmitter *out) const {
+  out->Append(InstructionToString(out->scratch()));
+  if (execution_count_valid_) {
+    out->Append("\t# ecount=");
+    out->AppendNumber(execution_count_);
+  }
+  EmitSourceInfo(out);
+  out->Append('\n');
+}
+
 std::string &InstructionEntry::ToString(std::string *out) const {
   InstructionToString(out);
   return *out;
@@ -1110,45 +1191,28 @@ const char *InstructionEntry::op_str() const {
   return(instruction_->tm.name);
 }
 
-// This deallocates memory allocated in CreateInstructionCopy().
-void InstructionEntry::FreeInstruction() {
-  MAO_ASSERT(instruction_);
-  for (unsigned int i = 0; i < instruction_->operands; i++) {
-    if (IsImmediateOperand(instruction_, i)) {
-      delete instruction_->op[i].imms;
-    }
-    if (IsMemOperand(instruction_, i)) {
-      delete instruction_->op[i].disps;
-    }
+i386_insn *InstructionEntry::mutable_instruction() {
+  InvalidateRegisterMasks();
+  summary_valid_ = false;
+  if (private_instruction_ == NULL) {
+    const i386_insn *shared = instruction_;
+    private_instruction_ = MaoInstructionPool::Copy(shared,
+                                                    maounit_->GetArena());
+    instruction_ = private_instruction_;
+    maounit_->GetInstructionPool()->Release(shared);
   }
-  for (unsigned int i = 0; i < 2; i++) {
-    delete instruction_->seg[i];
-  }
-
-  // Registers are shared, and should not be freed.
-  //   - instruction_->base_reg;
-  //   - instruction_->index_reg;
-  //   - instruction_->op[*].regs;
-
-  delete instruction_;
+  return private_instruction_;
 }
 
-bool InstructionEntry::IsPredicated() const {
-  const MaoOpcode opcode_is_predicated[] =  {
-    OP_cmovo,   OP_cmovno,  OP_cmovb,   OP_cmovc,    OP_cmovnae,
-    OP_cmovae,  OP_cmovnc,  OP_cmovnb,  OP_cmove,    OP_cmovz,
-    OP_cmovne,  OP_cmovnz,  OP_cmovbe,  OP_cmovna,   OP_cmova,
-    OP_cmovnbe, OP_cmovs,   OP_cmovns,  OP_cmovp,    OP_cmovnp,
-    OP_cmovl,   OP_cmovnge, OP_cmovge,  OP_cmovnl,   OP_cmovle,
-    OP_cmovng,  OP_cmovg,   OP_cmovnle, OP_fcmovb,   OP_fcmovnae,
-    OP_fcmove,  OP_fcmovbe, OP_fcmovna, OP_fcmovu,   OP_fcmovae,
-    OP_fcmovnb, OP_fcmovne, OP_fcmova,  OP_fcmovnbe, OP_fcmovnu
-  };
-
-  if (IsInList(op(), opcode_is_predicated,
-               sizeof(opcode_is_predicated)/sizeof(MaoOpcode)))
-    return true;
-  return false;
+// The private copy goes back to the arena of the unit, the reference to
+// the shared copy back to the instruction pool.
+void InstructionEntry::FreeInstruction() {
+  if (private_instruction_ == NULL) {
+    maounit_->GetInstructionPool()->Release(instruction_);
+    return;
+  }
+  MaoInstructionPool::Free(private_instruction_, maounit_->GetArena());
+  private_instruction_ = NULL;
 }
 
 bool InstructionEntry::IsMemOperand(const i386_insn *instruction,
@@ -1180,7 +1244,7 @@ bool InstructionEntry::IsImmediateIntOperand(const i386_insn *instruction,
                                              const unsigned int op_index) {
   MAO_ASSERT(instruction->operands > op_index);
   i386_operand_type t = instruction->types[op_index];
-  expressionS *imm1 = instruction->op[op_index].imms;
+  const expressionS *imm1 = instruction->op[op_index].imms;
   if (!imm1)
     return false;
   if (imm1->X_op != O_constant)
@@ -1217,12 +1281,13 @@ bool InstructionEntry::IsRegisterOperand(const i386_insn *instruction,
 }
 
 // If an operand is an immediate, get it's integer value
-offsetT  InstructionEntry::GetImmediateIntValue(const unsigned int op_index) {
-  i386_insn   *insn = instruction();
+offsetT  InstructionEntry::GetImmediateIntValue(
+    const unsigned int op_index) const {
+  const i386_insn *insn = instruction_;
   MAO_ASSERT(IsImmediateOperand(insn, op_index));
   MAO_ASSERT(insn->operands > op_index);
 
-  expressionS *imm1 = insn->op[op_index].imms;
+  const expressionS *imm1 = insn->op[op_index].imms;
   MAO_ASSERT(imm1->X_op == O_constant);
 
   return imm1->X_add_number;
@@ -1236,7 +1301,8 @@ offsetT  InstructionEntry::GetImmediateIntValue(const unsigned int op_index) {
 void InstructionEntry::SetImmediateIntOperand(const unsigned int op_index,
                                               int bit_size,
                                               int value) {
-  i386_insn *ins = instruction();
+  MaoAnalysisManager::NoteChange();
+  i386_insn *ins = mutable_instruction();
   MAO_ASSERT(ins->operands > op_index);
 
   switch (bit_size) {
@@ -1256,20 +1322,29 @@ void InstructionEntry::SetImmediateIntOperand(const unsigned int op_index,
       ins->types[op_index].bitfield.imm64 = 1;
       break;
   }
+  MaoArena *arena = maounit_->GetArena();
   if (ins->op[op_index].imms)
-    delete ins->op[op_index].imms;
-  ins->op[op_index].imms = new expressionS();
+    arena->Free(ins->op[op_index].imms, sizeof(expressionS));
+  ins->op[op_index].imms = arena->NewZeroed<expressionS>();
   ins->op[op_index].imms->X_op = O_constant;
   ins->op[op_index].imms->X_add_number = value;
 }
 
+void InstructionEntry::SetImmediate(const unsigned int op_index,
+                                    const expressionS &value) {
+  MAO_ASSERT(IsImmediateOperand(op_index));
+  MaoAnalysisManager::NoteChange();
+  // The private copy has its own copies of the expressions.
+  i386_insn *ins = mutable_instruction();
+  *ins->op[op_index].imms = value;
+}
+
 
 // Make a copy of an expression.
 expressionS *InstructionEntry::CreateExpressionCopy(expressionS *in_exp) {
   if (!in_exp)
     return NULL;
-  expressionS *new_exp = new expressionS;
-  memcpy(new_exp, in_exp, sizeof(expressionS));
+  expressionS *new_exp = maounit_->GetArena()->Copy(in_exp);
   MAO_ASSERT(new_exp->X_add_number == in_exp->X_add_number);
   return new_exp;
 }
@@ -1385,8 +1460,9 @@ bool InstructionEntry::EqualExpressions(expressionS *expression1,
 void InstructionEntry::SetOperand(int op1,
                                   InstructionEntry *insn2,
                                   int op2) {
-  i386_insn *i1 = instruction();
-  i386_insn *i2 = insn2->instruction();
+  MaoAnalysisManager::NoteChange();
+  i386_insn *i1 = mutable_instruction();
+  const i386_insn *i2 = insn2->instruction_;
 
   memcpy(&i1->types[op1], &i2->types[op2], sizeof(i386_operand_type));
   i1->flags[op1] = i2->flags[op2];
@@ -1407,8 +1483,8 @@ void InstructionEntry::SetOperand(int op1,
 bool InstructionEntry::CompareMemOperand(int op1,
                                          InstructionEntry *insn2,
                                          int op2) const {
-  i386_insn *i1 = instruction();
-  i386_insn *i2 = insn2->instruction();
+  const i386_insn *i1 = instruction_;
+  const i386_insn *i2 = insn2->instruction_;
 
   if (memcmp(&i1->types[op1], &i2->types[op2], sizeof(i386_operand_type)))
     return false;
@@ -1583,14 +1659,6 @@ std::string &InstructionEntry::MemoryOperandToString(std::string *out,
   return *out;
 }
 
-bool InstructionEntry::HasBaseRegister() const {
-  return instruction_->base_reg != NULL;
-}
-
-bool InstructionEntry::HasIndexRegister() const {
-  return instruction_->index_reg != NULL;
-}
-
 const char *InstructionEntry::GetBaseRegisterStr() const {
   return instruction_->base_reg ? instruction_->base_reg->reg_name : NULL;
 }
@@ -2191,48 +2259,6 @@ std::string &InstructionEntry::ProfileToString(std::string *out) const {
   return *out;
 }
 
-// From an instruction given by gas, allocate new memory and populate the
-// members.
-i386_insn *InstructionEntry::CreateInstructionCopy(i386_insn *in_inst) {
-  i386_insn *new_inst = new i386_insn;
-  MAO_ASSERT(new_inst);
-
-  // Copy all non-pointer data
-  memcpy(new_inst, in_inst, sizeof(i386_insn));
-
-  // Copy references
-  for (unsigned int i = 0; i < new_inst->operands; i++) {
-    // Select the correct part of the operand union.
-    if (IsImmediateOperand(in_inst, i)) {
-      new_inst->op[i].imms = new expressionS;
-      MAO_ASSERT(new_inst->op[i].imms);
-      *new_inst->op[i].imms = *in_inst->op[i].imms;
-    } else if (IsMemOperand(in_inst, i) && in_inst->op[i].disps) {
-      new_inst->op[i].disps = new expressionS;
-      MAO_ASSERT(new_inst->op[i].disps);
-      *new_inst->op[i].disps = *in_inst->op[i].disps;
-    } else if (IsRegisterOperand(in_inst, i)) {
-      new_inst->op[i].regs = in_inst->op[i].regs;
-    }
-  }
-  new_inst->base_reg = in_inst->base_reg;
-  new_inst->index_reg = in_inst->index_reg;
-
-  // Segment overrides
-  for (unsigned int i = 0; i < 2; i++) {
-    if (in_inst->seg[i]) {
-      seg_entry *tmp_seg = new seg_entry;
-      MAO_ASSERT(tmp_seg);
-      MAO_ASSERT(strlen(in_inst->seg[i]->seg_name) < MAX_SEGMENT_NAME_LENGTH);
-      tmp_seg->seg_name = strdup(in_inst->seg[i]->seg_name);
-      tmp_seg->seg_prefix = in_inst->seg[i]->seg_prefix;
-      new_inst->seg[i] = tmp_seg;
-    }
-  }
-
-  return new_inst;
-}
-
 bool InstructionEntry::IsInList(MaoOpcode opcode, const MaoOpcode list[],
                               const unsigned int number_of_elements) const {
   for (unsigned int i = 0; i < number_of_elements; i++) {
@@ -2243,24 +2269,6 @@ bool InstructionEntry::IsInList(MaoOpcode opcode, const MaoOpcode list[],
 }
 
 
-bool InstructionEntry::HasFallThrough() const {
-  if (IsReturn()) return false;
-  if (!HasTarget()) return true;
-  if (IsCall()) return true;
-  if (IsCondJump()) return true;
-  return false;
-}
-
-bool InstructionEntry::HasTarget() const {
-  const MaoOpcode insn[] = {OP_jmp, OP_ljmp};
-  if (IsInList(op(), insn, sizeof(insn)/sizeof(MaoOpcode)))
-    return true;
-  if (IsCondJump())
-    return true;
-
-  return false;
-}
-
 const char *InstructionEntry::GetTarget() const {
   //
   for (unsigned int i =0; i < instruction_->operands; i++) {
@@ -2281,13 +2289,6 @@ const char *InstructionEntry::GetTarget() const {
 }
 
 
-bool InstructionEntry::IsJump() const {
-  const MaoOpcode jumps[] = {
-    OP_jmp, OP_ljmp
-  };
-  return IsInList(op(), jumps, sizeof(jumps)/sizeof(MaoOpcode));
-}
-
 bool InstructionEntry::IsIndirectJump() const {
   // Jump instructions always have one operand
   MAO_ASSERT(!IsJump() || instruction_->operands == 1);
@@ -2296,30 +2297,6 @@ bool InstructionEntry::IsIndirectJump() const {
 }
 
 
-bool InstructionEntry::IsCondJump() const {
-  static const MaoOpcode cond_jumps[] = {
-    // Conditional jumps.
-    OP_jo,  OP_jno, OP_jb,   OP_jc,  OP_jnae, OP_jnb,  OP_jnc, OP_jae, OP_je,
-    OP_jz,  OP_jne, OP_jnz,  OP_jbe, OP_jna,  OP_jnbe, OP_ja,  OP_js,  OP_jns,
-    OP_jp,  OP_jpe, OP_jnp,  OP_jpo, OP_jl,   OP_jnge, OP_jnl, OP_jge, OP_jle,
-    OP_jng,  OP_jnle, OP_jg,
-
-    // jcxz vs. jecxz is chosen on the basis of the address size prefix.
-    OP_jcxz, OP_jecxz, OP_jecxz, OP_jrcxz,
-
-    // loop variants
-    OP_loop, OP_loopz, OP_loope, OP_loopnz, OP_loopne
-  };
-  return IsInList(op(), cond_jumps, sizeof(cond_jumps)/sizeof(MaoOpcode));
-}
-
-bool InstructionEntry::IsCall() const {
-  const MaoOpcode calls[] = {
-    OP_call, OP_lcall, OP_vmcall, OP_syscall, OP_vmmcall
-  };
-  return IsInList(op(), calls, sizeof(calls)/sizeof(MaoOpcode));
-}
-
 bool InstructionEntry::IsThunkCall() const {
   if (!IsCall())
     return false;
@@ -2327,17 +2304,118 @@ bool InstructionEntry::IsThunkCall() const {
   return (strstr(target, "get_pc_thunk") != NULL);
 }
 
-bool InstructionEntry::IsReturn() const {
-  const MaoOpcode rets[] = {
-    OP_ret, OP_lret, OP_retf, OP_iret, OP_sysret
-  };
-  return IsInList(op(), rets, sizeof(rets)/sizeof(MaoOpcode));
-}
+static const MaoOpcode jumps[] = {
+  OP_jmp, OP_ljmp
+};
+
+static const MaoOpcode cond_jumps[] = {
+  // Conditional jumps.
+  OP_jo,  OP_jno, OP_jb,   OP_jc,  OP_jnae, OP_jnb,  OP_jnc, OP_jae, OP_je,
+  OP_jz,  OP_jne, OP_jnz,  OP_jbe, OP_jna,  OP_jnbe, OP_ja,  OP_js,  OP_jns,
+  OP_jp,  OP_jpe, OP_jnp,  OP_jpo, OP_jl,   OP_jnge, OP_jnl, OP_jge, OP_jle,
+  OP_jng,  OP_jnle, OP_jg,
+
+  // jcxz vs. jecxz is chosen on the basis of the address size prefix.
+  OP_jcxz, OP_jecxz, OP_jecxz, OP_jrcxz,
+
+  // loop variants
+  OP_loop, OP_loopz, OP_loope, OP_loopnz, OP_loopne
+};
+
+static const MaoOpcode calls[] = {
+  OP_call, OP_lcall, OP_vmcall, OP_syscall, OP_vmmcall
+};
+
+static const MaoOpcode rets[] = {
+  OP_ret, OP_lret, OP_retf, OP_iret, OP_sysret
+};
 
-bool InstructionEntry::IsAdd() const {
-  return op() == OP_add;
+static const MaoOpcode movs[] = {
+  OP_mov, OP_movq
+};
+
+static const MaoOpcode opcode_is_predicated[] =  {
+  OP_cmovo,   OP_cmovno,  OP_cmovb,   OP_cmovc,    OP_cmovnae,
+  OP_cmovae,  OP_cmovnc,  OP_cmovnb,  OP_cmove,    OP_cmovz,
+  OP_cmovne,  OP_cmovnz,  OP_cmovbe,  OP_cmovna,   OP_cmova,
+  OP_cmovnbe, OP_cmovs,   OP_cmovns,  OP_cmovp,    OP_cmovnp,
+  OP_cmovl,   OP_cmovnge, OP_cmovge,  OP_cmovnl,   OP_cmovle,
+  OP_cmovng,  OP_cmovg,   OP_cmovnle, OP_fcmovb,   OP_fcmovnae,
+  OP_fcmove,  OP_fcmovbe, OP_fcmovna, OP_fcmovu,   OP_fcmovae,
+  OP_fcmovnb, OP_fcmovne, OP_fcmova,  OP_fcmovnbe, OP_fcmovnu
+};
+
+#define IN_LIST(list) IsInList(op(), list, sizeof(list)/sizeof(MaoOpcode))
+
+void InstructionEntry::ComputeSummary() const {
+  summary_.opcode_classes =
+      (IN_LIST(jumps) ? JUMP_CLASS : 0) |
+      (IN_LIST(cond_jumps) ? COND_JUMP_CLASS : 0) |
+      (IN_LIST(calls) ? CALL_CLASS : 0) |
+      (IN_LIST(rets) ? RETURN_CLASS : 0) |
+      (IN_LIST(movs) ? MOV_CLASS : 0) |
+      (IN_LIST(opcode_is_predicated) ? PREDICATED_CLASS : 0);
+
+  summary_.address_flags =
+      (instruction_->base_reg ? HAS_BASE_REG : 0) |
+      (instruction_->index_reg ? HAS_INDEX_REG : 0) |
+      (instruction_->log2_scale_factor ? HAS_SCALE : 0);
+
+  // The operand types are valid past the last operand, so this gives the
+  // predicates the same answers as looking at the types directly.
+  for (unsigned int i = 0; i < MAX_OPERANDS; i++) {
+    const i386_operand_type &t = instruction_->types[i];
+    unsigned int kinds = 0;
+    if (t.bitfield.disp8 || t.bitfield.disp16 || t.bitfield.disp32 ||
+        t.bitfield.disp32s || t.bitfield.disp64 || t.bitfield.baseindex)
+      kinds |= MEM_OPERAND;
+    if (t.bitfield.disp8 || t.bitfield.unspecified)
+      kinds |= MEM8_OPERAND;
+    if (t.bitfield.disp16 || t.bitfield.unspecified)
+      kinds |= MEM16_OPERAND;
+    if (t.bitfield.disp32 || t.bitfield.disp32s || t.bitfield.unspecified)
+      kinds |= MEM32_OPERAND;
+    if (t.bitfield.disp64 || t.bitfield.unspecified)
+      kinds |= MEM64_OPERAND;
+    if (t.bitfield.imm1 || t.bitfield.imm8 || t.bitfield.imm8s ||
+        t.bitfield.imm16 || t.bitfield.imm32 || t.bitfield.imm32s ||
+        t.bitfield.imm64) {
+      kinds |= IMM_OPERAND;
+      const expressionS *imm = instruction_->op[i].imms;
+      if (imm && imm->X_op == O_constant)
+        kinds |= IMM_INT_OPERAND;
+    }
+    if (t.bitfield.acc || t.bitfield.shiftcount || t.bitfield.reg8 ||
+        t.bitfield.reg16 || t.bitfield.reg32 || t.bitfield.reg64 ||
+        t.bitfield.control || t.bitfield.test || t.bitfield.debug ||
+        t.bitfield.sreg2 || t.bitfield.sreg3 || t.bitfield.floatreg ||
+        t.bitfield.regxmm || t.bitfield.regmmx || t.bitfield.regymm)
+      kinds |= REG_OPERAND;
+    if (t.bitfield.reg8 || (t.bitfield.acc && t.bitfield.byte))
+      kinds |= REG8_OPERAND;
+    if (t.bitfield.reg16 || (t.bitfield.acc && t.bitfield.word))
+      kinds |= REG16_OPERAND;
+    if (t.bitfield.reg32 || (t.bitfield.acc && t.bitfield.dword))
+      kinds |= REG32_OPERAND;
+    if (t.bitfield.reg64 || (t.bitfield.acc && t.bitfield.qword))
+      kinds |= REG64_OPERAND;
+    if (t.bitfield.floatreg)
+      kinds |= REG_FLOAT_OPERAND;
+    if (t.bitfield.regxmm)
+      kinds |= REG_XMM_OPERAND;
+    // HasDisplacement() only looks at the operand union, not the type.
+    if (i < instruction_->operands && instruction_->op[i].disps != NULL) {
+      kinds |= DISP_OPERAND;
+      if (kinds & MEM_OPERAND)
+        summary_.address_flags |= HAS_DISPLACEMENT;
+    }
+    summary_.operand_kinds[i] = kinds;
+  }
+  summary_valid_ = true;
 }
 
+#undef IN_LIST
+
 
 //
 // Class: EntryIterator
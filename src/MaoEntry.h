@@ -41,10 +41,13 @@ extern "C" {
 #include "gen-opcodes.h"
 #include "irlink.h"
 
+#include "MaoAnalysis.h"
 #include "MaoDebug.h"
 #include "MaoTypes.h"
 
 // Forward declarations.
+class BitString;
+class MaoEmitter;
 class MaoUnit;
 class DirectiveEntry;
 class InstructionEntry;
@@ -70,9 +73,13 @@ class MaoEntry {
   virtual std::string &ToString(std::string *out) const = 0;
   // Prints the entry to FILE *out.
   virtual void PrintEntry(FILE *out = stderr) const = 0;
+  // Emits the entry in assembly syntax, as PrintEntry() does.
+  virtual void EmitEntry(MaoEmitter *out) const = 0;
   // Prints the information corresponding to this entry in the input assembly
   // file.
   std::string &SourceInfoToString(std::string *out) const;
+  // Emits the same information, unless the emitter leaves it out.
+  void EmitSourceInfo(MaoEmitter *out) const;
   // Prints the internal representation of this entry.
   virtual void PrintIR(FILE *out = stderr) const = 0;
   // Returns a character that describes the type of this entry (L for label, D
@@ -86,6 +93,10 @@ class MaoEntry {
   const EntryID id() const { return id_; }
   // Sets the id of this entry.
   void set_id(const EntryID id) {id_ = id;}
+  // Returns the id the entry would have without the renumbering of
+  // MaoUnit::CompactEntries(). Shown in the source info comments.
+  const EntryID source_id() const { return source_id_; }
+  void set_source_id(const EntryID id) {source_id_ = id;}
 
   // Is this an instruction entry?
   bool IsInstruction() const { return Type() == INSTRUCTION; }
@@ -141,7 +152,7 @@ class MaoEntry {
   const char *const line_verbatim() const { return line_verbatim_; }
 
   // Returns the symbols name from an expressionS *.
-  const char *GetSymbolnameFromExpression(expressionS *expr) const;
+  const char *GetSymbolnameFromExpression(const expressionS *expr) const;
 
  protected:
   // Helper function to indent.
@@ -156,6 +167,9 @@ class MaoEntry {
 
   MaoUnit *maounit_;
 
+  // Returns the copy of str interned in the string pool of the unit.
+  const char *InternString(const char *str) const;
+
   // Converts a displacement expression into a string.
   const std::string &ExpressionToStringDisp(
       const expressionS *expr,
@@ -172,6 +186,7 @@ class MaoEntry {
 
  private:
   EntryID id_;
+  EntryID source_id_;
 
   // Section-local pointers to previous and next entry.
   // Null-value in prev/next means first/last entry in section.
@@ -181,7 +196,8 @@ class MaoEntry {
   // Line number assembly was found in the original file.
   const unsigned int line_number_;
   // A verbatim copy of the assembly instruction this entry is
-  // generated from. Might be NULL for some entries.
+  // generated from, interned in the string pool of the unit. Might be
+  // NULL for some entries.
   const char *line_verbatim_;
 
   // This flag is true for entries that have been added
@@ -210,17 +226,18 @@ class LabelEntry : public MaoEntry {
              const char *const line_verbatim,
              MaoUnit *maounit)
       : MaoEntry(line_number, line_verbatim, maounit),
-        name_(strdup(name)), from_assembly_(true) { }
-  ~LabelEntry() { delete name_; }
+        name_(InternString(name)), from_assembly_(true) { }
 
   // Returns the string form of this label.
   virtual std::string &ToString(std::string *out) const;
   // Prints the label entry.
   virtual void PrintEntry(FILE *out = stderr) const;
+  virtual void EmitEntry(MaoEmitter *out) const;
   // Prints the internal representation of this label entry.
   virtual void PrintIR(FILE *out) const;
   virtual EntryType Type() const { return LABEL; }
-  // Returns the label name.
+  // Returns the label name. Names are interned, so two labels have the
+  // same name if and only if the pointers are equal.
   const char *name() { return name_; }
   virtual char GetDescriptiveChar() const { return 'L'; }
   // Returns true if this label is present in the original assembly file.
@@ -432,6 +449,7 @@ class DirectiveEntry : public MaoEntry {
   virtual std::string &ToString(std::string *out) const;
   // Prints this directive entry to FILE *out.
   virtual void PrintEntry(::FILE *out = stderr) const;
+  virtual void EmitEntry(MaoEmitter *out) const;
   // Prints this directive entry to FILE *out.
   virtual void PrintIR(::FILE *out) const;
   virtual MaoEntry::EntryType  Type() const;
@@ -470,19 +488,76 @@ class DirectiveEntry : public MaoEntry {
 };
 
 
+// Read-only view of the i386_insn of an instruction, as returned by
+// InstructionEntry::instruction(). Through a const i386_insn, the
+// expressions of the immediate and displacement operands could still
+// be changed, and they may be shared with other entries, see
+// MaoInstructionPool. The view only hands them out as const. It has the
+// layout of i386_insn and is never constructed, only cast to.
+class InstructionView : private i386_insn {
+ public:
+  using i386_insn::tm;
+  using i386_insn::suffix;
+  using i386_insn::operands;
+  using i386_insn::reg_operands;
+  using i386_insn::disp_operands;
+  using i386_insn::mem_operands;
+  using i386_insn::imm_operands;
+  using i386_insn::types;
+  using i386_insn::flags;
+  using i386_insn::reloc;
+  using i386_insn::base_reg;
+  using i386_insn::index_reg;
+  using i386_insn::log2_scale_factor;
+  using i386_insn::seg;
+  using i386_insn::prefixes;
+  using i386_insn::prefix;
+  using i386_insn::rm;
+  using i386_insn::rex;
+  using i386_insn::sib;
+  using i386_insn::vex;
+  using i386_insn::swap_operand;
+  using i386_insn::disp32_encoding;
+
+  static const InstructionView *Of(const i386_insn *insn) {
+    return static_cast<const InstructionView *>(insn);
+  }
+
+  const expressionS *imms(const unsigned int op_index) const {
+    return op[op_index].imms;
+  }
+  const expressionS *disps(const unsigned int op_index) const {
+    return op[op_index].disps;
+  }
+  const reg_entry *regs(const unsigned int op_index) const {
+    return op[op_index].regs;
+  }
+
+  // The whole i386_insn, for code that only reads it, e.g. to compute
+  // the size of the instruction. The expressions must not be changed.
+  const i386_insn *raw() const { return this; }
+
+ private:
+  InstructionView();
+};
+
+
 // Class to represent an assembly instruction.
 class InstructionEntry : public MaoEntry {
  public:
   static const unsigned int kMaxRegisterNameLength = MAX_REGISTER_NAME_LENGTH;
 
+  // Without add_implied_prefixes, the instruction has the prefixes
+  // implied by its opcode already, e.g. when it is loaded by IRLOAD.
   InstructionEntry(i386_insn* instruction, enum flag_code flag_code,
                    unsigned int line_number, const char* line_verbatim,
-                   MaoUnit *maounit);
+                   MaoUnit *maounit, bool add_implied_prefixes = true);
   ~InstructionEntry();
   // Returns a string representation of this instruction entry.
   virtual std::string &ToString(std::string *out) const;
   // Prints this instruction  entry into FILE *out.
   virtual void PrintEntry(FILE *out = stderr) const;
+  virtual void EmitEntry(MaoEmitter *out) const;
   // Prints the internal representation of this instruction.
   virtual void PrintIR(FILE *out) const;
   virtual MaoEntry::EntryType  Type() const;
@@ -512,41 +587,51 @@ class InstructionEntry : public MaoEntry {
   // Returns the opcode of this instruction.
   MaoOpcode   op() const { return op_; }
   // Sets the opcode of this instruction.
-  void        set_op(MaoOpcode op) { op_ = op; }
+  void        set_op(MaoOpcode op) {
+    MaoAnalysisManager::NoteChange();
+    InvalidateRegisterMasks();
+    summary_valid_ = false;
+    op_ = op;
+  }
 
   // Property methods.
   //
   // Returns if this instruction has a target label.
-  bool HasTarget() const;
+  bool HasTarget() const {
+    return HasOpcodeClass(JUMP_CLASS | COND_JUMP_CLASS);
+  }
   // Returns if this instruction has a fallthrough (another instruction that
   // follows it to which control can get transfered after this instruction).
-  bool HasFallThrough() const;
+  bool HasFallThrough() const {
+    return !HasOpcodeClass(JUMP_CLASS | RETURN_CLASS);
+  }
   // Returns if this is a control transfer instruction.
   bool IsControlTransfer() const {
-    return HasTarget() || IsCall() || IsReturn();
+    return HasOpcodeClass(JUMP_CLASS | COND_JUMP_CLASS | CALL_CLASS |
+                          RETURN_CLASS);
   }
   // Returns if this is an indirect jump instruction.
   bool IsIndirectJump() const;
   // Returns if this is a conditional jump instruction.
-  bool IsCondJump() const;
+  bool IsCondJump() const { return HasOpcodeClass(COND_JUMP_CLASS); }
   // Returns if this is a jump instruction.
-  bool IsJump() const;
+  bool IsJump() const { return HasOpcodeClass(JUMP_CLASS); }
   // Returns if this is a call instruction.
-  bool IsCall() const;
+  bool IsCall() const { return HasOpcodeClass(CALL_CLASS); }
   // Returns if this is a 'thunk call' (one used to find the current IP).
   bool IsThunkCall() const;
   // Returns if this is a return instruction.
-  bool IsReturn() const;
+  bool IsReturn() const { return HasOpcodeClass(RETURN_CLASS); }
   // Returns if this is an add instruction.
-  bool IsAdd() const;
+  bool IsAdd() const { return op() == OP_add; }
   // Returns if this is a move instruction.
-  bool IsOpMov() const { return op() == OP_mov || op() == OP_movq; }
+  bool IsOpMov() const { return HasOpcodeClass(MOV_CLASS); }
   // Returns if this is a load which indexes/triggers the prefetcher(s)
   bool IsPrefetchLoad() const { return IsOpMov(); }
   // Returns if this is a lock instruction.
   bool IsLock() const { return op() == OP_lock; }
   // Returns if this is a predicated instruction (conditional moves).
-  bool IsPredicated() const;
+  bool IsPredicated() const { return HasOpcodeClass(PREDICATED_CLASS); }
 
   // Returns the number of operands to this instruction.
   int NumOperands() const {
@@ -554,96 +639,92 @@ class InstructionEntry : public MaoEntry {
   }
   // Returns if the operand with index op_index is a memory operand.
   bool IsMemOperand(const unsigned int op_index) const {
-    return IsMemOperand(instruction(), op_index);
+    MAO_ASSERT(instruction_->operands > op_index);
+    return HasOperandKind(op_index, MEM_OPERAND);
   }
   // Returns if the operand with index op_index is a memory operand accessing a
   // byte.
   bool IsMem8Operand(const unsigned int op_index) const {
-    return instruction_->types[op_index].bitfield.disp8 ||
-        instruction_->types[op_index].bitfield.unspecified;
+    return HasOperandKind(op_index, MEM8_OPERAND);
   }
   // Returns if the operand with index op_index is a memory operand accessing a
   // word.
   bool IsMem16Operand(const unsigned int op_index) const {
-    return instruction_->types[op_index].bitfield.disp16 ||
-        instruction_->types[op_index].bitfield.unspecified;
+    return HasOperandKind(op_index, MEM16_OPERAND);
   }
   // Returns if the operand with index op_index is a memory operand accessing a
   // double word.
   bool IsMem32Operand(const unsigned int op_index) const {
-    return instruction_->types[op_index].bitfield.disp32 ||
-        instruction_->types[op_index].bitfield.disp32s ||
-        instruction_->types[op_index].bitfield.unspecified;
+    return HasOperandKind(op_index, MEM32_OPERAND);
   }
   // Returns if the operand with index op_index is a memory operand accessing a
   // quad word.
   bool IsMem64Operand(const unsigned int op_index) const {
-    return instruction_->types[op_index].bitfield.disp64 ||
-        instruction_->types[op_index].bitfield.unspecified;
+    return HasOperandKind(op_index, MEM64_OPERAND);
   }
   // Returns if the operand with index op_index is an immediate operand.
   bool IsImmediateOperand(const unsigned int op_index) const {
-    return IsImmediateOperand(instruction(), op_index);
+    MAO_ASSERT(instruction_->operands > op_index);
+    return HasOperandKind(op_index, IMM_OPERAND);
   }
   // Returns if the operand with index op_index is an immediate integer operand.
   bool IsImmediateIntOperand(const unsigned int op_index) const {
-    return IsImmediateIntOperand(instruction(), op_index);
+    MAO_ASSERT(instruction_->operands > op_index);
+    return HasOperandKind(op_index, IMM_INT_OPERAND);
   }
   // Returns if the operand with index op_index is a register operand.
   bool IsRegisterOperand(const unsigned int op_index) const {
-    return IsRegisterOperand(instruction(), op_index);
+    MAO_ASSERT(instruction_->operands > op_index);
+    return HasOperandKind(op_index, REG_OPERAND);
   }
   // Returns if the operand with index op_index is a register operand with a 8
   // byte register.
   bool IsRegister8Operand(const unsigned int op_index) const {
-    return instruction_->types[op_index].bitfield.reg8 ||
-      (instruction_->types[op_index].bitfield.acc &&
-       instruction_->types[op_index].bitfield.byte);
+    return HasOperandKind(op_index, REG8_OPERAND);
   }
   // Returns if the operand with index op_index is a register operand with a 16
   // byte register.
   bool IsRegister16Operand(const unsigned int op_index) const {
-    return instruction_->types[op_index].bitfield.reg16 ||
-      (instruction_->types[op_index].bitfield.acc &&
-       instruction_->types[op_index].bitfield.word);
+    return HasOperandKind(op_index, REG16_OPERAND);
   }
   // Returns if the operand with index op_index is a register operand with a 32
   // byte register.
   bool IsRegister32Operand(const unsigned int op_index) const {
-    return instruction_->types[op_index].bitfield.reg32 ||
-      (instruction_->types[op_index].bitfield.acc &&
-       instruction_->types[op_index].bitfield.dword);
+    return HasOperandKind(op_index, REG32_OPERAND);
   }
   // Returns if the operand with index op_index is a register operand with a 64
   // byte register.
   bool IsRegister64Operand(const unsigned int op_index) const {
-    return instruction_->types[op_index].bitfield.reg64 ||
-      (instruction_->types[op_index].bitfield.acc &&
-       instruction_->types[op_index].bitfield.qword);
+    return HasOperandKind(op_index, REG64_OPERAND);
   }
   // Returns if the operand with index op_index is a register operand with a
   // floating point register.
   bool IsRegisterFloatOperand(const unsigned int op_index) const {
-    return instruction_->types[op_index].bitfield.floatreg;
+    return HasOperandKind(op_index, REG_FLOAT_OPERAND);
   }
   // Returns if the operand with index op_index is a register operand with a
   // xmm (SSE2) register.
   bool IsRegisterXMMOperand(const unsigned int op_index) const {
-    return instruction_->types[op_index].bitfield.regxmm;
+    return HasOperandKind(op_index, REG_XMM_OPERAND);
   }
   // Returns if this instruction is a string operation (movs, stos, etc).
-  bool IsStringOperation() {
+  bool IsStringOperation() const {
     return instruction_->tm.opcode_modifier.isstring;
   }
 
   // Returns if this instruction has a displacement field.
   bool HasDisplacement(const int op_index) const {
     MAO_ASSERT(op_index < NumOperands());
-    return instruction_->op[op_index].disps != NULL;
+    return HasOperandKind(op_index, DISP_OPERAND);
+  }
+  // Returns if a memory operand of this instruction has a displacement.
+  bool HasMemDisplacement() const {
+    return (summary().address_flags & HAS_DISPLACEMENT) != 0;
   }
 
-  // Returns the displacement field of this instruction.
-  expressionS *GetDisplacement(const int op_index) const {
+  // Returns the displacement field of this instruction. It may be
+  // shared with other entries, see MaoInstructionPool.
+  const expressionS *GetDisplacement(const int op_index) const {
     MAO_ASSERT(HasDisplacement(op_index));
     return instruction_->op[op_index].disps;
   }
@@ -654,9 +735,16 @@ class InstructionEntry : public MaoEntry {
   // i2.
   void SetOperand(int op1, InstructionEntry *i2, int op2);
 
-  // Returns a pointer to the binutils i386_insn structure wrapped by this
-  // instruction entry.
-  i386_insn   *instruction() const { return instruction_; }
+  // Returns a view of the binutils i386_insn structure wrapped by this
+  // instruction entry. It may be shared with other entries, see
+  // MaoInstructionPool.
+  const InstructionView *instruction() const {
+    return InstructionView::Of(instruction_);
+  }
+  // Returns the i386_insn for changing it. The first call replaces a
+  // shared i386_insn with a private copy. Drops the cached register
+  // masks and summary.
+  i386_insn *mutable_instruction();
 
   // Returns the register name of the register operand at index op_index.
   const char  *GetRegisterOperandStr(const unsigned int op_index) const {
@@ -673,9 +761,17 @@ class InstructionEntry : public MaoEntry {
   }
 
   // Returns if this instruction has base register.
-  bool HasBaseRegister() const;
+  bool HasBaseRegister() const {
+    return (summary().address_flags & HAS_BASE_REG) != 0;
+  }
   // Returns if this instruction has index register.
-  bool HasIndexRegister() const;
+  bool HasIndexRegister() const {
+    return (summary().address_flags & HAS_INDEX_REG) != 0;
+  }
+  // Returns if the index register of this instruction is scaled.
+  bool HasScale() const {
+    return (summary().address_flags & HAS_SCALE) != 0;
+  }
 
   // Returns the register name of the base register.
   const char  *GetBaseRegisterStr() const;
@@ -744,15 +840,104 @@ class InstructionEntry : public MaoEntry {
                                  const unsigned int op_index);
 
   // If operand is an immediate operand, return its integer value.
-  offsetT GetImmediateIntValue(const unsigned int op_index);
+  offsetT GetImmediateIntValue(const unsigned int op_index) const;
+  // Returns the expression of the immediate operand at op_index. It may
+  // be shared with other entries, see MaoInstructionPool.
+  const expressionS *GetImmediate(const unsigned int op_index) const {
+    MAO_ASSERT(IsImmediateOperand(op_index));
+    return instruction_->op[op_index].imms;
+  }
 
   // Make an operand an Int Immediate operand
   void SetImmediateIntOperand(const unsigned int op_index,
                               int bit_size,
                               int value);
+  // Replaces the expression of the immediate operand at op_index with a
+  // copy of value. The operand type stays.
+  void SetImmediate(const unsigned int op_index, const expressionS &value);
+
+  // Register masks of the instruction, as computed by
+  // GetRegisterDefMask() and GetRegisterUseMask(), which cache them
+  // here. The mutators above drop the cached masks. Code that changes
+  // the i386_insn through mutable_instruction() drops them as well.
+  enum RegisterMaskKind {
+    DEF_MASK = 0,
+    DEF_MASK_EXPANDED,
+    USE_MASK,
+    USE_MASK_EXPANDED,
+    NUM_REGISTER_MASKS
+  };
+  // Returns the cached mask, or NULL if it is not computed yet.
+  const BitString *GetCachedRegisterMask(RegisterMaskKind kind) const;
+  void SetCachedRegisterMask(RegisterMaskKind kind,
+                             const BitString &mask) const;
+  void InvalidateRegisterMasks() { register_masks_valid_ = 0; }
 
  private:
-  i386_insn *instruction_;
+  // Bits of Summary::opcode_classes.
+  enum OpcodeClass {
+    JUMP_CLASS       = 1 << 0,
+    COND_JUMP_CLASS  = 1 << 1,
+    CALL_CLASS       = 1 << 2,
+    RETURN_CLASS     = 1 << 3,
+    MOV_CLASS        = 1 << 4,
+    PREDICATED_CLASS = 1 << 5
+  };
+  // Bits of Summary::operand_kinds, one per operand predicate.
+  enum OperandKind {
+    MEM_OPERAND       = 1 << 0,
+    MEM8_OPERAND      = 1 << 1,
+    MEM16_OPERAND     = 1 << 2,
+    MEM32_OPERAND     = 1 << 3,
+    MEM64_OPERAND     = 1 << 4,
+    IMM_OPERAND       = 1 << 5,
+    IMM_INT_OPERAND   = 1 << 6,
+    REG_OPERAND       = 1 << 7,
+    REG8_OPERAND      = 1 << 8,
+    REG16_OPERAND     = 1 << 9,
+    REG32_OPERAND     = 1 << 10,
+    REG64_OPERAND     = 1 << 11,
+    REG_FLOAT_OPERAND = 1 << 12,
+    REG_XMM_OPERAND   = 1 << 13,
+    DISP_OPERAND      = 1 << 14
+  };
+  // Bits of Summary::address_flags.
+  enum AddressFlag {
+    HAS_BASE_REG     = 1 << 0,
+    HAS_INDEX_REG    = 1 << 1,
+    HAS_SCALE        = 1 << 2,
+    HAS_DISPLACEMENT = 1 << 3
+  };
+  // The opcode and operand types decoded for the predicates above, so
+  // that they do not go through the i386_insn and the opcode lists
+  // every time. Computed when the instruction is created, and on the
+  // next use after set_op(). It is only kept while the instruction is
+  // shared: a private copy may be changed through the pointer
+  // mutable_instruction() returned at any time, so its summary is
+  // computed again on every use.
+  struct Summary {
+    unsigned char opcode_classes;
+    unsigned char address_flags;
+    unsigned short operand_kinds[MAX_OPERANDS];
+  };
+
+  const Summary &summary() const {
+    if (!summary_valid_ || private_instruction_ != NULL)
+      ComputeSummary();
+    return summary_;
+  }
+  void ComputeSummary() const;
+  bool HasOpcodeClass(unsigned int classes) const {
+    return (summary().opcode_classes & classes) != 0;
+  }
+  bool HasOperandKind(const unsigned int op_index, unsigned int kind) const {
+    MAO_ASSERT(op_index < MAX_OPERANDS);
+    return (summary().operand_kinds[op_index] & kind) != 0;
+  }
+
+  // The shared copy from the instruction pool of the unit, or
+  // private_instruction_ once the instruction is changed.
+  const i386_insn *instruction_;
   MaoOpcode  op_;
 
   // This flag states which code-mode the instruction is in. This is changed
@@ -765,10 +950,18 @@ class InstructionEntry : public MaoEntry {
   bool execution_count_valid_;
   long execution_count_;
 
-  // Allocates memory for a new instruction and populates it.
-  // The instruction passed from gas might not be allocated
-  // until the end of the program.
-  i386_insn *CreateInstructionCopy(i386_insn *in_inst);
+  // The cached register masks, allocated on first use, and a bit per
+  // RegisterMaskKind telling which of them are valid.
+  mutable BitString *register_masks_;
+  mutable unsigned char register_masks_valid_;
+
+  mutable Summary summary_;
+  mutable bool summary_valid_;
+
+  // The copy of the instruction made by mutable_instruction(), or NULL
+  // while the instruction is shared.
+  i386_insn *private_instruction_;
+
   // Allocates memory for a register entry to be used
   // in the instruction.
   expressionS *CreateExpressionCopy(expressionS *in_exp);
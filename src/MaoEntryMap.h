@@ -0,0 +1,160 @@
+//
+// Copyright 2010 Google Inc.
+//
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301, USA.
+
+// MaoEntryIntMap maps entries to integers, e.g., the sizes and offsets
+// computed by the relaxer. It supports the subset of the std::map
+// interface used in MAO, but stores the values in a vector indexed by
+// the entry id, so lookups are constant time. The vector starts at the
+// smallest id in the map, so that the map of a section only takes room
+// for the ids of the section, not for all the entries before it.
+//
+// Iteration visits the entries in id order. Since entry ids change
+// when the unit compacts its entries (see MaoUnit::CompactEntries()),
+// a map must not be kept across a compaction.
+//
+// Usage:
+//   MaoEntryIntMap sizes;
+//   sizes[entry] = 4;
+//   if (sizes.find(entry) != sizes.end()) ...
+
+#ifndef MAOENTRYMAP_H_
+#define MAOENTRYMAP_H_
+
+#include <utility>
+#include <vector>
+
+#include "MaoDebug.h"
+#include "MaoEntry.h"
+
+class MaoEntryIntMap {
+ public:
+  typedef std::pair<MaoEntry *, int> value_type;
+
+ private:
+  // A slot whose first member is NULL holds no value.
+  typedef std::vector<value_type> SlotVector;
+
+  template <class Slots, class Value>
+  class IteratorBase {
+   public:
+    IteratorBase(Slots *slots, size_t index) : slots_(slots), index_(index) {
+      SkipEmpty();
+    }
+    // Allows an iterator to be converted to a const_iterator.
+    template <class OtherSlots, class OtherValue>
+    IteratorBase(const IteratorBase<OtherSlots, OtherValue> &other)
+        : slots_(other.slots()), index_(other.index()) { }
+
+    Value &operator *() const { return (*slots_)[index_]; }
+    Value *operator ->() const { return &(*slots_)[index_]; }
+    IteratorBase &operator ++() {
+      ++index_;
+      SkipEmpty();
+      return *this;
+    }
+    bool operator ==(const IteratorBase &other) const {
+      return index_ == other.index_;
+    }
+    bool operator !=(const IteratorBase &other) const {
+      return index_ != other.index_;
+    }
+    size_t index() const { return index_; }
+    Slots *slots() const { return slots_; }
+
+   private:
+    void SkipEmpty() {
+      while (index_ < slots_->size() && (*slots_)[index_].first == NULL)
+        ++index_;
+    }
+
+    Slots *slots_;
+    size_t index_;
+  };
+
+ public:
+  typedef IteratorBase<SlotVector, value_type> iterator;
+  typedef IteratorBase<const SlotVector, const value_type> const_iterator;
+
+  MaoEntryIntMap() : first_id_(0), size_(0) { }
+
+  // Returns the value for entry, inserting 0 if it has none.
+  int &operator[](MaoEntry *entry) {
+    EntryID id = entry->id();
+    MAO_ASSERT(id >= 0);
+    const value_type empty(static_cast<MaoEntry *>(NULL), 0);
+    if (slots_.empty()) {
+      first_id_ = id;
+    } else if (id < first_id_) {
+      slots_.insert(slots_.begin(), first_id_ - id, empty);
+      first_id_ = id;
+    }
+    size_t index = id - first_id_;
+    if (index >= slots_.size())
+      slots_.resize(index + 1, empty);
+    value_type &slot = slots_[index];
+    if (slot.first != entry) {
+      if (slot.first == NULL)
+        ++size_;
+      slot.first = entry;
+      slot.second = 0;
+    }
+    return slot.second;
+  }
+
+  iterator find(const MaoEntry *entry) {
+    return Contains(entry) ?
+        iterator(&slots_, entry->id() - first_id_) : end();
+  }
+  const_iterator find(const MaoEntry *entry) const {
+    return Contains(entry) ?
+        const_iterator(&slots_, entry->id() - first_id_) : end();
+  }
+
+  void erase(iterator iter) {
+    MAO_ASSERT(iter != end());
+    slots_[iter.index()].first = NULL;
+    --size_;
+  }
+
+  iterator begin() { return iterator(&slots_, 0); }
+  iterator end() { return iterator(&slots_, slots_.size()); }
+  const_iterator begin() const { return const_iterator(&slots_, 0); }
+  const_iterator end() const { return const_iterator(&slots_, slots_.size()); }
+
+  int size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  void clear() {
+    slots_.clear();
+    first_id_ = 0;
+    size_ = 0;
+  }
+
+ private:
+  bool Contains(const MaoEntry *entry) const {
+    return entry != NULL && entry->id() >= first_id_ &&
+        entry->id() - first_id_ < static_cast<EntryID>(slots_.size()) &&
+        slots_[entry->id() - first_id_].first == entry;
+  }
+
+  // The id of the entry in slots_[0].
+  EntryID first_id_;
+  SlotVector slots_;
+  int size_;
+};
+
+#endif  // MAOENTRYMAP_H_
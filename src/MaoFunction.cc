@@ -61,6 +61,14 @@ void Function::Print(FILE *out) {
 }
 
 void Function::set_cfg(CFG *cfg) {
+  // The LSG and the data-flow problems refer to the basic blocks of
+  // the previous CFG.
+  set_lsg(NULL);
+  set_liveness(NULL);
+  set_reaching_defs(NULL);
+  set_flags_liveness(NULL);
+  set_dominators(NULL);
+  set_post_dominators(NULL);
   // Deallocate any previous CFG.
   if (cfg_ != NULL) {
     delete cfg_;
@@ -75,3 +83,38 @@ void Function::set_lsg(LoopStructureGraph *lsg) {
   }
   lsg_ = lsg;
 }
+
+void Function::set_liveness(Liveness *liveness) {
+  if (liveness_ != NULL) {
+    delete liveness_;
+  }
+  liveness_ = liveness;
+}
+
+void Function::set_reaching_defs(ReachingDefs *reaching_defs) {
+  if (reaching_defs_ != NULL) {
+    delete reaching_defs_;
+  }
+  reaching_defs_ = reaching_defs;
+}
+
+void Function::set_flags_liveness(FlagsLiveness *flags_liveness) {
+  if (flags_liveness_ != NULL) {
+    delete flags_liveness_;
+  }
+  flags_liveness_ = flags_liveness;
+}
+
+void Function::set_dominators(DominatorTree *dominators) {
+  if (dominators_ != NULL) {
+    delete dominators_;
+  }
+  dominators_ = dominators;
+}
+
+void Function::set_post_dominators(PostDominatorTree *post_dominators) {
+  if (post_dominators_ != NULL) {
+    delete post_dominators_;
+  }
+  post_dominators_ = post_dominators;
+}
@@ -31,6 +31,12 @@
 #include "MaoSection.h"
 #include "MaoTypes.h"
 
+class DominatorTree;
+class FlagsLiveness;
+class Liveness;
+class PostDominatorTree;
+class ReachingDefs;
+
 // Function class
 // A function is defined as a sequence of instructions from a
 // label matching a symbol with the type Function to the next function,
@@ -42,15 +48,18 @@
 //
 class Function {
  public:
-  explicit Function(const std::string &name, const FunctionID id,
+  // The name is not copied, it must be interned in the string pool of
+  // the unit.
+  explicit Function(const char *name, const FunctionID id,
                     SubSection *subsection) :
       name_(name), id_(id), first_entry_(NULL), last_entry_(NULL),
-      subsection_(subsection), cfg_(NULL), lsg_(NULL) {}
+      subsection_(subsection), next_label_number_(0),
+      cfg_(NULL), lsg_(NULL), liveness_(NULL), reaching_defs_(NULL),
+      flags_liveness_(NULL), dominators_(NULL), post_dominators_(NULL) {}
 
   ~Function() {
     // Deallocate memory.
     set_cfg(NULL);
-    set_lsg(NULL);
   }
   // Sets the first entry of the function.
   void set_first_entry(MaoEntry *entry) { first_entry_ = entry;}
@@ -75,6 +84,10 @@ class Function {
   // Returns the function id.
   FunctionID id() const {return id_;}
 
+  // Returns the number to use for the next label MAO creates inside
+  // this function. See MaoUnit::BBNameGen.
+  long NextLabelNumber() {return next_label_number_++;}
+
   // Returns the number of instructions in this function.
   int GetNumInstructions();
   // Returns an iterator that points to first_entry().
@@ -104,7 +117,8 @@ class Function {
   // These methods are to be used by the respective analyses to cache
   // analysis results.
   CFG *cfg() const {return cfg_;}
-  // Sets the CFG (NULL for no one) for a function.
+  // Sets the CFG (NULL for no one) for a function. The analyses built
+  // from the previous CFG are dropped as well.
   void set_cfg(CFG *cfg);
   friend CFG *CFG::GetCFG(MaoUnit *mao, Function *function, bool);
   friend CFG *CFG::GetCFGIfExists(const MaoUnit *mao, Function *function);
@@ -117,8 +131,21 @@ class Function {
                                                         Function *function,
                                                         bool conservative);
 
-  // Name of the function, as given by the function symbol.
-  const std::string name_;
+  Liveness *liveness() const {return liveness_;}
+  void set_liveness(Liveness *liveness);
+  ReachingDefs *reaching_defs() const {return reaching_defs_;}
+  void set_reaching_defs(ReachingDefs *reaching_defs);
+  FlagsLiveness *flags_liveness() const {return flags_liveness_;}
+  void set_flags_liveness(FlagsLiveness *flags_liveness);
+  DominatorTree *dominators() const {return dominators_;}
+  void set_dominators(DominatorTree *dominators);
+  PostDominatorTree *post_dominators() const {return post_dominators_;}
+  void set_post_dominators(PostDominatorTree *post_dominators);
+  friend class MaoAnalysisManager;
+
+  // Name of the function, as given by the function symbol. Interned in
+  // the string pool of the unit.
+  const char *const name_;
 
   // The uniq id of this function.
   const FunctionID id_;
@@ -131,6 +158,9 @@ class Function {
   // Pointer to subsection that this function starts in.
   SubSection *subsection_;
 
+  // Number of labels created by MAO inside this function.
+  long next_label_number_;
+
   /////////////////////////////////////////
   // members populated by analysis passes
 
@@ -138,6 +168,15 @@ class Function {
   CFG *cfg_;
   // Pointer to Loop Structure Graph, if one is build for the function.
   LoopStructureGraph *lsg_;
+  // Pointers to the solved data-flow problems, if computed by the
+  // analysis manager.
+  Liveness *liveness_;
+  ReachingDefs *reaching_defs_;
+  FlagsLiveness *flags_liveness_;
+  // Pointers to the dominator trees, if computed by the analysis
+  // manager.
+  DominatorTree *dominators_;
+  PostDominatorTree *post_dominators_;
 };
 
 // Convenience macros
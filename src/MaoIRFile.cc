@@ -0,0 +1,805 @@
+//
+// Copyright 2010 Google Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the
+//   Free Software Foundation Inc.,
+//   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "MaoDebug.h"
+#include "MaoEmitter.h"
+#include "MaoIRFile.h"
+
+// Bump the version whenever the layout changes.
+static const char kMagic[] = "MAOIR";
+static const int kVersion = 2;
+
+// How a gas segment is stored.
+enum SegmentKind {
+  UNDEFINED_SEGMENT = 0,
+  ABSOLUTE_SEGMENT,
+  EXPR_SEGMENT,
+  REG_SEGMENT,
+  COMMON_SEGMENT,
+  NAMED_SEGMENT
+};
+
+// Gas symbols are either found by name, or are temporary symbols that
+// gas creates for "." and for parts of complex expressions.
+enum GasSymbolKind {
+  NAMED_SYMBOL = 0,
+  TEMP_SYMBOL
+};
+
+// Flags of a gas symbol.
+static const unsigned char kExternalSymbol = 1;
+static const unsigned char kWeakSymbol = 2;
+static const unsigned char kSymbolHasValue = 4;
+
+// How an operand of an instruction is stored.
+enum InsnOperandKind {
+  NO_INSN_OPERAND = 0,
+  IMMEDIATE_INSN_OPERAND,
+  DISPLACEMENT_INSN_OPERAND,
+  REGISTER_INSN_OPERAND
+};
+
+
+//
+// Writer
+//
+
+static void PutBytes(std::string *out, const void *data, size_t length) {
+  out->append(static_cast<const char *>(data), length);
+}
+
+static void PutByte(std::string *out, unsigned char value) {
+  out->push_back(value);
+}
+
+static void PutInt(std::string *out, int value) {
+  PutBytes(out, &value, sizeof(value));
+}
+
+// Strings are stored with their length, and a NUL. NULL is stored as
+// the length -1.
+static void PutString(std::string *out, const char *str, size_t length) {
+  PutInt(out, length);
+  PutBytes(out, str, length);
+  PutByte(out, '\0');
+}
+
+static void PutString(std::string *out, const char *str) {
+  if (str == NULL) {
+    PutInt(out, -1);
+    return;
+  }
+  PutString(out, str, strlen(str));
+}
+
+// Returns the index of reg in i386_regtab, or -1 for NULL.
+static int RegisterIndex(const reg_entry *reg) {
+  if (reg == NULL)
+    return -1;
+  MAO_RASSERT(reg >= i386_regtab && reg < i386_regtab + i386_regtab_size);
+  return reg - i386_regtab;
+}
+
+// Symbols in these segments have their value in an expression.
+static bool SymbolHasValue(symbolS *symbol) {
+  segT segment = S_GET_SEGMENT(symbol);
+  return (segment == absolute_section ||
+          segment == expr_section ||
+          segment == reg_section);
+}
+
+MaoIRWriter::MaoIRWriter(MaoUnit *unit) : unit_(unit) { }
+
+void MaoIRWriter::Write(int fd) {
+  // The entries are written first, since they decide which gas symbols
+  // go into the file.
+  std::string entries;
+  WriteEntries(&entries);
+  // Keep the gas symbols of the symbol table as well, e.g. the labels
+  // that the relaxer assigns fragments to.
+  SymbolTable *symbol_table = unit_->GetSymbolTable();
+  for (SymbolIterator iter = symbol_table->Begin();
+       iter != symbol_table->End(); ++iter) {
+    symbolS *symbol = symbol_find((*iter)->name());
+    if (symbol != NULL)
+      SymbolIndex(symbol);
+  }
+
+  std::string out;
+  PutBytes(&out, kMagic, sizeof(kMagic));
+  PutInt(&out, kVersion);
+  PutInt(&out, sizeof(i386_insn));
+  PutInt(&out, sizeof(expressionS));
+  PutInt(&out, MAX_OPERANDS);
+  PutInt(&out, i386_regtab_size);
+  PutByte(&out, unit_->Is64BitMode());
+
+  WriteSections(&out);
+  WriteMaoSymbols(&out);
+  WriteGasSymbols(&out);
+  out.append(entries);
+  WriteFunctions(&out);
+
+  MaoEmitter emitter(fd, false);
+  emitter.Append(out);
+  emitter.Flush();
+}
+
+void MaoIRWriter::WriteSections(std::string *out) {
+  std::string sections;
+  int count = 0;
+  for (SectionIterator iter = unit_->SectionBegin();
+       iter != unit_->SectionEnd(); ++iter) {
+    std::string name = (*iter)->name();
+    // Sections made up by MAO, e.g. for the directives before the first
+    // section, have no gas section.
+    asection *bfd_section = bfd_get_section_by_name(stdoutput, name.c_str());
+    PutString(&sections, name.c_str());
+    PutByte(&sections, bfd_section != NULL);
+    PutInt(&sections,
+           bfd_section != NULL ?
+           bfd_get_section_flags(stdoutput, bfd_section) : 0);
+    ++count;
+  }
+  PutInt(out, count);
+  out->append(sections);
+}
+
+void MaoIRWriter::WriteMaoSymbols(std::string *out) {
+  SymbolTable *symbol_table = unit_->GetSymbolTable();
+  PutInt(out, symbol_table->Size());
+  for (SymbolIterator iter = symbol_table->Begin();
+       iter != symbol_table->End(); ++iter) {
+    const Symbol *symbol = *iter;
+    PutString(out, symbol->name());
+    PutInt(out, symbol->symbol_type());
+    PutInt(out, symbol->size());
+    PutInt(out, symbol->symbol_visibility());
+    PutByte(out, symbol->common());
+    PutInt(out, symbol->common_size());
+    PutInt(out, symbol->common_align());
+    PutString(out, symbol->section() != NULL ?
+              symbol->section()->name().c_str() : NULL);
+  }
+}
+
+int MaoIRWriter::SymbolIndex(symbolS *symbol) {
+  if (symbol == NULL)
+    return -1;
+  std::map<symbolS *, int>::const_iterator iter =
+      symbol_indices_.find(symbol);
+  if (iter != symbol_indices_.end())
+    return iter->second;
+  int index = symbols_.size();
+  symbols_.push_back(symbol);
+  symbol_indices_[symbol] = index;
+  return index;
+}
+
+void MaoIRWriter::WriteGasSymbols(std::string *out) {
+  // The values of the symbols can refer to more symbols, which are added
+  // at the end of symbols_.
+  for (size_t i = 0; i < symbols_.size(); ++i) {
+    if (SymbolHasValue(symbols_[i])) {
+      expressionS *value = symbol_get_value_expression(symbols_[i]);
+      SymbolIndex(value->X_add_symbol);
+      SymbolIndex(value->X_op_symbol);
+    }
+  }
+
+  // All symbols are created before the values are read, so the values
+  // are stored after the symbols.
+  int count = symbols_.size();
+  PutInt(out, count);
+  for (int i = 0; i < count; ++i) {
+    symbolS *symbol = symbols_[i];
+    const char *name = S_GET_NAME(symbol);
+    if (strcmp(name, FAKE_LABEL_NAME) == 0) {
+      PutByte(out, TEMP_SYMBOL);
+    } else {
+      PutByte(out, NAMED_SYMBOL);
+      PutString(out, name);
+    }
+    WriteSegment(S_GET_SEGMENT(symbol), out);
+    unsigned char flags = 0;
+    if (S_IS_EXTERNAL(symbol))
+      flags |= kExternalSymbol;
+    if (S_IS_WEAK(symbol))
+      flags |= kWeakSymbol;
+    if (SymbolHasValue(symbol))
+      flags |= kSymbolHasValue;
+    PutByte(out, flags);
+    // Labels keep their offset into the frag.
+    if (!SymbolHasValue(symbol)) {
+      valueT offset = symbol_get_value_expression(symbol)->X_add_number;
+      PutBytes(out, &offset, sizeof(offset));
+    }
+  }
+  for (int i = 0; i < count; ++i) {
+    if (SymbolHasValue(symbols_[i]))
+      WriteExpression(symbol_get_value_expression(symbols_[i]), out);
+  }
+  MAO_ASSERT(static_cast<int>(symbols_.size()) == count);
+}
+
+void MaoIRWriter::WriteSegment(segT segment, std::string *out) {
+  if (segment == undefined_section) {
+    PutByte(out, UNDEFINED_SEGMENT);
+  } else if (segment == absolute_section) {
+    PutByte(out, ABSOLUTE_SEGMENT);
+  } else if (segment == expr_section) {
+    PutByte(out, EXPR_SEGMENT);
+  } else if (segment == reg_section) {
+    PutByte(out, REG_SEGMENT);
+  } else if (bfd_is_com_section(segment)) {
+    PutByte(out, COMMON_SEGMENT);
+  } else {
+    PutByte(out, NAMED_SEGMENT);
+    PutString(out, segment_name(segment));
+  }
+}
+
+void MaoIRWriter::WriteExpression(const expressionS *expr, std::string *out) {
+  PutByte(out, expr->X_op);
+  PutByte(out, expr->X_unsigned);
+  PutInt(out, expr->X_md);
+  PutBytes(out, &expr->X_add_number, sizeof(expr->X_add_number));
+  PutInt(out, SymbolIndex(expr->X_add_symbol));
+  PutInt(out, SymbolIndex(expr->X_op_symbol));
+}
+
+void MaoIRWriter::WriteEntries(std::string *out) {
+  // Subsections are rebuilt in the order of their ids when the entries
+  // are added to the unit again.
+  std::vector<SubSectionID> subsection_ids;
+  for (SectionIterator iter = unit_->SectionBegin();
+       iter != unit_->SectionEnd(); ++iter) {
+    std::vector<SubSectionID> ids = (*iter)->GetSubsectionIDs();
+    subsection_ids.insert(subsection_ids.end(), ids.begin(), ids.end());
+  }
+  std::sort(subsection_ids.begin(), subsection_ids.end());
+
+  std::string entries;
+  int count = 0;
+  for (std::vector<SubSectionID>::const_iterator id = subsection_ids.begin();
+       id != subsection_ids.end(); ++id) {
+    SubSection *subsection = unit_->GetSubSection(*id);
+    for (EntryIterator iter = subsection->EntryBegin();
+         iter != subsection->EntryEnd(); ++iter) {
+      MaoEntry *entry = *iter;
+      if (entry->id() >= static_cast<EntryID>(entry_indices_.size()))
+        entry_indices_.resize(entry->id() + 1, -1);
+      entry_indices_[entry->id()] = count++;
+
+      PutByte(&entries, entry->Type());
+      PutInt(&entries, entry->line_number());
+      PutString(&entries, entry->line_verbatim());
+      switch (entry->Type()) {
+        case MaoEntry::LABEL:
+          WriteLabel(entry->AsLabel(), &entries);
+          break;
+        case MaoEntry::DIRECTIVE:
+          WriteDirective(entry->AsDirective(), &entries);
+          break;
+        case MaoEntry::INSTRUCTION:
+          WriteInstruction(entry->AsInstruction(), &entries);
+          break;
+        default:
+          MAO_ASSERT_MSG(false, "Entry type not recognised.");
+      }
+    }
+  }
+  PutInt(out, count);
+  out->append(entries);
+}
+
+void MaoIRWriter::WriteLabel(LabelEntry *label, std::string *out) {
+  PutString(out, label->name());
+  PutByte(out, label->from_assembly());
+}
+
+void MaoIRWriter::WriteDirective(DirectiveEntry *directive,
+                                 std::string *out) {
+  PutInt(out, directive->op());
+  PutInt(out, directive->NumOperands());
+  for (int i = 0; i < directive->NumOperands(); ++i) {
+    const DirectiveEntry::Operand *operand = directive->GetOperand(i);
+    PutByte(out, operand->type);
+    switch (operand->type) {
+      case DirectiveEntry::STRING:
+        PutString(out, operand->data.str->data(), operand->data.str->size());
+        break;
+      case DirectiveEntry::INT:
+        PutInt(out, operand->data.i);
+        break;
+      case DirectiveEntry::SYMBOL:
+        PutInt(out, SymbolIndex(operand->data.sym));
+        break;
+      case DirectiveEntry::EXPRESSION:
+        WriteExpression(operand->data.expr, out);
+        break;
+      case DirectiveEntry::EXPRESSION_RELOC:
+        WriteExpression(operand->data.expr_reloc.expr, out);
+        PutInt(out, operand->data.expr_reloc.reloc);
+        break;
+      case DirectiveEntry::EMPTY_OPERAND:
+        break;
+      default:
+        MAO_ASSERT_MSG(false, "Operand type not recognised.");
+    }
+  }
+}
+
+void MaoIRWriter::WriteInstruction(InstructionEntry *insn, std::string *out) {
+  const i386_insn *instruction = insn->instruction()->raw();
+  MAO_ASSERT(instruction->operands <= MAX_OPERANDS);
+  PutByte(out, insn->GetFlag());
+  PutString(out, instruction->tm.name);
+  // The pointers in the raw copy are replaced when it is read.
+  PutBytes(out, instruction, sizeof(*instruction));
+  // Pick the member of the operand union the same way as
+  // MaoInstructionPool::Copy() does.
+  for (unsigned int i = 0; i < instruction->operands; ++i) {
+    if (InstructionEntry::IsImmediateOperand(instruction, i)) {
+      PutByte(out, IMMEDIATE_INSN_OPERAND);
+      WriteExpression(instruction->op[i].imms, out);
+    } else if (InstructionEntry::IsMemOperand(instruction, i) &&
+               instruction->op[i].disps) {
+      PutByte(out, DISPLACEMENT_INSN_OPERAND);
+      WriteExpression(instruction->op[i].disps, out);
+    } else if (InstructionEntry::IsRegisterOperand(instruction, i)) {
+      PutByte(out, REGISTER_INSN_OPERAND);
+      PutInt(out, RegisterIndex(instruction->op[i].regs));
+    } else {
+      PutByte(out, NO_INSN_OPERAND);
+    }
+  }
+  PutInt(out, RegisterIndex(instruction->base_reg));
+  PutInt(out, RegisterIndex(instruction->index_reg));
+  for (unsigned int i = 0; i < 2; ++i) {
+    PutByte(out, instruction->seg[i] != NULL);
+    if (instruction->seg[i] != NULL) {
+      PutString(out, instruction->seg[i]->seg_name);
+      PutInt(out, instruction->seg[i]->seg_prefix);
+    }
+  }
+  PutByte(out, insn->HasExecutionCount());
+  long count = insn->GetExecutionCount();
+  PutBytes(out, &count, sizeof(count));
+}
+
+void MaoIRWriter::WriteFunctions(std::string *out) {
+  std::string functions;
+  int count = 0;
+  for (MaoUnit::FunctionIterator iter = unit_->FunctionBegin();
+       iter != unit_->FunctionEnd(); ++iter) {
+    Function *function = *iter;
+    PutString(&functions, function->name().c_str());
+    PutInt(&functions, entry_indices_[function->first_entry()->id()]);
+    PutInt(&functions, entry_indices_[function->last_entry()->id()]);
+    ++count;
+  }
+  PutInt(out, count);
+  out->append(functions);
+}
+
+
+//
+// Reader
+//
+
+MaoIRReader::MaoIRReader(MaoUnit *unit)
+    : unit_(unit), file_name_(NULL), next_(NULL), end_(NULL) { }
+
+void MaoIRReader::ReadBytes(void *data, size_t length) {
+  MAO_RASSERT_MSG(length <= static_cast<size_t>(end_ - next_),
+                  "IR file %s is truncated", file_name_);
+  memcpy(data, next_, length);
+  next_ += length;
+}
+
+unsigned char MaoIRReader::ReadByte() {
+  unsigned char value;
+  ReadBytes(&value, sizeof(value));
+  return value;
+}
+
+int MaoIRReader::ReadInt() {
+  int value;
+  ReadBytes(&value, sizeof(value));
+  return value;
+}
+
+const char *MaoIRReader::ReadString(size_t *length) {
+  int str_length = ReadInt();
+  if (str_length < 0)
+    return NULL;
+  MAO_RASSERT_MSG(static_cast<size_t>(str_length) <
+                  static_cast<size_t>(end_ - next_) &&
+                  next_[str_length] == '\0',
+                  "IR file %s is corrupt", file_name_);
+  const char *str = next_;
+  next_ += str_length + 1;
+  if (length != NULL)
+    *length = str_length;
+  return str;
+}
+
+symbolS *MaoIRReader::ReadSymbol() {
+  int index = ReadInt();
+  if (index < 0)
+    return NULL;
+  MAO_RASSERT_MSG(index < static_cast<int>(symbols_.size()),
+                  "IR file %s is corrupt", file_name_);
+  return symbols_[index];
+}
+
+const reg_entry *MaoIRReader::ReadRegister() {
+  int index = ReadInt();
+  if (index < 0)
+    return NULL;
+  MAO_RASSERT_MSG(index < static_cast<int>(i386_regtab_size),
+                  "IR file %s is corrupt", file_name_);
+  return &i386_regtab[index];
+}
+
+MaoEntry *MaoIRReader::ReadEntryIndex() {
+  int index = ReadInt();
+  MAO_RASSERT_MSG(index >= 0 && index < static_cast<int>(entries_.size()),
+                  "IR file %s is corrupt", file_name_);
+  return entries_[index];
+}
+
+void MaoIRReader::Read(const char *file_name) {
+  MAO_RASSERT_MSG(unit_->SectionBegin() == unit_->SectionEnd(),
+                  "IR files can only be loaded into an empty unit");
+  file_name_ = file_name;
+
+  int fd = open(file_name, O_RDONLY);
+  MAO_RASSERT_MSG(fd >= 0, "Unable to open %s", file_name);
+  struct stat st;
+  MAO_RASSERT_MSG(fstat(fd, &st) == 0 && st.st_size > 0,
+                  "Unable to read %s", file_name);
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  MAO_RASSERT_MSG(map != MAP_FAILED, "Unable to map %s", file_name);
+  close(fd);
+  next_ = static_cast<const char *>(map);
+  end_ = next_ + st.st_size;
+
+  ReadHeader();
+  ReadSections();
+  // The MAO symbols are created first, so that they keep their ids.
+  // Making the gas symbols resets the visibility of the MAO symbols
+  // (see link_symbol()), so the attributes are set afterwards.
+  std::vector<MaoSymbolRecord> mao_symbols;
+  ReadMaoSymbols(&mao_symbols);
+  ReadGasSymbols();
+  for (std::vector<MaoSymbolRecord>::const_iterator iter =
+           mao_symbols.begin();
+       iter != mao_symbols.end(); ++iter) {
+    Symbol *symbol = iter->symbol;
+    symbol->set_symbol_type(iter->type);
+    symbol->set_size(iter->size);
+    symbol->set_symbol_visibility(iter->visibility);
+    symbol->set_common(iter->common);
+    symbol->set_common_size(iter->common_size);
+    symbol->set_common_align(iter->common_align);
+  }
+  ReadEntries();
+  // The sections exist now that the entries are added.
+  for (std::vector<MaoSymbolRecord>::const_iterator iter =
+           mao_symbols.begin();
+       iter != mao_symbols.end(); ++iter) {
+    if (iter->section_name != NULL)
+      iter->symbol->set_section(unit_->GetSection(iter->section_name));
+  }
+  ReadFunctions();
+  MAO_RASSERT_MSG(next_ == end_, "IR file %s is corrupt", file_name_);
+
+  // All strings are copied or interned by now.
+  munmap(map, st.st_size);
+  next_ = end_ = NULL;
+}
+
+void MaoIRReader::ReadHeader() {
+  char magic[sizeof(kMagic)];
+  ReadBytes(magic, sizeof(magic));
+  MAO_RASSERT_MSG(memcmp(magic, kMagic, sizeof(kMagic)) == 0,
+                  "%s is not an IR file", file_name_);
+  bool same_build = ReadInt() == kVersion;
+  same_build &= ReadInt() == static_cast<int>(sizeof(i386_insn));
+  same_build &= ReadInt() == static_cast<int>(sizeof(expressionS));
+  same_build &= ReadInt() == MAX_OPERANDS;
+  same_build &= ReadInt() == static_cast<int>(i386_regtab_size);
+  MAO_RASSERT_MSG(same_build, "IR file %s was written by another version "
+                  "of MAO", file_name_);
+  MAO_RASSERT_MSG(ReadByte() == unit_->Is64BitMode(),
+                  "IR file %s was written for another architecture, "
+                  "see --32 and --64", file_name_);
+}
+
+segT MaoIRReader::FindOrCreateSegment(const char *name) {
+  segT segment = bfd_get_section_by_name(stdoutput, name);
+  // bfd keeps the name, which points into the mapped file.
+  if (segment == NULL)
+    segment = subseg_get(xstrdup(name), 0);
+  return segment;
+}
+
+segT MaoIRReader::ReadSegment() {
+  switch (ReadByte()) {
+    case UNDEFINED_SEGMENT: return undefined_section;
+    case ABSOLUTE_SEGMENT: return absolute_section;
+    case EXPR_SEGMENT: return expr_section;
+    case REG_SEGMENT: return reg_section;
+    case COMMON_SEGMENT: return bfd_com_section_ptr;
+    case NAMED_SEGMENT: return FindOrCreateSegment(ReadString());
+    default:
+      MAO_RASSERT_MSG(false, "IR file %s is corrupt", file_name_);
+      return NULL;
+  }
+}
+
+void MaoIRReader::ReadSections() {
+  int count = ReadInt();
+  for (int i = 0; i < count; ++i) {
+    const char *name = ReadString();
+    bool in_gas = ReadByte();
+    flagword flags = ReadInt();
+    if (in_gas)
+      bfd_set_section_flags(stdoutput, FindOrCreateSegment(name), flags);
+  }
+}
+
+void MaoIRReader::ReadMaoSymbols(std::vector<MaoSymbolRecord> *records) {
+  SymbolTable *symbol_table = unit_->GetSymbolTable();
+  int count = ReadInt();
+  records->resize(count);
+  for (int i = 0; i < count; ++i) {
+    MaoSymbolRecord *record = &(*records)[i];
+    const char *name = ReadString();
+    MAO_RASSERT_MSG(name != NULL, "IR file %s is corrupt", file_name_);
+    record->symbol = symbol_table->Exists(name) ?
+        symbol_table->Find(name) : unit_->AddSymbol(name);
+    record->type = static_cast<SymbolType>(ReadInt());
+    record->size = ReadInt();
+    record->visibility = static_cast<SymbolVisibility>(ReadInt());
+    record->common = ReadByte();
+    record->common_size = ReadInt();
+    record->common_align = ReadInt();
+    record->section_name = ReadString();
+  }
+}
+
+void MaoIRReader::ReadGasSymbols() {
+  int count = ReadInt();
+  std::vector<unsigned char> flags(count);
+  for (int i = 0; i < count; ++i) {
+    unsigned char kind = ReadByte();
+    const char *name = kind == NAMED_SYMBOL ? ReadString() : NULL;
+    segT segment = ReadSegment();
+    flags[i] = ReadByte();
+    valueT offset = 0;
+    if (!(flags[i] & kSymbolHasValue))
+      ReadBytes(&offset, sizeof(offset));
+
+    symbolS *symbol;
+    if (kind == NAMED_SYMBOL) {
+      MAO_RASSERT_MSG(name != NULL, "IR file %s is corrupt", file_name_);
+      symbol = symbol_find_or_make(name);
+    } else {
+      symbol = symbol_create(FAKE_LABEL_NAME, segment, 0, &zero_address_frag);
+    }
+    S_SET_SEGMENT(symbol, segment);
+    if (!(flags[i] & kSymbolHasValue)) {
+      // The frags of the parse are not saved. MAO does not relax them,
+      // so their address is 0, as is the one of zero_address_frag. The
+      // relaxer assigns the labels their own frags.
+      symbol_set_frag(symbol, &zero_address_frag);
+      S_SET_VALUE(symbol, offset);
+    }
+    if (flags[i] & kExternalSymbol)
+      S_SET_EXTERNAL(symbol);
+    if (flags[i] & kWeakSymbol)
+      S_SET_WEAK(symbol);
+    symbols_.push_back(symbol);
+  }
+  for (int i = 0; i < count; ++i) {
+    if (flags[i] & kSymbolHasValue) {
+      expressionS value;
+      ReadExpression(&value);
+      symbol_set_value_expression(symbols_[i], &value);
+    }
+  }
+}
+
+void MaoIRReader::ReadExpression(expressionS *expr) {
+  memset(expr, 0, sizeof(*expr));
+  expr->X_op = static_cast<operatorT>(ReadByte());
+  expr->X_unsigned = ReadByte();
+  expr->X_md = ReadInt();
+  ReadBytes(&expr->X_add_number, sizeof(expr->X_add_number));
+  expr->X_add_symbol = ReadSymbol();
+  expr->X_op_symbol = ReadSymbol();
+}
+
+void MaoIRReader::ReadEntries() {
+  int count = ReadInt();
+  entries_.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    unsigned char type = ReadByte();
+    unsigned int line_number = ReadInt();
+    const char *line_verbatim = ReadString();
+    MaoEntry *entry = NULL;
+    switch (type) {
+      case MaoEntry::LABEL:
+        entry = ReadLabel(line_number, line_verbatim);
+        break;
+      case MaoEntry::DIRECTIVE:
+        entry = ReadDirective(line_number, line_verbatim);
+        break;
+      case MaoEntry::INSTRUCTION:
+        entry = ReadInstruction(line_number, line_verbatim);
+        break;
+      default:
+        MAO_RASSERT_MSG(false, "IR file %s is corrupt", file_name_);
+    }
+    // Same as when the entries are linked in from gas (see ir.cc), so
+    // the sections and subsections are built the same way.
+    unit_->AddEntry(entry, type != MaoEntry::DIRECTIVE);
+    entries_.push_back(entry);
+  }
+}
+
+MaoEntry *MaoIRReader::ReadLabel(unsigned int line_number,
+                                 const char *line_verbatim) {
+  const char *name = ReadString();
+  MAO_RASSERT_MSG(name != NULL, "IR file %s is corrupt", file_name_);
+  LabelEntry *label = new LabelEntry(name, line_number, line_verbatim, unit_);
+  label->set_from_assembly(ReadByte());
+  return label;
+}
+
+MaoEntry *MaoIRReader::ReadDirective(unsigned int line_number,
+                                     const char *line_verbatim) {
+  int op = ReadInt();
+  MAO_RASSERT_MSG(op >= 0 && op < DirectiveEntry::NUM_OPCODES,
+                  "IR file %s is corrupt", file_name_);
+  int num_operands = ReadInt();
+  DirectiveEntry::OperandVector operands;
+  for (int i = 0; i < num_operands; ++i) {
+    switch (ReadByte()) {
+      case DirectiveEntry::STRING: {
+        size_t length;
+        MaoStringPiece str;
+        str.data = ReadString(&length);
+        str.length = length;
+        MAO_RASSERT_MSG(str.data != NULL, "IR file %s is corrupt", file_name_);
+        operands.push_back(new DirectiveEntry::Operand(str));
+        break;
+      }
+      case DirectiveEntry::INT:
+        operands.push_back(new DirectiveEntry::Operand(ReadInt()));
+        break;
+      case DirectiveEntry::SYMBOL:
+        operands.push_back(new DirectiveEntry::Operand(ReadSymbol()));
+        break;
+      case DirectiveEntry::EXPRESSION: {
+        expressionS expr;
+        ReadExpression(&expr);
+        operands.push_back(new DirectiveEntry::Operand(&expr));
+        break;
+      }
+      case DirectiveEntry::EXPRESSION_RELOC: {
+        expressionS expr;
+        ReadExpression(&expr);
+        enum bfd_reloc_code_real reloc =
+            static_cast<enum bfd_reloc_code_real>(ReadInt());
+        operands.push_back(new DirectiveEntry::Operand(&expr, reloc));
+        break;
+      }
+      case DirectiveEntry::EMPTY_OPERAND:
+        operands.push_back(new DirectiveEntry::Operand());
+        break;
+      default:
+        MAO_RASSERT_MSG(false, "IR file %s is corrupt", file_name_);
+    }
+  }
+  return new DirectiveEntry(static_cast<DirectiveEntry::Opcode>(op),
+                            operands, line_number, line_verbatim, unit_);
+}
+
+MaoEntry *MaoIRReader::ReadInstruction(unsigned int line_number,
+                                       const char *line_verbatim) {
+  MaoStringPool *strings = unit_->GetStringPool();
+  enum flag_code code_flag = static_cast<enum flag_code>(ReadByte());
+  const char *name = ReadString();
+  MAO_RASSERT_MSG(name != NULL, "IR file %s is corrupt", file_name_);
+
+  // The instruction refers to the expressions and segments here, which
+  // are copied by the InstructionEntry constructor.
+  i386_insn instruction;
+  expressionS expressions[MAX_OPERANDS];
+  seg_entry segments[2];
+  ReadBytes(&instruction, sizeof(instruction));
+  MAO_RASSERT_MSG(instruction.operands <= MAX_OPERANDS,
+                  "IR file %s is corrupt", file_name_);
+  instruction.tm.name = const_cast<char *>(strings->Intern(name));
+  for (unsigned int i = 0; i < instruction.operands; ++i) {
+    switch (ReadByte()) {
+      case IMMEDIATE_INSN_OPERAND:
+        ReadExpression(&expressions[i]);
+        instruction.op[i].imms = &expressions[i];
+        break;
+      case DISPLACEMENT_INSN_OPERAND:
+        ReadExpression(&expressions[i]);
+        instruction.op[i].disps = &expressions[i];
+        break;
+      case REGISTER_INSN_OPERAND:
+        instruction.op[i].regs = ReadRegister();
+        break;
+      case NO_INSN_OPERAND:
+        instruction.op[i].disps = NULL;
+        break;
+      default:
+        MAO_RASSERT_MSG(false, "IR file %s is corrupt", file_name_);
+    }
+  }
+  instruction.base_reg = ReadRegister();
+  instruction.index_reg = ReadRegister();
+  for (unsigned int i = 0; i < 2; ++i) {
+    instruction.seg[i] = NULL;
+    if (ReadByte()) {
+      segments[i].seg_name = const_cast<char *>(ReadString());
+      segments[i].seg_prefix = ReadInt();
+      instruction.seg[i] = &segments[i];
+    }
+  }
+
+  // The saved instruction has the prefixes implied by the opcode
+  // already, so that it is shared like the parsed one.
+  InstructionEntry *insn = new InstructionEntry(&instruction, code_flag,
+                                                line_number, line_verbatim,
+                                                unit_, false);
+
+  bool has_execution_count = ReadByte();
+  long execution_count;
+  ReadBytes(&execution_count, sizeof(execution_count));
+  if (has_execution_count)
+    insn->SetExecutionCount(execution_count);
+  return insn;
+}
+
+void MaoIRReader::ReadFunctions() {
+  int count = ReadInt();
+  for (int i = 0; i < count; ++i) {
+    const char *name = ReadString();
+    MAO_RASSERT_MSG(name != NULL, "IR file %s is corrupt", file_name_);
+    MaoEntry *first = ReadEntryIndex();
+    MaoEntry *last = ReadEntryIndex();
+    unit_->AddFunction(name, first, last);
+  }
+}
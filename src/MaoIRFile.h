@@ -0,0 +1,151 @@
+//
+// Copyright 2010 Google Inc.
+//
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301, USA.
+
+// The binary IR file holds a parsed unit, so that the unit can be saved
+// once (IRSAVE pass) and loaded again (IRLOAD) without parsing the
+// assembly with gas.
+//
+// The file is a cache, to be read by the same build of MAO that wrote
+// it. Instructions are stored as the raw bytes of the gas i386_insn,
+// and the header checks the sizes of the gas structures. Pointers are
+// stored as indices: registers into i386_regtab, gas symbols into the
+// symbol records of the file, and entries by their position in the
+// file.
+//
+// Layout, all numbers in host byte order:
+//   header       magic, version and the sizes of the gas structures
+//   sections     name and flags of the gas section
+//   MAO symbols  the symbol table of the unit, in id order
+//   gas symbols  the symbols referenced by entries and the symbol table,
+//                with their value expression or their offset
+//   entries      in the order of the subsections
+//   functions    name, first and last entry
+//
+// The reader maps the file and reads straight from the mapping, strings
+// are stored with a terminating NUL so they can be interned in place.
+//
+// Usage:
+//   MaoIRWriter writer(unit);
+//   writer.Write(fd);
+//
+//   MaoIRReader reader(unit);
+//   reader.Read("foo.ir");
+
+#ifndef MAOIRFILE_H_
+#define MAOIRFILE_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "MaoUnit.h"
+
+class MaoIRWriter {
+ public:
+  explicit MaoIRWriter(MaoUnit *unit);
+
+  // Writes the unit to the file descriptor fd, which is not closed.
+  void Write(int fd);
+
+ private:
+  void WriteSections(std::string *out);
+  void WriteMaoSymbols(std::string *out);
+  void WriteGasSymbols(std::string *out);
+  void WriteEntries(std::string *out);
+  void WriteLabel(LabelEntry *label, std::string *out);
+  void WriteDirective(DirectiveEntry *directive, std::string *out);
+  void WriteInstruction(InstructionEntry *insn, std::string *out);
+  void WriteFunctions(std::string *out);
+  void WriteExpression(const expressionS *expr, std::string *out);
+  void WriteSegment(segT segment, std::string *out);
+
+  // Returns the index of the gas symbol in the file, or -1 for NULL.
+  int SymbolIndex(symbolS *symbol);
+
+  MaoUnit *const unit_;
+
+  // The gas symbols in the file, and their indices.
+  std::vector<symbolS *> symbols_;
+  std::map<symbolS *, int> symbol_indices_;
+
+  // Position of each entry in the file, indexed by entry id.
+  std::vector<int> entry_indices_;
+};
+
+class MaoIRReader {
+ public:
+  explicit MaoIRReader(MaoUnit *unit);
+
+  // Adds the contents of the file to the unit, which must be empty. gas
+  // must be initialized, since the symbols and sections are recreated
+  // in gas as well.
+  void Read(const char *file_name);
+
+ private:
+  // The attributes of a MAO symbol, which are set once the gas symbols
+  // are created.
+  struct MaoSymbolRecord {
+    Symbol *symbol;
+    SymbolType type;
+    unsigned int size;
+    SymbolVisibility visibility;
+    bool common;
+    unsigned int common_size;
+    unsigned int common_align;
+    const char *section_name;
+  };
+
+  void ReadHeader();
+  void ReadSections();
+  void ReadMaoSymbols(std::vector<MaoSymbolRecord> *records);
+  void ReadGasSymbols();
+  void ReadEntries();
+  MaoEntry *ReadLabel(unsigned int line_number, const char *line_verbatim);
+  MaoEntry *ReadDirective(unsigned int line_number, const char *line_verbatim);
+  MaoEntry *ReadInstruction(unsigned int line_number,
+                            const char *line_verbatim);
+  void ReadFunctions();
+  void ReadExpression(expressionS *expr);
+  segT ReadSegment();
+
+  // Returns the gas section, which is created if needed.
+  segT FindOrCreateSegment(const char *name);
+
+  // Primitive readers. They abort if the file ends early.
+  void ReadBytes(void *data, size_t length);
+  unsigned char ReadByte();
+  int ReadInt();
+  // Returns the string in the mapped file, or NULL. Sets length, unless
+  // it is NULL.
+  const char *ReadString(size_t *length = NULL);
+  symbolS *ReadSymbol();
+  const reg_entry *ReadRegister();
+  MaoEntry *ReadEntryIndex();
+
+  MaoUnit *const unit_;
+  const char *file_name_;
+
+  // The unread part of the mapped file.
+  const char *next_;
+  const char *end_;
+
+  std::vector<symbolS *> symbols_;
+  std::vector<MaoEntry *> entries_;
+};
+
+#endif  // MAOIRFILE_H_
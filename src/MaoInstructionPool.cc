@@ -0,0 +1,290 @@
+//
+// Copyright 2010 Google Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the
+//   Free Software Foundation Inc.,
+//   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <string.h>
+
+#include "MaoDebug.h"
+#include "MaoEntry.h"
+#include "MaoInstructionPool.h"
+
+const unsigned int MaoInstructionPool::kEmptySlot;
+
+// Returns true if the expression of operand i is held by pointer,
+// i.e. if it is copied by MaoInstructionPool::Copy().
+static bool HasExpression(const i386_insn *insn, unsigned int i) {
+  if (InstructionEntry::IsImmediateOperand(insn, i))
+    return insn->op[i].imms != NULL;
+  return InstructionEntry::IsMemOperand(insn, i) && insn->op[i].disps != NULL;
+}
+
+static const expressionS *Expression(const i386_insn *insn, unsigned int i) {
+  if (InstructionEntry::IsImmediateOperand(insn, i))
+    return insn->op[i].imms;
+  return insn->op[i].disps;
+}
+
+// Copies insn to normalized, with the pointers to the expressions and
+// segment overrides cleared, so that equal instructions compare equal
+// byte for byte.
+static void Normalize(const i386_insn *insn, i386_insn *normalized) {
+  memcpy(normalized, insn, sizeof(*normalized));
+  for (unsigned int i = 0; i < insn->operands; ++i) {
+    if (HasExpression(insn, i))
+      normalized->op[i].disps = NULL;
+  }
+  normalized->seg[0] = NULL;
+  normalized->seg[1] = NULL;
+}
+
+// Adds length bytes of data to the hash (FNV-1a).
+static unsigned int HashBytes(const void *data, size_t length,
+                              unsigned int hash) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  for (size_t i = 0; i < length; ++i) {
+    hash ^= bytes[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+// The fields of an expression are hashed and compared one by one, gas
+// leaves the padding and unused bits of expressions uninitialized.
+static unsigned int HashExpression(const expressionS *expr,
+                                   unsigned int hash) {
+  hash = HashBytes(&expr->X_add_symbol, sizeof(expr->X_add_symbol), hash);
+  hash = HashBytes(&expr->X_op_symbol, sizeof(expr->X_op_symbol), hash);
+  hash = HashBytes(&expr->X_add_number, sizeof(expr->X_add_number), hash);
+  unsigned int bits[3] = { expr->X_op, expr->X_unsigned, expr->X_md };
+  return HashBytes(bits, sizeof(bits), hash);
+}
+
+static bool EqualExpressions(const expressionS *expr1,
+                             const expressionS *expr2) {
+  return expr1->X_add_symbol == expr2->X_add_symbol &&
+      expr1->X_op_symbol == expr2->X_op_symbol &&
+      expr1->X_add_number == expr2->X_add_number &&
+      expr1->X_op == expr2->X_op &&
+      expr1->X_unsigned == expr2->X_unsigned &&
+      expr1->X_md == expr2->X_md;
+}
+
+static unsigned int HashInstruction(const i386_insn *insn) {
+  i386_insn normalized;
+  Normalize(insn, &normalized);
+  unsigned int hash = HashBytes(&normalized, sizeof(normalized),
+                                2166136261u);
+  for (unsigned int i = 0; i < insn->operands; ++i) {
+    if (HasExpression(insn, i))
+      hash = HashExpression(Expression(insn, i), hash);
+  }
+  for (unsigned int i = 0; i < 2; ++i) {
+    if (insn->seg[i]) {
+      hash = HashBytes(insn->seg[i]->seg_name,
+                       strlen(insn->seg[i]->seg_name), hash);
+      hash = HashBytes(&insn->seg[i]->seg_prefix,
+                       sizeof(insn->seg[i]->seg_prefix), hash);
+    }
+  }
+  return hash;
+}
+
+static bool EqualInstructions(const i386_insn *insn1,
+                              const i386_insn *insn2) {
+  i386_insn normalized1, normalized2;
+  Normalize(insn1, &normalized1);
+  Normalize(insn2, &normalized2);
+  if (memcmp(&normalized1, &normalized2, sizeof(normalized1)) != 0)
+    return false;
+  // The operand types are equal, so both have the same expressions.
+  for (unsigned int i = 0; i < insn1->operands; ++i) {
+    if (HasExpression(insn1, i) != HasExpression(insn2, i))
+      return false;
+    if (HasExpression(insn1, i) &&
+        !EqualExpressions(Expression(insn1, i), Expression(insn2, i)))
+      return false;
+  }
+  for (unsigned int i = 0; i < 2; ++i) {
+    const seg_entry *seg1 = insn1->seg[i];
+    const seg_entry *seg2 = insn2->seg[i];
+    if ((seg1 == NULL) != (seg2 == NULL))
+      return false;
+    if (seg1 && (strcmp(seg1->seg_name, seg2->seg_name) != 0 ||
+                 seg1->seg_prefix != seg2->seg_prefix))
+      return false;
+  }
+  return true;
+}
+
+MaoInstructionPool::MaoInstructionPool() : slots_(1024, kEmptySlot) {
+}
+
+i386_insn *MaoInstructionPool::Copy(const i386_insn *insn, MaoArena *arena) {
+  // Copy all non-pointer data
+  i386_insn *copy = arena->Copy(insn);
+
+  // Copy references. Registers are shared, they point into the
+  // register table of gas.
+  for (unsigned int i = 0; i < copy->operands; i++) {
+    // Select the correct part of the operand union.
+    if (InstructionEntry::IsImmediateOperand(insn, i)) {
+      copy->op[i].imms = arena->Copy(insn->op[i].imms);
+    } else if (InstructionEntry::IsMemOperand(insn, i) && insn->op[i].disps) {
+      copy->op[i].disps = arena->Copy(insn->op[i].disps);
+    }
+  }
+
+  // Segment overrides
+  for (unsigned int i = 0; i < 2; i++) {
+    if (insn->seg[i]) {
+      seg_entry *tmp_seg = arena->NewZeroed<seg_entry>();
+      MAO_ASSERT(strlen(insn->seg[i]->seg_name) < MAX_SEGMENT_NAME_LENGTH);
+      tmp_seg->seg_name = arena->StrDup(insn->seg[i]->seg_name);
+      tmp_seg->seg_prefix = insn->seg[i]->seg_prefix;
+      copy->seg[i] = tmp_seg;
+    }
+  }
+
+  return copy;
+}
+
+void MaoInstructionPool::Free(i386_insn *copy, MaoArena *arena) {
+  for (unsigned int i = 0; i < copy->operands; i++) {
+    if (InstructionEntry::IsImmediateOperand(copy, i)) {
+      arena->Free(copy->op[i].imms, sizeof(expressionS));
+    } else if (InstructionEntry::IsMemOperand(copy, i)) {
+      arena->Free(copy->op[i].disps, sizeof(expressionS));
+    }
+  }
+
+  // The segment entries go back to the arena. Their names do not:
+  // StrDup() packs strings without alignment, so the name can not be
+  // put on a free list, and it stays allocated until the arena is
+  // destroyed.
+  for (unsigned int i = 0; i < 2; i++) {
+    arena->Free(copy->seg[i], sizeof(seg_entry));
+  }
+
+  // Registers are shared, and should not be freed.
+  //   - copy->base_reg;
+  //   - copy->index_reg;
+  //   - copy->op[*].regs;
+
+  arena->Free(copy, sizeof(i386_insn));
+}
+
+size_t MaoInstructionPool::FindSlot(const i386_insn *insn,
+                                    unsigned int hash) const {
+  size_t mask = slots_.size() - 1;
+  for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+    if (slots_[slot] == kEmptySlot)
+      return slot;
+    unsigned int index = slots_[slot] - 1;
+    if (hashes_[index] == hash && EqualInstructions(insns_[index], insn))
+      return slot;
+  }
+}
+
+void MaoInstructionPool::Grow() {
+  std::vector<unsigned int> slots(slots_.size() * 2, kEmptySlot);
+  size_t mask = slots.size() - 1;
+  for (std::vector<unsigned int>::const_iterator iter = slots_.begin();
+       iter != slots_.end(); ++iter) {
+    if (*iter == kEmptySlot)
+      continue;
+    size_t slot = hashes_[*iter - 1] & mask;
+    while (slots[slot] != kEmptySlot)
+      slot = (slot + 1) & mask;
+    slots[slot] = *iter;
+  }
+  slots_.swap(slots);
+}
+
+void MaoInstructionPool::RemoveSlot(size_t slot) {
+  size_t mask = slots_.size() - 1;
+  size_t next = slot;
+  for (;;) {
+    next = (next + 1) & mask;
+    if (slots_[next] == kEmptySlot)
+      break;
+    // The copy in next may move to slot if slot lies on its probe
+    // sequence, i.e. between its home slot and next.
+    size_t home = hashes_[slots_[next] - 1] & mask;
+    bool probed_past = next > slot ?
+        (home <= slot || home > next) : (home <= slot && home > next);
+    if (probed_past) {
+      slots_[slot] = slots_[next];
+      slot = next;
+    }
+  }
+  slots_[slot] = kEmptySlot;
+}
+
+const i386_insn *MaoInstructionPool::Intern(const i386_insn *insn) {
+  MAO_ASSERT(insn);
+  unsigned int hash = HashInstruction(insn);
+
+  MaoMutexLock lock(&mutex_);
+  size_t slot = FindSlot(insn, hash);
+  if (slots_[slot] != kEmptySlot) {
+    unsigned int index = slots_[slot] - 1;
+    ++references_[index];
+    return insns_[index];
+  }
+
+  unsigned int index;
+  if (free_indices_.empty()) {
+    index = insns_.size();
+    insns_.push_back(NULL);
+    hashes_.push_back(0);
+    references_.push_back(0);
+  } else {
+    index = free_indices_.back();
+    free_indices_.pop_back();
+  }
+  const i386_insn *shared = Copy(insn, &arena_);
+  insns_[index] = shared;
+  hashes_[index] = hash;
+  references_[index] = 1;
+  slots_[slot] = index + 1;
+  if (2 * NumShared() > slots_.size())
+    Grow();
+  return shared;
+}
+
+void MaoInstructionPool::Release(const i386_insn *shared) {
+  MAO_ASSERT(shared);
+  unsigned int hash = HashInstruction(shared);
+
+  MaoMutexLock lock(&mutex_);
+  size_t slot = FindSlot(shared, hash);
+  MAO_ASSERT(slots_[slot] != kEmptySlot);
+  unsigned int index = slots_[slot] - 1;
+  MAO_ASSERT(insns_[index] == shared && references_[index] > 0);
+  if (--references_[index] > 0)
+    return;
+
+  RemoveSlot(slot);
+  Free(const_cast<i386_insn *>(shared), &arena_);
+  insns_[index] = NULL;
+  free_indices_.push_back(index);
+}
+
+size_t MaoInstructionPool::size() const {
+  MaoMutexLock lock(&mutex_);
+  return NumShared();
+}
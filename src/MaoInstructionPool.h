@@ -0,0 +1,114 @@
+//
+// Copyright 2010 Google Inc.
+//
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301, USA.
+
+// MaoInstructionPool holds the shared copies of the instructions of a
+// unit. The i386_insn that gas fills in for an instruction is large,
+// and the same instructions, e.g. "ret" or "push %rbp", occur many
+// times in a program. An InstructionEntry starts out with the shared
+// copy returned by Intern(), and only makes a private copy of its own
+// when it is changed, see InstructionEntry::mutable_instruction().
+//
+// Two instructions share a copy if their i386_insn are equal byte for
+// byte, except for the immediate and displacement expressions and the
+// segment overrides, which are compared by value. Registers point into
+// the register table of gas, and are compared as pointers.
+//
+// The shared copies must not be changed. They are reference counted:
+// every Intern() takes a reference, which the entry gives back with
+// Release() when it is deleted or makes its private copy. The copy is
+// freed with the last reference, so that streaming (see MaoStream.h)
+// does not keep the instructions of released functions.
+//
+// Usage:
+//   const i386_insn *shared = unit->GetInstructionPool()->Intern(&insn);
+//   ...
+//   unit->GetInstructionPool()->Release(shared);
+
+#ifndef MAOINSTRUCTIONPOOL_H_
+#define MAOINSTRUCTIONPOOL_H_
+
+#include <stddef.h>
+
+#include <vector>
+
+extern "C" {
+  #include "as.h"
+  #include "tc-i386.h"
+}
+
+#include "MaoArena.h"
+#include "MaoThreads.h"
+
+class MaoInstructionPool {
+ public:
+  MaoInstructionPool();
+
+  // Returns the shared copy of insn, adding it to the pool if needed,
+  // and takes a reference to it.
+  const i386_insn *Intern(const i386_insn *insn);
+  // Gives back a reference taken by Intern(). The last one frees the
+  // shared copy.
+  void Release(const i386_insn *shared);
+
+  // Returns a copy of insn allocated in the arena, with copies of its
+  // expressions and segment overrides.
+  static i386_insn *Copy(const i386_insn *insn, MaoArena *arena);
+  // Gives a copy made by Copy() back to the arena.
+  static void Free(i386_insn *copy, MaoArena *arena);
+
+  // Returns the number of shared copies in the pool.
+  size_t size() const;
+
+ private:
+  static const unsigned int kEmptySlot = 0;
+
+  // Returns the index of the slot for insn, either the one holding its
+  // shared copy or the empty slot where it belongs. Slots hold the
+  // index + 1 of the copy in insns_.
+  size_t FindSlot(const i386_insn *insn, unsigned int hash) const;
+  // Returns the number of shared copies, with mutex_ held.
+  size_t NumShared() const { return insns_.size() - free_indices_.size(); }
+  // Doubles the size of the hash table.
+  void Grow();
+  // Empties the slot, moving the copies after it that probed past it
+  // back, so that no lookup stops early.
+  void RemoveSlot(size_t slot);
+
+  // Holds the shared copies and their expressions.
+  MaoArena arena_;
+
+  // The shared copies, their hashes and reference counts. Freed copies
+  // are NULL, and their indices are reused.
+  std::vector<const i386_insn *> insns_;
+  std::vector<unsigned int> hashes_;
+  std::vector<unsigned int> references_;
+  std::vector<unsigned int> free_indices_;
+  // Open addressing hash table with linear probing. The size is a power
+  // of two, and at most half of the slots are used.
+  std::vector<unsigned int> slots_;
+
+  // Entries may be created by several threads at once, see
+  // MaoFunctionPassManager.
+  mutable MaoMutex mutex_;
+
+  // Not copyable.
+  MaoInstructionPool(const MaoInstructionPool &);
+  void operator=(const MaoInstructionPool &);
+};
+
+#endif  // MAOINSTRUCTIONPOOL_H_
@@ -30,6 +30,14 @@ Liveness::Liveness(MaoUnit *unit,
   num_bits_ = 256;
 }
 
+BitString Liveness::DefMask(const InstructionEntry *insn) const {
+  return GetRegisterDefMask(insn, true);
+}
+
+BitString Liveness::UseMask(const InstructionEntry *insn) const {
+  return GetRegisterUseMask(insn, true);
+}
+
 // Gen set for Liveness:
 //  - The set of variables used in bb before any assignment.
 BitString Liveness::CreateGenSet(const BasicBlock& bb) {
@@ -39,8 +47,8 @@ BitString Liveness::CreateGenSet(const BasicBlock& bb) {
        entry != bb.RevEntryEnd(); ++entry) {
     if ((*entry)->IsInstruction()) {
       InstructionEntry *insn = (*entry)->AsInstruction();
-      BitString def_mask = GetRegisterDefMask(insn, true);
-      BitString use_mask = GetRegisterUseMask(insn, true);
+      BitString def_mask = DefMask(insn);
+      BitString use_mask = UseMask(insn);
       current_set = Transfer(current_set, use_mask, def_mask);
     }
   }
@@ -55,8 +63,8 @@ BitString Liveness::CreateKillSet(const BasicBlock& bb) {
        entry != bb.RevEntryEnd(); ++entry) {
     if ((*entry)->IsInstruction()) {
       InstructionEntry *insn = (*entry)->AsInstruction();
-      BitString def_mask = GetRegisterDefMask(insn, true);
-      BitString use_mask = GetRegisterUseMask(insn, true);
+      BitString def_mask = DefMask(insn);
+      BitString use_mask = UseMask(insn);
       current_set = Transfer(current_set, def_mask, use_mask);
     }
   }
@@ -68,6 +76,9 @@ BitString Liveness::CreateKillSet(const BasicBlock& bb) {
 BitString Liveness::GetLive(const BasicBlock& bb,
                             const InstructionEntry& insn) {
   MAO_ASSERT(solved_);
+  if (HasIndex())
+    return GetLiveOut(insn);
+
   // Start by getting the end of the bb, then move backwards until we
   // reach insn
   BitString current_set = GetOutSet(bb);
@@ -81,10 +92,150 @@ BitString Liveness::GetLive(const BasicBlock& bb,
       if (curr_insn == &insn)
         break;
       // remove defs, then add uses
-      BitString def_mask = GetRegisterDefMask(curr_insn, true);
-      BitString use_mask = GetRegisterUseMask(curr_insn, true);
+      BitString def_mask = DefMask(curr_insn);
+      BitString use_mask = UseMask(curr_insn);
       current_set = Transfer(current_set, use_mask, def_mask);
     }
   }
   return current_set;
 }
+
+// Returns the slot of the id in a table of the given size, a power of
+// two. Entry ids are mostly consecutive, so multiplying by an odd
+// constant spreads them well.
+static size_t IndexSlot(EntryID id, size_t size) {
+  return (static_cast<size_t>(id) * 0x9e3779b1u) & (size - 1);
+}
+
+void Liveness::BuildIndex() {
+  MAO_ASSERT(solved_);
+  index_insns_.clear();
+  live_in_.clear();
+  live_out_.clear();
+  index_slots_.clear();
+
+  FORALL_CFG_BB(cfg_, it) {
+    FORALL_BB_ENTRY(it, entry) {
+      if (entry->IsInstruction())
+        index_insns_.push_back(entry->AsInstruction());
+    }
+  }
+  if (index_insns_.empty())
+    return;
+  live_in_.resize(index_insns_.size(), BitString(num_bits_));
+  live_out_.resize(index_insns_.size(), BitString(num_bits_));
+
+  // Keep the table at most half full.
+  size_t size = 16;
+  while (size < 2 * index_insns_.size())
+    size *= 2;
+  index_slots_.resize(size, std::make_pair(static_cast<EntryID>(-1), -1));
+  for (size_t i = 0; i < index_insns_.size(); ++i) {
+    EntryID id = index_insns_[i]->id();
+    size_t slot = IndexSlot(id, size);
+    while (index_slots_[slot].second != -1)
+      slot = (slot + 1) & (size - 1);
+    index_slots_[slot] = std::make_pair(id, static_cast<int>(i));
+  }
+
+  int index = 0;
+  FORALL_CFG_BB(cfg_, it) {
+    // The instructions of the block are numbered in order, from
+    // first_index on.
+    int first_index = index;
+    FORALL_BB_ENTRY(it, entry) {
+      if (entry->IsInstruction())
+        ++index;
+    }
+    BitString current_set = GetOutSet(**it);
+    int insn_index = index;
+    for (ReverseEntryIterator entry = (*it)->RevEntryBegin();
+         entry != (*it)->RevEntryEnd(); ++entry) {
+      if (!(*entry)->IsInstruction()) continue;
+      InstructionEntry *insn = (*entry)->AsInstruction();
+      --insn_index;
+      MAO_ASSERT(insn_index >= first_index && index_insns_[insn_index] == insn);
+      live_out_[insn_index] = current_set;
+      // remove defs, then add uses
+      BitString def_mask = DefMask(insn);
+      BitString use_mask = UseMask(insn);
+      current_set = Transfer(current_set, use_mask, def_mask);
+      live_in_[insn_index] = current_set;
+    }
+  }
+}
+
+int Liveness::FindIndex(EntryID id) const {
+  size_t size = index_slots_.size();
+  for (size_t slot = IndexSlot(id, size); index_slots_[slot].second != -1;
+       slot = (slot + 1) & (size - 1)) {
+    if (index_slots_[slot].first == id)
+      return index_slots_[slot].second;
+  }
+  return -1;
+}
+
+int Liveness::IndexOf(const InstructionEntry& insn) {
+  MAO_ASSERT(HasIndex());
+  int index = FindIndex(insn.id());
+  if (index == -1 || index_insns_[index] != &insn) {
+    BuildIndex();
+    index = FindIndex(insn.id());
+  }
+  MAO_ASSERT_MSG(index != -1 && index_insns_[index] == &insn,
+                 "Instruction is not in the liveness index.");
+  return index;
+}
+
+const BitString &Liveness::GetLiveIn(const InstructionEntry& insn) {
+  return live_in_[IndexOf(insn)];
+}
+
+const BitString &Liveness::GetLiveOut(const InstructionEntry& insn) {
+  return live_out_[IndexOf(insn)];
+}
+
+BitString Liveness::GetFreeRegisters(const InstructionEntry& insn) {
+  const BitString &live = GetLiveOut(insn);
+  BitString free_regs(num_bits_);
+  for (int i = 0; i < GetNumberOfRegisters() && i < num_bits_; ++i) {
+    if (!live.Get(i))
+      free_regs.Set(i);
+  }
+  return free_regs;
+}
+
+FlagsLiveness::FlagsLiveness(MaoUnit *unit,
+                             Function *function,
+                             const CFG *cfg)
+    : Liveness(unit, function, cfg) {
+  num_bits_ = NUM_FLAGS;
+}
+
+// Converts a mask of FLAG_xx bits to a bitstring.
+static BitString FlagsToBitString(unsigned int flags) {
+  BitString bits(NUM_FLAGS);
+  for (int i = 0; i < NUM_FLAGS; ++i) {
+    if (flags & (1 << i))
+      bits.Set(i);
+  }
+  return bits;
+}
+
+BitString FlagsLiveness::DefMask(const InstructionEntry *insn) const {
+  return FlagsToBitString(GetFlagsDefMask(insn));
+}
+
+BitString FlagsLiveness::UseMask(const InstructionEntry *insn) const {
+  return FlagsToBitString(GetFlagsUseMask(insn));
+}
+
+unsigned int FlagsLiveness::GetLiveFlags(const InstructionEntry& insn) {
+  const BitString &live = GetLiveOut(insn);
+  unsigned int flags = 0;
+  for (int i = 0; i < NUM_FLAGS; ++i) {
+    if (live.Get(i))
+      flags |= 1 << i;
+  }
+  return flags;
+}
@@ -19,6 +19,8 @@
 #define MAOLIVENESS_H_
 
 #include <set>
+#include <utility>
+#include <vector>
 
 #include "MaoCFG.h"
 #include "MaoDataFlow.h"
@@ -43,18 +45,81 @@ class Liveness : public DFProblem {
   // Returns the live registers of a given instruction.
   // The information is stored in a bitstring, indexed by register number.
   // A set bit means the register is live.
+  // Uses the instruction index if it was built, and otherwise
+  // rescans the basic block.
   BitString GetLive(const BasicBlock& bb, const InstructionEntry& insn);
+
+  // Builds the per-instruction index of live registers, in one
+  // backward sweep per basic block. Needs a solved problem.
+  void BuildIndex();
+  bool HasIndex() const { return !index_insns_.empty(); }
+
+  // Constant time queries, the index must be built. Returns the
+  // registers live before and after the instruction.
+  const BitString &GetLiveIn(const InstructionEntry& insn);
+  const BitString &GetLiveOut(const InstructionEntry& insn);
+  // Returns the registers that are not live after the instruction,
+  // i.e., that can be clobbered right after it.
+  BitString GetFreeRegisters(const InstructionEntry& insn);
+
+ protected:
+  // Returns the bits defined and used by the instruction. The default
+  // is the register masks, expanded to the parent and sub registers.
+  virtual BitString DefMask(const InstructionEntry *insn) const;
+  virtual BitString UseMask(const InstructionEntry *insn) const;
+
  private:
   BitString CreateGenSet(const BasicBlock& bb);
   BitString CreateKillSet(const BasicBlock& bb);
 
   BitString GetInitialEntryState() {return BitString(num_bits_);}
 
-  BitString Confluence(const std::set<BitString *> &dataset) const {
-    return Union(dataset);
+  void Confluence(BitString *result, const BitString &exit) const {
+    Union(result, exit);
   }
+
+  // Returns the position of insn in the index, rebuilding the index
+  // once if the entries were renumbered since it was built.
+  int IndexOf(const InstructionEntry& insn);
+  // Returns the position of the instruction with the given id, or -1.
+  int FindIndex(EntryID id) const;
+
+  // The index, built by BuildIndex(). The instructions of the function
+  // are numbered densely, and position i describes index_insns_[i].
+  std::vector<const InstructionEntry *> index_insns_;
+  std::vector<BitString> live_in_;
+  std::vector<BitString> live_out_;
+  // Maps entry ids to positions. Open addressing with linear probing,
+  // the size is a power of two, and empty slots hold -1.
+  std::vector<std::pair<EntryID, int> > index_slots_;
 };
 
+// Liveness of the individual flags in eflags. Bit i stands for the
+// flag (1 << i), see FLAG_CF and friends in MaoDefs.h. Nothing is live
+// at the function exits, flags are not preserved across calls.
+//
+// Usage:
+//   FlagsLiveness *flags = unit_->GetAnalyses()->GetFlagsLiveness(function_);
+//   if (flags->FlagsDeadAfter(*insn, FLAG_CF)) ...
+class FlagsLiveness : public Liveness {
+ public:
+  FlagsLiveness(MaoUnit *unit,
+                Function *function,
+                const CFG *cfg);
 
+  // Returns the flags live after the instruction, as FLAG_xx bits.
+  // The index must be built.
+  unsigned int GetLiveFlags(const InstructionEntry& insn);
+  // Returns true if none of the given flags is live after the
+  // instruction, i.e., the instruction may clobber them.
+  bool FlagsDeadAfter(const InstructionEntry& insn,
+                      unsigned int flags = FLAGS_ALL) {
+    return (GetLiveFlags(insn) & flags) == 0;
+  }
+
+ protected:
+  virtual BitString DefMask(const InstructionEntry *insn) const;
+  virtual BitString UseMask(const InstructionEntry *insn) const;
+};
 
 #endif  // MAOLIVENESS_H_
@@ -453,6 +453,7 @@ class LoopFinderPass : public MaoFunctionPass {
       : MaoFunctionPass("LFIND", GetStaticOptionPass("LFIND"), mao, function),
         LSG_(LSG), conservative_(conservative) {
     dump_lsg_ = GetOptionBool("lsg");
+    Preserve(ANALYSIS_ALL);
   }
 
   bool Go() {
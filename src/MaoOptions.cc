@@ -313,6 +313,73 @@ void MaoOptions::InitializeOptionMap(MaoOptionMap *options,
   }
 }
 
+// Appends "name{option=value,...}" for the options of the pass to key.
+// The options in the map are sorted by name.
+static void AppendPassKey(const std::string &pass_name,
+                          const MaoOptionMap *options, std::string *key) {
+  MaoOptionArray *pass_opts = FindOptionArray(pass_name.c_str());
+  key->append(pass_name);
+  key->append("{");
+  for (MaoOptionMap::const_iterator iter = options->begin();
+       iter != options->end(); ++iter) {
+    if (!strcasecmp(pass_name.c_str(), "ASM") && iter->first == "o")
+      continue;
+
+    // The builtin options (see InitializeOptionMap()) are not in the
+    // option array of the pass.
+    MaoOptionType type = OPT_BOOL;
+    if (iter->first == "trace")
+      type = OPT_INT;
+    else if (iter->first == "apply_to_funcs")
+      type = OPT_STRING;
+    for (int i = 0; i < pass_opts->num_entries(); i++) {
+      if (!strcasecmp(iter->first.c_str(), pass_opts->array()[i].name()))
+        type = pass_opts->array()[i].type();
+    }
+
+    char number[16];
+    key->append(iter->first);
+    key->append("=");
+    switch (type) {
+      case OPT_INT:
+        sprintf(number, "%d", iter->second.ival_);
+        key->append(number);
+        break;
+      case OPT_STRING:
+        key->append(iter->second.cval_);
+        break;
+      case OPT_BOOL:
+        key->append(iter->second.bval_ ? "1" : "0");
+        break;
+    }
+    key->append(",");
+  }
+  key->append("}");
+}
+
+std::string MaoOptions::PipelineKey() const {
+  std::string key;
+  for (Pipeline::const_iterator iter = pipeline_.begin();
+       iter != pipeline_.end(); ++iter)
+    AppendPassKey(iter->first, iter->second, &key);
+  key.append("|");
+  for (RegisteredStaticOptionPassMap::const_iterator pass =
+           GetStaticOptionPasses().begin();
+       pass != GetStaticOptionPasses().end(); ++pass)
+    AppendPassKey(pass->first, pass->second, &key);
+  return key;
+}
+
+const char *MaoOptions::AsmOutputFile() const {
+  const char *output = NULL;
+  for (Pipeline::const_iterator iter = pipeline_.begin();
+       iter != pipeline_.end(); ++iter) {
+    if (!strcasecmp(iter->first.c_str(), "ASM"))
+      output = (*iter->second)["o"].cval_;
+  }
+  return output;
+}
+
 // Reparse the accumulated option strings. The reason for reparsing is
 // that dynamically created passes are not visible at standard option
 // parsing time. We therefore reparse on pass creation.
@@ -325,6 +392,8 @@ void MaoOptions::Parse(const char *argv0,
                        const char *arg, bool collect,
                        MaoUnit *unit, MaoPassManager *pass_man) {
   MaoFunctionPassManager *func_pass_man = NULL;
+  if (pass_man)
+    pipeline_.clear();
 
   // Initialize the options for all static option passes
   for (RegisteredStaticOptionPassMap::const_iterator pass =
@@ -474,18 +543,20 @@ void MaoOptions::Parse(const char *argv0,
               GetUnitPass(pass_name.c_str());
           if (unit_creator) {
             pass_man->LinkPass(unit_creator(options, unit));
+            pipeline_.push_back(std::make_pair(pass_name, options));
             func_pass_man = NULL;
           } else {
             MaoFunctionPassManager::PassCreator func_creator =
                 GetFunctionPass(pass_name.c_str());
             if (func_creator) {
               if (!func_pass_man) {
-                MaoOptionMap *func_options = new MaoOptionMap;
-                InitializeOptionMap(func_options, FindOptionArray("PASSMAN"));
+                MaoOptionMap *func_options = GetStaticOptionPass("PASSMAN");
+                MAO_ASSERT(func_options);
                 func_pass_man = new MaoFunctionPassManager(func_options, unit);
                 pass_man->LinkPass(func_pass_man);
               }
               func_pass_man->LinkPass(std::make_pair(func_creator, options));
+              pipeline_.push_back(std::make_pair(pass_name, options));
             } else if (static_option_pass) {
               // Nothing to do for static option passes
             } else {
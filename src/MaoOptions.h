@@ -20,12 +20,15 @@
 
 #include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <unistd.h>
 #include <sys/times.h>
 #include <strings.h>
 
 #include "MaoDebug.h"
+#include "MaoThreads.h"
 
 class MaoOption;
 class MaoPassManager;
@@ -54,21 +57,30 @@ struct MaoOption {
 typedef std::map<std::string, MaoOptionValue> MaoOptionMap;
 
 // Time for pass executions. There is one timer for each pass, if
-// a pass runs multiple times, the times are accumulated.
+// a pass runs multiple times, the times are accumulated.  When
+// instances of a pass run concurrently on several threads, the timer
+// measures the time during which at least one of them is running.
 //
 class MaoTimer {
  public:
- MaoTimer() : total_(0), triggered_(false) { }
+ MaoTimer() : total_(0), triggered_(false), running_(0) { }
 
   void Start() {
-    struct tms t;
-    triggered_ = true;
-    start_ = times(&t);;
+    MaoMutexLock lock(&mutex_);
+    if (running_++ == 0) {
+      struct tms t;
+      triggered_ = true;
+      start_ = times(&t);
+    }
   }
 
   void Stop() {
-    struct tms t;
-    total_ += (times(&t) - start_);
+    MaoMutexLock lock(&mutex_);
+    MAO_ASSERT(running_ > 0);
+    if (--running_ == 0) {
+      struct tms t;
+      total_ += (times(&t) - start_);
+    }
   }
 
   void Print(FILE *f) {
@@ -88,9 +100,11 @@ class MaoTimer {
   bool Triggered() const { return triggered_; }
 
  private:
-  clock_t total_;
-  clock_t start_;
-  bool    triggered_;
+  clock_t  total_;
+  clock_t  start_;
+  bool     triggered_;
+  int      running_;   // Number of active Start() calls.
+  MaoMutex mutex_;
 };
 
 // This is how to define options, build up an array consisting of
@@ -196,6 +210,19 @@ class MaoOptions {
                         const char *option_name,
                         const char *value);
 
+  // The passes linked by the last Reparse() with a pass manager, in
+  // order, with their options.
+  typedef std::vector<std::pair<std::string, MaoOptionMap *> > Pipeline;
+  const Pipeline &pipeline() const { return pipeline_; }
+
+  // Returns a canonical description of the passes linked by the last
+  // Reparse() with a pass manager, of their options and of the options
+  // of the static option passes. The output file of ASM is left out.
+  std::string PipelineKey() const;
+  // Returns the file written by the last ASM pass in the pipeline, or
+  // NULL if there is none.
+  const char *AsmOutputFile() const;
+
   void        TimerStart(const char *pass_name);
   void        TimerStop(const char *pass_name);
   static void TimerPrint();
@@ -215,6 +242,9 @@ class MaoOptions {
   bool verbose_;
   bool timer_print_;
   char *mao_options_;
+
+  // The passes linked to the pass manager, and their options.
+  Pipeline pipeline_;
 };
 
 #endif  // MAOOPTIONS_H_
@@ -15,15 +15,27 @@
 // along with this program; if not, write to the Free Software Foundation, Inc.,
 // 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 
 #include <algorithm>
 #include <map>
+#include <set>
 #include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <unistd.h>
 
 #include "Mao.h"
+#include "MaoIRFile.h"
 
 // MaoAction
 //
@@ -48,8 +60,12 @@ MaoAction::MaoAction(const char *name, MaoOptionMap *options, MaoUnit *unit)
 
 MaoAction::~MaoAction() { }
 
+// Serializes trace output of passes running on different threads.
+static MaoMutex trace_mutex(true);
+
 void MaoAction::Trace(unsigned int level, const char *fmt, ...) const {
   if (level > tracing_level()) return;
+  MaoMutexLock lock(&trace_mutex);
 
   fprintf(stderr, "[%s]\t", name());
 
@@ -64,6 +80,7 @@ void MaoAction::Trace(unsigned int level, const char *fmt, ...) const {
 
 void MaoAction::TraceC(unsigned int level, const char *fmt, ...) const {
   if (level > tracing_level()) return;
+  MaoMutexLock lock(&trace_mutex);
 
   fprintf(stderr, "[%s]\t", name());
 
@@ -77,6 +94,7 @@ void MaoAction::TraceC(unsigned int level, const char *fmt, ...) const {
 void MaoAction::TraceReplace(unsigned int level,
                              InstructionEntry *before,
                              InstructionEntry *after) {
+  MaoMutexLock lock(&trace_mutex);
   TraceC(level, "*** Replaced: ");
   if (tracing_level() >= level) before->PrintEntry(stderr);
   TraceC(level, "*** With    : ");
@@ -148,22 +166,28 @@ class PassDebugAction : public MaoDebugAction {
 };
 
 static PassDebugAction *pass_debug_action = NULL;
+static MaoMutex pass_debug_action_mutex;
 
 
 // MaoPass
 //
 MaoPass::MaoPass(const char *name, MaoOptionMap *options, MaoUnit *unit)
-  : MaoAction(name, options, unit), redundants(NULL)
+  : MaoAction(name, options, unit), redundants(NULL),
+    preserved_(ANALYSIS_NONE)
 {}
 
 MaoPass::~MaoPass() { }
 
 bool MaoPass::Run() {
-  if (!pass_debug_action)
-    pass_debug_action = new PassDebugAction(name());
-  else
-    pass_debug_action->set_pass_name(name());
+  {
+    MaoMutexLock lock(&pass_debug_action_mutex);
+    if (!pass_debug_action)
+      pass_debug_action = new PassDebugAction(name());
+    else
+      pass_debug_action->set_pass_name(name());
+  }
   redundants = new std::list<MaoEntry *>();
+  long changes = MaoAnalysisManager::changes();
 
   int ret = Go();
 
@@ -174,9 +198,16 @@ bool MaoPass::Run() {
   }
   delete redundants;
   redundants = NULL;
+
+  if (MaoAnalysisManager::changes() != changes)
+    InvalidateAnalyses();
   return ret;
 }
 
+void MaoPass::InvalidateAnalyses() {
+  unit_->GetAnalyses()->InvalidateAll(preserved_);
+}
+
 // Allow marking of Entries for deletion after exit from Go()
 void MaoPass::MarkInsnForDelete(MaoEntry *insn) {
   MAO_ASSERT(redundants);
@@ -191,6 +222,10 @@ MaoFunctionPass::MaoFunctionPass(const char *pname, MaoOptionMap *options,
 
 MaoFunctionPass::~MaoFunctionPass() { }
 
+void MaoFunctionPass::InvalidateAnalyses() {
+  unit_->GetAnalyses()->Invalidate(function_, preserved());
+}
+
 bool MaoFunctionPass::FunctionMatchFilter(const Function *function) const {
   // A match is found, if the function name exists in the list, _or_ no
   // filter was given (empty set).
@@ -247,9 +282,13 @@ bool MaoFunctionPass::Run() {
 //
 // Read/parse the input asm file and generate the IR
 //
-MAO_DEFINE_OPTIONS(READ, "Reads the input assembly file", 1) {
+MAO_DEFINE_OPTIONS(READ, "Reads the input assembly file", 2) {
   OPTION_BOOL("create_anonymous", false, "Create anonymous functions for "
               "instructions that are not part of regular functions."),
+  OPTION_BOOL("scrub", true, "Preprocess the input to remove comments and "
+              "extra whitespace. Compiler generated input does not need "
+              "it, except for #APP sections, which are always "
+              "preprocessed."),
 };
 
 class SourceDebugAction : public MaoDebugAction {
@@ -279,6 +318,10 @@ bool ReadInputPass::Go() {
 
   bool create_anonymous = GetOptionString("create_anonymous");
 
+  // Same as the gas -f option.
+  if (!GetOptionBool("scrub"))
+    flag_no_comments = 1;
+
   // Use gas to parse input file.
   MAO_ASSERT(!as_main(argc_, const_cast<char**>(argv_)));
   unit_->FindFunctions(create_anonymous);
@@ -288,28 +331,185 @@ bool ReadInputPass::Go() {
   return true;
 }
 
+// Returns true if the gas argument is an input file. Values of options
+// that name a file are not inputs.
+static bool IsGasInput(const char *arg, const char *previous) {
+  struct stat st;
+  if (arg[0] == '-' || stat(arg, &st) != 0 || !S_ISREG(st.st_mode))
+    return false;
+  return strcmp(previous, "-I") != 0 && strcmp(previous, "-MD") != 0 &&
+      strcmp(previous, "--MD") != 0;
+}
+
+// LoadIrPass
+//
+// Load the IR from a file written by IRSAVE
+//
+MAO_DEFINE_OPTIONS(IRLOAD, "Loads the IR from a file written by IRSAVE, "
+                   "instead of reading the input assembly file", 1) {
+  OPTION_STR("i", "", "Filename to load the IR from."),
+};
+
+LoadIrPass::LoadIrPass(int argc, const char *argv[],
+                       MaoOptionMap *options, MaoUnit *mao_unit)
+    : MaoPass("IRLOAD", options, mao_unit),
+      argc_(argc), argv_(argv) { }
+
+bool LoadIrPass::Requested(MaoOptionMap *options) {
+  return (*options)["i"].cval_[0] != '\0';
+}
+
+bool LoadIrPass::Go() {
+  const char *ir_input_filename = GetOptionString("i");
+
+  Trace(1, "Load IR File: %s", ir_input_filename);
+
+  // gas still sets up the target, the sections and the symbols. Give it
+  // the arguments without the inputs, and an empty input instead, so
+  // that it neither reads them nor standard input.
+  std::vector<const char *> argv;
+  argv.push_back(argv_[0]);
+  for (int i = 1; i < argc_; ++i) {
+    if (!IsGasInput(argv_[i], argv_[i - 1]))
+      argv.push_back(argv_[i]);
+  }
+  argv.push_back("/dev/null");
+  MAO_RASSERT(!as_main(argv.size(), const_cast<char**>(&argv[0])));
+  unit_->SetDefaultArch();
+
+  MaoIRReader reader(unit_);
+  reader.Read(ir_input_filename);
+  return true;
+}
+
 // AssemblyPass
 //
 // Pass to dump out the IR in assembly format
 //
-MAO_DEFINE_OPTIONS(ASM, "Writes assembly output to file", 1) {
+MAO_DEFINE_OPTIONS(ASM, "Writes assembly output to file", 3) {
   OPTION_STR("o", "/dev/stdout", "Filename to output assembly to."),
+  OPTION_BOOL("source_info", true, "Append the entry id and source line "
+              "number to each line as a comment."),
+  OPTION_INT("threads", 1, "Number of threads to format the output on. "
+             "0 uses one thread per online processor."),
 };
 
 AssemblyPass::AssemblyPass(MaoOptionMap *options, MaoUnit *mao_unit)
-    : MaoPass("ASM", options, mao_unit) { }
+    : MaoPass("ASM", options, mao_unit) {
+  Preserve(ANALYSIS_ALL);
+}
 
 bool AssemblyPass::Go() {
   const char *output_file_name = GetOptionString("o");
 
   Trace(1, "Generate Assembly File: %s", output_file_name);
 
-  FILE *outfile = fopen(output_file_name, "w");
-  MAO_ASSERT(outfile);
+  int fd = open(output_file_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  MAO_RASSERT_MSG(fd >= 0, "Unable to open %s", output_file_name);
 
-  unit_->PrintMaoUnit(outfile);
+  int num_threads = GetOptionInt("threads");
+  if (num_threads <= 0)
+    num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if (num_threads > 1)
+    Trace(1, "Formatting assembly on %d threads", num_threads);
 
-  fclose(outfile);
+  MaoEmitter emitter(fd, GetOptionBool("source_info"));
+  unit_->EmitMaoUnit(&emitter, num_threads);
+
+  close(fd);
+  return true;
+}
+
+
+// ObjectPass
+//
+// Pass to pipe the assembly into an assembler
+//
+MAO_DEFINE_OPTIONS(OBJ, "Pipes the assembly into an assembler, which "
+                   "writes the object file", 3) {
+  OPTION_STR("o", "a.out", "Filename of the object file."),
+  OPTION_STR("as", "as", "Assembler to run. Searched in PATH, unless it "
+             "contains a slash."),
+  OPTION_INT("threads", 1, "Number of threads to format the assembly on. "
+             "0 uses one thread per online processor."),
+};
+
+ObjectPass::ObjectPass(MaoOptionMap *options, MaoUnit *mao_unit)
+    : MaoPass("OBJ", options, mao_unit) {
+  Preserve(ANALYSIS_ALL);
+}
+
+bool ObjectPass::Go() {
+  const char *object_file_name = GetOptionString("o");
+  const char *assembler = GetOptionString("as");
+
+  Trace(1, "Generate Object File: %s", object_file_name);
+
+  // The assembler gets the gas arguments of this run, without the
+  // inputs and the output file, and reads the assembly from its
+  // standard input.
+  std::vector<const char *> argv;
+  argv.push_back(assembler);
+  const char **gas_argv = unit_->gas_argv();
+  for (int i = 1; i < unit_->gas_argc(); ++i) {
+    if (!strcmp(gas_argv[i], "-o")) {
+      ++i;
+      continue;
+    }
+    if (!strncmp(gas_argv[i], "-o", 2) ||
+        IsGasInput(gas_argv[i], gas_argv[i - 1]))
+      continue;
+    argv.push_back(gas_argv[i]);
+  }
+  argv.push_back("-o");
+  argv.push_back(object_file_name);
+  argv.push_back(NULL);
+
+  int fds[2];
+  MAO_RASSERT_MSG(pipe(fds) == 0, "Unable to create a pipe: %s",
+                  strerror(errno));
+  fflush(stdout);
+  fflush(stderr);
+  pid_t pid = fork();
+  MAO_RASSERT_MSG(pid >= 0, "Unable to fork: %s", strerror(errno));
+  if (pid == 0) {
+    dup2(fds[0], 0);
+    close(fds[0]);
+    close(fds[1]);
+    execvp(assembler, const_cast<char **>(&argv[0]));
+    fprintf(stderr, "Unable to run %s: %s\n", assembler, strerror(errno));
+    _exit(127);
+  }
+  close(fds[0]);
+
+  int num_threads = GetOptionInt("threads");
+  if (num_threads <= 0)
+    num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  // The assembler may exit before it has read all of the assembly, e.g.
+  // on an error. Writing then fails with EPIPE instead of killing mao,
+  // so that the failure of the assembler is reported.
+  void (*old_handler)(int) = signal(SIGPIPE, SIG_IGN);
+  bool broken_pipe;
+  {
+    // The source info comments are of no use to the assembler.
+    MaoEmitter emitter(fds[1], false);
+    unit_->EmitMaoUnit(&emitter, num_threads);
+    emitter.Flush();
+    broken_pipe = emitter.broken_pipe();
+  }
+  close(fds[1]);
+  signal(SIGPIPE, old_handler);
+
+  int status;
+  pid_t waited;
+  do {
+    waited = waitpid(pid, &status, 0);
+  } while (waited < 0 && errno == EINTR);
+  MAO_RASSERT_MSG(waited == pid && WIFEXITED(status) &&
+                  WEXITSTATUS(status) == 0,
+                  "Assembling %s with %s failed", object_file_name, assembler);
+  MAO_RASSERT_MSG(!broken_pipe, "%s exited before reading all of the "
+                  "assembly for %s", assembler, object_file_name);
   return true;
 }
 
@@ -324,7 +524,9 @@ MAO_DEFINE_OPTIONS(IR, "Dumps the IR in text format", 1) {
 };
 
 DumpIrPass::DumpIrPass(MaoOptionMap *options, MaoUnit *mao_unit)
-    : MaoPass("IR", options, mao_unit) { }
+    : MaoPass("IR", options, mao_unit) {
+  Preserve(ANALYSIS_ALL);
+}
 
 bool DumpIrPass::Go() {
   const char *ir_output_filename = GetOptionString("o");
@@ -340,6 +542,33 @@ bool DumpIrPass::Go() {
 }
 
 
+// SaveIrPass
+//
+// Pass to write the IR to a binary file, which IRLOAD reads back.
+//
+MAO_DEFINE_OPTIONS(IRSAVE, "Saves the IR to a binary file for IRLOAD", 1) {
+  OPTION_STR("o", "mao.ir", "Filename to save the IR to."),
+};
+
+SaveIrPass::SaveIrPass(MaoOptionMap *options, MaoUnit *mao_unit)
+    : MaoPass("IRSAVE", options, mao_unit) {
+  Preserve(ANALYSIS_ALL);
+}
+
+bool SaveIrPass::Go() {
+  const char *ir_output_filename = GetOptionString("o");
+
+  Trace(1, "Generate IR File: %s", ir_output_filename);
+
+  int fd = open(ir_output_filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  MAO_RASSERT_MSG(fd >= 0, "Unable to open %s", ir_output_filename);
+  MaoIRWriter writer(unit_);
+  writer.Write(fd);
+  close(fd);
+  return true;
+}
+
+
 // DumpSymbolTablePass
 //
 // Pass to to dump out the symbol table in text format.
@@ -350,7 +579,9 @@ MAO_DEFINE_OPTIONS(SYMBOLTABLE, "Dumps the symbol table in text format", 1) {
 
 DumpSymbolTablePass::DumpSymbolTablePass(MaoOptionMap *options,
                                          MaoUnit *mao_unit)
-    : MaoPass("SYMBOLTABLE", options, mao_unit) { }
+    : MaoPass("SYMBOLTABLE", options, mao_unit) {
+  Preserve(ANALYSIS_ALL);
+}
 
 bool DumpSymbolTablePass::Go() {
   const char *symboltable_output_filename = GetOptionString("o");
@@ -385,6 +616,7 @@ TestPass::TestPass(MaoOptionMap *options, MaoUnit *mao_unit,
     cfg_(GetOptionBool("cfg")),
     lsg_(GetOptionBool("lsg")),
     relax_(GetOptionBool("relax")) {
+  Preserve(ANALYSIS_ALL);
 }
 
 bool TestPass::Go() {
@@ -403,38 +635,195 @@ bool TestPass::Go() {
 }
 REGISTER_FUNC_PASS("TEST", TestPass)
 
+// MaoPassManager
+//
+// Runs the unit passes in order.
+//
+void MaoPassManager::Run() {
+  for (std::list<MaoPass *>::iterator pass_iter = pass_list_.begin();
+       pass_iter != pass_list_.end(); ++pass_iter) {
+    MaoPass *pass = (*pass_iter);
+    pass->TimerStart();
+    MAO_ASSERT(pass->Run());
+    pass->TimerStop();
+    unit_->CompactEntries();
+  }
+}
+
 // MaoFunctionPassManager
 //
 // A pass to run function passes on all functions in the unit.
 //
 MAO_DEFINE_OPTIONS(PASSMAN, "A uber-pass that runs function passes on all "\
-                   "functions in a file", 0) {
+                   "functions in a file", 1) {
+  OPTION_INT("threads", 1, "Number of threads to run function passes on. "
+             "0 uses one thread per online processor."),
 };
 
 MaoFunctionPassManager::MaoFunctionPassManager(MaoOptionMap *options,
                                                MaoUnit *unit)
     : MaoPass("PASSMAN", options, unit) { }
 
+void MaoFunctionPassManager::RunPasses(Function *function) {
+  for (std::list<MaoFunctionPassManager::ConfiguredPass>::iterator pass_iter =
+           pass_list_.begin();
+       pass_iter != pass_list_.end(); ++pass_iter) {
+    PassCreator creator = pass_iter->first;
+    MaoOptionMap *options = pass_iter->second;
+    MaoFunctionPass *pass = creator(options, unit_, function);
+    pass->TimerStart();
+    MAO_ASSERT(pass->Run());
+    pass->TimerStop();
+    delete pass;
+  }
+}
+
+bool MaoFunctionPassManager::PassesAreThreadSafe() const {
+  for (std::list<MaoFunctionPassManager::ConfiguredPass>::const_iterator
+           pass_iter = pass_list_.begin();
+       pass_iter != pass_list_.end(); ++pass_iter) {
+    if (!IsThreadSafeFunctionPass(pass_iter->first))
+      return false;
+  }
+  return true;
+}
+
 bool MaoFunctionPassManager::Go() {
+  int num_threads = GetOptionInt("threads");
+  if (num_threads <= 0)
+    num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  int num_functions = unit_->ConstFunctionEnd() - unit_->ConstFunctionBegin();
+  if (num_threads > num_functions)
+    num_threads = num_functions;
+
+  if (num_threads > 1) {
+    if (PassesAreThreadSafe()) {
+      Trace(1, "Running function passes on %d threads", num_threads);
+      RunThreaded(num_threads);
+      return true;
+    }
+    Trace(1, "Not all function passes are thread safe, running serially");
+  }
+
   // Run passes on functions.
   for (MaoUnit::ConstFunctionIterator func_iter = unit_->ConstFunctionBegin();
        func_iter != unit_->ConstFunctionEnd(); ++func_iter) {
-    Function *function = *func_iter;
-    for (std::list<MaoFunctionPassManager::ConfiguredPass>::iterator pass_iter =
-             pass_list_.begin();
-         pass_iter != pass_list_.end(); ++pass_iter) {
-      PassCreator creator = pass_iter->first;
-      MaoOptionMap *options = pass_iter->second;
-      MaoFunctionPass *pass = creator(options, unit_, function);
-      pass->TimerStart();
-      MAO_ASSERT(pass->Run());
-      pass->TimerStop();
-      delete pass;
-    }
+    RunPasses(*func_iter);
+  }
+  return true;
+}
+
+// Work distribution for the threaded pass manager.
+//
+// Each thread owns a queue holding a contiguous range of function
+// indices, and takes functions from the front of it.  A thread with
+// an empty queue steals the back half of the queue of another thread,
+// and exits once there is nothing left to steal.
+//
+namespace {
+
+struct FunctionQueue {
+  MaoMutex mutex;
+  int next;  // Next function index to run.
+  int end;   // One past the last function index in the queue.
+};
+
+struct PassManagerWorker {
+  MaoFunctionPassManager *manager;
+  MaoUnit *unit;
+  std::vector<FunctionQueue *> *queues;
+  int self;
+};
+
+bool PopFunction(FunctionQueue *queue, int *index) {
+  MaoMutexLock lock(&queue->mutex);
+  if (queue->next >= queue->end)
+    return false;
+  *index = queue->next++;
+  return true;
+}
+
+bool StealFunctions(FunctionQueue *victim, FunctionQueue *thief) {
+  int begin, end;
+  {
+    MaoMutexLock lock(&victim->mutex);
+    int remaining = victim->end - victim->next;
+    if (remaining <= 0)
+      return false;
+    end = victim->end;
+    begin = end - (remaining + 1) / 2;
+    victim->end = begin;
   }
+  MaoMutexLock lock(&thief->mutex);
+  thief->next = begin;
+  thief->end = end;
   return true;
 }
 
+}  // namespace
+
+void *MaoFunctionPassManager::WorkerThread(void *arg) {
+  PassManagerWorker *worker = static_cast<PassManagerWorker *>(arg);
+  std::vector<FunctionQueue *> &queues = *worker->queues;
+  int num_queues = queues.size();
+  FunctionQueue *own = queues[worker->self];
+
+  while (true) {
+    int index;
+    if (!PopFunction(own, &index)) {
+      bool stolen = false;
+      for (int i = 1; i < num_queues && !stolen; ++i)
+        stolen = StealFunctions(queues[(worker->self + i) % num_queues], own);
+      if (!stolen)
+        break;
+      continue;
+    }
+    Function *function = *(worker->unit->FunctionBegin() + index);
+    worker->unit->SetThreadFunction(function);
+    worker->manager->RunPasses(function);
+  }
+  worker->unit->SetThreadFunction(NULL);
+  return NULL;
+}
+
+void MaoFunctionPassManager::RunThreaded(int num_threads) {
+  int num_functions = unit_->ConstFunctionEnd() - unit_->ConstFunctionBegin();
+
+  // Give each thread an equal share of the functions to start with.
+  std::vector<FunctionQueue *> queues;
+  std::vector<PassManagerWorker> workers(num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    FunctionQueue *queue = new FunctionQueue;
+    queue->next = num_functions * i / num_threads;
+    queue->end = num_functions * (i + 1) / num_threads;
+    queues.push_back(queue);
+    workers[i].manager = this;
+    workers[i].unit = unit_;
+    workers[i].queues = &queues;
+    workers[i].self = i;
+  }
+
+  unit_->BeginParallelRun();
+
+  // The calling thread acts as worker 0.
+  std::vector<pthread_t> threads(num_threads);
+  for (int i = 1; i < num_threads; ++i) {
+    MAO_RASSERT_MSG(pthread_create(&threads[i], NULL, WorkerThread,
+                                   &workers[i]) == 0,
+                    "Unable to create pass manager thread");
+  }
+  WorkerThread(&workers[0]);
+  for (int i = 1; i < num_threads; ++i) {
+    MAO_RASSERT(pthread_join(threads[i], NULL) == 0);
+  }
+
+  unit_->EndParallelRun();
+
+  for (int i = 0; i < num_threads; ++i) {
+    delete queues[i];
+  }
+}
+
 // Other utility methods
 //
 
@@ -442,6 +831,11 @@ bool MaoFunctionPassManager::Go() {
 void InitPasses() {
   // Static Option Passes
   RegisterStaticOptionPass("READ", new MaoOptionMap);
+  RegisterStaticOptionPass("IRLOAD", new MaoOptionMap);
+  RegisterStaticOptionPass("BATCH", new MaoOptionMap);
+  RegisterStaticOptionPass("CACHE", new MaoOptionMap);
+  RegisterStaticOptionPass("STREAM", new MaoOptionMap);
+  RegisterStaticOptionPass("PASSMAN", new MaoOptionMap);
   InitCFG();
   InitRelax();
   InitLoops();
@@ -478,6 +872,23 @@ void RegisterStaticOptionPass(const char *name, MaoOptionMap *options) {
   registered_static_option_passes[name] = options;
 }
 
+typedef std::set<MaoFunctionPassManager::PassCreator> ThreadSafePassSet;
+
+static ThreadSafePassSet& GetThreadSafeFunctionPasses() {
+  static ThreadSafePassSet *set = new ThreadSafePassSet();
+  return *set;
+}
+
+void RegisterThreadSafeFunctionPass(
+    MaoFunctionPassManager::PassCreator creator) {
+  GetThreadSafeFunctionPasses().insert(creator);
+}
+
+bool IsThreadSafeFunctionPass(MaoFunctionPassManager::PassCreator creator) {
+  ThreadSafePassSet &set = GetThreadSafeFunctionPasses();
+  return set.find(creator) != set.end();
+}
+
 MaoPassManager::PassCreator GetUnitPass(const char *name) {
   RegisteredUnitPassesMap &map = GetRegisteredUnitPasses();
   RegisteredUnitPassesMap::iterator iter =
@@ -509,5 +920,7 @@ const RegisteredStaticOptionPassMap &GetStaticOptionPasses() {
 }
 
 REGISTER_UNIT_PASS("ASM", AssemblyPass)
+REGISTER_UNIT_PASS("OBJ", ObjectPass)
 REGISTER_UNIT_PASS("IR", DumpIrPass)
+REGISTER_UNIT_PASS("IRSAVE", SaveIrPass)
 REGISTER_UNIT_PASS("SYMBOLTABLE", DumpSymbolTablePass)
@@ -118,8 +118,22 @@ class MaoPass : public MaoAction {
   // Allow marking of Entries for deletion after exit from Go()
   void MarkInsnForDelete(MaoEntry *insn);
 
+ protected:
+  // Declares analyses (see MaoAnalysisKind) that this pass keeps
+  // valid. Typically called from the constructor of the pass. If the
+  // pass changes the IR, all other analyses are invalidated after it
+  // ran.
+  void Preserve(MaoAnalysisSet analyses) { preserved_ |= analyses; }
+
+  // Invalidates the analyses not preserved by the pass. Called by
+  // Run() if the pass changed the IR.
+  virtual void InvalidateAnalyses();
+
+  MaoAnalysisSet preserved() const { return preserved_; }
+
  private:
   std::list<MaoEntry *> *redundants;
+  MaoAnalysisSet preserved_;
 };
 
 
@@ -138,6 +152,9 @@ class MaoFunctionPass : public MaoPass {
   virtual bool Run();
 
  protected:
+  // Only invalidates the analyses of function_.
+  virtual void InvalidateAnalyses();
+
   Function *const function_;
 
  private:
@@ -176,15 +193,9 @@ class MaoPassManager {
     return new Pass(options, unit);
   }
 
-  void Run() {
-    for (std::list<MaoPass *>::iterator pass_iter = pass_list_.begin();
-         pass_iter != pass_list_.end(); ++pass_iter) {
-      MaoPass *pass = (*pass_iter);
-      pass->TimerStart();
-      MAO_ASSERT(pass->Run());
-      pass->TimerStop();
-    }
-  }
+  // Runs the passes in order. Between passes, the entry ids freed by
+  // deleted entries are reclaimed, see MaoUnit::CompactEntries().
+  void Run();
 
  private:
   MaoUnit *unit_;
@@ -202,6 +213,13 @@ class MaoPassManager {
 // pass and deletes the pass object.  MaoFunctionPassManager is a
 // MaoPass, so it can be linked to in a MaoPassManager.
 //
+// With PASSMAN=threads[N], the functions are distributed over N
+// threads, each running the whole chain of passes on one function at
+// a time.  This is only done if all linked passes are registered as
+// thread safe, otherwise the chain runs serially.  The output is the
+// same as the one of a serial run, except for the names of labels
+// MAO inserts in functions, which are numbered per function.
+//
 class MaoFunctionPassManager : public MaoPass {
  public:
   typedef MaoFunctionPass *(*PassCreator)(MaoOptionMap *options, MaoUnit *unit,
@@ -224,7 +242,16 @@ class MaoFunctionPassManager : public MaoPass {
 
   bool Go();
 
+  // Runs the linked passes on the given function.
+  void RunPasses(Function *function);
+
  private:
+  // Returns true if all linked passes may run concurrently.
+  bool PassesAreThreadSafe() const;
+  // Runs the linked passes on all functions using num_threads threads.
+  void RunThreaded(int num_threads);
+  static void *WorkerThread(void *arg);
+
   std::list<ConfiguredPass> pass_list_;
 };
 
@@ -244,8 +271,11 @@ void RegisterUnitPass(const char *name,
 void RegisterFunctionPass(const char *name,
                           MaoFunctionPassManager::PassCreator creator);
 void RegisterStaticOptionPass(const char *name, MaoOptionMap *options);
+void RegisterThreadSafeFunctionPass(
+    MaoFunctionPassManager::PassCreator creator);
 MaoPassManager::PassCreator          GetUnitPass(const char *name);
 MaoFunctionPassManager::PassCreator  GetFunctionPass(const char *name);
+bool IsThreadSafeFunctionPass(MaoFunctionPassManager::PassCreator creator);
 MaoOptionMap *                       GetStaticOptionPass(const char *name);
 const RegisteredStaticOptionPassMap &GetStaticOptionPasses();
 
@@ -269,6 +299,25 @@ class ReadInputPass : public MaoPass {
   const char **argv_;
 };
 
+// LoadIrPass
+//
+// Loads the IR from a file written by SaveIrPass, instead of reading
+// the input assembly file.
+//
+class LoadIrPass : public MaoPass {
+ public:
+  LoadIrPass(int argc, const char *argv[], MaoOptionMap *options,
+             MaoUnit *mao_unit);
+  bool Go();
+
+  // Returns true if the options ask for the IR to be loaded.
+  static bool Requested(MaoOptionMap *options);
+
+ private:
+  const int argc_;
+  const char **argv_;
+};
+
 // AssemblyPass
 //
 // Pass to dump out the IR in assembly format
@@ -279,6 +328,18 @@ class AssemblyPass : public MaoPass {
   bool Go();
 };
 
+// ObjectPass
+//
+// Pass to pipe the assembly into an assembler process, which writes
+// the object file. This only saves the temporary assembly file: the
+// object is assembled from the text as usual, not encoded from the IR.
+//
+class ObjectPass : public MaoPass {
+ public:
+  ObjectPass(MaoOptionMap *options, MaoUnit *mao_unit);
+  bool Go();
+};
+
 
 // DumpIrPass
 
@@ -291,6 +352,17 @@ class DumpIrPass : public MaoPass {
   bool Go();
 };
 
+// SaveIrPass
+
+//
+// Pass to write the IR to a binary file, see MaoIRFile.h
+//
+class SaveIrPass : public MaoPass {
+ public:
+  explicit SaveIrPass(MaoOptionMap *options, MaoUnit *mao_unit);
+  bool Go();
+};
+
 // DumpSymbolTablePass
 
 //
@@ -340,6 +412,13 @@ class PassInitializer {
                     MaoFunctionPassManager::PassCreator creator) {
       RegisterFunctionPass(name, creator);
     }
+    PassInitializer(const char *name,
+                    MaoFunctionPassManager::PassCreator creator,
+                    bool thread_safe) {
+      RegisterFunctionPass(name, creator);
+      if (thread_safe)
+        RegisterThreadSafeFunctionPass(creator);
+    }
     PassInitializer(const char *name, MaoPassManager::PassCreator creator) {
       RegisterUnitPass(name, creator);
     }
@@ -348,6 +427,13 @@ class PassInitializer {
 #define REGISTER_FUNC_PASS(name, classname)  \
     static PassInitializer classname##Init(name, MaoFunctionPassManager::GenericPassCreator<classname>);
 
+// Thread safe function passes may run on several functions at the same
+// time.  Such a pass must only read and modify entries of its own
+// function, and must not use the relaxer or other state that is shared
+// between functions.
+#define REGISTER_THREADSAFE_FUNC_PASS(name, classname)  \
+    static PassInitializer classname##Init(name, MaoFunctionPassManager::GenericPassCreator<classname>, true);
+
 #define REGISTER_UNIT_PASS(name, classname)  \
     static PassInitializer classname##Init(name, MaoPassManager::GenericPassCreator<classname>);
 
@@ -360,6 +446,13 @@ class PassInitializer {
       } \
    }
 
+#define REGISTER_PLUGIN_THREADSAFE_FUNC_PASS(name, classname) \
+   extern "C" { \
+      void MaoInit() {\
+         REGISTER_THREADSAFE_FUNC_PASS(name, classname ) \
+      } \
+   }
+
 #define REGISTER_PLUGIN_UNIT_PASS(name, classname) \
    extern "C" { \
       void MaoInit() {\
@@ -24,6 +24,12 @@
 
 #include "Mao.h"
 
+static std::vector<LoadedPlugin> loaded_plugins;
+
+const std::vector<LoadedPlugin> &GetLoadedPlugins() {
+  return loaded_plugins;
+}
+
 void LoadPlugin(const char *path, bool verbose) {
   if (verbose)
     fprintf(stderr, "  Loading plugin: %s\n", path);
@@ -47,6 +53,20 @@ void LoadPlugin(const char *path, bool verbose) {
                  version->major, version->minor,
                  MAO_MAJOR_VERSION, MAO_MINOR_VERSION);
 
+  // A plugin may be loaded again, e.g. by the runs of a server.
+  bool known = false;
+  for (std::vector<LoadedPlugin>::const_iterator iter = loaded_plugins.begin();
+       iter != loaded_plugins.end(); ++iter) {
+    if (iter->path == path)
+      known = true;
+  }
+  if (!known) {
+    LoadedPlugin plugin;
+    plugin.path = path;
+    plugin.version = *version;
+    loaded_plugins.push_back(plugin);
+  }
+
   // Load the init function from the plugin
   void (*init)();
 
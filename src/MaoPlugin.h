@@ -19,6 +19,9 @@
 #ifndef MAOPLUGIN_H_
 #define MAOPLUGIN_H_
 
+#include <string>
+#include <vector>
+
 #include "MaoUnit.h"
 
 struct PluginVersion {
@@ -31,9 +34,18 @@ struct PluginVersion {
     PluginVersion mao_plugin_version = {MAO_MAJOR_VERSION, MAO_MINOR_VERSION}; \
   }
 
+// A plugin loaded by LoadPlugin().
+struct LoadedPlugin {
+  std::string path;
+  PluginVersion version;
+};
+
 // Load single fully specified plugin.so file.
 void LoadPlugin(const char *path, bool verbose);
 
+// Returns the plugins loaded so far, in load order.
+const std::vector<LoadedPlugin> &GetLoadedPlugins();
+
 // Given MAO's binary path, find and scan all possible
 // plugins, following this algorithm:
 //
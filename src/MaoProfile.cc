@@ -210,7 +210,9 @@ class ProfileAnnotationPass : public MaoPass {
  public:
   ProfileAnnotationPass(MaoOptionMap *options, MaoUnit *mao)
       : MaoPass("PROFILE", options, mao),
-        sample_profile_(GetOptionString("sample_profile")) { }
+        sample_profile_(GetOptionString("sample_profile")) {
+    Preserve(ANALYSIS_ALL);
+  }
   virtual ~ProfileAnnotationPass();
   virtual bool Go();
 
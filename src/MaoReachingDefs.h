@@ -81,8 +81,8 @@ class ReachingDefs : public DFProblem {
 
   BitString GetInitialEntryState() {return BitString(num_bits_);}
 
-  BitString Confluence(const std::set<BitString *> &dataset) const {
-    return Union(dataset);
+  void Confluence(BitString *result, const BitString &exit) const {
+    Union(result, exit);
   }
 
   // Returns all the registers defined in the basic block.
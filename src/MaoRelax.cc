@@ -19,6 +19,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <map>
 #include <string>
@@ -59,9 +60,11 @@ MAO_DEFINE_OPTIONS(RELAX, "Runs a relaxation algorithm to compute sizes and" \
 
 
 MaoRelaxer::MaoRelaxer(MaoUnit *mao_unit, Section *section,
-                       MaoEntryIntMap *size_map, MaoEntryIntMap *offset_map)
+                       MaoEntryIntMap *size_map, MaoEntryIntMap *offset_map,
+                       MaoFragmentChain *chain)
     : MaoPass("RELAX",  GetStaticOptionPass("RELAX"), mao_unit),
-      section_(section), size_map_(size_map), offset_map_(offset_map) {
+      section_(section), size_map_(size_map), offset_map_(offset_map),
+      chain_(chain) {
   collect_stat_ = GetOptionBool("collect_stats");
   dump_sizemap_ = GetOptionBool("dump_sizemap");
   dump_function_stat_ = GetOptionBool("dump_function_stat");
@@ -98,8 +101,10 @@ void MaoRelaxer::RestoreState(const struct frag *fragments, FragState *state) {
 }
 
 bool MaoRelaxer::Go() {
-  // Build the fragments (and initial sizes)
-  FragToEntryMap relax_map;
+  // Without a chain to keep, build the fragments in a temporary one.
+  MaoFragmentChain temporary_chain;
+  if (chain_ == NULL)
+    chain_ = &temporary_chain;
 
   // This makes sure that gas do not finalize syms after
   // its first relaxation. We want to keep the symbols
@@ -111,8 +116,16 @@ bool MaoRelaxer::Go() {
                                                   section_->name().c_str());
   MAO_ASSERT(bfd_section);
 
-  struct frag *fragments =
-      BuildFragments(unit_, section_, size_map_, &relax_map);
+  // Build the fragments (and initial sizes). If the chain is kept from
+  // an earlier relaxation, only rebuild the fragments around the changed
+  // entries, and reset the others to their state before relaxation.
+  if (chain_->fragments == NULL) {
+    BuildChain();
+  } else {
+    RebuildDirtyFragments();
+    ResetChain();
+  }
+  struct frag *fragments = chain_->fragments;
 
   // The relaxer updates the instruction through the fragment. The opcode
   // will change. Since we want to be able to relax several times,
@@ -120,35 +133,35 @@ bool MaoRelaxer::Go() {
   FragState fragment_state;
   SaveState(fragments, &fragment_state);
 
-  // Relaxation normally only changes the fr_var part of the
-  // fragment. There are some cases (see md_estimate_size_before_relax())
-  // where fr_fix is changed as well. Therefore we need to keep track
-  // of the fr_fix values before relaxation. We do that in old_fr_fix.
-  std::vector<int> old_fr_fix;
-  for (struct frag *frag = fragments; frag; frag = frag->fr_next) {
-    old_fr_fix.push_back(frag->fr_fix);
-  }
-
-  // Run relaxation
+  // Run relaxation. This covers the whole chain, also when only a few
+  // fragments were rebuilt: a branch before the first rebuilt fragment
+  // can span it, so relaxing from there on would not give the sizes of
+  // a full relaxation.
   for (int change = 1, pass = 0; change; pass++)
     change = relax_segment(fragments, bfd_section, pass);
 
+  // Start from the sizes before relaxation.
+  for (EntryIterator iter = section_->EntryBegin();
+       iter != section_->EntryEnd(); ++iter) {
+    (*size_map_)[*iter] = chain_->base_sizes[*iter];
+  }
+
   // Update sizes based on relaxation
-  int frag_index = 0;
   for (struct frag *frag = fragments; frag; frag = frag->fr_next) {
-    std::map<struct frag *, MaoEntry *>::iterator entry =
-        relax_map.find(frag);
-    if (entry == relax_map.end()) continue;
+    FragToEntryMap::iterator entry = chain_->relax_map.find(frag);
+    if (entry == chain_->relax_map.end()) continue;
 
     // fr_next is guaranteed to be non-null because frag was found in
     // the relax map.
     int var_size = frag->fr_next->fr_address - frag->fr_address - frag->fr_fix;
     (*size_map_)[entry->second] += var_size;
-    // Check if fr_fix have changed in relaxation:
-    if (frag->fr_fix != old_fr_fix[frag_index]) {
-      (*size_map_)[entry->second] += (frag->fr_fix - old_fr_fix[frag_index]);
+    // Relaxation normally only changes the fr_var part of the
+    // fragment. There are some cases (see md_estimate_size_before_relax())
+    // where fr_fix is changed as well.
+    int built_fr_fix = chain_->built[frag].fr_fix;
+    if (frag->fr_fix != built_fr_fix) {
+      (*size_map_)[entry->second] += (frag->fr_fix - built_fr_fix);
     }
-    frag_index++;
   }
 
   // calculate offset map
@@ -163,8 +176,11 @@ bool MaoRelaxer::Go() {
   // Restore fragments/instructions to the originial state.
   RestoreState(fragments, &fragment_state);
 
-  // Throw away the fragments
-  FreeFragments(fragments);
+  // Throw away the fragments, unless they are kept in the section.
+  if (chain_ == &temporary_chain) {
+    FreeFragments(fragments);
+    chain_ = NULL;
+  }
 
   if (dump_sizemap_) {
     for (MaoEntryIntMap::const_iterator iter = size_map_->begin();
@@ -190,7 +206,7 @@ bool MaoRelaxer::Go() {
         fprintf(stderr, "%20s %10x %10d\n",
                 function->name().c_str(),
                 (*offset_map_)[function->first_entry()],
-                FunctionSize(function, size_map_));
+                FunctionSize(function, size_map_, offset_map_));
       }
     }
   }
@@ -203,7 +219,8 @@ bool MaoRelaxer::Go() {
       Function *function = *iter;
       if (function->GetSection() == section_) {
         relax_stat_->AddFunction(function, FunctionSize(function,
-                                                        size_map_));
+                                                        size_map_,
+                                                        offset_map_));
       }
     }
   }
@@ -213,15 +230,36 @@ bool MaoRelaxer::Go() {
 
 
 MaoEntryIntMap *MaoRelaxer::GetSizeMap(MaoUnit *mao, Section *section) {
+  MaoMutexLock lock(MaoAnalysisManager::size_map_mutex());
   CacheSizeAndOffsetMap(mao, section);
   return section->sizes();
 }
 
 MaoEntryIntMap *MaoRelaxer::GetOffsetMap(MaoUnit *mao, Section *section) {
+  MaoMutexLock lock(MaoAnalysisManager::size_map_mutex());
   CacheSizeAndOffsetMap(mao, section);
   return section->offsets();
 }
 
+std::pair<int, int> MaoRelaxer::GetFunctionRange(MaoUnit *mao,
+                                                 Function *function) {
+  Section *section = function->GetSection();
+  MaoEntryIntMap *sizes = GetSizeMap(mao, section);
+  MaoEntryIntMap *offsets = GetOffsetMap(mao, section);
+  return FunctionRange(function, sizes, offsets);
+}
+
+std::pair<int, int> MaoRelaxer::FunctionRange(Function *function,
+                                              MaoEntryIntMap *size_map,
+                                              MaoEntryIntMap *offset_map) {
+  MaoEntry *first = function->first_entry();
+  MaoEntry *last = function->last_entry();
+  MAO_ASSERT(offset_map->find(first) != offset_map->end());
+  MAO_ASSERT(offset_map->find(last) != offset_map->end());
+  return std::make_pair((*offset_map)[first],
+                        (*offset_map)[last] + (*size_map)[last]);
+}
+
 void MaoRelaxer::CacheSizeAndOffsetMap(MaoUnit *mao, Section *section) {
   MAO_ASSERT(section);
   MaoEntryIntMap *offsets, *sizes = section->sizes();
@@ -229,7 +267,9 @@ void MaoRelaxer::CacheSizeAndOffsetMap(MaoUnit *mao, Section *section) {
     sizes   = new MaoEntryIntMap();
     offsets = new MaoEntryIntMap();
 
-    Relax(mao, section, sizes, offsets);
+    if (section->fragments() == NULL)
+      section->set_fragments(new MaoFragmentChain());
+    Relax(mao, section, sizes, offsets, section->fragments());
 
     section->set_sizes(sizes);
     section->set_offsets(offsets);
@@ -238,14 +278,176 @@ void MaoRelaxer::CacheSizeAndOffsetMap(MaoUnit *mao, Section *section) {
 
 
 bool MaoRelaxer::HasSizeMap(Section *section) {
+  MaoMutexLock lock(MaoAnalysisManager::size_map_mutex());
   return (section->sizes() != NULL);
 }
 
 void MaoRelaxer::InvalidateSizeMap(Section *section) {
+  MaoMutexLock lock(MaoAnalysisManager::size_map_mutex());
+  section->set_sizes(NULL);
+  section->set_offsets(NULL);
+  InvalidateFragments(section);
+}
+
+void MaoRelaxer::MarkChanged(Section *section, MaoEntry *entry) {
+  MaoMutexLock lock(MaoAnalysisManager::size_map_mutex());
+  MaoFragmentChain *chain = section->fragments();
+  if (chain == NULL || chain->fragments == NULL)
+    return;
+
+  // The entry belongs to the first fragment ended by an entry at or
+  // after it. Entries that are new to the chain end no fragment.
+  for (MaoEntry *e = entry; e != NULL; e = e->next()) {
+    std::map<MaoEntry *, struct frag *>::const_iterator iter =
+        chain->end_map.find(e);
+    if (iter != chain->end_map.end()) {
+      chain->dirty.insert(iter->second);
+      return;
+    }
+  }
+  chain->dirty.insert(chain->last);
+}
+
+void MaoRelaxer::UpdateSizeMap(Section *section) {
+  MaoMutexLock lock(MaoAnalysisManager::size_map_mutex());
   section->set_sizes(NULL);
   section->set_offsets(NULL);
 }
 
+void MaoRelaxer::InvalidateFragments(Section *section) {
+  MaoMutexLock lock(MaoAnalysisManager::size_map_mutex());
+  MaoFragmentChain *chain = section->fragments();
+  if (chain != NULL) {
+    FreeFragmentChain(chain);
+    section->set_fragments(NULL);
+  }
+}
+
+void MaoRelaxer::FreeFragmentChain(MaoFragmentChain *chain) {
+  if (chain->fragments != NULL)
+    FreeFragments(chain->fragments);
+  delete chain;
+}
+
+
+void MaoRelaxer::BuildChain() {
+  FragToEntryMap relax_map;
+  chain_->fragments = BuildFragments(unit_, section_, &chain_->base_sizes,
+                                     &relax_map);
+  struct frag *last = chain_->fragments;
+  while (last->fr_next != NULL)
+    last = last->fr_next;
+  AddToChain(chain_->fragments, last, relax_map);
+}
+
+void MaoRelaxer::RebuildDirtyFragments() {
+  bool is_text = !section_->name().compare(".text");
+
+  struct frag *prev = NULL;
+  struct frag *old = chain_->fragments;
+  while (old != NULL) {
+    if (chain_->dirty.find(old) == chain_->dirty.end()) {
+      prev = old;
+      old = old->fr_next;
+      continue;
+    }
+
+    // Rebuild the entries from the end of the previous fragment. Old
+    // fragments are replaced until the end of one is reached that
+    // still ends a fragment, and the next one is not dirty.
+    MaoEntry *entry = prev ? chain_->relax_map[prev]->next() :
+        *section_->EntryBegin();
+    FragToEntryMap relax_map;
+    struct frag *first = NewFragment();
+    struct frag *frag = first;
+    struct frag *last = NULL;
+    while (true) {
+      FragToEntryMap::const_iterator end_iter = chain_->relax_map.find(old);
+      MaoEntry *old_end =
+          end_iter != chain_->relax_map.end() ? end_iter->second : NULL;
+      struct frag *before = frag;
+      bool found_end = false;
+      while (entry != NULL) {
+        MaoEntry *current = entry;
+        entry = entry->next();
+        before = frag;
+        frag = AddToFragment(unit_, current, is_text, frag,
+                             &chain_->base_sizes, &relax_map);
+        if (current == old_end) {
+          found_end = true;
+          break;
+        }
+      }
+
+      struct frag *next_old = old->fr_next;
+      RemoveFromChain(old);
+
+      if (old_end == NULL) {
+        // Rebuilt up to the end of the section.
+        MAO_ASSERT(next_old == NULL);
+        EndFragmentAlign(is_text, 0, 0, frag, false);
+        last = frag;
+        break;
+      }
+      MAO_ASSERT(found_end);
+      old = next_old;
+      if (frag != before &&
+          chain_->dirty.find(next_old) == chain_->dirty.end()) {
+        // old_end still ends a fragment. Drop the empty fragment started
+        // after it, and continue with the old ones.
+        free(frag);
+        last = before;
+        last->fr_next = next_old;
+        break;
+      }
+    }
+
+    if (prev)
+      prev->fr_next = first;
+    else
+      chain_->fragments = first;
+    AddToChain(first, last, relax_map);
+    prev = last;
+    old = last->fr_next;
+  }
+  MAO_ASSERT(chain_->dirty.empty());
+}
+
+void MaoRelaxer::AddToChain(struct frag *first, struct frag *last,
+                            const FragToEntryMap &relax_map) {
+  for (struct frag *frag = first; ; frag = frag->fr_next) {
+    chain_->built[frag] = *frag;
+    FragToEntryMap::const_iterator iter = relax_map.find(frag);
+    if (iter != relax_map.end()) {
+      chain_->relax_map[frag] = iter->second;
+      chain_->end_map[iter->second] = frag;
+    }
+    if (frag == last)
+      break;
+  }
+  if (last->fr_next == NULL)
+    chain_->last = last;
+}
+
+void MaoRelaxer::RemoveFromChain(struct frag *frag) {
+  FragToEntryMap::iterator iter = chain_->relax_map.find(frag);
+  if (iter != chain_->relax_map.end()) {
+    chain_->end_map.erase(iter->second);
+    chain_->relax_map.erase(iter);
+  }
+  chain_->built.erase(frag);
+  chain_->dirty.erase(frag);
+  free(frag);
+}
+
+void MaoRelaxer::ResetChain() {
+  for (struct frag *frag = chain_->fragments; frag; frag = frag->fr_next) {
+    struct frag *next = frag->fr_next;
+    *frag = chain_->built[frag];
+    frag->fr_next = next;
+  }
+}
+
 
 struct frag *MaoRelaxer::BuildFragments(MaoUnit *mao, Section *section,
                                         MaoEntryIntMap *size_map,
@@ -257,245 +459,254 @@ struct frag *MaoRelaxer::BuildFragments(MaoUnit *mao, Section *section,
 
   for (EntryIterator iter = section->EntryBegin();
        iter != section->EntryEnd(); ++iter) {
-    MaoEntry *entry = *iter;
-    switch (entry->Type()) {
-      case MaoEntry::INSTRUCTION: {
-        InstructionEntry *ientry = static_cast<InstructionEntry*>(entry);
-        X86InstructionSizeHelper size_helper(
-            ientry->instruction());
-        std::pair<int, bool> size_pair =
-            size_helper.SizeOfInstruction(ientry->GetFlag());
-        frag->fr_fix += size_pair.first;
-        (*size_map)[entry] = size_pair.first;
-
-        if (size_pair.second) {
-          (*relax_map)[frag] = entry;
-          frag = EndFragmentInstruction(ientry, frag, true);
-        }
+    frag = AddToFragment(mao, *iter, is_text, frag, size_map, relax_map);
+  }
 
-        break;
+  EndFragmentAlign(is_text, 0, 0, frag, false);
+
+  return fragments;
+}
+
+
+struct frag *MaoRelaxer::AddToFragment(MaoUnit *mao, MaoEntry *entry,
+                                       bool is_text, struct frag *frag,
+                                       MaoEntryIntMap *size_map,
+                                       FragToEntryMap *relax_map) {
+  switch (entry->Type()) {
+    case MaoEntry::INSTRUCTION: {
+      InstructionEntry *ientry = static_cast<InstructionEntry*>(entry);
+      X86InstructionSizeHelper size_helper(
+          ientry->instruction()->raw());
+      std::pair<int, bool> size_pair =
+          size_helper.SizeOfInstruction(ientry->GetFlag());
+      frag->fr_fix += size_pair.first;
+      (*size_map)[entry] = size_pair.first;
+
+      if (size_pair.second) {
+        (*relax_map)[frag] = entry;
+        frag = EndFragmentInstruction(ientry, frag, true);
       }
-      case MaoEntry::DIRECTIVE: {
-        DirectiveEntry *dentry = static_cast<DirectiveEntry*>(entry);
-        switch (dentry->op()) {
-          case DirectiveEntry::P2ALIGN:
-          case DirectiveEntry::P2ALIGNW:
-          case DirectiveEntry::P2ALIGNL: {
-            MAO_ASSERT(dentry->NumOperands() == 3);
-            const DirectiveEntry::Operand *alignment = dentry->GetOperand(0);
-            const DirectiveEntry::Operand *max = dentry->GetOperand(2);
-
-            MAO_ASSERT(alignment->type == DirectiveEntry::INT);
-            MAO_ASSERT(max->type == DirectiveEntry::INT);
 
+      break;
+    }
+    case MaoEntry::DIRECTIVE: {
+      DirectiveEntry *dentry = static_cast<DirectiveEntry*>(entry);
+      switch (dentry->op()) {
+        case DirectiveEntry::P2ALIGN:
+        case DirectiveEntry::P2ALIGNW:
+        case DirectiveEntry::P2ALIGNL: {
+          MAO_ASSERT(dentry->NumOperands() == 3);
+          const DirectiveEntry::Operand *alignment = dentry->GetOperand(0);
+          const DirectiveEntry::Operand *max = dentry->GetOperand(2);
+
+          MAO_ASSERT(alignment->type == DirectiveEntry::INT);
+          MAO_ASSERT(max->type == DirectiveEntry::INT);
+
+          (*size_map)[entry] = 0;
+          (*relax_map)[frag] = entry;
+          frag = EndFragmentAlign(is_text, alignment->data.i,
+                                  max->data.i, frag, true);
+          break;
+        }
+        case DirectiveEntry::SLEB128:
+        case DirectiveEntry::ULEB128: {
+          bool is_signed = dentry->op() == DirectiveEntry::SLEB128;
+          MAO_ASSERT(dentry->NumOperands() == 1);
+          const DirectiveEntry::Operand *value = dentry->GetOperand(0);
+          MAO_ASSERT(value->type == DirectiveEntry::EXPRESSION);
+          expressionS *expr = value->data.expr;
+
+          if (expr->X_op == O_constant && is_signed &&
+              (expr->X_add_number < 0) != !expr->X_unsigned) {
+            // TODO(nvachhar): Should we assert instead of changing the IR?
+            // We're outputting a signed leb128 and the sign of X_add_number
+            // doesn't reflect the sign of the original value.  Convert EXP
+            // to a correctly-extended bignum instead.
+            convert_to_bignum(expr);
+          }
+
+          if (expr->X_op == O_constant) {
+            // If we've got a constant, compute its size right now
+            int size =
+                sizeof_leb128(expr->X_add_number, is_signed ? 1 : 0);
+            frag->fr_fix += size;
+            (*size_map)[entry] = size;
+          } else if (expr->X_op == O_big) {
+            // O_big is a different sort of constant.
+            int size =
+                output_big_leb128(NULL, generic_bignum,
+                                  expr->X_add_number, is_signed ? 1 : 0);
+            (*size_map)[entry] = size;
+            frag->fr_fix += size;
+          } else {
+            // Otherwise, end the fragment
             (*size_map)[entry] = 0;
             (*relax_map)[frag] = entry;
-            frag = EndFragmentAlign(is_text, alignment->data.i,
-                                    max->data.i, frag, true);
-            break;
+            frag = EndFragmentLeb128(value, is_signed, frag, true);
           }
-          case DirectiveEntry::SLEB128:
-          case DirectiveEntry::ULEB128: {
-            bool is_signed = dentry->op() == DirectiveEntry::SLEB128;
-            MAO_ASSERT(dentry->NumOperands() == 1);
-            const DirectiveEntry::Operand *value = dentry->GetOperand(0);
-            MAO_ASSERT(value->type == DirectiveEntry::EXPRESSION);
-            expressionS *expr = value->data.expr;
-
-            if (expr->X_op == O_constant && is_signed &&
-                (expr->X_add_number < 0) != !expr->X_unsigned) {
-              // TODO(nvachhar): Should we assert instead of changing the IR?
-              // We're outputting a signed leb128 and the sign of X_add_number
-              // doesn't reflect the sign of the original value.  Convert EXP
-              // to a correctly-extended bignum instead.
-              convert_to_bignum(expr);
-            }
-
-            if (expr->X_op == O_constant) {
-              // If we've got a constant, compute its size right now
-              int size =
-                  sizeof_leb128(expr->X_add_number, is_signed ? 1 : 0);
-              frag->fr_fix += size;
-              (*size_map)[entry] = size;
-            } else if (expr->X_op == O_big) {
-              // O_big is a different sort of constant.
-              int size =
-                  output_big_leb128(NULL, generic_bignum,
-                                    expr->X_add_number, is_signed ? 1 : 0);
-              (*size_map)[entry] = size;
-              frag->fr_fix += size;
-            } else {
-              // Otherwise, end the fragment
-              (*size_map)[entry] = 0;
-              (*relax_map)[frag] = entry;
-              frag = EndFragmentLeb128(value, is_signed, frag, true);
-            }
-            break;
-          }
-          case DirectiveEntry::BYTE:
-            frag->fr_fix++;
-            (*size_map)[entry] = 1;
-            break;
-          case DirectiveEntry::WORD:
-            frag->fr_fix += 2;
-            (*size_map)[entry] = 2;
-            break;
-          case DirectiveEntry::RVA:
-          case DirectiveEntry::LONG:
-            frag->fr_fix += 4;
-            (*size_map)[entry] = 4;
-            break;
-          case DirectiveEntry::QUAD:
-            frag->fr_fix += 8;
-            (*size_map)[entry] = 8;
-            break;
-          case DirectiveEntry::ASCII:
-            HandleString(dentry, 1, false, frag, size_map);
-            break;
-          case DirectiveEntry::STRING8:
-            HandleString(dentry, 1, true, frag, size_map);
-            break;
-          case DirectiveEntry::STRING16:
-            HandleString(dentry, 2, true, frag, size_map);
-            break;
-          case DirectiveEntry::STRING32:
-            HandleString(dentry, 4, true, frag, size_map);
-            break;
-          case DirectiveEntry::STRING64:
-            HandleString(dentry, 8, true, frag, size_map);
-            break;
-          case DirectiveEntry::SPACE:
-            frag = HandleSpace(dentry, 0, frag, true, size_map, relax_map);
-            break;
-          case DirectiveEntry::DS_B:
-            frag = HandleSpace(dentry, 1, frag, true, size_map, relax_map);
-            break;
-          case DirectiveEntry::DS_W:
-            frag = HandleSpace(dentry, 2, frag, true, size_map, relax_map);
-            break;
-          case DirectiveEntry::DS_L:
-            frag = HandleSpace(dentry, 4, frag, true, size_map, relax_map);
-            break;
-          case DirectiveEntry::DS_D:
-            frag = HandleSpace(dentry, 8, frag, true, size_map, relax_map);
-            break;
-          case DirectiveEntry::DS_X:
-            frag = HandleSpace(dentry, 12, frag, true, size_map, relax_map);
-            break;
-          case DirectiveEntry::COMM:
-            // TODO(martint): verify that its safe to handle COMM this way
-            (*size_map)[entry] = 0;
-            // Nothing to do
-            break;
-          case DirectiveEntry::IDENT:
-            // TODO(martint): Update relaxer to handle the comment section
-            // properly for the ident directive
-            (*size_map)[entry] = 0;
-            break;
-          case DirectiveEntry::SET:
-          case DirectiveEntry::FILE:
-          case DirectiveEntry::SECTION:
-          case DirectiveEntry::GLOBAL:
-          case DirectiveEntry::LOCAL:
-          case DirectiveEntry::WEAK:
-          case DirectiveEntry::TYPE:
-          case DirectiveEntry::SIZE:
-          case DirectiveEntry::EQUIV:
-          case DirectiveEntry::WEAKREF:
-          case DirectiveEntry::ARCH:
-          case DirectiveEntry::LINEFILE:
-          case DirectiveEntry::LOC:
-          case DirectiveEntry::ALLOW_INDEX_REG:
-          case DirectiveEntry::DISALLOW_INDEX_REG:
-            (*size_map)[entry] = 0;
-            break;
-          case DirectiveEntry::ORG:
-            // TODO(martint): Add support for ORG directives in the relaxer.
-            MAO_ASSERT_MSG(false, ".org directive unsupported in relaxer.");
-          case DirectiveEntry::CODE16:
-          case DirectiveEntry::CODE16GCC:
-          case DirectiveEntry::CODE32:
-          case DirectiveEntry::CODE64:
-            (*size_map)[entry] = 0;
-            break;
-          case DirectiveEntry::DC_D:
-          case DirectiveEntry::DC_S:
-          case DirectiveEntry::DC_X:
-            (*size_map)[entry] = SizeOfFloat(dentry);
-            break;
-          case DirectiveEntry::HIDDEN:
-            (*size_map)[entry] = 0;
-            break;
-          case DirectiveEntry::FILL:
-            frag = HandleFill(dentry, frag, true, size_map, relax_map);
-            break;
-          case DirectiveEntry::STRUCT:
-            // TODO(martint): Add support for .struct/.offset directives
-            MAO_ASSERT_MSG(false, ".struct directive unsupported in relaxer.");
-          case DirectiveEntry::INCBIN:
-            // TODO(martint): Add support for .struct/.offset directives
-            MAO_ASSERT_MSG(false, ".struct directive unsupported in relaxer.");
-          case DirectiveEntry::SYMVER:
-          case DirectiveEntry::LOC_MARK_LABELS:
-          case DirectiveEntry::CFI_STARTPROC:
-          case DirectiveEntry::CFI_ENDPROC:
-          case DirectiveEntry::CFI_DEF_CFA:
-          case DirectiveEntry::CFI_DEF_CFA_REGISTER:
-          case DirectiveEntry::CFI_DEF_CFA_OFFSET:
-          case DirectiveEntry::CFI_ADJUST_CFA_OFFSET:
-          case DirectiveEntry::CFI_OFFSET:
-          case DirectiveEntry::CFI_REL_OFFSET:
-          case DirectiveEntry::CFI_REGISTER:
-          case DirectiveEntry::CFI_RETURN_COLUMN:
-          case DirectiveEntry::CFI_RESTORE:
-          case DirectiveEntry::CFI_UNDEFINED:
-          case DirectiveEntry::CFI_SAME_VALUE:
-          case DirectiveEntry::CFI_REMEMBER_STATE:
-          case DirectiveEntry::CFI_RESTORE_STATE:
-          case DirectiveEntry::CFI_WINDOW_SAVE:
-          case DirectiveEntry::CFI_ESCAPE:
-          case DirectiveEntry::CFI_SIGNAL_FRAME:
-          case DirectiveEntry::CFI_PERSONALITY:
-          case DirectiveEntry::CFI_LSDA:
-          case DirectiveEntry::CFI_VAL_ENCODED_ADDR:
-            (*size_map)[entry] = 0;
-            break;
-          case DirectiveEntry::NUM_OPCODES: // should never happen..
-          default:
-            MAO_ASSERT_MSG(0, "Unhandled directive: %d", dentry->op());
+          break;
         }
-        break;
+        case DirectiveEntry::BYTE:
+          frag->fr_fix++;
+          (*size_map)[entry] = 1;
+          break;
+        case DirectiveEntry::WORD:
+          frag->fr_fix += 2;
+          (*size_map)[entry] = 2;
+          break;
+        case DirectiveEntry::RVA:
+        case DirectiveEntry::LONG:
+          frag->fr_fix += 4;
+          (*size_map)[entry] = 4;
+          break;
+        case DirectiveEntry::QUAD:
+          frag->fr_fix += 8;
+          (*size_map)[entry] = 8;
+          break;
+        case DirectiveEntry::ASCII:
+          HandleString(dentry, 1, false, frag, size_map);
+          break;
+        case DirectiveEntry::STRING8:
+          HandleString(dentry, 1, true, frag, size_map);
+          break;
+        case DirectiveEntry::STRING16:
+          HandleString(dentry, 2, true, frag, size_map);
+          break;
+        case DirectiveEntry::STRING32:
+          HandleString(dentry, 4, true, frag, size_map);
+          break;
+        case DirectiveEntry::STRING64:
+          HandleString(dentry, 8, true, frag, size_map);
+          break;
+        case DirectiveEntry::SPACE:
+          frag = HandleSpace(dentry, 0, frag, true, size_map, relax_map);
+          break;
+        case DirectiveEntry::DS_B:
+          frag = HandleSpace(dentry, 1, frag, true, size_map, relax_map);
+          break;
+        case DirectiveEntry::DS_W:
+          frag = HandleSpace(dentry, 2, frag, true, size_map, relax_map);
+          break;
+        case DirectiveEntry::DS_L:
+          frag = HandleSpace(dentry, 4, frag, true, size_map, relax_map);
+          break;
+        case DirectiveEntry::DS_D:
+          frag = HandleSpace(dentry, 8, frag, true, size_map, relax_map);
+          break;
+        case DirectiveEntry::DS_X:
+          frag = HandleSpace(dentry, 12, frag, true, size_map, relax_map);
+          break;
+        case DirectiveEntry::COMM:
+          // TODO(martint): verify that its safe to handle COMM this way
+          (*size_map)[entry] = 0;
+          // Nothing to do
+          break;
+        case DirectiveEntry::IDENT:
+          // TODO(martint): Update relaxer to handle the comment section
+          // properly for the ident directive
+          (*size_map)[entry] = 0;
+          break;
+        case DirectiveEntry::SET:
+        case DirectiveEntry::FILE:
+        case DirectiveEntry::SECTION:
+        case DirectiveEntry::GLOBAL:
+        case DirectiveEntry::LOCAL:
+        case DirectiveEntry::WEAK:
+        case DirectiveEntry::TYPE:
+        case DirectiveEntry::SIZE:
+        case DirectiveEntry::EQUIV:
+        case DirectiveEntry::WEAKREF:
+        case DirectiveEntry::ARCH:
+        case DirectiveEntry::LINEFILE:
+        case DirectiveEntry::LOC:
+        case DirectiveEntry::ALLOW_INDEX_REG:
+        case DirectiveEntry::DISALLOW_INDEX_REG:
+          (*size_map)[entry] = 0;
+          break;
+        case DirectiveEntry::ORG:
+          // TODO(martint): Add support for ORG directives in the relaxer.
+          MAO_ASSERT_MSG(false, ".org directive unsupported in relaxer.");
+        case DirectiveEntry::CODE16:
+        case DirectiveEntry::CODE16GCC:
+        case DirectiveEntry::CODE32:
+        case DirectiveEntry::CODE64:
+          (*size_map)[entry] = 0;
+          break;
+        case DirectiveEntry::DC_D:
+        case DirectiveEntry::DC_S:
+        case DirectiveEntry::DC_X:
+          (*size_map)[entry] = SizeOfFloat(dentry);
+          break;
+        case DirectiveEntry::HIDDEN:
+          (*size_map)[entry] = 0;
+          break;
+        case DirectiveEntry::FILL:
+          frag = HandleFill(dentry, frag, true, size_map, relax_map);
+          break;
+        case DirectiveEntry::STRUCT:
+          // TODO(martint): Add support for .struct/.offset directives
+          MAO_ASSERT_MSG(false, ".struct directive unsupported in relaxer.");
+        case DirectiveEntry::INCBIN:
+          // TODO(martint): Add support for .struct/.offset directives
+          MAO_ASSERT_MSG(false, ".struct directive unsupported in relaxer.");
+        case DirectiveEntry::SYMVER:
+        case DirectiveEntry::LOC_MARK_LABELS:
+        case DirectiveEntry::CFI_STARTPROC:
+        case DirectiveEntry::CFI_ENDPROC:
+        case DirectiveEntry::CFI_DEF_CFA:
+        case DirectiveEntry::CFI_DEF_CFA_REGISTER:
+        case DirectiveEntry::CFI_DEF_CFA_OFFSET:
+        case DirectiveEntry::CFI_ADJUST_CFA_OFFSET:
+        case DirectiveEntry::CFI_OFFSET:
+        case DirectiveEntry::CFI_REL_OFFSET:
+        case DirectiveEntry::CFI_REGISTER:
+        case DirectiveEntry::CFI_RETURN_COLUMN:
+        case DirectiveEntry::CFI_RESTORE:
+        case DirectiveEntry::CFI_UNDEFINED:
+        case DirectiveEntry::CFI_SAME_VALUE:
+        case DirectiveEntry::CFI_REMEMBER_STATE:
+        case DirectiveEntry::CFI_RESTORE_STATE:
+        case DirectiveEntry::CFI_WINDOW_SAVE:
+        case DirectiveEntry::CFI_ESCAPE:
+        case DirectiveEntry::CFI_SIGNAL_FRAME:
+        case DirectiveEntry::CFI_PERSONALITY:
+        case DirectiveEntry::CFI_LSDA:
+        case DirectiveEntry::CFI_VAL_ENCODED_ADDR:
+          (*size_map)[entry] = 0;
+          break;
+        case DirectiveEntry::NUM_OPCODES: // should never happen..
+        default:
+          MAO_ASSERT_MSG(0, "Unhandled directive: %d", dentry->op());
       }
-      case MaoEntry::LABEL: {
-        LabelEntry *le;
-        // Assign the frag to the symbol
-        le = entry->AsLabel();
-        // Only assign frags to labels that have a symbol
-        // entry int the gas symbol table.
-        if (le->from_assembly()) {
-          UpdateSymbol(le->name(), frag);
-          // Check if there are any "equal" symbols that needs to be updated
-          // for the relaxer to work.
-          Symbol *s = mao->GetSymbolTable()->Find(le->name());
-          MAO_ASSERT(s != NULL);
-          for (Symbol::EqualIterator iter = s->EqualBegin();
-               iter != s->EqualEnd();
-               ++iter) {
-            UpdateSymbol((*iter)->name(), frag);
-          }
+      break;
+    }
+    case MaoEntry::LABEL: {
+      LabelEntry *le;
+      // Assign the frag to the symbol
+      le = entry->AsLabel();
+      // Only assign frags to labels that have a symbol
+      // entry int the gas symbol table.
+      if (le->from_assembly()) {
+        UpdateSymbol(le->name(), frag);
+        // Check if there are any "equal" symbols that needs to be updated
+        // for the relaxer to work.
+        Symbol *s = mao->GetSymbolTable()->Find(le->name());
+        MAO_ASSERT(s != NULL);
+        for (Symbol::EqualIterator iter = s->EqualBegin();
+             iter != s->EqualEnd();
+             ++iter) {
+          UpdateSymbol((*iter)->name(), frag);
         }
-        break;
       }
-      case MaoEntry::UNDEFINED:
-        // Nothing to do
-      default:
-        MAO_ASSERT(0);
+      break;
     }
+    case MaoEntry::UNDEFINED:
+      // Nothing to do
+    default:
+      MAO_ASSERT(0);
   }
 
-  EndFragmentAlign(is_text, 0, 0, frag, false);
-
-  return fragments;
+  return frag;
 }
 
 
@@ -570,7 +781,7 @@ struct frag *MaoRelaxer::EndFragmentInstruction(InstructionEntry *entry,
 #define ENCODE_RELAX_STATE(type, size) \
   ((relax_substateT) (((type) << 2) | (size)))
 
-  i386_insn *insn = entry->instruction();
+  const InstructionView *insn = entry->instruction();
 
   // Only jumps should end fragments
   MAO_ASSERT(insn->tm.opcode_modifier.jump);
@@ -591,19 +802,24 @@ struct frag *MaoRelaxer::EndFragmentInstruction(InstructionEntry *entry,
     subtype = ENCODE_RELAX_STATE(COND_JUMP86, SMALL);
   subtype |= code16;
 
-  symbolS *sym = insn->op[0].disps->X_add_symbol;
-  offsetT off = insn->op[0].disps->X_add_number;
+  symbolS *sym = insn->disps(0)->X_add_symbol;
+  offsetT off = insn->disps(0)->X_add_number;
 
-  if (insn->op[0].disps->X_op != O_constant &&
-      insn->op[0].disps->X_op != O_symbol) {
+  if (insn->disps(0)->X_op != O_constant &&
+      insn->disps(0)->X_op != O_symbol) {
     /* Handle complex expressions.  */
-    sym = make_expr_symbol(insn->op[0].disps);
+    expressionS disp = *insn->disps(0);
+    sym = make_expr_symbol(&disp);
     off = 0;
   }
 
+  // md_estimate_size_before_relax() rewrites the opcode of a jump it can
+  // not relax. The instruction may be shared with other entries, so it
+  // works on a copy in the fragment.
+  memcpy(frag->fr_literal, &insn->tm.base_opcode,
+         sizeof(insn->tm.base_opcode));
   return FragVar(rs_machine_dependent, insn->reloc[0],
-                 subtype, sym, off,
-                 reinterpret_cast<char*>(&insn->tm.base_opcode),
+                 subtype, sym, off, frag->fr_literal,
                  frag, new_frag);
 
 #undef UNCOND_JUMP
@@ -799,17 +1015,10 @@ int MaoRelaxer::SectionSize(MaoEntryIntMap *size_map) {
   return size;
 }
 
-int MaoRelaxer::FunctionSize(Function *function, MaoEntryIntMap *size_map) {
-  int size = 0;
-  for (EntryIterator iter = function->EntryBegin();
-      iter != function->EntryEnd();
-      ++iter) {
-    if (!(*iter)->IsLabel()) {
-      MAO_ASSERT(size_map->find(*iter) != size_map->end());
-      size += (*size_map)[*iter];
-    }
-  }
-  return size;
+int MaoRelaxer::FunctionSize(Function *function, MaoEntryIntMap *size_map,
+                             MaoEntryIntMap *offset_map) {
+  std::pair<int, int> range = FunctionRange(function, size_map, offset_map);
+  return range.second - range.first;
 }
 
 
@@ -817,8 +1026,8 @@ int MaoRelaxer::FunctionSize(Function *function, MaoEntryIntMap *size_map) {
 // External entry point
 // --------------------------------------------------------------------
 void Relax(MaoUnit *mao, Section *section, MaoEntryIntMap *size_map,
-           MaoEntryIntMap *offset_map) {
-  MaoRelaxer relaxer(mao, section, size_map, offset_map);
+           MaoEntryIntMap *offset_map, MaoFragmentChain *chain) {
+  MaoRelaxer relaxer(mao, section, size_map, offset_map, chain);
   relaxer.Go();
 }
 
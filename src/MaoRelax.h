@@ -27,11 +27,30 @@
 //   MaoEntryIntMap *sizes = MaoRelaxer::GetSizeMap(unit_,
 //                                                  function_->GetSection());
 //   int entry_size = (*sizes)[entry];
+//
+// The maps are indexed by entry id (see MaoEntryMap.h), so lookups take
+// constant time.
+// The static methods below take MaoAnalysisManager::size_map_mutex(),
+// so function passes running in parallel may use them.
+//
+// The fragment chain of a section is kept between relaxations. A pass
+// that makes a local change can report it with MarkChanged() and call
+// UpdateSizeMap() instead of InvalidateSizeMap(). The next GetSizeMap()
+// then only rebuilds the fragments around the changed entries before
+// relaxing the section again. The relaxation itself still runs over
+// all fragments of the section, starting from their state before
+// relaxation, since a branch spanning the change may change size:
+//   entry->AlignTo(4, -1, 15);
+//   MaoRelaxer::MarkChanged(section, entry);
+//   MaoRelaxer::UpdateSizeMap(section);
+//   offsets = MaoRelaxer::GetOffsetMap(unit_, section);
 
 #ifndef MAORELAX_H_
 #define MAORELAX_H_
 
 #include <map>
+#include <set>
+#include <utility>
 #include <vector>
 
 #include "MaoDebug.h"
@@ -39,6 +58,30 @@
 #include "MaoUnit.h"
 #include "tc-i386-helper.h"
 
+// The fragments built for a section, and what is needed to relax them
+// again after some of them are rebuilt. Owned by the section, see
+// Section::fragments().
+struct MaoFragmentChain {
+  MaoFragmentChain() : fragments(NULL), last(NULL) { }
+
+  struct frag *fragments;
+  struct frag *last;
+
+  // Maps a fragment to the entry that ends it, and back. The last
+  // fragment is not ended by an entry.
+  std::map<struct frag *, MaoEntry *> relax_map;
+  std::map<MaoEntry *, struct frag *> end_map;
+
+  // The fragments as built, before relaxation updated them.
+  std::map<struct frag *, struct frag> built;
+
+  // The sizes of the entries before relaxation.
+  MaoEntryIntMap base_sizes;
+
+  // Fragments that need to be rebuilt before the next relaxation.
+  std::set<struct frag *> dirty;
+};
+
 // The main relaxation class.
 //
 // Use the static methods MaoRelaxer::GetSizeMap() and
@@ -47,8 +90,11 @@
 // MaoRelaxer::InvalidateSizeMap() if the section is updated.
 class MaoRelaxer : public MaoPass {
  public:
+  // The fragments are built in chain, or in a temporary chain if chain
+  // is NULL. If chain already holds fragments, only the dirty ones are
+  // rebuilt.
   MaoRelaxer(MaoUnit *mao_unit, Section *section, MaoEntryIntMap *size_map,
-             MaoEntryIntMap *offset_map);
+             MaoEntryIntMap *offset_map, MaoFragmentChain *chain = NULL);
   bool Go();
 
   // Used when a pass needs the sizes for a given section.
@@ -57,11 +103,32 @@ class MaoRelaxer : public MaoPass {
   // Used when a pass needs the offsets for a given section.
   // Returns the offsetmap, which holds entries for the whole section.
   static MaoEntryIntMap *GetOffsetMap(MaoUnit *mao, Section *section);
+  // Returns the byte range [first, second) the function occupies in
+  // its section, relaxing the section first if needed.
+  static std::pair<int, int> GetFunctionRange(MaoUnit *mao,
+                                              Function *function);
   // Checks if a section has a sizemap and an offsetmap computed.
   static bool HasSizeMap(Section *section);
-  // Invalidates the sizemap and offsetmap for the section.
+  // Invalidates the sizemap and offsetmap for the section, and throws
+  // away its fragments.
   static void InvalidateSizeMap(Section *section);
 
+  // Reusing the fragments. This saves building the fragments of the
+  // whole section again after a local change. The section is still
+  // relaxed as a whole, see Go().
+  //
+  // Reports that entry changed size, or that new entries were linked
+  // in right before it. The maps are left as they are.
+  static void MarkChanged(Section *section, MaoEntry *entry);
+  // Invalidates the sizemap and offsetmap like InvalidateSizeMap(),
+  // but keeps the fragments, so the next GetSizeMap() only rebuilds
+  // the fragments that MarkChanged() reported.
+  static void UpdateSizeMap(Section *section);
+  // Throws away the fragments of the section, but keeps the maps. Used
+  // for changes that are not reported with MarkChanged(), e.g., when
+  // entries are deleted.
+  static void InvalidateFragments(Section *section);
+
  private:
   typedef std::map<struct frag *, MaoEntry *> FragToEntryMap;
 
@@ -69,6 +136,26 @@ class MaoRelaxer : public MaoPass {
       MaoUnit *mao, Section *section, MaoEntryIntMap *size_map,
       FragToEntryMap *relax_map);
 
+  // Adds the entry to frag, and returns the fragment to continue with.
+  static struct frag *AddToFragment(
+      MaoUnit *mao, MaoEntry *entry, bool is_text, struct frag *frag,
+      MaoEntryIntMap *size_map, FragToEntryMap *relax_map);
+
+  // Builds all fragments of the section into chain_.
+  void BuildChain();
+  // Replaces the dirty fragments in chain_ with new ones built from
+  // the current entries.
+  void RebuildDirtyFragments();
+  // Records the fragments first to last (inclusive) in chain_.
+  void AddToChain(struct frag *first, struct frag *last,
+                  const FragToEntryMap &relax_map);
+  // Removes a fragment from chain_ and frees it.
+  void RemoveFromChain(struct frag *frag);
+  // Resets all fragments in chain_ to their state before relaxation.
+  void ResetChain();
+
+  static void FreeFragmentChain(MaoFragmentChain *chain);
+
   static int SizeOfFloat(DirectiveEntry *entry);
 
   static void UpdateSymbol(const char *symbol_name,
@@ -106,9 +193,13 @@ class MaoRelaxer : public MaoPass {
 
   static void FragInitOther(struct frag *frag);
 
+  // The fragments do not hold the bytes of their fixed part. Instead,
+  // fr_literal has room for a copy of the opcode of the jump that ends
+  // the fragment, which the relaxer may rewrite, see
+  // EndFragmentInstruction().
   static struct frag *NewFragment() {
-    struct frag *frag =
-        static_cast<struct frag *>(calloc(1, sizeof(struct frag)));
+    struct frag *frag = static_cast<struct frag *>(
+        calloc(1, sizeof(struct frag) + sizeof(unsigned int)));
     MAO_ASSERT(frag);
     return frag;
   }
@@ -122,7 +213,11 @@ class MaoRelaxer : public MaoPass {
   }
 
   static int SectionSize(MaoEntryIntMap *size_map);
-  static int FunctionSize(Function *function, MaoEntryIntMap *size_map);
+  static std::pair<int, int> FunctionRange(Function *function,
+                                           MaoEntryIntMap *size_map,
+                                           MaoEntryIntMap *offset_map);
+  static int FunctionSize(Function *function, MaoEntryIntMap *size_map,
+                          MaoEntryIntMap *offset_map);
 
   static void CacheSizeAndOffsetMap(MaoUnit *mao, Section *section);
 
@@ -137,6 +232,7 @@ class MaoRelaxer : public MaoPass {
   Section *section_;
   MaoEntryIntMap *size_map_;
   MaoEntryIntMap *offset_map_;
+  MaoFragmentChain *chain_;
 
   bool collect_stat_;
   bool dump_sizemap_;
@@ -169,6 +265,6 @@ class MaoRelaxer : public MaoPass {
 
 // External entry point
 void Relax(MaoUnit *mao, Section *section, MaoEntryIntMap *size_map,
-           MaoEntryIntMap *offset_map);
+           MaoEntryIntMap *offset_map, MaoFragmentChain *chain = NULL);
 
 #endif  // MAORELAX_H_
@@ -82,8 +82,11 @@ bool ConstSectionIterator::operator !=(const ConstSectionIterator &other)
 
 void SubSection::set_last_entry(MaoEntry *entry) {
   // Link the entries, unless we insert the first entry. This special case is
-  // handled in AddEntry().
-  if (entry != first_entry_) {
+  // handled in AddEntry(), or the subsection was emptied by
+  // clear_entries().
+  if (last_entry_ == NULL) {
+    first_entry_ = entry;
+  } else if (entry != first_entry_) {
     last_entry_->set_next(entry);
     entry->set_prev(last_entry_);
   }
@@ -125,10 +128,14 @@ std::vector<SubSectionID> Section::GetSubsectionIDs() const {
 }
 
 EntryIterator Section::EntryBegin() const {
-  if (subsections_.size() == 0)
-    return EntryEnd();
-  SubSection *ss = subsections_[0];
-  return EntryIterator(ss->first_entry());
+  // The leading subsections are empty once their entries are released.
+  for (std::vector<SubSection *>::const_iterator ss_iter = subsections_.begin();
+       ss_iter != subsections_.end();
+       ++ss_iter) {
+    if ((*ss_iter)->first_entry() != NULL)
+      return EntryIterator((*ss_iter)->first_entry());
+  }
+  return EntryEnd();
 }
 
 EntryIterator Section::EntryEnd() const {
@@ -33,15 +33,14 @@
 #include <utility>
 #include <vector>
 
+#include "MaoEntryMap.h"
 #include "MaoTypes.h"
 #include "MaoUtil.h"
 
 // Forward declarations
 class MaoEntry;
 class EntryIterator;
-
-// Global Map Types
-typedef std::map<MaoEntry *, int> MaoEntryIntMap;
+struct MaoFragmentChain;
 
 class Section;
 // A Subsection is part of a section. The subsection concept allows the assembly
@@ -74,6 +73,9 @@ class SubSection {
   MaoEntry *last_entry() const { return last_entry_;}
   void set_first_entry(MaoEntry *entry) { first_entry_ = entry;}
   void set_last_entry(MaoEntry *entry);
+  // Empties the subsection once its entries are released, see
+  // MaoUnit::ReleaseEntries(). The next entry added becomes the first.
+  void clear_entries() { first_entry_ = last_entry_ = NULL; }
   // A unique ID of the subsection.
   SubSectionID id() const { return id_;}
   // Helper method to make sure we have a first section if needed.
@@ -113,7 +115,7 @@ class Section {
   // Memory for the name is allocated in the constructor and freed
   // in the destructor.
   explicit Section(const char *name, const SectionID id) :
-    name_(name), id_(id), sizes_(NULL), offsets_(NULL) {}
+    name_(name), id_(id), sizes_(NULL), offsets_(NULL), fragments_(NULL) {}
   ~Section() {}
   // Getters for name and id.
   std::string name() const {return name_;}
@@ -131,7 +133,7 @@ class Section {
   // Returns the last subsection in the section or NULL if section is empty.
   SubSection *GetLastSubSection() const;
 
-  // The next 4 methods are only to be used by MaoRelaxer.  Others
+  // The next 6 methods are only to be used by MaoRelaxer.  Others
   // should invoke the utility functions there to get access to the
   // size and offset.
   MaoEntryIntMap *sizes() {return sizes_;}
@@ -146,6 +148,8 @@ class Section {
       delete offsets_;
     offsets_ = offsets;
   }
+  MaoFragmentChain *fragments() {return fragments_;}
+  void set_fragments(MaoFragmentChain *fragments) {fragments_ = fragments;}
 
  private:
   const std::string name_;  // e.g. ".text", ".data", etc.
@@ -159,6 +163,11 @@ class Section {
 
   // Store corresponding entry offsets
   MaoEntryIntMap *offsets_;
+
+  // The fragments the relaxer built for the section, kept so that the
+  // next relaxation only rebuilds the changed ones, see
+  // MaoRelaxer::MarkChanged(). NULL if not set.
+  MaoFragmentChain *fragments_;
 };
 
 // Iterator wrapper for iterating over all the Sections in a MaoUnit.
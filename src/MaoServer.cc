@@ -0,0 +1,262 @@
+//
+// Copyright 2010 Google Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the
+//   Free Software Foundation Inc.,
+//   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "MaoDebug.h"
+#include "MaoServer.h"
+
+static bool ReadFully(int fd, char *data, size_t length) {
+  while (length > 0) {
+    ssize_t got = read(fd, data, length);
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got <= 0)
+      return false;
+    data += got;
+    length -= got;
+  }
+  return true;
+}
+
+static bool WriteFully(int fd, const char *data, size_t length) {
+  while (length > 0) {
+    ssize_t written = write(fd, data, length);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written <= 0)
+      return false;
+    data += written;
+    length -= written;
+  }
+  return true;
+}
+
+// Receives the size of the request, and the standard input, output and
+// error of the client in fds.
+static bool ReceiveHeader(int connection, int *size, int fds[3]) {
+  char control[CMSG_SPACE(3 * sizeof(int))];
+  struct iovec iov;
+  iov.iov_base = size;
+  iov.iov_len = sizeof(*size);
+  struct msghdr message;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  ssize_t got;
+  do {
+    got = recvmsg(connection, &message, 0);
+  } while (got < 0 && errno == EINTR);
+  if (got != sizeof(*size))
+    return false;
+
+  struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+  if (header == NULL || header->cmsg_level != SOL_SOCKET ||
+      header->cmsg_type != SCM_RIGHTS ||
+      header->cmsg_len != CMSG_LEN(3 * sizeof(int)))
+    return false;
+  memcpy(fds, CMSG_DATA(header), 3 * sizeof(int));
+  return true;
+}
+
+// Runs the request in the environment of the client. Called in a fresh
+// child of the server, does not return.
+static void RunRequest(const char *argv0, const std::vector<char> &request,
+                       const int fds[3], MaoRequestHandler handler) {
+  for (int i = 0; i < 3; ++i) {
+    dup2(fds[i], i);
+    if (fds[i] > 2)
+      close(fds[i]);
+  }
+
+  // The request ends with a NUL, see HandleConnection().
+  const char *next = &request[0];
+  const char *end = next + request.size();
+  const char *cwd = next;
+  next += strlen(next) + 1;
+  MAO_RASSERT_MSG(next < end, "Malformed server request.");
+  const char *mao_opts = next;
+  next += strlen(next) + 1;
+
+  std::vector<const char *> argv;
+  argv.push_back(argv0);
+  while (next < end) {
+    argv.push_back(next);
+    next += strlen(next) + 1;
+  }
+  argv.push_back(NULL);
+
+  MAO_RASSERT_MSG(chdir(cwd) == 0, "Unable to change to directory %s: %s",
+                  cwd, strerror(errno));
+  if (mao_opts[0] == '=')
+    setenv("MAOOPTS", mao_opts + 1, 1);
+  else
+    unsetenv("MAOOPTS");
+
+  // exit() flushes the stdio buffers of the run.
+  exit(handler(argv.size() - 1, &argv[0]));
+}
+
+// Reads one request from the connection, runs it in a child process and
+// sends back the exit status. Called in a child of the server, does not
+// return.
+static void HandleConnection(int connection, const char *argv0,
+                             MaoRequestHandler handler) {
+  int size;
+  int fds[3];
+  if (!ReceiveHeader(connection, &size, fds) ||
+      size <= 0 || size > kMaoMaxRequestSize)
+    _exit(1);
+  std::vector<char> request(size);
+  if (!ReadFully(connection, &request[0], size) || request[size - 1] != '\0')
+    _exit(1);
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(connection);
+    RunRequest(argv0, request, fds, handler);
+  }
+  for (int i = 0; i < 3; ++i)
+    close(fds[i]);
+
+  int status = 1;
+  if (pid > 0) {
+    int wait_status;
+    pid_t waited;
+    do {
+      waited = waitpid(pid, &wait_status, 0);
+    } while (waited < 0 && errno == EINTR);
+    if (waited == pid) {
+      if (WIFEXITED(wait_status))
+        status = WEXITSTATUS(wait_status);
+      else if (WIFSIGNALED(wait_status))
+        status = 128 + WTERMSIG(wait_status);
+    }
+  }
+  WriteFully(connection, reinterpret_cast<const char *>(&status),
+             sizeof(status));
+  _exit(0);
+}
+
+// Returns true if the client runs as the user of the server.
+static bool IsSameUser(int connection) {
+  struct ucred credentials;
+  socklen_t length = sizeof(credentials);
+  if (getsockopt(connection, SOL_SOCKET, SO_PEERCRED, &credentials,
+                 &length) != 0 || length != sizeof(credentials))
+    return false;
+  return credentials.uid == getuid();
+}
+
+// Creates the directory of the socket if it does not exist, and checks
+// that only the user of the server can get to it.
+static void CheckSocketDirectory(const char *socket_path) {
+  std::string directory(socket_path);
+  std::string::size_type slash = directory.find_last_of('/');
+  if (slash == std::string::npos)
+    directory = ".";
+  else
+    directory.resize(slash == 0 ? 1 : slash);
+
+  if (mkdir(directory.c_str(), 0700) != 0)
+    MAO_RASSERT_MSG(errno == EEXIST, "Unable to create directory %s: %s",
+                    directory.c_str(), strerror(errno));
+  struct stat st;
+  MAO_RASSERT_MSG(lstat(directory.c_str(), &st) == 0,
+                  "Unable to stat %s: %s", directory.c_str(), strerror(errno));
+  MAO_RASSERT_MSG(S_ISDIR(st.st_mode) && st.st_uid == getuid() &&
+                  (st.st_mode & 077) == 0,
+                  "The socket directory %s must be a directory that only "
+                  "its owner can access", directory.c_str());
+}
+
+void RunMaoServer(const char *socket_path, const char *argv0,
+                  MaoRequestHandler handler) {
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  MAO_RASSERT_MSG(strlen(socket_path) < sizeof(address.sun_path),
+                  "Socket path too long: %s", socket_path);
+  strcpy(address.sun_path, socket_path);
+
+  CheckSocketDirectory(socket_path);
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  MAO_RASSERT_MSG(listener >= 0, "Unable to create socket: %s",
+                  strerror(errno));
+  unlink(socket_path);
+  // The socket is created 0600.
+  mode_t old_umask = umask(077);
+  int bound = bind(listener, reinterpret_cast<struct sockaddr *>(&address),
+                   sizeof(address));
+  umask(old_umask);
+  MAO_RASSERT_MSG(bound == 0, "Unable to bind to %s: %s", socket_path,
+                  strerror(errno));
+  MAO_RASSERT_MSG(listen(listener, SOMAXCONN) == 0,
+                  "Unable to listen on %s: %s", socket_path, strerror(errno));
+
+  // The connection handlers are reaped by the kernel.
+  signal(SIGCHLD, SIG_IGN);
+
+  for (;;) {
+    int connection = accept(listener, NULL, NULL);
+    if (connection < 0) {
+      MAO_RASSERT_MSG(errno == EINTR || errno == ECONNABORTED,
+                      "Unable to accept on %s: %s", socket_path,
+                      strerror(errno));
+      continue;
+    }
+    // Requests run with the rights of the server, so only its user may
+    // send them.
+    if (!IsSameUser(connection)) {
+      close(connection);
+      continue;
+    }
+
+    // Nothing buffered in the server may show up in the output of a
+    // request.
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid == 0) {
+      close(listener);
+      // The handler waits for its request.
+      signal(SIGCHLD, SIG_DFL);
+      HandleConnection(connection, argv0, handler);
+    }
+    if (pid < 0)
+      fprintf(stderr, "Unable to fork a request handler: %s\n",
+              strerror(errno));
+    close(connection);
+  }
+}
@@ -0,0 +1,64 @@
+//
+// Copyright 2010 Google Inc.
+//
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301, USA.
+
+// Server mode. A MAO server initializes the passes, the register tables
+// and the plugins once, and then serves requests on a Unix domain
+// socket. Each request is the command line of a MAO run, sent by the
+// mao-client program (see MaoClient.cc).
+//
+// Every request runs in a child process forked from the initialized
+// server. The child starts with the gas globals as they are before
+// as_main() runs for the first time, and all the state of the request,
+// the MaoUnit included, goes away when the child exits. The server
+// itself never runs gas.
+//
+// Requests run with the rights of the server. The socket is created
+// 0600 in a directory that only the user of the server can access,
+// which is created 0700 if it does not exist, and connections from
+// other users are dropped.
+//
+// Protocol, all numbers in host byte order:
+//   client  an int with the size of the request, sent together with the
+//           standard input, output and error of the client (SCM_RIGHTS)
+//   client  the request: NUL terminated strings, the working directory,
+//           the MAOOPTS of the client ('=' and the value, or empty if
+//           MAOOPTS is not set), then the arguments without argv[0]
+//   server  an int with the exit status of the run, 128 plus the signal
+//           number if the run was killed
+//
+// Usage:
+//   mao --mao-server=/tmp/mao-$USER/mao.socket [--mao=-plugin=...]
+//   mao-client /tmp/mao-$USER/mao.socket --mao=ASM=o[foo.mao.s] foo.s
+
+#ifndef MAOSERVER_H_
+#define MAOSERVER_H_
+
+// Runs MAO on the command line of one request.
+typedef int (*MaoRequestHandler)(int argc, const char *argv[]);
+
+// Limit on the size of a request.
+const int kMaoMaxRequestSize = 1 << 20;
+
+// Serves requests on the Unix domain socket socket_path, replacing any
+// stale socket file. The directory of socket_path must be private to
+// the user, or not exist. Each request is handled by calling handler with
+// argv0 and the arguments of the request. Does not return.
+void RunMaoServer(const char *socket_path, const char *argv0,
+                  MaoRequestHandler handler);
+
+#endif  // MAOSERVER_H_
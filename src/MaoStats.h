@@ -19,6 +19,8 @@
 #ifndef MAOSTATS_H_
 #define MAOSTATS_H_
 
+#include "MaoThreads.h"
+
 class Stat {
  public:
   virtual ~Stat() {}
@@ -28,9 +30,12 @@ class Stat {
 };
 
 // Print all stats to the same file.
+// The methods are safe to call from concurrently running function
+// passes.  Callers that first check for a stat and then add it should
+// hold mutex() across both calls.
 class Stats {
  public:
-  Stats() {
+  Stats() : mutex_(true) {
     stats_.clear();
   }
   ~Stats() {
@@ -40,19 +45,24 @@ class Stats {
     }
   }
   void Add(const char *name, Stat *stat) {
+    MaoMutexLock lock(&mutex_);
     MAO_ASSERT(!HasStat(name));
     stats_[name] = stat;
   }
 
   bool HasStat(const char *name) const {
+    MaoMutexLock lock(&mutex_);
     return stats_.find(name) != stats_.end();
   }
 
   Stat *GetStat(const char *name)  {
+    MaoMutexLock lock(&mutex_);
     MAO_ASSERT(HasStat(name));
     return stats_[name];
   }
 
+  MaoMutex *mutex() { return &mutex_; }
+
   void Print(FILE *out) {
     for (std::map<const char *, Stat *, ltstr>::iterator iter = stats_.begin();
         iter != stats_.end(); ++iter) {
@@ -62,6 +72,7 @@ class Stats {
   void Print() {Print(stdout);}
  private:
   std::map<const char *, Stat *, ltstr> stats_;
+  mutable MaoMutex mutex_;
 };
 
 #endif  // MAOSTATS_H_
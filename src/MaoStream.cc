@@ -0,0 +1,119 @@
+//
+// Copyright 2010 Google Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the
+//   Free Software Foundation Inc.,
+//   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <utility>
+
+#include "Mao.h"
+#include "MaoStream.h"
+
+MAO_DEFINE_OPTIONS(STREAM, "Optimizes and writes each function while "
+                   "the input is read", 2) {
+  OPTION_STR("o", "", "Filename to write the assembly to. Streaming is "
+             "off if empty."),
+  OPTION_BOOL("source_info", true, "Append the entry id and source line "
+              "number to each line as a comment."),
+};
+
+// Returns true if name is the symbol of a function.
+static bool IsFunctionSymbol(MaoUnit *unit, const char *name) {
+  // Find() asserts that the symbol exists.
+  SymbolTable *symbol_table = unit->GetSymbolTable();
+  return symbol_table->Exists(name) && symbol_table->Find(name)->IsFunction();
+}
+
+// Returns true if the entries from label to last are a function, as
+// MaoUnit::FindFunctions() would find it: last follows label in the
+// same section, and no other function starts in between.
+static bool IsFunctionBody(MaoUnit *unit, MaoEntry *label, MaoEntry *last) {
+  for (MaoEntry *entry = label; entry != last; entry = entry->next()) {
+    if (entry == NULL || unit->InFunction(entry))
+      return false;
+    if (entry != label && entry->IsLabel() &&
+        IsFunctionSymbol(unit, entry->AsLabel()->name()))
+      return false;
+  }
+  return true;
+}
+
+MaoStreamer::MaoStreamer(MaoOptionMap *options, MaoUnit *unit)
+    : unit_(unit),
+      output_file_((*options)["o"].cval_),
+      source_info_((*options)["source_info"].bval_),
+      passes_(NULL), fd_(-1), emitter_(NULL) { }
+
+MaoStreamer::~MaoStreamer() {
+  if (emitter_ != NULL) {
+    unit_->set_streamer(NULL);
+    delete emitter_;
+    close(fd_);
+  }
+  delete passes_;
+}
+
+void MaoStreamer::Start(const MaoOptions &options) {
+  MAO_ASSERT(enabled());
+  passes_ = new MaoFunctionPassManager(GetStaticOptionPass("PASSMAN"), unit_);
+  const MaoOptions::Pipeline &pipeline = options.pipeline();
+  for (MaoOptions::Pipeline::const_iterator iter = pipeline.begin();
+       iter != pipeline.end(); ++iter) {
+    MaoFunctionPassManager::PassCreator creator =
+        GetFunctionPass(iter->first.c_str());
+    MAO_RASSERT_MSG(creator != NULL, "STREAM only runs function passes, "
+                    "%s is not one", iter->first.c_str());
+    passes_->LinkPass(std::make_pair(creator, iter->second));
+  }
+
+  fd_ = open(output_file_, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  MAO_RASSERT_MSG(fd_ >= 0, "Unable to open %s", output_file_);
+  emitter_ = new MaoEmitter(fd_, source_info_);
+  unit_->set_streamer(this);
+}
+
+void MaoStreamer::SizeDirectiveAdded(DirectiveEntry *size_directive) {
+  MAO_ASSERT(size_directive->NumOperands() == 2);
+  const DirectiveEntry::Operand *symbol_op = size_directive->GetOperand(0);
+  if (symbol_op->type != DirectiveEntry::SYMBOL)
+    return;
+  const char *name = S_GET_NAME(symbol_op->data.sym);
+  // Objects have a .size directive too.
+  if (!IsFunctionSymbol(unit_, name))
+    return;
+  LabelEntry *label = unit_->GetLabelEntry(name);
+  if (label == NULL || !IsFunctionBody(unit_, label, size_directive))
+    return;
+
+  Function *function = unit_->AddFunction(name, label, size_directive);
+  passes_->RunPasses(function);
+  // Releasing the last entry drops the function.
+  unit_->ReleaseEntries(emitter_, function->last_entry());
+  unit_->CompactEntries();
+}
+
+void MaoStreamer::Finish() {
+  MAO_ASSERT(emitter_ != NULL);
+  unit_->set_streamer(NULL);
+  unit_->ReleaseEntries(emitter_, NULL);
+  // Flushes the output.
+  delete emitter_;
+  emitter_ = NULL;
+  MAO_RASSERT_MSG(close(fd_) == 0, "Unable to write %s", output_file_);
+  fd_ = -1;
+}
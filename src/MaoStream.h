@@ -0,0 +1,89 @@
+//
+// Copyright 2010 Google Inc.
+//
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301, USA.
+
+// Streaming. With --mao=STREAM=o[file], the functions are optimized and
+// written while the input is parsed, so that the memory used does not
+// grow with the size of the input. When the .size directive of a
+// function is read, the function passes run on the function, and the
+// function is written to the output, together with the entries before
+// it. Then these entries are released (see MaoUnit::ReleaseEntries()),
+// with the CFG, LSG and other analyses of the function. Changed
+// instructions give their private copies back to the arena of the unit,
+// which reuses the memory. The others give back their reference to the
+// shared copy, which the instruction pool frees once no entry uses it
+// (see MaoInstructionPool.h). The symbol table and the sections stay.
+//
+// This only works for inputs whose functions are self-contained:
+//   - Only function passes can be given, no pass sees the whole unit.
+//     STREAM writes the output, so ASM is not given either.
+//   - The labels of released functions, and of functions not read yet,
+//     are not found. Branches to them are external jumps in the CFG.
+//   - The relaxer only sees the entries that are not released, so the
+//     offsets start at the function being optimized.
+//   - Entries outside of functions ending in a .size directive are
+//     written as they are.
+// The entries left when the input is read, e.g. functions without .size
+// directive, go through the passes as usual and are written at the end.
+// The entry ids are reused once released, so the ids in the source info
+// comments differ from those of a run without STREAM.
+//
+// Usage:
+//   mao --mao=STREAM=o[out.s] --mao=ZEE:REDTEST in.s
+
+#ifndef MAOSTREAM_H_
+#define MAOSTREAM_H_
+
+#include "MaoOptions.h"
+
+class DirectiveEntry;
+class MaoEmitter;
+class MaoFunctionPassManager;
+class MaoUnit;
+
+class MaoStreamer {
+ public:
+  // options are the options of the static option pass STREAM.
+  MaoStreamer(MaoOptionMap *options, MaoUnit *unit);
+  ~MaoStreamer();
+
+  // Returns true if an output file is given.
+  bool enabled() const { return output_file_[0] != '\0'; }
+
+  // Links the passes of the pipeline in options, which must all be
+  // function passes, opens the output and starts streaming.
+  void Start(const MaoOptions &options);
+  // Called by MaoUnit::AddEntry() for every .size directive. If the
+  // directive ends a function, runs the passes on the function and
+  // writes and releases it.
+  void SizeDirectiveAdded(DirectiveEntry *size_directive);
+  // Writes the entries left after the passes ran, and closes the
+  // output.
+  void Finish();
+
+ private:
+  MaoUnit *const unit_;
+  const char *const output_file_;
+  const bool source_info_;
+
+  // Set up by Start().
+  MaoFunctionPassManager *passes_;
+  int fd_;
+  MaoEmitter *emitter_;
+};
+
+#endif  // MAOSTREAM_H_
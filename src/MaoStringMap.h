@@ -0,0 +1,155 @@
+//
+// Copyright 2010 Google Inc.
+//
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301, USA.
+
+// MaoStringMap is a hash index from interned strings (see
+// MaoStringPool) to pointers. Keys are compared by address and hashed
+// with the hash precomputed by the pool, so a lookup never looks at
+// the characters of the key.
+//
+// The table uses open addressing with linear probing, and backward
+// shift deletion, so erasing leaves no tombstones. The index has no
+// iteration order; tables that need one keep their values in a vector
+// next to the index (see SymbolTable).
+//
+// Usage:
+//   MaoStringMap<LabelEntry *> labels;
+//   labels.Insert(label->name(), label);
+//   LabelEntry *label = labels.Find(strings->Find("foo"));
+
+#ifndef MAOSTRINGMAP_H_
+#define MAOSTRINGMAP_H_
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "MaoDebug.h"
+#include "MaoStringPool.h"
+
+template <class T>
+class MaoStringMap {
+ public:
+  MaoStringMap() : size_(0), slots_(kInitialSlots) { }
+
+  // Returns the value of the interned key, or NULL if the key is not in
+  // the map. key may be NULL.
+  T Find(const char *key) const {
+    if (key == NULL)
+      return NULL;
+    const Slot &slot = slots_[FindSlot(key)];
+    return slot.key == key ? slot.value : NULL;
+  }
+
+  // Adds the key with the given value. Returns false, and leaves the
+  // map unchanged, if the key is already in the map.
+  bool Insert(const char *key, T value) {
+    MAO_ASSERT(key != NULL && value != NULL);
+    Slot *slot = &slots_[FindSlot(key)];
+    if (slot->key == key)
+      return false;
+    slot->key = key;
+    slot->value = value;
+    if (2 * ++size_ > slots_.size())
+      Grow();
+    return true;
+  }
+
+  // Adds the key, or changes its value if it is already in the map.
+  void Set(const char *key, T value) {
+    MAO_ASSERT(key != NULL && value != NULL);
+    Slot *slot = &slots_[FindSlot(key)];
+    if (slot->key == key) {
+      slot->value = value;
+      return;
+    }
+    slot->key = key;
+    slot->value = value;
+    if (2 * ++size_ > slots_.size())
+      Grow();
+  }
+
+  // Removes the key. Returns false if the key is not in the map.
+  bool Erase(const char *key) {
+    if (key == NULL)
+      return false;
+    size_t mask = slots_.size() - 1;
+    size_t hole = FindSlot(key);
+    if (slots_[hole].key != key)
+      return false;
+    // Move back the following slots of the probe sequence that can not
+    // be found anymore once the hole is emptied.
+    for (size_t slot = (hole + 1) & mask; slots_[slot].key != NULL;
+         slot = (slot + 1) & mask) {
+      size_t home = MaoStringPool::Hash(slots_[slot].key) & mask;
+      if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+        slots_[hole] = slots_[slot];
+        hole = slot;
+      }
+    }
+    slots_[hole] = Slot();
+    --size_;
+    return true;
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  void clear() {
+    slots_.assign(kInitialSlots, Slot());
+    size_ = 0;
+  }
+
+ private:
+  static const size_t kInitialSlots = 64;
+
+  struct Slot {
+    Slot() : key(NULL), value(NULL) { }
+    const char *key;
+    T value;
+  };
+
+  // Returns the index of the slot holding key, or of the empty slot
+  // where it belongs.
+  size_t FindSlot(const char *key) const {
+    size_t mask = slots_.size() - 1;
+    size_t slot = MaoStringPool::Hash(key) & mask;
+    while (slots_[slot].key != NULL && slots_[slot].key != key)
+      slot = (slot + 1) & mask;
+    return slot;
+  }
+
+  // Doubles the number of slots.
+  void Grow() {
+    std::vector<Slot> slots(slots_.size() * 2);
+    size_t mask = slots.size() - 1;
+    for (typename std::vector<Slot>::const_iterator iter = slots_.begin();
+         iter != slots_.end(); ++iter) {
+      if (iter->key == NULL)
+        continue;
+      size_t slot = MaoStringPool::Hash(iter->key) & mask;
+      while (slots[slot].key != NULL)
+        slot = (slot + 1) & mask;
+      slots[slot] = *iter;
+    }
+    slots_.swap(slots);
+  }
+
+  size_t size_;
+  std::vector<Slot> slots_;
+};
+
+#endif  // MAOSTRINGMAP_H_
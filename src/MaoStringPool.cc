@@ -0,0 +1,144 @@
+//
+// Copyright 2010 Google Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the
+//   Free Software Foundation Inc.,
+//   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "MaoDebug.h"
+#include "MaoStringPool.h"
+
+const size_t MaoStringPool::kBufferSize;
+const unsigned int MaoStringPool::kEmptySlot;
+
+MaoStringPool::MaoStringPool()
+    : next_(NULL), end_(NULL), bytes_used_(0), slots_(1024, kEmptySlot) {
+}
+
+MaoStringPool::~MaoStringPool() {
+  for (std::vector<char *>::iterator iter = buffers_.begin();
+       iter != buffers_.end(); ++iter) {
+    free(*iter);
+  }
+}
+
+unsigned int MaoStringPool::HashString(const char *str, size_t length) {
+  unsigned int hash = 2166136261u;
+  for (size_t i = 0; i < length; ++i) {
+    hash ^= static_cast<unsigned char>(str[i]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+size_t MaoStringPool::FindSlot(const char *str, size_t length,
+                               unsigned int hash) const {
+  size_t mask = slots_.size() - 1;
+  for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+    if (slots_[slot] == kEmptySlot)
+      return slot;
+    const char *candidate = strings_[slots_[slot] - 1];
+    if (Hash(candidate) == hash &&
+        strncmp(candidate, str, length) == 0 && candidate[length] == '\0')
+      return slot;
+  }
+}
+
+char *MaoStringPool::Store(const char *str, size_t length,
+                           unsigned int hash) {
+  // Keep the headers aligned.
+  size_t size = sizeof(Header) + length + 1;
+  size = (size + sizeof(Header) - 1) & ~(sizeof(Header) - 1);
+  if (next_ == NULL || next_ + size > end_) {
+    // The rest of the current buffer is abandoned.
+    size_t buffer_size = size > kBufferSize ? size : kBufferSize;
+    next_ = static_cast<char *>(malloc(buffer_size));
+    MAO_RASSERT_MSG(next_ != NULL, "Out of memory.");
+    end_ = next_ + buffer_size;
+    buffers_.push_back(next_);
+  }
+  Header *header = reinterpret_cast<Header *>(next_);
+  header->hash = hash;
+  header->id = strings_.size();
+  char *copy = reinterpret_cast<char *>(header + 1);
+  memcpy(copy, str, length);
+  copy[length] = '\0';
+  next_ += size;
+  bytes_used_ += size;
+  return copy;
+}
+
+void MaoStringPool::Grow() {
+  std::vector<unsigned int> slots(slots_.size() * 2, kEmptySlot);
+  size_t mask = slots.size() - 1;
+  for (std::vector<unsigned int>::const_iterator iter = slots_.begin();
+       iter != slots_.end(); ++iter) {
+    if (*iter == kEmptySlot)
+      continue;
+    size_t slot = Hash(strings_[*iter - 1]) & mask;
+    while (slots[slot] != kEmptySlot)
+      slot = (slot + 1) & mask;
+    slots[slot] = *iter;
+  }
+  slots_.swap(slots);
+}
+
+const char *MaoStringPool::Intern(const char *str) {
+  MAO_ASSERT(str);
+  size_t length = strlen(str);
+  unsigned int hash = HashString(str, length);
+
+  MaoMutexLock lock(&mutex_);
+  size_t slot = FindSlot(str, length, hash);
+  if (slots_[slot] != kEmptySlot)
+    return strings_[slots_[slot] - 1];
+
+  const char *copy = Store(str, length, hash);
+  strings_.push_back(copy);
+  slots_[slot] = strings_.size();
+  if (2 * strings_.size() > slots_.size())
+    Grow();
+  return copy;
+}
+
+const char *MaoStringPool::Find(const char *str) const {
+  MAO_ASSERT(str);
+  size_t length = strlen(str);
+  unsigned int hash = HashString(str, length);
+
+  MaoMutexLock lock(&mutex_);
+  size_t slot = FindSlot(str, length, hash);
+  if (slots_[slot] == kEmptySlot)
+    return NULL;
+  return strings_[slots_[slot] - 1];
+}
+
+const char *MaoStringPool::String(MaoStringID id) const {
+  MaoMutexLock lock(&mutex_);
+  MAO_ASSERT(id < strings_.size());
+  return strings_[id];
+}
+
+size_t MaoStringPool::size() const {
+  MaoMutexLock lock(&mutex_);
+  return strings_.size();
+}
+
+size_t MaoStringPool::bytes_used() const {
+  MaoMutexLock lock(&mutex_);
+  return bytes_used_;
+}
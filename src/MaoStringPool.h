@@ -0,0 +1,123 @@
+//
+// Copyright 2010 Google Inc.
+//
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301, USA.
+
+// MaoStringPool interns the strings of a unit: the verbatim source
+// lines of the entries, label names, symbol names and function names.
+// Each distinct string is stored once, and Intern() returns the same
+// pointer for equal strings. Two interned strings are therefore equal
+// if and only if their pointers are equal.
+//
+// Each interned string also has a dense id, and a precomputed hash
+// that tables keyed by interned strings can use instead of hashing the
+// characters again. Both are stored in front of the characters, so
+// Id() and Hash() are O(1).
+//
+// The strings are packed into large buffers that contain no pointers,
+// only the header and the characters of each string.
+//
+// Usage:
+//   MaoStringPool *strings = unit->GetStringPool();
+//   const char *name = strings->Intern(label_name);
+//   if (strings->Find("main") == name) ...
+
+#ifndef MAOSTRINGPOOL_H_
+#define MAOSTRINGPOOL_H_
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "MaoThreads.h"
+
+typedef unsigned int MaoStringID;
+
+class MaoStringPool {
+ public:
+  MaoStringPool();
+  ~MaoStringPool();
+
+  // Returns the interned copy of str, adding it to the pool if needed.
+  const char *Intern(const char *str);
+  // Returns the interned copy of str, or NULL if str was never
+  // interned.
+  const char *Find(const char *str) const;
+
+  // Returns the id of an interned string. Ids are dense, starting at 0.
+  static MaoStringID Id(const char *interned) {
+    return HeaderOf(interned)->id;
+  }
+  // Returns the hash of an interned string, see HashString().
+  static unsigned int Hash(const char *interned) {
+    return HeaderOf(interned)->hash;
+  }
+  // Returns the interned string with the given id.
+  const char *String(MaoStringID id) const;
+
+  // Hashes the length characters of str (FNV-1a).
+  static unsigned int HashString(const char *str, size_t length);
+
+  // Returns the number of strings in the pool.
+  size_t size() const;
+  // Returns the number of bytes used by the interned strings and their
+  // headers.
+  size_t bytes_used() const;
+
+ private:
+  // Stored in front of the characters of each string.
+  struct Header {
+    unsigned int hash;
+    MaoStringID id;
+  };
+  static const Header *HeaderOf(const char *interned) {
+    return reinterpret_cast<const Header *>(interned) - 1;
+  }
+
+  static const size_t kBufferSize = 256 * 1024;
+  static const unsigned int kEmptySlot = 0;
+
+  // Returns the index of the slot for a string, either the one holding
+  // it or the empty slot where it belongs. Slots hold the id + 1 of the
+  // string.
+  size_t FindSlot(const char *str, size_t length, unsigned int hash) const;
+  // Copies the string into a buffer and returns the copy.
+  char *Store(const char *str, size_t length, unsigned int hash);
+  // Doubles the size of the hash table.
+  void Grow();
+
+  // The buffers that hold the strings. Strings never move.
+  std::vector<char *> buffers_;
+  char *next_;
+  char *end_;
+  size_t bytes_used_;
+
+  // The interned strings, indexed by id.
+  std::vector<const char *> strings_;
+  // Open addressing hash table with linear probing. The size is a power
+  // of two, and at most half of the slots are used.
+  std::vector<unsigned int> slots_;
+
+  // Entries may be created by several threads at once, see
+  // MaoFunctionPassManager.
+  mutable MaoMutex mutex_;
+
+  // Not copyable.
+  MaoStringPool(const MaoStringPool &);
+  void operator=(const MaoStringPool &);
+};
+
+#endif  // MAOSTRINGPOOL_H_
@@ -0,0 +1,77 @@
+//
+// Copyright 2010 Google Inc.
+//
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301, USA.
+
+// Thin wrappers around pthreads, used where MAO state can be shared
+// between the threads of the function pass manager.
+//
+// Classes:
+//   MaoMutex     - A (optionally recursive) mutex.
+//   MaoMutexLock - Holds a MaoMutex for the lifetime of a scope.
+//
+// Usage:
+//   static MaoMutex mutex;
+//   {
+//     MaoMutexLock lock(&mutex);
+//     // Critical section.
+//   }
+
+#ifndef MAOTHREADS_H_
+#define MAOTHREADS_H_
+
+#include <pthread.h>
+
+#include "MaoDebug.h"
+
+class MaoMutex {
+ public:
+  // A recursive mutex may be locked again by the thread holding it.
+  explicit MaoMutex(bool recursive = false) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    if (recursive)
+      pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    MAO_RASSERT(pthread_mutex_init(&mutex_, &attr) == 0);
+    pthread_mutexattr_destroy(&attr);
+  }
+  ~MaoMutex() { pthread_mutex_destroy(&mutex_); }
+
+  void Lock()   { MAO_RASSERT(pthread_mutex_lock(&mutex_) == 0); }
+  void Unlock() { MAO_RASSERT(pthread_mutex_unlock(&mutex_) == 0); }
+
+ private:
+  pthread_mutex_t mutex_;
+
+  // Not copyable.
+  MaoMutex(const MaoMutex &);
+  void operator=(const MaoMutex &);
+};
+
+class MaoMutexLock {
+ public:
+  explicit MaoMutexLock(MaoMutex *mutex) : mutex_(mutex) { mutex_->Lock(); }
+  ~MaoMutexLock() { mutex_->Unlock(); }
+
+ private:
+  MaoMutex *const mutex_;
+
+  // Not copyable.
+  MaoMutexLock(const MaoMutexLock &);
+  void operator=(const MaoMutexLock &);
+};
+
+#endif  // MAOTHREADS_H_
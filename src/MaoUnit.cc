@@ -17,11 +17,14 @@
 //   51 Franklin Street, Fifth Floor,
 //   Boston, MA  02110-1301, USA.
 
+#include <algorithm>
 #include <iostream>
+#include <set>
 #include <sstream>
 #include <string>
 
 #include "Mao.h"
+#include "MaoStream.h"
 #include "MaoUnit.h"
 
 #include "ir.h"
@@ -36,13 +39,22 @@
 // Default to no subsection selected
 // A default will be generated if necessary later on.
 MaoUnit::MaoUnit(MaoOptions *mao_options)
-    : arch_(UNKNOWN), current_subsection_(0), mao_options_(mao_options) {
+    : arch_(UNKNOWN), current_subsection_(0), symbol_table_(&strings_),
+      entry_mutex_(true),
+      parallel_run_(false), parallel_first_id_(0),
+      mao_options_(mao_options), gas_argc_(0), gas_argv_(NULL),
+      analyses_(this) {
   entry_vector_.clear();
   sub_sections_.clear();
   sections_.clear();
   functions_.clear();
-  entry_to_function_.clear();
-  entry_to_subsection_.clear();
+  next_function_id_ = 0;
+  entry_function_.clear();
+  entry_subsection_.clear();
+  deleted_entries_ = 0;
+  compacted_entries_ = 0;
+  streamer_ = NULL;
+  released_subsections_ = 0;
 }
 
 MaoUnit::~MaoUnit() {
@@ -109,6 +121,100 @@ class EntryDumper : public MaoDebugAction {
 
 // Prints all entries in the MaoUnit
 void MaoUnit::PrintMaoUnit(FILE *out) const {
+  // The emitter writes to the file descriptor directly.
+  fflush(out);
+  MaoEmitter emitter(fileno(out), true);
+  EmitMaoUnit(&emitter);
+}
+
+// Parallel emission.
+//
+// The subsections are cut into chunks of consecutive entries. Worker
+// threads take the chunks in order and render each into its own
+// buffer. Rendering only reads the IR.
+//
+namespace {
+
+struct EmitChunk {
+  MaoEntry *first;
+  int num_entries;
+  std::string text;
+};
+
+struct EmitWorker {
+  std::vector<EmitChunk> *chunks;
+  int *next_chunk;
+  bool source_info;
+};
+
+const int kEntriesPerEmitChunk = 4096;
+
+void *EmitWorkerThread(void *arg) {
+  EmitWorker *worker = static_cast<EmitWorker *>(arg);
+  std::vector<EmitChunk> &chunks = *worker->chunks;
+  MaoEmitter emitter(worker->source_info);
+  while (true) {
+    int index = __sync_fetch_and_add(worker->next_chunk, 1);
+    if (index >= static_cast<int>(chunks.size()))
+      break;
+    MaoEntry *entry = chunks[index].first;
+    for (int i = 0; i < chunks[index].num_entries; ++i) {
+      entry->EmitEntry(&emitter);
+      entry = entry->next();
+    }
+    emitter.TakeOutput(&chunks[index].text);
+  }
+  return NULL;
+}
+
+}  // namespace
+
+void MaoUnit::EmitMaoUnit(MaoEmitter *out, int num_threads) const {
+  if (num_threads > 1) {
+    std::vector<EmitChunk> chunks;
+    for (std::vector<SubSection *>::const_iterator iter =
+             sub_sections_.begin();
+         iter != sub_sections_.end(); ++iter) {
+      SubSection *ss = *iter;
+      int in_chunk = kEntriesPerEmitChunk;
+      for (EntryIterator e_iter = ss->EntryBegin();
+           e_iter != ss->EntryEnd();
+           ++e_iter) {
+        if (in_chunk == kEntriesPerEmitChunk) {
+          chunks.push_back(EmitChunk());
+          chunks.back().first = *e_iter;
+          chunks.back().num_entries = 0;
+          in_chunk = 0;
+        }
+        ++chunks.back().num_entries;
+        ++in_chunk;
+      }
+    }
+    if (num_threads > static_cast<int>(chunks.size()))
+      num_threads = chunks.size();
+
+    int next_chunk = 0;
+    EmitWorker worker = { &chunks, &next_chunk, out->source_info() };
+    // The calling thread acts as one of the workers.
+    std::vector<pthread_t> threads(num_threads);
+    for (int i = 1; i < num_threads; ++i) {
+      MAO_RASSERT_MSG(pthread_create(&threads[i], NULL, EmitWorkerThread,
+                                     &worker) == 0,
+                      "Unable to create emitter thread");
+    }
+    EmitWorkerThread(&worker);
+    for (int i = 1; i < num_threads; ++i) {
+      MAO_RASSERT(pthread_join(threads[i], NULL) == 0);
+    }
+
+    for (std::vector<EmitChunk>::const_iterator iter = chunks.begin();
+         iter != chunks.end(); ++iter) {
+      out->Append(iter->text);
+    }
+    out->Flush();
+    return;
+  }
+
   EntryDumper entry_dumper;
   for (std::vector<SubSection *>::const_iterator iter = sub_sections_.begin();
        iter != sub_sections_.end(); ++iter) {
@@ -118,9 +224,10 @@ void MaoUnit::PrintMaoUnit(FILE *out) const {
          ++e_iter) {
       MaoEntry *e = *e_iter;
       entry_dumper.set_entry(e);
-      e->PrintEntry(out);
+      e->EmitEntry(out);
     }
   }
+  out->Flush();
 }
 
 void MaoUnit::PrintIR(bool print_entries, bool print_sections,
@@ -132,7 +239,7 @@ void MaoUnit::PrintIR(bool print_entries, bool print_sections,
 const char *MaoUnit::FunctionName(MaoEntry *entry) const {
   const char *function = "";
   if (InFunction(entry)) {
-    function = (*(entry_to_function_.find(entry))).second->name().c_str();
+    function = entry_function_[entry->id()]->name().c_str();
   }
   return function;
 }
@@ -140,7 +247,7 @@ const char *MaoUnit::FunctionName(MaoEntry *entry) const {
 const char *MaoUnit::SectionName(MaoEntry *entry) const {
   const char *section = "";
   if (InSubSection(entry)) {
-    SubSection *ss = (*(entry_to_subsection_.find(entry))).second;
+    SubSection *ss = entry_subsection_[entry->id()];
     section = ss->section()->name().c_str();
   }
   return section;
@@ -276,7 +383,8 @@ SubSection *MaoUnit::AddNewSubSection(const char *section_name,
 
   // Now we should check if we should link this entry back to the previous
   // subsection within this section!
-  if (last_subsection) {
+  // The last subsection is empty if its entries are released.
+  if (last_subsection && last_subsection->last_entry()) {
     MaoEntry *last_entry = last_subsection->last_entry();
     last_entry->set_next(entry);
     entry->set_prev(last_entry);
@@ -287,13 +395,11 @@ SubSection *MaoUnit::AddNewSubSection(const char *section_name,
 
 
 LabelEntry *MaoUnit::GetLabelEntry(const char *label_name) const {
-  std::map<const char *, LabelEntry *>::const_iterator iter =
-      labels_.find(label_name);
-  if (iter == labels_.end()) {
-    return NULL;
-  } else {
-    return iter->second;
-  }
+  // Labels are keyed by their interned name. A name that was never
+  // interned can not be a label.
+  const char *key = strings_.Find(label_name);
+  MaoMutexLock lock(&entry_mutex_);
+  return labels_.Find(key);
 }
 
 
@@ -326,20 +432,7 @@ InstructionEntry *MaoUnit::CreateInstruction(i386_insn *instruction,
   }
 
   InstructionEntry *e = new InstructionEntry(instruction, flag, 0, NULL, this);
-  // next free ID for the entry
-  EntryID entry_index = entry_vector_.size();
-  e->set_id(entry_index);
-
-  // Add the entry to the compilation unit
-  entry_vector_.push_back(e);
-
-  SubSection *subsection = function->GetSubSection();
-  if (function) {
-    entry_to_function_[e] = function;
-  }
-  if (subsection) {
-    entry_to_subsection_[e] = subsection;
-  }
+  RegisterEntry(e, function, function->GetSubSection());
   return e;
 }
 
@@ -368,20 +461,7 @@ InstructionEntry *MaoUnit::CreateInstruction(const char *opcode_str,
   }
 
   InstructionEntry *e = new InstructionEntry(&insn, flag, 0, NULL, this);
-  // next free ID for the entry
-  EntryID entry_index = entry_vector_.size();
-  e->set_id(entry_index);
-
-  // Add the entry to the compilation unit
-  entry_vector_.push_back(e);
-
-  SubSection *subsection = function->GetSubSection();
-  if (function) {
-    entry_to_function_[e] = function;
-  }
-  if (subsection) {
-    entry_to_subsection_[e] = subsection;
-  }
+  RegisterEntry(e, function, function->GetSubSection());
   return e;
 }
 
@@ -414,7 +494,7 @@ InstructionEntry *MaoUnit::Create2ByteNop(Function *function) {
   #define WORD_MNEM_SUFFIX  'w'
   InstructionEntry *e = CreateInstruction("xchg", 0x90, function);
 
-  i386_insn *insn = e->instruction();
+  i386_insn *insn = e->mutable_instruction();
   insn->operands = 2;
   insn->reg_operands = 2;
 
@@ -466,7 +546,7 @@ InstructionEntry *MaoUnit::CreatePrefetch(Function *function,
 
   e->set_op(prefetch_opcodes[type]);
 
-  i386_insn *in_insn = e->instruction();
+  i386_insn *in_insn = e->mutable_instruction();
   in_insn->operands = 1;
   in_insn->mem_operands = 1;
 
@@ -484,11 +564,10 @@ InstructionEntry *MaoUnit::CreatePrefetch(Function *function,
 InstructionEntry *MaoUnit::CreateUncondJump(LabelEntry *label,
                                             Function *function) {
   InstructionEntry *e = CreateInstruction("jmp", 0xeb, function);
-  expressionS *disp_expression =
-      static_cast<expressionS *>(xmalloc(sizeof(expressionS)));
+  expressionS *disp_expression = arena_.NewZeroed<expressionS>();
   symbolS *symbolP;
 
-  i386_insn *insn = e->instruction();
+  i386_insn *insn = e->mutable_instruction();
   insn->operands = 1;
   insn->disp_operands = 1;
   insn->mem_operands = 1;
@@ -500,7 +579,11 @@ InstructionEntry *MaoUnit::CreateUncondJump(LabelEntry *label,
   for (int j = 0; j < MAX_OPERANDS; j++)
     insn->reloc[j] = NO_RELOC;
 
-  symbolP = symbol_find_or_make(label->name());
+  {
+    // The gas symbol table is not thread safe.
+    MaoMutexLock lock(&entry_mutex_);
+    symbolP = symbol_find_or_make(label->name());
+  }
 
   disp_expression->X_op = O_symbol;
   disp_expression->X_add_symbol = symbolP;
@@ -520,7 +603,7 @@ InstructionEntry *MaoUnit::CreateIncFromOperand(Function *function,
                                                 int op2) {
   InstructionEntry *e = CreateInstruction("inc", 0xfe, function);
   e->SetOperand(0, insn2, op2);
-  e->instruction()->operands++;
+  e->mutable_instruction()->operands++;
   e->set_op(OP_inc);
 
   return e;
@@ -531,7 +614,7 @@ InstructionEntry *MaoUnit::CreateDecFromOperand(Function *function,
                                                 int op2) {
   InstructionEntry *e = CreateInstruction("dec", 0xfe, function);
   e->SetOperand(0, insn2, op2);
-  e->instruction()->operands++;
+  e->mutable_instruction()->operands++;
   e->set_op(OP_dec);
 
   return e;
@@ -541,21 +624,7 @@ LabelEntry *MaoUnit::CreateLabel(const char *labelname,
                                  Function *function,
                                  SubSection *subsection) {
   LabelEntry *l = new LabelEntry(labelname, 0, NULL, this);
-
-  // next free ID for the entry
-  EntryID entry_index = entry_vector_.size();
-  l->set_id(entry_index);
-
-  // Add the entry to the compilation unit
-  entry_vector_.push_back(l);
-
-  if (function) {
-    entry_to_function_[l] = function;
-  }
-  if (subsection) {
-    entry_to_subsection_[l] = subsection;
-  }
-
+  RegisterEntry(l, function, subsection);
   return l;
 }
 
@@ -567,21 +636,108 @@ DirectiveEntry *MaoUnit::CreateDirective(
   DirectiveEntry *directive =
       new DirectiveEntry(op, operands,
                          0, NULL, this);
+  RegisterEntry(directive, function, subsection);
+  return directive;
+}
+
+// Thread specific function set by SetThreadFunction().
+static __thread Function *thread_function = NULL;
+
+void MaoUnit::RegisterEntry(MaoEntry *entry, Function *function,
+                            SubSection *subsection) {
+  MaoMutexLock lock(&entry_mutex_);
+
   // next free ID for the entry
   EntryID entry_index = entry_vector_.size();
-  directive->set_id(entry_index);
+  entry->set_id(entry_index);
+  entry->set_source_id(entry_index + compacted_entries_);
 
   // Add the entry to the compilation unit
-  entry_vector_.push_back(directive);
+  entry_vector_.push_back(entry);
+  entry_function_.push_back(function);
+  entry_subsection_.push_back(subsection);
 
-  if (function) {
-    entry_to_function_[directive] = function;
+  if (parallel_run_) {
+    MAO_RASSERT_MSG(thread_function != NULL,
+                    "Entry created outside of a function in a parallel run");
+    parallel_created_entries_[thread_function->id()].push_back(entry);
   }
-  if (subsection) {
-    entry_to_subsection_[directive] = subsection;
+}
+
+void MaoUnit::BeginParallelRun() {
+  MaoMutexLock lock(&entry_mutex_);
+  MAO_ASSERT(!parallel_run_);
+  parallel_run_ = true;
+  parallel_first_id_ = entry_vector_.size();
+  parallel_created_entries_.clear();
+  parallel_created_entries_.resize(next_function_id_);
+  parallel_deleted_entries_.clear();
+  parallel_deleted_functions_.clear();
+}
+
+void MaoUnit::SetThreadFunction(Function *function) {
+  MAO_ASSERT(function == NULL ||
+             function->id() < next_function_id_);
+  thread_function = function;
+}
+
+void MaoUnit::EndParallelRun() {
+  MaoMutexLock lock(&entry_mutex_);
+  MAO_ASSERT(parallel_run_);
+  parallel_run_ = false;
+
+  // Unlink the entries that were deleted at function boundaries.
+  for (std::vector<MaoEntry *>::const_iterator iter =
+           parallel_deleted_entries_.begin();
+       iter != parallel_deleted_entries_.end(); ++iter) {
+    DeleteEntry(*iter);
+  }
+  for (std::vector<Function *>::const_iterator iter =
+           parallel_deleted_functions_.begin();
+       iter != parallel_deleted_functions_.end(); ++iter) {
+    FunctionVector::iterator function =
+        std::find(functions_.begin(), functions_.end(), *iter);
+    MAO_ASSERT(function != functions_.end());
+    functions_.erase(function);
+    delete *iter;
   }
 
-  return directive;
+  // Hand out the ids of the new entries again, in the order a serial
+  // run would have created them. Deleted entries keep their (NULL) slot.
+  EntryVector renumbered;
+  std::vector<Function *> renumbered_function;
+  std::vector<SubSection *> renumbered_subsection;
+  for (std::vector<std::vector<MaoEntry *> >::const_iterator func_iter =
+           parallel_created_entries_.begin();
+       func_iter != parallel_created_entries_.end(); ++func_iter) {
+    for (std::vector<MaoEntry *>::const_iterator iter = func_iter->begin();
+         iter != func_iter->end(); ++iter) {
+      MaoEntry *entry = *iter;
+      renumbered.push_back(entry_vector_[entry->id()]);
+      renumbered_function.push_back(entry_function_[entry->id()]);
+      renumbered_subsection.push_back(entry_subsection_[entry->id()]);
+      entry->set_id(parallel_first_id_ + renumbered.size() - 1);
+      entry->set_source_id(entry->id() + compacted_entries_);
+    }
+  }
+  MAO_ASSERT(parallel_first_id_ + renumbered.size() == entry_vector_.size());
+  std::copy(renumbered.begin(), renumbered.end(),
+            entry_vector_.begin() + parallel_first_id_);
+  std::copy(renumbered_function.begin(), renumbered_function.end(),
+            entry_function_.begin() + parallel_first_id_);
+  std::copy(renumbered_subsection.begin(), renumbered_subsection.end(),
+            entry_subsection_.begin() + parallel_first_id_);
+
+  // Size and offset maps are indexed by entry id. The entries deleted
+  // above were no longer in a function, so their sizes are still there.
+  if (!renumbered.empty() || !parallel_deleted_entries_.empty()) {
+    for (SectionIterator iter = SectionBegin(); iter != SectionEnd(); ++iter)
+      MaoRelaxer::InvalidateSizeMap(*iter);
+  }
+
+  parallel_created_entries_.clear();
+  parallel_deleted_entries_.clear();
+  parallel_deleted_functions_.clear();
 }
 
 // Add an entry to the MaoUnit list
@@ -597,6 +753,7 @@ bool MaoUnit::AddEntry(MaoEntry *entry,
 
   MAO_ASSERT(entry);
   entry->set_id(entry_index);
+  entry->set_source_id(entry_index + compacted_entries_);
 
   // Check if we should add a new section for the first directives.
   if (!current_subsection_ &&
@@ -624,8 +781,8 @@ bool MaoUnit::AddEntry(MaoEntry *entry,
     case MaoEntry::LABEL:
       // A Label will generate in a new symbol in the symbol table
       label_entry = static_cast<LabelEntry *>(entry);
-      MAO_ASSERT(labels_.insert(std::make_pair(label_entry->name(),
-                                               label_entry)).second);
+      MAO_RASSERT_MSG(labels_.Insert(label_entry->name(), label_entry),
+                      "Label %s already defined", label_entry->name());
       symbol = symbol_table_.FindOrCreateAndFind(label_entry->name(),
                                                 current_subsection_->section());
       MAO_ASSERT(symbol);
@@ -703,13 +860,19 @@ bool MaoUnit::AddEntry(MaoEntry *entry,
 
   // Add the entry to the compilation unit
   entry_vector_.push_back(entry);
+  entry_function_.push_back(NULL);
+  entry_subsection_.push_back(current_subsection_);
 
   // Update subsection information
   if (current_subsection_) {
     current_subsection_->set_last_entry(entry);
-    entry_to_subsection_[entry] = current_subsection_;
   }
 
+  // The .size directive usually ends a function.
+  if (streamer_ && entry->IsDirective() &&
+      entry->AsDirective()->op() == DirectiveEntry::SIZE)
+    streamer_->SizeDirectiveAdded(entry->AsDirective());
+
   return true;
 }
 
@@ -728,7 +891,8 @@ bool MaoUnit::AddCommSymbol(const char *name, unsigned int common_size,
     Section *section = current_subsection_?
         (current_subsection_->section()):
         NULL;
-    symbol = symbol_table_.Add(new Symbol(name, symbol_table_.Size(), section));
+    symbol = symbol_table_.Add(new Symbol(strings_.Intern(name),
+                                          symbol_table_.Size(), section));
     symbol->set_symbol_type(OBJECT_SYMBOL);
   } else {
     // Get the symbol
@@ -750,13 +914,21 @@ bool MaoUnit::AddCommSymbol(const char *name, unsigned int common_size,
 long MaoUnit::BBNameGen::i = 0;
 const char *MaoUnit::BBNameGen::GetUniqueName() {
   char buff[512];
-  MAO_ASSERT(i <= LONG_MAX);
-  sprintf(buff, ".L__mao_label_%ld", i);
+  long number = __sync_fetch_and_add(&i, 1);
+  MAO_ASSERT(number <= LONG_MAX);
+  sprintf(buff, ".L__mao_label_%ld", number);
   char *buff2 = strdup(buff);
-  i++;
   return buff2;
 }
 
+const char *MaoUnit::BBNameGen::GetUniqueName(Function *function) {
+  MAO_ASSERT(function);
+  char buff[512];
+  sprintf(buff, ".L__mao_label_%d_%ld", function->id(),
+          function->NextLabelNumber());
+  return strdup(buff);
+}
+
 MaoUnit::FunctionIterator MaoUnit::FunctionBegin() {
   return functions_.begin();
 }
@@ -799,14 +971,17 @@ void MaoUnit::FindFunctions(bool create_anonymous) {
     if (symbol->IsFunction()) {
       // Find the entry given the label now
       MaoEntry *entry = GetLabelEntry(symbol->name());
+      // The functions handed to a streamer are released already.
+      if (entry == NULL && streamer_ != NULL)
+        continue;
       MAO_ASSERT_MSG(entry != NULL, "Unable to find label: %s", symbol->name());
 
       // TODO(martint): create ID factory for functions
       MAO_ASSERT(GetSubSection(entry));
-      Function *function = new Function(symbol->name(), functions_.size(),
+      Function *function = new Function(symbol->name(), next_function_id_++,
                                         GetSubSection(entry));
       function->set_first_entry(entry);
-      entry_to_function_[entry] = function;
+      entry_function_[entry->id()] = function;
 
       // Find the last entry in this function:
       // A function ends when you find one of the following
@@ -854,12 +1029,12 @@ void MaoUnit::FindFunctions(bool create_anonymous) {
             break;
           }
         }
-        entry_to_function_[entry_tail] = function;
+        entry_function_[entry_tail->id()] = function;
         entry_tail = entry_tail->next();
       }
 
       // Now entry_tail can not move more forward.
-      entry_to_function_[entry_tail] = function;
+      entry_function_[entry_tail->id()] = function;
       function->set_last_entry(entry_tail);
       functions_.push_back(function);
     }
@@ -894,14 +1069,14 @@ void MaoUnit::FindFunctions(bool create_anonymous) {
 
           char function_name[64];
           sprintf(function_name, "__mao_unnamed%d", function_number++);
-          Function *function = new Function(function_name, functions_.size(),
-                                            subsection);
+          Function *function = new Function(strings_.Intern(function_name),
+                                            next_function_id_, subsection);
           function->set_first_entry(entry);
           // New section should break the anaonumous function.
           while (entry &&
                  !InFunction(entry)) {
             function->set_last_entry(entry);
-            entry_to_function_[entry] = function;
+            entry_function_[entry->id()] = function;
             if (entry->IsInstruction())
               ++instruciton_entries;
             entry = entry->next();
@@ -910,6 +1085,7 @@ void MaoUnit::FindFunctions(bool create_anonymous) {
           // any instruction entries in them.
           if (instruciton_entries > 0) {
             functions_.push_back(function);
+            ++next_function_id_;
           } else {
             delete function;
           }
@@ -920,13 +1096,32 @@ void MaoUnit::FindFunctions(bool create_anonymous) {
   return;
 }
 
+Function *MaoUnit::AddFunction(const char *name, MaoEntry *first,
+                               MaoEntry *last) {
+  SubSection *subsection = GetSubSection(first);
+  MAO_ASSERT(subsection);
+  Function *function = new Function(strings_.Intern(name),
+                                    next_function_id_++, subsection);
+  function->set_first_entry(first);
+  function->set_last_entry(last);
+  for (MaoEntry *entry = first; ; entry = entry->next()) {
+    MAO_RASSERT_MSG(entry != NULL, "Function %s does not end", name);
+    entry_function_[entry->id()] = function;
+    if (entry == last)
+      break;
+  }
+  functions_.push_back(function);
+  return function;
+}
+
 
 Symbol *MaoUnit::AddSymbol(const char *name) {
   Section *section = current_subsection_?
       (current_subsection_->section()):
       NULL;
   // TODO(martint): Use a ID factory
-  return symbol_table_.Add(new Symbol(name, symbol_table_.Size(), section));
+  return symbol_table_.Add(new Symbol(strings_.Intern(name),
+                                      symbol_table_.Size(), section));
 }
 
 
@@ -939,31 +1134,53 @@ Symbol *MaoUnit::FindOrCreateAndFindSymbol(const char *name) {
 
 
 Function *MaoUnit::GetFunction(MaoEntry *entry) {
-  if (entry_to_function_.find(entry) == entry_to_function_.end()) {
-    return NULL;
-  } else {
-    return entry_to_function_[entry];
-  }
+  MaoMutexLock lock(&entry_mutex_);
+  return IsLiveEntry(entry) ? entry_function_[entry->id()] : NULL;
 }
 
 bool MaoUnit::InFunction(MaoEntry *entry) const {
-  return entry_to_function_.find(entry) != entry_to_function_.end();
+  MaoMutexLock lock(&entry_mutex_);
+  return IsLiveEntry(entry) && entry_function_[entry->id()] != NULL;
 }
 
 
 SubSection *MaoUnit::GetSubSection(MaoEntry *entry) {
-  if (entry_to_subsection_.find(entry) == entry_to_subsection_.end()) {
-    return NULL;
-  } else {
-    return entry_to_subsection_[entry];
-  }
+  MaoMutexLock lock(&entry_mutex_);
+  return IsLiveEntry(entry) ? entry_subsection_[entry->id()] : NULL;
 }
 
 bool MaoUnit::InSubSection(MaoEntry *entry) const {
-  return entry_to_subsection_.find(entry) != entry_to_subsection_.end();
+  MaoMutexLock lock(&entry_mutex_);
+  return IsLiveEntry(entry) && entry_subsection_[entry->id()] != NULL;
 }
 
 void MaoUnit::DeleteEntry(MaoEntry *entry) {
+  MaoMutexLock size_map_lock(MaoAnalysisManager::size_map_mutex());
+  MaoMutexLock lock(&entry_mutex_);
+  MAO_ASSERT(IsLiveEntry(entry));
+  Function *function = entry_function_[entry->id()];
+  SubSection *subsection = entry_subsection_[entry->id()];
+
+  // 0. In a parallel run, the neighbors of the first and last entry of
+  // a function may be changed by other threads. Move such an entry
+  // out of the function, and leave the unlinking to EndParallelRun().
+  // The links are unchanged, so iterating the function still stops
+  // at its new last entry. A function whose only entry is deleted keeps
+  // pointing to it until EndParallelRun() removes the function.
+  if (parallel_run_ && function != NULL &&
+      (function->first_entry() == entry || function->last_entry() == entry)) {
+    if (function->first_entry() == function->last_entry())
+      parallel_deleted_functions_.push_back(function);
+    else if (function->first_entry() == entry)
+      function->set_first_entry(entry->next());
+    else
+      function->set_last_entry(entry->prev());
+    entry_function_[entry->id()] = NULL;
+    parallel_deleted_entries_.push_back(entry);
+    MaoAnalysisManager::NoteChange();
+    return;
+  }
+
   // 1. Prev/next pointers around the entry
   MaoEntry *prev_entry = entry->prev();  // Possibly null
   MaoEntry *next_entry = entry->next();  // Possibly null
@@ -972,13 +1189,8 @@ void MaoUnit::DeleteEntry(MaoEntry *entry) {
   if (next_entry)
     next_entry->set_prev(prev_entry);
 
-  // 2. Remove it from entry_vector_
-  entry_vector_[entry->id()] = NULL;
-
-  // 3. Update function if needed
-  if (InFunction(entry)) {
-    Function *function = GetFunction(entry);
-    MAO_ASSERT(function);
+  // 2. Update function if needed
+  if (function) {
     // check if this function should be deleted altogether?
     if (function->first_entry() == function->last_entry()) {
       // TODO(martint): remove function!
@@ -993,22 +1205,22 @@ void MaoUnit::DeleteEntry(MaoEntry *entry) {
       MAO_ASSERT(GetFunction(prev_entry) == function);
       function->set_last_entry(prev_entry);
     }
-    // For now, we reset the cfg
-    // TODO(martint): Deallocate memory!
-    // function->set_cfg(NULL);
+    // The analyses of the function are dropped by the pass that
+    // deletes the entry once it finishes, see MaoAnalysisManager.
+    MaoAnalysisManager::NoteChange();
 
     Section *section = function->GetSection();
     if (MaoRelaxer::HasSizeMap(section)) {
-        std::map<MaoEntry *, int> *sizes =
-            MaoRelaxer::GetSizeMap(this, section);
+        MaoEntryIntMap *sizes = MaoRelaxer::GetSizeMap(this, section);
         MAO_ASSERT(sizes->find(entry) != sizes->end());
         sizes->erase(sizes->find(entry));
     }
   }
 
-  // 4. Update subsection if needed
-  if (InSubSection(entry)) {
-    SubSection *subsection = GetSubSection(entry);
+  // 3. Update subsection if needed
+  if (subsection) {
+    // The fragments kept by the relaxer do not know about deletions.
+    MaoRelaxer::InvalidateFragments(subsection->section());
     if (subsection->first_entry() == subsection->last_entry()) {
       // TODO(martint): remove subsection!
       MAO_ASSERT_MSG(false, "Not implemented. Remove subsection here.");
@@ -1024,20 +1236,114 @@ void MaoUnit::DeleteEntry(MaoEntry *entry) {
     }
   }
 
-  // 5. Update entry_to_*_ maps
-  if (InFunction(entry)) {
-    entry_to_function_.erase(entry_to_function_.find(entry));
-    MAO_ASSERT(!InFunction(entry));
-  }
-  if (InSubSection(entry)) {
-    entry_to_subsection_.erase(entry_to_subsection_.find(entry));
-    MAO_ASSERT(!InSubSection(entry));
-  }
+  // 4. Remove it from entry_vector_ and the side tables. The slot
+  // stays until CompactEntries() is called.
+  entry_vector_[entry->id()] = NULL;
+  entry_function_[entry->id()] = NULL;
+  entry_subsection_[entry->id()] = NULL;
+  ++deleted_entries_;
+  MAO_ASSERT(!InFunction(entry) && !InSubSection(entry));
 
-  // 6. Update labels map
+  // 5. Update labels map
   if (entry->IsLabel()) {
     LabelEntry *le = entry->AsLabel();
-    labels_.erase(labels_.find(le->name()));
+    labels_.Erase(le->name());
+  }
+}
+
+bool MaoUnit::CompactEntries() {
+  MaoMutexLock lock(&entry_mutex_);
+  MAO_ASSERT(!parallel_run_);
+
+  // Only renumber once at least a quarter of the slots are unused.
+  if (deleted_entries_ == 0 ||
+      4 * deleted_entries_ < static_cast<int>(entry_vector_.size()))
+    return false;
+
+  EntryID next_id = 0;
+  for (EntryID id = 0; id < static_cast<EntryID>(entry_vector_.size()); ++id) {
+    MaoEntry *entry = entry_vector_[id];
+    if (entry == NULL)
+      continue;
+    entry->set_id(next_id);
+    entry_vector_[next_id] = entry;
+    entry_function_[next_id] = entry_function_[id];
+    entry_subsection_[next_id] = entry_subsection_[id];
+    ++next_id;
+  }
+  compacted_entries_ += entry_vector_.size() - next_id;
+  entry_vector_.resize(next_id);
+  entry_function_.resize(next_id);
+  entry_subsection_.resize(next_id);
+  deleted_entries_ = 0;
+
+  // The size and offset maps are indexed by entry id.
+  for (SectionIterator iter = SectionBegin(); iter != SectionEnd(); ++iter)
+    MaoRelaxer::InvalidateSizeMap(*iter);
+  return true;
+}
+
+void MaoUnit::ReleaseEntries(MaoEmitter *out, MaoEntry *last) {
+  MaoMutexLock lock(&entry_mutex_);
+  MAO_ASSERT(!parallel_run_);
+
+  // Emit the entries in the order of EmitMaoUnit(). Entries are only
+  // added to the last subsection, so the released entries are a prefix
+  // of the output, and of every section.
+  EntryDumper entry_dumper;
+  std::vector<MaoEntry *> released;
+  bool found_last = false;
+  for (size_t i = released_subsections_;
+       i < sub_sections_.size() && !found_last; ++i) {
+    SubSection *ss = sub_sections_[i];
+    MaoEntry *entry = ss->first_entry();
+    while (entry != NULL && !found_last) {
+      MaoEntry *next = entry == ss->last_entry() ? NULL : entry->next();
+      entry_dumper.set_entry(entry);
+      entry->EmitEntry(out);
+      released.push_back(entry);
+      found_last = entry == last;
+      entry = next;
+    }
+    if (entry != NULL) {
+      ss->set_first_entry(entry);
+    } else {
+      ss->clear_entries();
+      // The last subsection may still get entries.
+      if (i == released_subsections_ && i + 1 < sub_sections_.size())
+        ++released_subsections_;
+    }
+    MaoRelaxer::InvalidateFragments(ss->section());
+    MaoRelaxer::InvalidateSizeMap(ss->section());
+  }
+  MAO_ASSERT(found_last || last == NULL);
+
+  // Drop the functions ending in a released entry. Their analyses refer
+  // to the entries.
+  std::set<MaoEntry *> released_set(released.begin(), released.end());
+  for (FunctionIterator iter = functions_.begin(); iter != functions_.end(); ) {
+    if (released_set.find((*iter)->last_entry()) != released_set.end()) {
+      delete *iter;
+      iter = functions_.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+
+  for (std::vector<MaoEntry *>::const_iterator iter = released.begin();
+       iter != released.end(); ++iter) {
+    MaoEntry *entry = *iter;
+    // Unlink the first remaining entry of the section.
+    MaoEntry *next_entry = entry->next();
+    if (next_entry && next_entry->prev() == entry)
+      next_entry->set_prev(NULL);
+    if (entry->IsLabel())
+      labels_.Erase(entry->AsLabel()->name());
+    entry_vector_[entry->id()] = NULL;
+    entry_function_[entry->id()] = NULL;
+    entry_subsection_[entry->id()] = NULL;
+    ++deleted_entries_;
+    delete entry;
   }
 }
 
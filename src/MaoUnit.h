@@ -37,13 +37,20 @@ extern "C" {
 
 #include "gen-opcodes.h"
 
+#include "MaoAnalysis.h"
+#include "MaoArena.h"
 #include "MaoDebug.h"
 #include "MaoDefs.h"
+#include "MaoEmitter.h"
 #include "MaoEntry.h"
 #include "MaoFunction.h"
+#include "MaoInstructionPool.h"
 #include "MaoOptions.h"
 #include "MaoSection.h"
 #include "MaoStats.h"
+#include "MaoStringMap.h"
+#include "MaoStringPool.h"
+#include "MaoThreads.h"
 
 #include "ir.h"
 #include "SymbolTable.h"
@@ -54,6 +61,7 @@ extern "C" {
 #define DEFAULT_SECTION_NAME ".text"
 
 class Function;
+class MaoStreamer;
 class MaoUnit;
 class Symbol;
 class SymbolTable;
@@ -185,6 +193,10 @@ class MaoUnit {
   void PrintMaoUnit() const;
   // Prints this MAO unit to FILE *out.
   void PrintMaoUnit(FILE *out) const;
+  // Emits this MAO unit in assembly syntax, see MaoEmitter. With more
+  // than one thread, chunks of the subsections are rendered in parallel
+  // and written in order, so the output is the same.
+  void EmitMaoUnit(MaoEmitter *out, int num_threads = 1) const;
   // Prints the IR of this unit. The flags controls what gets printed.
   void PrintIR(bool print_entries = true,
                bool print_sections = true,
@@ -207,6 +219,11 @@ class MaoUnit {
   class BBNameGen {
    public:
     static const char *GetUniqueName();
+    // Returns a name for a label inside the function. The name is built
+    // from the function id and a per-function counter, so that serial
+    // and parallel runs name the labels the same, whatever the order in
+    // which the functions are processed.
+    static const char *GetUniqueName(Function *function);
    private:
     static long i;
   };
@@ -215,6 +232,18 @@ class MaoUnit {
   // passed during the invocation of MAO.
   MaoOptions *mao_options() { return mao_options_; }
 
+  // The gas command line of the run, without the --mao= arguments.
+  void set_gas_arguments(int argc, const char **argv) {
+    gas_argc_ = argc;
+    gas_argv_ = argv;
+  }
+  int gas_argc() const { return gas_argc_; }
+  const char **gas_argv() const { return gas_argv_; }
+
+  // Guards the entries of the unit and the links between them while
+  // function passes run concurrently.
+  MaoMutex *entry_mutex() const { return &entry_mutex_; }
+
   // Returns an iterator that points to the first section in this unit.
   SectionIterator SectionBegin();
   // Returns an iterator that points after the last section in this unit.
@@ -239,6 +268,10 @@ class MaoUnit {
   // create_anonymous tells whether MAO has to create anonymous functions for
   // instructions not in any function.
   void FindFunctions(bool create_anonymous);
+  // Adds a function that spans the entries from first to last, both
+  // included, to functions_. Used when the boundaries are already
+  // known, e.g. when loading a saved unit (see MaoIRFile.h).
+  Function *AddFunction(const char *name, MaoEntry *first, MaoEntry *last);
 
   // Returns the function to which the given entry belongs.
   Function *GetFunction(MaoEntry *entry);
@@ -262,9 +295,60 @@ class MaoUnit {
   // Deletes the entry from the IR.
   void DeleteEntry(MaoEntry *entry);
 
+  // Deleted entries leave a NULL slot behind in the entry vector. Once
+  // enough of them have piled up, CompactEntries() closes the gaps and
+  // renumbers the remaining entries, keeping their relative order.
+  // This drops the relaxer's size and offset maps, which are indexed by
+  // entry id. The source ids of the entries (see MaoEntry::source_id())
+  // stay, so the source info comments of the output do not change.
+  // Returns true if the entries were renumbered. Must not be called
+  // during a parallel run.
+  bool CompactEntries();
+
+  // Streaming, see MaoStream.h. While a streamer is set, AddEntry()
+  // hands it every .size directive as it is parsed.
+  void set_streamer(MaoStreamer *streamer) { streamer_ = streamer; }
+  // Emits the entries that are not released yet, up to and including
+  // last, in output order, and releases them: the entries are deleted,
+  // and their labels and the functions ending in them are dropped. The
+  // sections and subsections stay. With last NULL, all the remaining
+  // entries are emitted and released.
+  void ReleaseEntries(MaoEmitter *out, MaoEntry *last);
+
+  // Support for running function passes on several threads.
+  //
+  // Entry creation and deletion, and the entry to function/subsection
+  // lookups, are safe to call concurrently. Between BeginParallelRun()
+  // and EndParallelRun(), each worker thread announces the function it
+  // works on with SetThreadFunction(). Entries created meanwhile are
+  // logged per function, and EndParallelRun() renumbers them in
+  // function order, so that entry ids are the same as in a serial run.
+  // Deleting the first or last entry of a function only moves it out
+  // of the function, since its neighbors may belong to functions other
+  // threads change. EndParallelRun() unlinks these entries.
+  void BeginParallelRun();
+  void SetThreadFunction(Function *function);
+  void EndParallelRun();
+
   // Returns statistics about the unit.
   Stats *GetStats() {return &stats_;}
 
+  // Returns the arena that holds the strings, and the private instruction
+  // copies and expressions of the entries in the unit.
+  MaoArena *GetArena() {return &arena_;}
+
+  // Returns the pool that interns the verbatim lines, and the label,
+  // symbol and function names of the unit.
+  MaoStringPool *GetStringPool() {return &strings_;}
+
+  // Returns the pool that holds the shared copies of the instructions
+  // of the unit.
+  MaoInstructionPool *GetInstructionPool() {return &instructions_;}
+
+  // Returns the analysis manager, which caches the analyses of the
+  // functions and sections in the unit.
+  MaoAnalysisManager *GetAnalyses() {return &analyses_;}
+
 
   // Returns true if the code is in 64 bit mode.
   bool Is64BitMode() const { return arch_ == X86_64; }
@@ -318,6 +402,9 @@ class MaoUnit {
 
   // Holds the function identified in the MaoUnit.
   FunctionVector  functions_;
+  // The id of the next function. Functions released by streaming are
+  // removed from functions_, their ids are not reused.
+  FunctionID next_function_id_;
 
   // Pointer to current subsection. Used when parsing the assembly file.
   SubSection *current_subsection_;
@@ -330,12 +417,55 @@ class MaoUnit {
   // One symbol table holds all symbols found in the assembly file.
   SymbolTable symbol_table_;
 
-  // Maps label-names to the corresponding label entry.
-  std::map<const char *, LabelEntry *, ltstr> labels_;
-
-  // Maps an entry to the corresponding Function and SubSection.
-  std::map<MaoEntry *, Function *>   entry_to_function_;
-  std::map<MaoEntry *, SubSection *> entry_to_subsection_;
+  // Maps label-names to the corresponding label entry. The keys are
+  // interned in strings_.
+  MaoStringMap<LabelEntry *> labels_;
+
+  // Maps an entry to the corresponding Function and SubSection. Both are
+  // indexed by entry id and kept the same size as entry_vector_. NULL
+  // means that the entry is not in a function (or subsection).
+  std::vector<Function *>   entry_function_;
+  std::vector<SubSection *> entry_subsection_;
+
+  // Number of NULL slots in entry_vector_, see CompactEntries().
+  int deleted_entries_;
+  // Number of slots CompactEntries() has removed so far. The source id
+  // of an entry is its id plus this number when it is created.
+  EntryID compacted_entries_;
+
+  // Set while streaming, see set_streamer().
+  MaoStreamer *streamer_;
+  // The subsections before this index in sub_sections_ are emptied by
+  // ReleaseEntries().
+  size_t released_subsections_;
+
+  // Guards entry_vector_, labels_ and the entry_function_/subsection_
+  // tables while function passes run concurrently. Recursive, since
+  // DeleteEntry() uses the lookup methods.
+  mutable MaoMutex entry_mutex_;
+
+  // Entries created by each function (indexed by function id) while a
+  // parallel run is active, and the first entry id of the run.
+  bool parallel_run_;
+  EntryID parallel_first_id_;
+  std::vector<std::vector<MaoEntry *> > parallel_created_entries_;
+  // Entries deleted at the boundary of a function during the run.
+  std::vector<MaoEntry *> parallel_deleted_entries_;
+  // Functions whose only entry was deleted during the run.
+  std::vector<Function *> parallel_deleted_functions_;
+
+  // Gives a newly created entry the next free id, adds it to the unit
+  // and maps it to function and subsection if they are not NULL.
+  void RegisterEntry(MaoEntry *entry, Function *function,
+                     SubSection *subsection);
+
+  // Returns true if entry is a live entry of this unit, i.e. its id
+  // indexes the side tables.
+  bool IsLiveEntry(const MaoEntry *entry) const {
+    return entry != NULL &&
+        entry->id() < static_cast<EntryID>(entry_vector_.size()) &&
+        entry_vector_[entry->id()] == entry;
+  }
 
   // Given an entry, return the name of the function it belongs to,
   // or "" if it is not in any function.
@@ -343,6 +473,8 @@ class MaoUnit {
   const char *SectionName(MaoEntry *entry) const;
 
   MaoOptions *mao_options_;
+  int gas_argc_;
+  const char **gas_argv_;
 
   // Called when found a new subsection reference in the assembly.
   // The following is done:
@@ -354,6 +486,13 @@ class MaoUnit {
                                unsigned int subsection_number, MaoEntry *entry);
 
   Stats stats_;
+
+  MaoAnalysisManager analyses_;
+
+  // Must outlive the entries, which are deleted by the destructor.
+  MaoArena arena_;
+  MaoStringPool strings_;
+  MaoInstructionPool instructions_;
 };  // MaoUnit
 
 
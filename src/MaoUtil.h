@@ -20,6 +20,12 @@
 
 #include <string.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include <cstdarg>
 #include <set>
 #include <string>
@@ -39,8 +45,16 @@ struct ltstr {
 
 // BitString implementation.
 //
+// Bit strings of up to kInlineBits bits, which covers all register
+// masks, keep their words inside the object and never allocate.
+// Longer bit strings (e.g., in reaching definitions) use the heap.
+// The set operations use SSE2 (or AVX2, if enabled at compile time)
+// kernels, see the BitStringKernels class below.
+//
 class BitString {
  public:
+  static const int kInlineBits = 256;
+
   explicit BitString(int number_of_bits) {
     InitObj(number_of_bits);
   }
@@ -61,7 +75,7 @@ class BitString {
      number_of_words_ = number_of_words;
      number_of_bits_ = number_of_bits;
 
-     word_ = new unsigned long long[number_of_words_];
+     AllocateWords();
 
      va_start(vl, number_of_words);
      for (int i = 0; i < number_of_words_; ++i) {
@@ -75,18 +89,30 @@ class BitString {
 
   // Copy constructor performs a deep copy.
   BitString(const BitString& b) {
-    CopyObj(b);
+    number_of_bits_ = b.number_of_bits_;
+    number_of_words_ = b.number_of_words_;
+    AllocateWords();
+    CopyWords(b);
   }
 
-  // Assignment performs a deep copy.
+  // Assignment performs a deep copy. The storage is reused if the
+  // sizes match.
   BitString& operator = (const BitString& other) {
-    CopyObj(other);
+    if (this == &other)
+      return *this;
+    if (number_of_words_ != other.number_of_words_) {
+      FreeWords();
+      number_of_words_ = other.number_of_words_;
+      AllocateWords();
+    }
+    number_of_bits_ = other.number_of_bits_;
+    CopyWords(other);
     return *this;
   }
 
   ~BitString() {
     MAO_ASSERT(word_);
-    delete[] word_;
+    FreeWords();
   }
 
   void Set(int index) {
@@ -122,11 +148,10 @@ class BitString {
     unsigned int word_pos = from_index/(sizeof(unsigned long long) * 8);
     unsigned int bit_pos = from_index%(sizeof(unsigned long long) * 8);
     while ((int) word_pos < number_of_words_) {
-      while (word_[word_pos] && (bit_pos < (sizeof(unsigned long long) * 8))) {
-        if (word_[word_pos]&(1ULL << bit_pos))
-          return word_pos*sizeof(unsigned long long)*8+bit_pos;
-        bit_pos++;
-      }
+      unsigned long long word = bit_pos == 0 ? word_[word_pos] :
+          word_[word_pos] & (~0ULL << bit_pos);
+      if (word)
+        return word_pos*sizeof(unsigned long long)*8 + __builtin_ctzll(word);
       word_pos++;
       bit_pos = 0;
     }
@@ -142,26 +167,43 @@ class BitString {
   // Union
   BitString operator |(const BitString &b) const {
     MAO_ASSERT(b.number_of_bits() == number_of_bits_);
-    BitString bs_new(number_of_bits_);
-    for (int i = 0; i < number_of_words_; ++i) {
-      bs_new.word_[i] = word_[i] | b.word_[i];
-    }
+    BitString bs_new(number_of_bits_, kNoInit);
+    BitStringKernels::Or(bs_new.word_, word_, b.word_, number_of_words_);
     return bs_new;
   }
 
   // Intersect
   BitString operator &(const BitString &b) const {
     MAO_ASSERT(b.number_of_bits() == number_of_bits_);
-    BitString bs_new(number_of_bits_);
-    for (int i = 0; i < number_of_words_; ++i) {
-      bs_new.word_[i] = word_[i] & b.word_[i];
-    }
+    BitString bs_new(number_of_bits_, kNoInit);
+    BitStringKernels::And(bs_new.word_, word_, b.word_, number_of_words_);
     return bs_new;
   }
 
+  // In-place union
+  BitString &operator |=(const BitString &b) {
+    MAO_ASSERT(b.number_of_bits() == number_of_bits_);
+    BitStringKernels::Or(word_, word_, b.word_, number_of_words_);
+    return *this;
+  }
+
+  // In-place intersect
+  BitString &operator &=(const BitString &b) {
+    MAO_ASSERT(b.number_of_bits() == number_of_bits_);
+    BitStringKernels::And(word_, word_, b.word_, number_of_words_);
+    return *this;
+  }
+
+  // In-place remove bits
+  BitString &operator -=(const BitString &b) {
+    MAO_ASSERT(b.number_of_bits() == number_of_bits_);
+    BitStringKernels::AndNot(word_, word_, b.word_, number_of_words_);
+    return *this;
+  }
+
   // Flip the bits
   BitString operator ~() const {
-    BitString bs_new(number_of_bits_);
+    BitString bs_new(number_of_bits_, kNoInit);
     for (int i = 0; i < number_of_words_; ++i) {
       bs_new.word_[i] = ~word_[i];
     }
@@ -174,20 +216,14 @@ class BitString {
   // Remove bits
   BitString operator -(const BitString &b) const {
     MAO_ASSERT(b.number_of_bits() == number_of_bits_);
-    BitString bs_new(number_of_bits_);
-    for (int i = 0; i < number_of_words_; ++i) {
-      bs_new.word_[i] = word_[i] & ~b.word_[i];
-    }
+    BitString bs_new(number_of_bits_, kNoInit);
+    BitStringKernels::AndNot(bs_new.word_, word_, b.word_, number_of_words_);
     return bs_new;
   }
 
   bool operator == (const BitString &b) const {
     MAO_ASSERT(b.number_of_bits() == number_of_bits_);
-    for (int i = 0; i < number_of_words_; ++i) {
-      if (word_[i] != b.word_[i])
-        return false;
-    }
-    return true;
+    return BitStringKernels::Equal(word_, b.word_, number_of_words_);
   }
 
   bool operator != (const BitString &b) const {
@@ -203,11 +239,7 @@ class BitString {
   }
 
   bool IsNonNull() const {
-    for (int i = 0; i < number_of_words_; ++i) {
-      if (word_[i] != 0)
-        return true;
-    }
-    return false;
+    return !IsNull();
   }
 
   bool IsUndef() const {
@@ -269,37 +301,52 @@ class BitString {
 
   // Return the number of set bits in the bitstring.
   int NumOfBitsSet() const {
-    int c = 0; // c accumulates the total bits set.
-    // Process one byte at the time.
-    for (int i = 0; i < number_of_words_; ++i) {
-      unsigned long long v = word_[i];
-      // Loop one iteration for each bit set in v.
-      for (; v; c++)
-      {
-        // Clear the least significant set bit in v.
-        v &= v - 1;
-      }
-    }
-    return c;
+    return BitStringKernels::PopCount(word_, number_of_words_);
   }
 
   int number_of_bits() const {return number_of_bits_;}
 
  private:
+  static const int kInlineWords =
+      kInlineBits / (sizeof(unsigned long long) * 8);
+
+  // Tag for the constructor that leaves the words uninitialized.
+  enum NoInit { kNoInit };
+  BitString(int number_of_bits, NoInit) {
+    MAO_ASSERT(number_of_bits > 0);
+    number_of_bits_ = number_of_bits;
+    number_of_words_ = (number_of_bits-1)/(sizeof(unsigned long long) * 8)
+        + 1;
+    AllocateWords();
+  }
+
   // Implementation assumes that unused bits in word_ are always set to 0.
   // Special case is the Undefined value, then all words are set to -1ULL.
+  // Points to inline_word_, unless the bit string is longer than
+  // kInlineBits.
   unsigned long long *word_;
+  unsigned long long inline_word_[kInlineWords];
   // Number of bits in the bit-string.
   int number_of_bits_;
   // Number of words used to represent the bit-string.
   int number_of_words_;
 
-  void CopyObj(const BitString& b) {
-    number_of_bits_ = b.number_of_bits_;
-    number_of_words_ = b.number_of_words_;
-    word_ = new unsigned long long[number_of_words_];
-    for (int i = 0; i < number_of_words_; ++i)
-      word_[i] = b.word_[i];
+  void AllocateWords() {
+    if (number_of_words_ <= kInlineWords)
+      word_ = inline_word_;
+    else
+      word_ = new unsigned long long[number_of_words_];
+  }
+
+  void FreeWords() {
+    if (word_ != inline_word_)
+      delete[] word_;
+    word_ = NULL;
+  }
+
+  void CopyWords(const BitString& b) {
+    MAO_ASSERT(number_of_words_ == b.number_of_words_);
+    memcpy(word_, b.word_, number_of_words_ * sizeof(unsigned long long));
   }
 
   void InitObj(int number_of_bits) {
@@ -307,7 +354,7 @@ class BitString {
     number_of_bits_ = number_of_bits;
     number_of_words_ = (number_of_bits-1)/(sizeof(unsigned long long) * 8)
         + 1;
-    word_ = new unsigned long long[number_of_words_];
+    AllocateWords();
     for (int i = 0; i < number_of_words_; i++)
       word_[i] = 0;
   }
@@ -317,11 +364,9 @@ class BitString {
   //  - NextSetBit(), ==, IsNull(), IsNonNull()
   void ClearUnusedBits() {
     // Zero the unused bits.
-    int unused_bits = sizeof(unsigned long long)*8 -
-        number_of_bits_ % (sizeof(unsigned long long)*8);
-    for (int i = 0; i < unused_bits; ++i) {
-      Clear(number_of_bits_ + i);
-    }
+    int used_bits = number_of_bits_ % (sizeof(unsigned long long)*8);
+    if (used_bits != 0)
+      word_[number_of_words_ - 1] &= (1ULL << used_bits) - 1;
   }
 
   void VerifyBitString() {
@@ -333,14 +378,111 @@ class BitString {
 #endif
     if (!IsUndef()) {
       // Assert that all unused bits are zero.
-      int unused_bits = sizeof(unsigned long long)*8 -
-          number_of_bits_ % (sizeof(unsigned long long)*8);
-      unused_bits = unused_bits % (sizeof(unsigned long long)*8);
-      for (int i = 0; i < unused_bits; ++i) {
-        MAO_ASSERT(Get(number_of_bits_ + i) == false);
-      }
+      int used_bits = number_of_bits_ % (sizeof(unsigned long long)*8);
+      if (used_bits != 0)
+        MAO_ASSERT((word_[number_of_words_ - 1] >> used_bits) == 0);
     }
   }
+
+  // Word-array kernels behind the set operations. The destination
+  // may alias a source.
+  class BitStringKernels {
+   public:
+    static void Or(unsigned long long *dst, const unsigned long long *a,
+                   const unsigned long long *b, int n) {
+      int i = 0;
+#if defined(__AVX2__)
+      for (; i + 4 <= n; i += 4)
+        Store256(dst + i, _mm256_or_si256(Load256(a + i), Load256(b + i)));
+#endif
+#if defined(__SSE2__)
+      for (; i + 2 <= n; i += 2)
+        Store128(dst + i, _mm_or_si128(Load128(a + i), Load128(b + i)));
+#endif
+      for (; i < n; ++i)
+        dst[i] = a[i] | b[i];
+    }
+
+    static void And(unsigned long long *dst, const unsigned long long *a,
+                    const unsigned long long *b, int n) {
+      int i = 0;
+#if defined(__AVX2__)
+      for (; i + 4 <= n; i += 4)
+        Store256(dst + i, _mm256_and_si256(Load256(a + i), Load256(b + i)));
+#endif
+#if defined(__SSE2__)
+      for (; i + 2 <= n; i += 2)
+        Store128(dst + i, _mm_and_si128(Load128(a + i), Load128(b + i)));
+#endif
+      for (; i < n; ++i)
+        dst[i] = a[i] & b[i];
+    }
+
+    // dst = a & ~b
+    static void AndNot(unsigned long long *dst, const unsigned long long *a,
+                       const unsigned long long *b, int n) {
+      int i = 0;
+#if defined(__AVX2__)
+      for (; i + 4 <= n; i += 4)
+        Store256(dst + i, _mm256_andnot_si256(Load256(b + i), Load256(a + i)));
+#endif
+#if defined(__SSE2__)
+      for (; i + 2 <= n; i += 2)
+        Store128(dst + i, _mm_andnot_si128(Load128(b + i), Load128(a + i)));
+#endif
+      for (; i < n; ++i)
+        dst[i] = a[i] & ~b[i];
+    }
+
+    static bool Equal(const unsigned long long *a,
+                      const unsigned long long *b, int n) {
+      int i = 0;
+#if defined(__AVX2__)
+      for (; i + 4 <= n; i += 4) {
+        __m256i diff = _mm256_xor_si256(Load256(a + i), Load256(b + i));
+        if (!_mm256_testz_si256(diff, diff))
+          return false;
+      }
+#endif
+#if defined(__SSE2__)
+      for (; i + 2 <= n; i += 2) {
+        __m128i eq = _mm_cmpeq_epi8(Load128(a + i), Load128(b + i));
+        if (_mm_movemask_epi8(eq) != 0xFFFF)
+          return false;
+      }
+#endif
+      for (; i < n; ++i) {
+        if (a[i] != b[i])
+          return false;
+      }
+      return true;
+    }
+
+    static int PopCount(const unsigned long long *a, int n) {
+      int c = 0;
+      for (int i = 0; i < n; ++i)
+        c += __builtin_popcountll(a[i]);
+      return c;
+    }
+
+   private:
+#if defined(__SSE2__)
+    static __m128i Load128(const unsigned long long *p) {
+      return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    }
+    static void Store128(unsigned long long *p, __m128i v) {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v);
+    }
+#endif
+#if defined(__AVX2__)
+    static __m256i Load256(const unsigned long long *p) {
+      return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    }
+    static void Store256(unsigned long long *p, __m256i v) {
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v);
+    }
+#endif
+  };
 };
 
 namespace MaoUtil {
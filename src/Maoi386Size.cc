@@ -164,7 +164,7 @@ std::pair<int, bool> X86InstructionSizeHelper::SizeOfInstruction(
     size = SizeOfIntersegJump(flag);
   } else {
     /* Output normal instructions here.  */
-    unsigned char *q;
+    const unsigned char *q;
     unsigned int j;
 
     /* Since the VEX prefix contains the implicit prefix, we don't
@@ -17,28 +17,36 @@
 //   51 Franklin Street, Fifth Floor,
 //   Boston, MA  02110-1301, USA.
 
+#include <algorithm>
+
 #include "Mao.h"
 
-SymbolTable::SymbolTable() {
-  table_.clear();
+SymbolTable::SymbolTable(MaoStringPool *strings) : strings_(strings) {
 }
 
 SymbolTable::~SymbolTable() {
   // we should clear the entries here.
   // when added, they are allocated with new!
-  for (std::map<const char*, Symbol *, ltstr>::iterator iter = table_.begin();
-      iter != table_.end(); ++iter) {
-    delete iter->second;
+  for (SymbolVector::iterator iter = symbols_.begin();
+      iter != symbols_.end(); ++iter) {
+    delete *iter;
   }
 }
 
+Symbol *SymbolTable::Lookup(const char *name) const {
+  // A name that was never interned can not be a symbol.
+  return index_.Find(strings_->Find(name));
+}
+
 bool SymbolTable::Exists(const char *name) {
-  std::map<const char*, Symbol *, ltstr>::const_iterator it = table_.find(name);
-  return it != table_.end();
+  return Lookup(name) != NULL;
 }
 
 Symbol *SymbolTable::Add(Symbol *symbol) {
-  table_[symbol->name()] = symbol;
+  MAO_ASSERT(strings_->Find(symbol->name()) == symbol->name());
+  MAO_RASSERT_MSG(index_.Insert(symbol->name(), symbol),
+                  "Symbol %s already defined", symbol->name());
+  symbols_.push_back(symbol);
   return symbol;
 }
 
@@ -46,11 +54,17 @@ void SymbolTable::Print() const {
   Print(stdout);
 }
 
+// Orders symbols by name, for the printed symbol table.
+static bool SymbolNameLess(const Symbol *s1, const Symbol *s2) {
+  return strcmp(s1->name(), s2->name()) < 0;
+}
+
 void SymbolTable::Print(FILE *out) const {
-  for (std::map<const char*, Symbol *, ltstr>::const_iterator iter =
-           table_.begin();
-      iter != table_.end(); ++iter) {
-    Symbol *symbol = iter->second;
+  SymbolVector sorted(symbols_);
+  std::sort(sorted.begin(), sorted.end(), SymbolNameLess);
+  for (SymbolVector::const_iterator iter = sorted.begin();
+      iter != sorted.end(); ++iter) {
+    Symbol *symbol = *iter;
     fprintf(out, "\t# ");
     fprintf(out, " [%3d] ", symbol->id());
     fprintf(out, " %-10s", symbol->name());
@@ -80,36 +94,35 @@ void SymbolTable::Print(FILE *out) const {
 
 
 Symbol *SymbolTable::Find(const char *name) {
-  std::map<const char*, Symbol *, ltstr>::const_iterator it = table_.find(name);
-  MAO_ASSERT(it != table_.end() );
-  return it->second;
+  Symbol *symbol = Lookup(name);
+  MAO_ASSERT(symbol != NULL);
+  return symbol;
 }
 
 Symbol *SymbolTable::FindOrCreateAndFind(const char *name,
                                          const Section *section) {
-  if (!Exists(name)) {
+  Symbol *symbol = Lookup(name);
+  if (symbol == NULL) {
     // TODO(martint): use ID factory
-    return Add(new Symbol(name, Size(), section));
-  } else {
-    return Find(name);
+    symbol = Add(new Symbol(strings_->Intern(name), Size(), section));
   }
-  MAO_RASSERT(1);
+  return symbol;
 }
 
 SymbolIterator SymbolTable::Begin() {
-  return SymbolIterator(table_.begin());
+  return SymbolIterator(symbols_.begin());
 }
 
 SymbolIterator SymbolTable::End() {
-  return SymbolIterator(table_.end());
+  return SymbolIterator(symbols_.end());
 }
 
 SymbolTable::ConstSymbolIterator SymbolTable::ConstBegin() const {
-  return table_.begin();
+  return symbols_.begin();
 }
 
 SymbolTable::ConstSymbolIterator SymbolTable::ConstEnd() const {
-  return table_.end();
+  return symbols_.end();
 }
 
 
@@ -118,7 +131,7 @@ SymbolTable::ConstSymbolIterator SymbolTable::ConstEnd() const {
 //
 
 Symbol *&SymbolIterator::operator *() const {
-  return symbol_iter_->second;
+  return *symbol_iter_;
 }
 
 SymbolIterator &SymbolIterator::operator ++() {
@@ -146,7 +159,8 @@ bool SymbolIterator::operator !=(const SymbolIterator &other) const {
 Symbol::Symbol(const char *name, SymbolID id, const Section *section,
                const SymbolVisibility symbol_visibility,
                const SymbolType symbol_type)
-    : id_(id),
+    : name_(name),
+      id_(id),
       symbol_type_(symbol_type),
       size_(0),
       symbol_visibility_(symbol_visibility),
@@ -155,13 +169,10 @@ Symbol::Symbol(const char *name, SymbolID id, const Section *section,
       common_align_(0),
       section_(section) {
   MAO_ASSERT(strlen(name) < kMaxSymbolLength);
-  name_ = strdup(name);
   equals_.clear();
 }
 
 Symbol::~Symbol() {
-  MAO_ASSERT(name_);
-  free(name_);
 }
 
 SymbolVisibility Symbol::symbol_visibility() const {
@@ -18,19 +18,13 @@
 #ifndef SYMBOLTABLE_H_
 #define SYMBOLTABLE_H_
 
-#include <map>
 #include <vector>
 
 #include "irlink.h"
+#include "MaoStringMap.h"
 
 class SymbolIterator;
 
-struct cltstr {
-  bool operator()(const char* s1, const char* s2) const {
-    return strcmp(s1, s2) < 0;
-  }
-};
-
 typedef int SymbolID;
 
 // TODO(martint):
@@ -41,7 +35,8 @@ typedef int SymbolID;
 // Create iterators for the symboltable
 
 class Symbol {
-  // allocates memory INSIDE the constructor!
+  // The name is not copied, it must be interned in the string pool of
+  // the unit (see MaoStringPool).
  public:
   Symbol(const char *name, SymbolID id, const Section *section,
          SymbolVisibility symbol_visibility = LOCAL,
@@ -79,8 +74,8 @@ class Symbol {
 //   std::vector<Symbol *> *GetEquals() { return &equals_; }
 
  private:
-  // Dynamically allocated, thus not a constant.
-  char *name_;
+  // Interned in the string pool of the unit.
+  const char *const name_;
   SymbolID  id_;
   // Type of symbol. See irlink.h for list of types
   SymbolType symbol_type_;
@@ -104,10 +99,17 @@ class Symbol {
 
 
 // Symbol table
+// Symbols are indexed by their interned names (see MaoStringMap), and
+// kept in a vector in the order they were added, which is also the
+// order of their ids. Iteration follows that order. Print() sorts the
+// symbols by name.
 class SymbolTable {
  public:
-  SymbolTable();
+  // New symbols get their names interned in strings.
+  explicit SymbolTable(MaoStringPool *strings);
   ~SymbolTable();
+  // Adds a symbol. The name of the symbol must be interned, and must not
+  // be in the table already.
   Symbol *Add(Symbol *symbol);
   bool Exists(const char *name);
   // Returns a pointer to a symbol with the given name. Creates it if it does
@@ -116,13 +118,13 @@ class SymbolTable {
   // Returns a pointer a symbol with the given name. Assumes such a symbol
   // exists.
   Symbol *Find(const char *name);
-  // Prints out the symbol table.
+  // Prints out the symbol table, sorted by name.
   void Print() const;
   void Print(FILE *out) const;
 
-  int Size() const {return table_.size();}
-  typedef std::map<const char *, Symbol *, cltstr> SymbolMap;
-  typedef SymbolMap::const_iterator                ConstSymbolIterator;
+  int Size() const {return symbols_.size();}
+  typedef std::vector<Symbol *>       SymbolVector;
+  typedef SymbolVector::const_iterator ConstSymbolIterator;
 
   SymbolIterator Begin();
   SymbolIterator End();
@@ -130,15 +132,21 @@ class SymbolTable {
   ConstSymbolIterator ConstEnd() const;
 
  private:
-  // Used for the map of symbols
-  SymbolMap table_;
+  // Returns the symbol with the given name, or NULL.
+  Symbol *Lookup(const char *name) const;
+
+  MaoStringPool *const strings_;
+  // The symbols, indexed by id.
+  SymbolVector symbols_;
+  // Maps interned names to symbols.
+  MaoStringMap<Symbol *> index_;
 };
 
 
 // Iterator wrapper for iterating over all the Symbols in a MaoUnit.
 class SymbolIterator {
  public:
-  explicit SymbolIterator(SymbolTable::SymbolMap::iterator symbol_iter)
+  explicit SymbolIterator(SymbolTable::SymbolVector::iterator symbol_iter)
       : symbol_iter_(symbol_iter) { }
   Symbol *&operator *() const;
   SymbolIterator &operator ++();
@@ -146,7 +154,7 @@ class SymbolIterator {
   bool operator ==(const SymbolIterator &other) const;
   bool operator !=(const SymbolIterator &other) const;
  private:
-  SymbolTable::SymbolMap::iterator symbol_iter_;
+  SymbolTable::SymbolVector::iterator symbol_iter_;
 };
 
 
@@ -0,0 +1,383 @@
+/* input_file.c - Deal with Input Files -
+   Copyright 1987, 1990, 1991, 1992, 1993, 1994, 1995, 1999, 2000, 2001,
+   2002, 2003, 2005, 2006, 2007, 2009
+   Free Software Foundation, Inc.
+
+   This file is part of GAS, the GNU Assembler.
+
+   GAS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   GAS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GAS; see the file COPYING.  If not, write to the Free
+   Software Foundation, 51 Franklin Street - Fifth Floor, Boston, MA
+   02110-1301, USA.  */
+
+/* Confines all details of reading source bytes to this module.
+   All O/S specific crocks should live here.
+   What we lose in "efficiency" we gain in modularity.
+   Note we don't need to #include the "as.h" file. No common coupling!  */
+
+/* MAO: Unlike the gas version, the whole input file is mapped into
+   memory (or, for pipes and standard input, read into one buffer)
+   when it is opened.  The buffers handed to input-scrub.c are then
+   copied straight out of the mapping, without going through stdio.  */
+
+#include "as.h"
+#include "input-file.h"
+#include "safe-ctype.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* This variable is non-zero if the file currently being read should be
+   preprocessed by app.  It is zero if the file can be read straight in.  */
+int preprocess = 0;
+
+/* This code opens a file, then delivers BUFFER_SIZE character
+   chunks of the file on demand.
+   BUFFER_SIZE is supposed to be a number chosen for speed.
+   The caller only asks once what BUFFER_SIZE is, and asks before
+   the nature of the input files (if any) is known.  */
+
+#define BUFFER_SIZE (32 * 1024)
+
+/* The contents of the current file, and the read position in it.  */
+static char *file_start;
+static char *file_pos;
+static char *file_end;
+/* Non-zero if file_start is mmap'ed, zero if it is xmalloc'ed.  */
+static int file_mapped;
+/* Non-zero while a file is open.  */
+static int file_open;
+
+static char *file_name;
+
+/* Struct for saving the state of this module for file includes.  */
+struct saved_file
+  {
+    char *file_start;
+    char *file_pos;
+    char *file_end;
+    int file_mapped;
+    int file_open;
+    char *file_name;
+    int preprocess;
+    char *app_save;
+  };
+
+/* These hooks accommodate most operating systems.  */
+
+void
+input_file_begin (void)
+{
+  file_open = 0;
+}
+
+void
+input_file_end (void)
+{
+}
+
+/* Return BUFFER_SIZE.  */
+unsigned int
+input_file_buffer_size (void)
+{
+  return (BUFFER_SIZE);
+}
+
+/* Push the state of our input, returning a pointer to saved info that
+   can be restored with input_file_pop ().  */
+
+char *
+input_file_push (void)
+{
+  register struct saved_file *saved;
+
+  saved = (struct saved_file *) xmalloc (sizeof *saved);
+
+  saved->file_start = file_start;
+  saved->file_pos = file_pos;
+  saved->file_end = file_end;
+  saved->file_mapped = file_mapped;
+  saved->file_open = file_open;
+  saved->file_name = file_name;
+  saved->preprocess = preprocess;
+  if (preprocess)
+    saved->app_save = app_push ();
+
+  /* Initialize for new file.  */
+  input_file_begin ();
+
+  return (char *) saved;
+}
+
+void
+input_file_pop (char *arg)
+{
+  register struct saved_file *saved = (struct saved_file *) arg;
+
+  input_file_end ();		/* Close out old file.  */
+
+  file_start = saved->file_start;
+  file_pos = saved->file_pos;
+  file_end = saved->file_end;
+  file_mapped = saved->file_mapped;
+  file_open = saved->file_open;
+  file_name = saved->file_name;
+  preprocess = saved->preprocess;
+  if (preprocess)
+    app_pop (saved->app_save);
+
+  free (arg);
+}
+
+/* Read all of FD into an xmalloc'ed buffer.  Used for input that can
+   not be mapped, e.g. pipes.  Returns zero on a read error.  */
+
+static int
+input_file_read_all (int fd)
+{
+  size_t size = 0;
+  size_t allocated = BUFFER_SIZE;
+  char *buffer = (char *) xmalloc (allocated);
+
+  for (;;)
+    {
+      ssize_t got;
+
+      if (size == allocated)
+	{
+	  allocated *= 2;
+	  buffer = (char *) xrealloc (buffer, allocated);
+	}
+      got = read (fd, buffer + size, allocated - size);
+      if (got < 0 && errno == EINTR)
+	continue;
+      if (got < 0)
+	{
+	  free (buffer);
+	  return 0;
+	}
+      if (got == 0)
+	break;
+      size += got;
+    }
+
+  file_start = buffer;
+  file_end = buffer + size;
+  file_mapped = 0;
+  return 1;
+}
+
+/* Map the regular file FD into memory.  The mapping is private and
+   writable, so that the first line can be patched like the gas
+   version does with ungetc ().  Falls back to reading the file.  */
+
+static int
+input_file_map (int fd)
+{
+  struct stat st;
+  void *map;
+
+  if (fstat (fd, &st) != 0 || !S_ISREG (st.st_mode) || st.st_size == 0)
+    return input_file_read_all (fd);
+
+  map = mmap (NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED)
+    return input_file_read_all (fd);
+#ifdef MADV_SEQUENTIAL
+  madvise (map, st.st_size, MADV_SEQUENTIAL);
+#endif
+
+  file_start = (char *) map;
+  file_end = file_start + st.st_size;
+  file_mapped = 1;
+  return 1;
+}
+
+/* Read at most BUFLEN - 1 characters of the current line, like fgets ()
+   does, into BUF.  Returns zero at the end of the file.  */
+
+static int
+input_file_gets (char *buf, size_t buflen)
+{
+  size_t n = 0;
+
+  if (file_pos == file_end)
+    return 0;
+  while (n < buflen - 1 && file_pos < file_end)
+    {
+      buf[n] = *file_pos++;
+      if (buf[n++] == '\n')
+	break;
+    }
+  buf[n] = '\0';
+  return 1;
+}
+
+/* Put back the character C, like ungetc ().  */
+
+static void
+input_file_ungetc (int c)
+{
+  gas_assert (file_pos > file_start);
+  *--file_pos = c;
+}
+
+void
+input_file_open (char *filename, /* "" means use stdin. Must not be 0.  */
+		 int pre)
+{
+  int c;
+  char buf[80];
+  int fd;
+
+  preprocess = pre;
+
+  gas_assert (filename != 0);	/* Filename may not be NULL.  */
+  if (filename[0])
+    {
+      fd = open (filename, O_RDONLY);
+      file_name = filename;
+    }
+  else
+    {
+      /* Use stdin for the input file.  */
+      fd = fileno (stdin);
+      /* For error messages.  */
+      file_name = _("{standard input}");
+    }
+
+  if (fd < 0)
+    {
+      as_bad (_("can't open %s for reading: %s"),
+	      file_name, xstrerror (errno));
+      return;
+    }
+
+  if (!input_file_map (fd))
+    {
+      as_bad (_("can't read from %s: %s"),
+	      file_name, xstrerror (errno));
+      if (filename[0])
+	close (fd);
+      return;
+    }
+  /* The mapping stays valid after the descriptor is closed.  */
+  if (filename[0])
+    close (fd);
+
+  file_pos = file_start;
+  file_open = 1;
+
+  c = file_pos < file_end ? *file_pos++ : EOF;
+
+  if (c == '#')
+    {
+      /* Begins with comment, may not want to preprocess.  */
+      c = file_pos < file_end ? *file_pos++ : EOF;
+      if (c == 'N')
+	{
+	  buf[0] = '\0';
+	  if (input_file_gets (buf, sizeof (buf))
+	      && !strncmp (buf, "O_APP", 5) && ISSPACE (buf[5]))
+	    preprocess = 0;
+	  if (!strchr (buf, '\n'))
+	    input_file_ungetc ('#');	/* It was longer.  */
+	  else
+	    input_file_ungetc ('\n');
+	}
+      else if (c == 'A')
+	{
+	  buf[0] = '\0';
+	  if (input_file_gets (buf, sizeof (buf))
+	      && !strncmp (buf, "PP", 2) && ISSPACE (buf[2]))
+	    preprocess = 1;
+	  if (!strchr (buf, '\n'))
+	    input_file_ungetc ('#');
+	  else
+	    input_file_ungetc ('\n');
+	}
+      else if (c == '\n')
+	input_file_ungetc ('\n');
+      else
+	input_file_ungetc ('#');
+    }
+  else if (c != EOF)
+    --file_pos;
+}
+
+/* Close input file.  */
+
+void
+input_file_close (void)
+{
+  if (!file_open)
+    return;
+  if (file_mapped)
+    munmap (file_start, file_end - file_start);
+  else
+    free (file_start);
+  file_start = file_pos = file_end = NULL;
+  file_open = 0;
+}
+
+/* This function is passed to do_scrub_chars.  */
+
+static size_t
+input_file_get (char *buf, size_t buflen)
+{
+  size_t size = file_end - file_pos;
+
+  if (size > buflen)
+    size = buflen;
+  memcpy (buf, file_pos, size);
+  file_pos += size;
+  return size;
+}
+
+/* Read a buffer from the input file.  */
+
+char *
+input_file_give_next_buffer (char *where /* Where to place 1st character of new buffer.  */)
+{
+  char *return_value;		/* -> Last char of what we read, + 1.  */
+  size_t size;
+
+  if (!file_open)
+    return 0;
+  /* fflush (stdin); could be done here if you want to synchronise
+     stdin and stdout, for the case where our input file is stdin.
+     Since the assembler shouldn't do any output to stdout, we
+     don't bother to synch output and input.  */
+  if (preprocess)
+    size = do_scrub_chars (input_file_get, where, BUFFER_SIZE);
+  else
+    size = input_file_get (where, BUFFER_SIZE);
+
+  if (size)
+    return_value = where + size;
+  else
+    {
+      input_file_close ();
+      return_value = 0;
+    }
+
+  return return_value;
+}
+
+int
+input_file_is_open (void)
+{
+  return file_open;
+}
@@ -18,18 +18,22 @@
 #include <stdio.h>
 #include <string.h>
 
-#include "Mao.h"
-
-//==================================
-// MAO Main Entry
-//==================================
-int main(int argc, const char *argv[]) {
-  InitPasses();
+#include <vector>
 
+#include "Mao.h"
+#include "MaoBatch.h"
+#include "MaoCache.h"
+#include "MaoServer.h"
+#include "MaoStream.h"
+
+// Runs MAO on one command line. The passes and the register tables are
+// initialized once, in main(), so that a server can run many command
+// lines (see MaoServer.h and MaoBatch.h).
+static int RunMao(int argc, const char *argv[]) {
   MaoOptions mao_options;
 
   // Parse any mao-specific command line flags (start with --mao=)
-  const char **new_argv = new const char*[argc];
+  std::vector<const char *> new_argv(argc);
   int    new_argc = 0;
   int    gas_help_requested = false;
 
@@ -57,26 +61,90 @@ int main(int argc, const char *argv[]) {
     fprintf(stdout, "\nAssembler specific options:\n\n");
   }
 
-  InitRegisters();
+  // The static options are only complete once all the option strings
+  // are parsed together.
+  mao_options.Reparse();
+
+  // BATCH=i[list] runs this command line once for every input.
+  MaoOptionMap *batch_options = GetStaticOptionPass("BATCH");
+  if (MaoBatchRequested(batch_options))
+    return RunMaoBatch(argc, argv, batch_options, RunMao);
 
   MaoUnit mao_unit(&mao_options);
   RegisterMaoUnit(&mao_unit);
+  mao_unit.set_gas_arguments(new_argc, &new_argv[0]);
 
   MaoPassManager mao_pass_man(&mao_unit);
-  mao_pass_man.LinkPass(new ReadInputPass(new_argc, new_argv,
-                                          GetStaticOptionPass("READ"),
-                                          &mao_unit));
+
+  // IRLOAD=i[file] loads a unit saved by IRSAVE instead of reading the
+  // input.
+  MaoOptionMap *load_options = GetStaticOptionPass("IRLOAD");
+  bool load_ir = LoadIrPass::Requested(load_options);
+  if (load_ir) {
+    mao_pass_man.LinkPass(new LoadIrPass(new_argc, &new_argv[0],
+                                         load_options, &mao_unit));
+  } else {
+    mao_pass_man.LinkPass(new ReadInputPass(new_argc, &new_argv[0],
+                                            GetStaticOptionPass("READ"),
+                                            &mao_unit));
+  }
 
   // Reparse the arguments now that all the dynamic passes have been
   // loaded.  This will initialize the pass manager with the desired
   // passes for execution.
   mao_options.Reparse(&mao_unit, &mao_pass_man);
 
-  // run the passes
-  mao_pass_man.Run();
+  // STREAM=o[file] optimizes and writes every function as soon as it
+  // is read.
+  MaoStreamer streamer(GetStaticOptionPass("STREAM"), &mao_unit);
+  if (streamer.enabled()) {
+    MAO_RASSERT_MSG(!load_ir, "STREAM can not be used with IRLOAD");
+    streamer.Start(mao_options);
+  }
+
+  // CACHE=d[dir] copies the assembly output of an earlier run on the
+  // same input and options, instead of running the passes.
+  MaoResultCache cache(GetStaticOptionPass("CACHE"));
+  const char *asm_output = mao_options.AsmOutputFile();
+  bool use_cache = cache.enabled() && asm_output != NULL && !load_ir &&
+      !streamer.enabled() && cache.ComputeKey(new_argc, &new_argv[0], mao_options);
+
+  if (!use_cache || !cache.Lookup(asm_output)) {
+    // run the passes
+    mao_pass_man.Run();
+    if (streamer.enabled())
+      streamer.Finish();
+    if (use_cache)
+      cache.Store(asm_output);
+  }
+  if (use_cache)
+    cache.AddStat(mao_unit.GetStats());
 
   mao_unit.GetStats()->Print(stdout);
   if (mao_options.timer_print())
     mao_options.TimerPrint();
   return 0;
 }
+
+//==================================
+// MAO Main Entry
+//==================================
+int main(int argc, const char *argv[]) {
+  InitPasses();
+  InitRegisters();
+
+  // mao --mao-server=SOCKET serves the command lines sent by mao-client.
+  // The plugins given in MAOOPTS and the --mao= arguments of the server
+  // are loaded before serving.
+  if (argc > 1 && strncmp(argv[1], "--mao-server=", 13) == 0) {
+    MaoOptions server_options;
+    server_options.Parse(argv[0], getenv("MAOOPTS"));
+    for (int i = 2; i < argc; i++) {
+      if (strncmp(argv[i], "--mao=", 6) == 0)
+        server_options.Parse(argv[0], &argv[i][6]);
+    }
+    RunMaoServer(&argv[1][13], argv[0], RunMao);
+  }
+
+  return RunMao(argc, argv);
+}
@@ -20,19 +20,18 @@
 // Convert add|sub -1|1,reg to inc|dec reg (the reverse is
 // done in MaoInc2Add.cc)
 //
-// Note that there is a subtle dependence which is not being
-// handled by this pass.
+// Note that there is a subtle dependence:
 //
 //  inc/dec only write a subset of the flag registers
 //  add/sub overwrite all flags.
 //
-//  inc/dec therefore introduce a dependence on previous
-//  writes to the flags register.
-//
-// This is not handled in this pass, assumption is that
-// compilers won't model the flags at this level of granularity
-// anyways, so this is more a theoreritical concern.
+// inc/dec do not compute the carry flag. The pass therefore only
+// converts an add/sub if the carry flag is dead after it, see
+// FlagsLiveness. inc/dec still introduce a dependence on previous
+// writes to the flags register, this is not modeled.
 //
+#include <vector>
+
 #include "Mao.h"
 
 namespace {
@@ -65,32 +64,46 @@ class Add2IncPass : public MaoFunctionPass {
     // OP_sub, replace the instructions with an inc or dec
     // instruction.
     //
-    FORALL_FUNC_ENTRY(function_, iter) {
-      if (!iter->IsInstruction()) continue;
-      InstructionEntry *insn = iter->AsInstruction();
+    // Only instructions after which the carry flag is dead are
+    // replaced. They are collected first, replacing them changes the
+    // IR the flags liveness was computed from.
+    //
+    CFG *cfg = unit_->GetAnalyses()->GetCFG(function_);
+    if (cfg->HasUnresolvedIndirectJump()) return true;
+    FlagsLiveness *flags = unit_->GetAnalyses()->GetFlagsLiveness(function_);
 
-      if (insn->NumOperands() != 2 ||
-          !insn->IsImmediateIntOperand(0) ||
-          !insn->IsRegisterOperand(1))
-        continue;
+    std::vector<InstructionEntry *> candidates;
+    FORALL_CFG_BB(cfg, it) {
+      FORALL_BB_ENTRY(it, entry) {
+        if (!(*entry)->IsInstruction()) continue;
+        InstructionEntry *insn = (*entry)->AsInstruction();
 
-      if (insn->op() == OP_add && insn->GetImmediateIntValue(0) == 1) {
-        InstructionEntry *i = unit_->CreateIncFromOperand(function_, insn, 1);
-        insn->LinkBefore(i);
-        MarkInsnForDelete(insn);
-        TraceReplace(1, insn, i);
-      }
-      if (insn->op() == OP_sub && insn->GetImmediateIntValue(0) == 1) {
-        InstructionEntry *i = unit_->CreateDecFromOperand(function_, insn, 1);
-        insn->LinkBefore(i);
-        MarkInsnForDelete(insn);
-        TraceReplace(1, insn, i);
+        if (insn->NumOperands() != 2 ||
+            !insn->IsImmediateIntOperand(0) ||
+            !insn->IsRegisterOperand(1))
+          continue;
+
+        if ((insn->op() == OP_add || insn->op() == OP_sub) &&
+            insn->GetImmediateIntValue(0) == 1 &&
+            flags->FlagsDeadAfter(*insn, FLAG_CF))
+          candidates.push_back(insn);
       }
     }
 
+    for (std::vector<InstructionEntry *>::iterator iter = candidates.begin();
+         iter != candidates.end(); ++iter) {
+      InstructionEntry *insn = *iter;
+      InstructionEntry *i = insn->op() == OP_add ?
+        unit_->CreateIncFromOperand(function_, insn, 1) :
+        unit_->CreateDecFromOperand(function_, insn, 1);
+      insn->LinkBefore(i);
+      MarkInsnForDelete(insn);
+      TraceReplace(1, insn, i);
+    }
+
     return true;
   }
 };
 
-REGISTER_PLUGIN_FUNC_PASS("ADD2INC", Add2IncPass )
+REGISTER_PLUGIN_THREADSAFE_FUNC_PASS("ADD2INC", Add2IncPass )
 } // namespace
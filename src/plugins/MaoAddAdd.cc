@@ -152,42 +152,35 @@ class AddAddElimPass : public MaoFunctionPass {
       return false;
     }
 
-    // Now get the immediate value
-    expressionS *imm1 = inst1->instruction()->op[0].imms;
-    expressionS *imm2 = inst2->instruction()->op[0].imms;
+    // Now get the immediate value. The expressions may be shared with
+    // other instructions, the sum is set through SetImmediate().
+    const expressionS *imm1 = inst1->GetImmediate(0);
+    expressionS imm2 = *inst2->GetImmediate(0);
 
     // supported variants:
-    if (imm1->X_op == O_constant && imm2->X_op == O_constant) {
-      imm2->X_add_number = imm1->X_add_number + imm2->X_add_number;
-      return true;
-    }
-
-    if (imm1->X_op == O_symbol && imm2->X_op == O_constant) {
-      imm2->X_op = O_symbol;
-      imm2->X_add_number = imm1->X_add_number + imm2->X_add_number;
-      imm2->X_add_symbol = imm1->X_add_symbol;
-      return true;
-    }
-
-    if (imm1->X_op == O_symbol && imm2->X_op == O_symbol) {
-      imm2->X_op = O_add;
-      imm2->X_add_number = imm1->X_add_number + imm2->X_add_number;
-      imm2->X_op_symbol  = imm1->X_add_symbol;
-      return true;
-    }
-
-
-    if (imm1->X_op == O_constant && imm2->X_op == O_symbol) {
-      imm2->X_add_number = imm1->X_add_number + imm2->X_add_number;
-      return true;
+    if (imm1->X_op == O_constant && imm2.X_op == O_constant) {
+      imm2.X_add_number = imm1->X_add_number + imm2.X_add_number;
+    } else if (imm1->X_op == O_symbol && imm2.X_op == O_constant) {
+      imm2.X_op = O_symbol;
+      imm2.X_add_number = imm1->X_add_number + imm2.X_add_number;
+      imm2.X_add_symbol = imm1->X_add_symbol;
+    } else if (imm1->X_op == O_symbol && imm2.X_op == O_symbol) {
+      imm2.X_op = O_add;
+      imm2.X_add_number = imm1->X_add_number + imm2.X_add_number;
+      imm2.X_op_symbol  = imm1->X_add_symbol;
+    } else if (imm1->X_op == O_constant && imm2.X_op == O_symbol) {
+      imm2.X_add_number = imm1->X_add_number + imm2.X_add_number;
+    } else {
+      return false;
     }
 
-    return false;
+    inst2->SetImmediate(0, imm2);
+    return true;
   }
 
   // Stores the mask for the e-flag.
   const BitString emask_;
 };
 
-REGISTER_PLUGIN_FUNC_PASS("ADDADD", AddAddElimPass)
+REGISTER_PLUGIN_THREADSAFE_FUNC_PASS("ADDADD", AddAddElimPass)
 }  // namespace
@@ -88,6 +88,8 @@ class BackBranchAlign : public MaoFunctionPass {
       : MaoFunctionPass("BACKBRALIGN", options, mao, function) {
     limit_ = GetOptionInt("limit");
     align_limit_ = GetOptionInt("align_limit");
+    // The relaxer is told about the inserted alignments, see Go().
+    Preserve(ANALYSIS_SIZE_MAP);
   }
 
 
@@ -285,7 +287,9 @@ class BackBranchAlign : public MaoFunctionPass {
 
       if ((*offsets)[(*iter)->min_bb()->GetFirstInstruction()] % 8) {
         (*iter)->min_bb()->first_entry()->AlignTo(3,-1,7);
-        MaoRelaxer::InvalidateSizeMap(function_->GetSection());
+        MaoRelaxer::MarkChanged(function_->GetSection(),
+                                (*iter)->min_bb()->first_entry());
+        MaoRelaxer::UpdateSizeMap(function_->GetSection());
         sizes = MaoRelaxer::GetSizeMap(unit_, function_->GetSection());
         offsets = MaoRelaxer::GetOffsetMap(unit_, function_->GetSection());
 
@@ -308,7 +312,9 @@ class BackBranchAlign : public MaoFunctionPass {
         (*iter)->min_bb()->first_entry()->LinkBefore(nop);
       }
 
-      MaoRelaxer::InvalidateSizeMap(function_->GetSection());
+      MaoRelaxer::MarkChanged(function_->GetSection(),
+                              (*iter)->min_bb()->first_entry());
+      MaoRelaxer::UpdateSizeMap(function_->GetSection());
       sizes = MaoRelaxer::GetSizeMap(unit_, function_->GetSection());
       offsets = MaoRelaxer::GetOffsetMap(unit_, function_->GetSection());
 
@@ -141,6 +141,8 @@ BranchSeparatorPass::BranchSeparatorPass(MaoOptionMap *options, MaoUnit *mao,
   min_branch_distance_ = GetOptionInt("min_branch_distance");
   profitable = IsProfitable (function);
   Trace(2, "Mao branch separator");
+  // The relaxer is told about the inserted nops, see Go().
+  Preserve(ANALYSIS_SIZE_MAP);
 
   if (collect_stat_) {
     // check if a stat object already exists?
@@ -190,6 +192,7 @@ bool BranchSeparatorPass::Go() {
         Trace(2, "Inserting %d nops between \"%s\" and \"%s\"", num_nops,  prev_branch_str, op_str.c_str());
         bool insert_jump = num_nops >= (FETCH_LINE_SIZE + 2);
         AlignEntry(function_, *iter, insert_jump);
+        MaoRelaxer::MarkChanged(function_->GetSection(), *iter);
         offset += num_nops;
         change = true;
         rerelax = true;
@@ -203,7 +206,7 @@ bool BranchSeparatorPass::Go() {
       //If we have separated a branch and then we see a directive,
       //we need to re-relax 
       if (rerelax) {
-        MaoRelaxer::InvalidateSizeMap(function_->GetSection());
+        MaoRelaxer::UpdateSizeMap(function_->GetSection());
         sizes_ = MaoRelaxer::GetSizeMap(unit_, function_->GetSection());
         Trace (2, "Re-relaxing");
         rerelax=false;
@@ -214,11 +217,12 @@ bool BranchSeparatorPass::Go() {
     offset += size;
   }
   if(change) {
-    if(rerelax)
-      //Relaxation has to be performed again
-      MaoRelaxer::InvalidateSizeMap(function_->GetSection());
     //Align function begining based on min_branch_distance
-    AlignEntry(function_, *(function_->EntryBegin()), false);
+    MaoEntry *first = *(function_->EntryBegin());
+    AlignEntry(function_, first, false);
+    MaoRelaxer::MarkChanged(function_->GetSection(), first);
+    //Relaxation has to be performed again
+    MaoRelaxer::UpdateSizeMap(function_->GetSection());
     if (collect_stat_)
       branch_separator_stat_->Relaxed();
   }
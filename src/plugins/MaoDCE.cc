@@ -58,6 +58,7 @@ class DeadCodeElimPass : public MaoFunctionPass {
  public:
   DeadCodeElimPass(MaoOptionMap *options, MaoUnit *mao, Function *function)
       : MaoFunctionPass("DCE", options, mao, function) {
+    Preserve(ANALYSIS_ALL);
   }
 
   bool Go() {
@@ -91,5 +92,5 @@ class DeadCodeElimPass : public MaoFunctionPass {
   }
 };
 
-REGISTER_PLUGIN_FUNC_PASS("DCE", DeadCodeElimPass)
+REGISTER_PLUGIN_THREADSAFE_FUNC_PASS("DCE", DeadCodeElimPass)
 }  // namespace
@@ -20,19 +20,17 @@
 // Convert inc|dec reg to add|sub -1|1, reg (the reverse is
 // done in MaoAdd2Inc.cc)
 //
-// Note that there is a subtle dependence which is not being
-// handled by this pass.
+// Note that there is a subtle dependence:
 //
 //  inc/dec only write a subset of the flag registers
 //  add/sub overwrite all flags.
 //
-//  inc/dec therefore introduce a dependence on previous
-//  writes to the flags register.
-//
-// This is not handled in this pass, assumption is that
-// compilers won't model the flags at this level of granularity
-// anyways, so this is more a theoreritical concern.
+// inc/dec leave the carry flag alone, which add/sub write. The pass
+// therefore only converts an inc/dec if the carry flag is dead after
+// it, see FlagsLiveness.
 //
+#include <vector>
+
 #include "Mao.h"
 
 namespace {
@@ -58,36 +56,54 @@ class Inc2AddPass : public MaoFunctionPass {
   // for whichever registers support these forms.
   //
   bool Go() {
+    // Without the targets of the indirect jumps, the flags liveness
+    // is not known.
+    CFG *cfg = unit_->GetAnalyses()->GetCFG(function_);
+    if (cfg->HasUnresolvedIndirectJump()) return true;
+    FlagsLiveness *flags = unit_->GetAnalyses()->GetFlagsLiveness(function_);
+
     // Iterate over all BBs, all entries which are instructions.
     // Find instructions that have 1 operand and a register as
-    // the 1st operand.
-    // Then, convert this instruction to an add or sub of 1 to that
-    // register.
+    // the 1st operand, and after which the carry flag is dead.
+    // The instructions are collected first, converting them changes
+    // the IR the flags liveness was computed from.
     //
-    FORALL_FUNC_ENTRY(function_, iter) {
-      if (!iter->IsInstruction()) continue;
-      InstructionEntry *insn = iter->AsInstruction();
-
-      if (insn->NumOperands() != 1 ||
-          !insn->IsRegisterOperand(0))
-        continue;
+    std::vector<InstructionEntry *> candidates;
+    FORALL_CFG_BB(cfg, it) {
+      FORALL_BB_ENTRY(it, entry) {
+        if (!(*entry)->IsInstruction()) continue;
+        InstructionEntry *insn = (*entry)->AsInstruction();
 
-      if (insn->op() == OP_inc || insn->op() == OP_dec) {
-        InstructionEntry *i = insn->op() == OP_inc ?
-          unit_->CreateAdd(function_) : unit_->CreateSub(function_);
-        i->instruction()->operands = 2;
-        i->SetImmediateIntOperand(0, 32, 1);
-        i->SetOperand(1, insn, 0);
+        if (insn->NumOperands() != 1 ||
+            !insn->IsRegisterOperand(0))
+          continue;
 
-        insn->LinkBefore(i);
-        MarkInsnForDelete(insn);
-        TraceReplace(1, insn, i);
+        if ((insn->op() == OP_inc || insn->op() == OP_dec) &&
+            flags->FlagsDeadAfter(*insn, FLAG_CF))
+          candidates.push_back(insn);
       }
     }
 
+    // Then, convert these instructions to an add or sub of 1 to that
+    // register.
+    //
+    for (std::vector<InstructionEntry *>::iterator iter = candidates.begin();
+         iter != candidates.end(); ++iter) {
+      InstructionEntry *insn = *iter;
+      InstructionEntry *i = insn->op() == OP_inc ?
+        unit_->CreateAdd(function_) : unit_->CreateSub(function_);
+      i->mutable_instruction()->operands = 2;
+      i->SetImmediateIntOperand(0, 32, 1);
+      i->SetOperand(1, insn, 0);
+
+      insn->LinkBefore(i);
+      MarkInsnForDelete(insn);
+      TraceReplace(1, insn, i);
+    }
+
     return true;
   }
 };
 
-REGISTER_PLUGIN_FUNC_PASS("INC2ADD", Inc2AddPass )
+REGISTER_PLUGIN_THREADSAFE_FUNC_PASS("INC2ADD", Inc2AddPass )
 } // namespace
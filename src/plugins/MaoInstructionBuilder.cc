@@ -90,7 +90,7 @@ class InstructionBuilderPlugin : public MaoPass {
         }
       }
     }
-    PrintI386InsnStruct(insn->instruction());
+    PrintI386InsnStruct(insn->instruction()->raw());
     return true;
   }
 };
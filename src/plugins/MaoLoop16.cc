@@ -67,6 +67,8 @@ class AlignTinyLoops16 : public MaoFunctionPass {
     fetchline_size_  = GetOptionInt("fetch_line_size");
     max_fetch_lines_ = GetOptionInt("max_fetch_lines");
     limit_ = GetOptionInt("limit");
+    // The relaxer is told about the inserted alignments, see Go().
+    Preserve(ANALYSIS_SIZE_MAP);
   }
 
   // Find Candidates for loop alignment. Candidates are all
@@ -219,13 +221,15 @@ class AlignTinyLoops16 : public MaoFunctionPass {
         //
         if (lines <= max_fetch_lines_) {
           Trace(0, "  -> Alignment DONE");
-          (*iter)->min_bb()->first_entry()->AlignTo(4,-1,15);
+          MaoEntry *first = (*iter)->min_bb()->first_entry();
+          first->AlignTo(4,-1,15);
 
           // After alignment, we have to re-relax in order to
           // check how alignment changed for loops at higher
           // addresses (after this current loop in the list)
           //
-          MaoRelaxer::InvalidateSizeMap(function_->GetSection());
+          MaoRelaxer::MarkChanged(function_->GetSection(), first);
+          MaoRelaxer::UpdateSizeMap(function_->GetSection());
           sizes = MaoRelaxer::GetSizeMap(unit_, function_->GetSection());
           offsets = MaoRelaxer::GetOffsetMap(unit_, function_->GetSection());
         }
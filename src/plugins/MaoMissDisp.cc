@@ -77,5 +77,5 @@ class MissDispElimPass : public MaoFunctionPass {
   }
 };
 
-REGISTER_PLUGIN_FUNC_PASS("MISSDISP", MissDispElimPass)
+REGISTER_PLUGIN_THREADSAFE_FUNC_PASS("MISSDISP", MissDispElimPass)
 }  // namespace
@@ -51,6 +51,7 @@ class PrefAlias : public MaoFunctionPass {
  public:
   PrefAlias(MaoOptionMap *options, MaoUnit *mao, Function *function)
     : MaoFunctionPass("PREFALIAS", options, mao, function) {
+    Preserve(ANALYSIS_ALL);
   }
 
   struct Load {
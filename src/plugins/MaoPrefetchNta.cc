@@ -107,5 +107,5 @@ class PrefetchNtaPass : public MaoFunctionPass {
 };
 
 
-REGISTER_PLUGIN_FUNC_PASS("PREFNTA", PrefetchNtaPass)
+REGISTER_PLUGIN_THREADSAFE_FUNC_PASS("PREFNTA", PrefetchNtaPass)
 }  // namespace
@@ -33,7 +33,9 @@ MAO_DEFINE_OPTIONS(RATFINDER, "Finds potential RAT stalls in the code", 0) {
 class RatFinderPass : public MaoFunctionPass {
  public:
   RatFinderPass(MaoOptionMap *options, MaoUnit *mao, Function *function)
-      : MaoFunctionPass("RATFINDER", options, mao, function) { }
+      : MaoFunctionPass("RATFINDER", options, mao, function) {
+    Preserve(ANALYSIS_ALL);
+  }
 
   // RAT finder: For each basic block, this pass looks
   // at the defined registers, and checks if there are any writes to registers
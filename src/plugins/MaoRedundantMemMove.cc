@@ -143,5 +143,5 @@ class RedMemMovElimPass : public MaoFunctionPass {
   int        look_ahead_;
 };
 
-REGISTER_PLUGIN_FUNC_PASS("REDMOV", RedMemMovElimPass)
+REGISTER_PLUGIN_THREADSAFE_FUNC_PASS("REDMOV", RedMemMovElimPass)
 }  // namespace
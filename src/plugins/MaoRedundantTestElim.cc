@@ -41,19 +41,23 @@ class RedTestElimPass : public MaoFunctionPass {
   // Find patterns like these in a single basic block:
   //
   //   subl     xxx, %r15d
-  //   ... instructions not setting flags
+  //   ... instructions not setting flags or %r15d
   //   testl    %r15d, %r15d
   //
   //   addl     xxx, %r15d
-  //   ... instructions not setting flags
+  //   ... instructions not setting flags or %r15d
   //   testl    %r15d, %r15d
   //
-  // subl/addl/others set all the flags that test is testing for.
-  // The test instruction is therefore redundant
+  // subl/addl/others set the flags that test is testing for the same
+  // way test does, except for the carry and overflow flags, which test
+  // clears. The test instruction is therefore redundant if these two
+  // flags are dead after it, or if the instruction is and/or/xor,
+  // which clear them as well.
   //
   bool Go() {
     CFG *cfg = CFG::GetCFG(unit_, function_);
     if (!cfg->IsWellFormed()) return true;
+    FlagsLiveness *flags = unit_->GetAnalyses()->GetFlagsLiveness(function_);
 
     // Iterate over all basic blocks in the function.
     // This analysis is done 'local', we're only looking
@@ -73,19 +77,19 @@ class RedTestElimPass : public MaoFunctionPass {
             insn->GetRegisterOperand(0) == insn->GetRegisterOperand(1) &&
             insn->prevInstruction()) {
           InstructionEntry *prev = insn->prevInstruction();
+          BitString reg_mask = GetMaskForRegister(insn->GetRegisterOperand(1));
+          FillSubRegs(&reg_mask);
+          FillParentRegs(&reg_mask);
 
           // Traverse upwards in the basic block, passing
-          // by mov instructions, which are known to not
-          // modify flags. This could be extended to include
-          // additional instructions, but these are the only
-          // patterns we've found so far.
+          // by instructions which neither set flags nor
+          // modify the tested register.
           //
-          while (prev && prev->IsOpMov()) {
+          while (prev && GetFlagsDefMask(prev) == 0 &&
+                 !prev->IsControlTransfer()) {
             // check for re-def's of sub registers.
             //
-            if (prev->IsRegisterOperand(1) &&
-                RegistersOverlap(prev->GetRegisterOperand(1),
-                                 insn->GetRegisterOperand(1))) {
+            if ((GetRegisterDefMask(prev, true) & reg_mask).IsNonNull()) {
               prev = NULL;
               break;
             }
@@ -100,29 +104,43 @@ class RedTestElimPass : public MaoFunctionPass {
           //       is really difficult for these various shifts.
           //       Disabled for now.
           //
-          if (prev)
-            if (prev->op() == OP_sub || prev->op() == OP_add ||
-                prev->op() == OP_and || prev->op() == OP_or ||
-                prev->op() == OP_xor ||
-                prev->op() == OP_sbb) {
-              int op_index = prev->NumOperands() > 1 ? 1 : 0;
-              if (prev->IsRegisterOperand(op_index) &&
-                  prev->GetRegisterOperand(op_index) ==
-                  insn->GetRegisterOperand(0)) {
-                MarkInsnForDelete(insn);
+          if (prev && IsFlagsProducer(prev, flags, insn)) {
+            int op_index = prev->NumOperands() > 1 ? 1 : 0;
+            if (prev->IsRegisterOperand(op_index) &&
+                prev->GetRegisterOperand(op_index) ==
+                insn->GetRegisterOperand(0)) {
+              MarkInsnForDelete(insn);
 
-                Trace(1, "Found %s/test seq", prev->op_str());
-                if (tracing_level() > 0)
-                  (*it)->Print(stderr, prev,insn);
-              }
+              Trace(1, "Found %s/test seq", prev->op_str());
+              if (tracing_level() > 0)
+                (*it)->Print(stderr, prev,insn);
             }
-	}
+          }
+        }
       }
     }
 
     return true;
   }
+
+ private:
+  // Returns true if prev sets the zero, sign and parity flags from its
+  // result the way test would, and the remaining flags of test are not
+  // needed after test.
+  bool IsFlagsProducer(InstructionEntry *prev, FlagsLiveness *flags,
+                       InstructionEntry *test) {
+    // These clear the carry and overflow flags, like test.
+    if (prev->op() == OP_and || prev->op() == OP_or ||
+        prev->op() == OP_xor)
+      return true;
+    if (prev->op() == OP_sub || prev->op() == OP_add ||
+        prev->op() == OP_sbb || prev->op() == OP_adc ||
+        prev->op() == OP_inc || prev->op() == OP_dec ||
+        prev->op() == OP_neg)
+      return flags->FlagsDeadAfter(*test, FLAG_CF | FLAG_OF);
+    return false;
+  }
 };
 
-REGISTER_PLUGIN_FUNC_PASS("REDTEST", RedTestElimPass)
+REGISTER_PLUGIN_THREADSAFE_FUNC_PASS("REDTEST", RedTestElimPass)
 }  // namespace
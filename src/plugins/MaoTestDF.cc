@@ -29,9 +29,11 @@ PLUGIN_VERSION
 // Options
 // --------------------------------------------------------------------
 MAO_DEFINE_OPTIONS(TESTDF, "Implements example analysis that uses MAO's "\
-                   "dataflow analysis framework", 2) {
+                   "dataflow analysis framework", 3) {
   OPTION_BOOL("liveness", true, "Run liveness analysis."),
   OPTION_BOOL("reachingdef", true, "Run reaching def. analysis."),
+  OPTION_BOOL("dominators", false, "Print the dominator and "
+              "post-dominator trees."),
 };
 
 class TestDataFlowPass : public MaoFunctionPass {
@@ -39,24 +41,23 @@ class TestDataFlowPass : public MaoFunctionPass {
   TestDataFlowPass(MaoOptionMap *options, MaoUnit *mao, Function *function)
       : MaoFunctionPass("TESTDF", options, mao, function),
         liveness_(GetOptionBool("liveness")),
-        reachingdef_(GetOptionBool("reachingdef")) {
-    MAO_ASSERT_MSG(liveness_ || reachingdef_, "TESTDF has nothing to do.");
+        reachingdef_(GetOptionBool("reachingdef")),
+        dominators_(GetOptionBool("dominators")) {
+    MAO_ASSERT_MSG(liveness_ || reachingdef_ || dominators_,
+                   "TESTDF has nothing to do.");
+    Preserve(ANALYSIS_ALL);
   }
 
   bool Go() {
     Trace(1, "Entering TESTDF for function %s:", function_->name().c_str());
 
-    CFG *cfg = CFG::GetCFG(unit_, function_);
+    MaoAnalysisManager *analyses = unit_->GetAnalyses();
 
     if (liveness_) {
       Trace(1, "Test liveness:");
-      // Create the problem instance
-      Liveness liveness = Liveness(unit_,
-                                   function_,
-                                   cfg);
-
-      // Now we can solve it.
-      liveness.Solve();
+      // Get the solved problem instance.
+      Liveness *liveness = analyses->GetLiveness(function_);
+      CFG *cfg = analyses->GetCFG(function_);
 
       // Print the live registers for each instruction.
       FORALL_CFG_BB(cfg, it) {
@@ -68,7 +69,7 @@ class TestDataFlowPass : public MaoFunctionPass {
             std::string insn_str;
             insn->ToString(&insn_str);
             fprintf(stderr, "insn: %s\n", insn_str.c_str());
-            BitString live_regs = liveness.GetLive(*bb, *insn);
+            BitString live_regs = liveness->GetLive(*bb, *insn);
             fprintf(stderr, "live: ");
             for (int i = 0; i < live_regs.number_of_bits(); ++i) {
               if (live_regs.Get(i)) {
@@ -91,12 +92,9 @@ class TestDataFlowPass : public MaoFunctionPass {
 
     if (reachingdef_) {
       Trace(1, "Test reaching defs:");
-      // Create the problem instance
-      ReachingDefs rd_problem = ReachingDefs(unit_,
-                                             function_,
-                                             cfg);
-      // Now we can solve it.
-      rd_problem.Solve();
+      // Get the solved problem instance.
+      ReachingDefs *rd_problem = analyses->GetReachingDefs(function_);
+      CFG *cfg = analyses->GetCFG(function_);
 
       // Print out the results!
       // For each instruction, print out the reaching definitions.
@@ -118,9 +116,9 @@ class TestDataFlowPass : public MaoFunctionPass {
             if (used_registers.Get(reg_num)) {
               fprintf(stderr, "Uses: %s\n", GetRegName(reg_num));
               // Regnum was defined!
-              std::list<Definition> defs = rd_problem.GetReachingDefs(*bb,
-                                                                      *insn,
-                                                                      reg_num);
+              std::list<Definition> defs = rd_problem->GetReachingDefs(*bb,
+                                                                       *insn,
+                                                                       reg_num);
               if (defs.size() == 0) {
                 fprintf(stderr, "%5s: No definitions found\n",
                         GetRegName(reg_num));
@@ -141,11 +139,18 @@ class TestDataFlowPass : public MaoFunctionPass {
         }
       }
     }
+
+    if (dominators_) {
+      Trace(1, "Test dominators:");
+      analyses->GetDominatorTree(function_)->Print(stderr);
+      analyses->GetPostDominatorTree(function_)->Print(stderr);
+    }
     return true;
   }
  private:
   bool liveness_;
   bool reachingdef_;
+  bool dominators_;
 };
 
 REGISTER_PLUGIN_FUNC_PASS("TESTDF", TestDataFlowPass)
@@ -33,7 +33,9 @@ MAO_DEFINE_OPTIONS(TESTPLUG, "A test plugin pass", 1) {
 class TestPlugin : public MaoFunctionPass {
  public:
   TestPlugin(MaoOptionMap *options, MaoUnit *mao, Function *function)
-      : MaoFunctionPass("TESTPLUG", options, mao, function) { }
+      : MaoFunctionPass("TESTPLUG", options, mao, function) {
+    Preserve(ANALYSIS_ALL);
+  }
 
   bool Go() {
     printf("%s: %s\n", GetOptionString("prefix"), function_->name().c_str());
@@ -59,6 +59,8 @@ class UOpsCmpJmp : public MaoFunctionPass {
     cacheline_size_  = GetOptionInt("cache_line_size");
     offset_min_ = GetOptionInt("offset_min");
     align_cmp_ = GetOptionBool("align_cmp");
+    // The relaxer is told about the inserted alignments, see Go().
+    Preserve(ANALYSIS_SIZE_MAP);
   }
 
   // Look for these patterns:
@@ -108,9 +110,10 @@ class UOpsCmpJmp : public MaoFunctionPass {
     do {
       changed = false;
 
-      // Relax and compute offsets
+      // Relax and compute offsets, rebuilding only what the nops
+      // inserted in the previous iteration changed.
       //
-      MaoRelaxer::InvalidateSizeMap(function_->GetSection());
+      MaoRelaxer::UpdateSizeMap(function_->GetSection());
       sizes = MaoRelaxer::GetSizeMap(unit_, function_->GetSection());
       offsets = MaoRelaxer::GetOffsetMap(unit_, function_->GetSection());
 
@@ -171,6 +174,7 @@ class UOpsCmpJmp : public MaoFunctionPass {
                 MaoEntry *nop = unit_->CreateNop(function_);
                 insert->LinkBefore(nop);
               }
+              MaoRelaxer::MarkChanged(function_->GetSection(), insert);
             }
           }
         } // FORALL_ENTRY's
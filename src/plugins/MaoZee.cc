@@ -115,5 +115,5 @@ class ZeroExtentElimPass : public MaoFunctionPass {
   }
 };
 
-REGISTER_PLUGIN_FUNC_PASS("ZEE", ZeroExtentElimPass)
+REGISTER_PLUGIN_THREADSAFE_FUNC_PASS("ZEE", ZeroExtentElimPass)
 }  // namespace
@@ -121,7 +121,7 @@ class X86InstructionSizeHelper {
     MAX_PREFIXES   = 7	/* max prefixes per opcode */
   };
 
-  X86InstructionSizeHelper(i386_insn *insn) : insn_(insn) { }
+  X86InstructionSizeHelper(const i386_insn *insn) : insn_(insn) { }
 
   // This function returns the fixed size of an instruction and a bool
   // which indicates whether or not the instruction can be variably
@@ -143,7 +143,7 @@ class X86InstructionSizeHelper {
 
   void MergeSizePair(const std::pair<int, bool> &from, std::pair<int, bool> *to);
 
-  i386_insn *insn_;
+  const i386_insn *insn_;
 };
 
 #endif
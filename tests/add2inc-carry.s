@@ -0,0 +1,21 @@
+#Option: --mao=ADD2INC=trace[2]
+#grep Replaced 1
+#
+# inc leaves the carry flag alone. The add in keep is followed by adc,
+# which reads the carry of the add, so only the add in replace becomes
+# an inc.
+
+	.text
+	.globl	keep
+	.type	keep, @function
+keep:
+	addl	$1, %eax
+	adcl	$0, %edx
+	ret
+	.size	keep, .-keep
+	.globl	replace
+	.type	replace, @function
+replace:
+	addl	$1, %eax
+	ret
+	.size	replace, .-replace
@@ -0,0 +1,26 @@
+#Option: --mao=PASSMAN=threads[4]:ADD2INC=trace[2]
+#grep Replaced 6
+
+.globl add1
+.type	add1, @function
+add1:
+ add    $1, %al
+ addl   $1, %eax
+ ret
+.size add1, .-add1
+
+.globl add2
+.type	add2, @function
+add2:
+ sub    $1, %ax
+ sub    $1, %rax
+ ret
+.size add2, .-add2
+
+.globl add3
+.type	add3, @function
+add3:
+ add    $1, %rax
+ subl   $1, %eax
+ ret
+.size add3, .-add3
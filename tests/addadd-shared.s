@@ -0,0 +1,23 @@
+#Option: --mao=ADDADD:ASM=source_info[0]
+#Plugin: MaoAddAdd
+#grep \$6, 1
+#grep \$3, 1
+#
+# The three adds share one copy in the instruction pool. Merging the
+# two in f must not change the one in g.
+
+	.text
+	.globl	f
+	.type	f, @function
+f:
+	addl	$3, %eax
+	addl	$3, %eax
+	ret
+	.size	f, .-f
+	.globl	g
+	.type	g, @function
+g:
+	addl	$3, %eax
+	movl	%eax, %ebx
+	ret
+	.size	g, .-g
@@ -0,0 +1,9 @@
+#Option: --mao=ASM=source_info[0]
+#grep movl 1
+#grep addl 1
+#grep id: 0
+#
+# Without source_info, ASM writes no id comments.
+
+ movl   %eax, %ebx
+ addl   $2, %ebx
@@ -0,0 +1,8 @@
+#Option: --mao=ASM
+#grep movl.*# id: [0-9]+, l: 7 1
+#grep addl.*# id: [0-9]+, l: 8 1
+#
+# ASM appends the entry id and the input line to every line.
+
+ movl   %eax, %ebx
+ addl   $2, %ebx
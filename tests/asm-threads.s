@@ -0,0 +1,37 @@
+#Option: --mao=ASM=threads[4]
+#Compare: --mao=ASM
+#
+# The output formatted on several threads has to be the same as the
+# serial output. Every subsection is formatted in its own chunk.
+
+	.text
+	.globl	f
+	.type	f, @function
+f:
+	movl	value(%rip), %eax
+	addl	$1, %eax
+	ret
+	.size	f, .-f
+
+	.data
+	.align 4
+	.type	value, @object
+	.size	value, 4
+value:
+	.long	42
+
+	.section	.rodata
+.LC0:
+	.string	"mao"
+
+	.text
+	.globl	g
+	.type	g, @function
+g:
+	leaq	.LC0(%rip), %rax
+	ret
+	.size	g, .-g
+
+	.data
+value2:
+	.quad	f
@@ -0,0 +1,16 @@
+#Option: --mao=BATCH=i[/dev/null]+o[.batch.s]+jobs[2]:ADD2INC
+#File: batch.batch.s
+#Compare: --mao=ADD2INC:ASM
+#grep inc 1
+#
+# A batch run writes the assembly of each input next to it, the same
+# assembly a run on that input alone writes.
+
+	.text
+	.globl	f
+	.type	f, @function
+f:
+	movl	%edi, %eax
+	addl	$1, %eax
+	ret
+	.size	f, .-f
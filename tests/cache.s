@@ -0,0 +1,20 @@
+#Clean: cache.dir
+#Setup: --mao=CACHE=d[cache.dir]:ADD2INC:ASM=o[cache.out]
+#Option: --mao=CACHE=d[cache.dir]:ADD2INC:ASM=o[cache.out]
+#File: cache.out
+#grep CACHE:.miss 0
+#grep CACHE:.hit 1
+#grep 1.of.2.lookups 1
+#grep inc 1
+#
+# The first run misses and stores its assembly, the second hits and
+# restores it.
+
+	.text
+	.globl	f
+	.type	f, @function
+f:
+	movl	%edi, %eax
+	addl	$1, %eax
+	ret
+	.size	f, .-f
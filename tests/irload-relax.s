@@ -0,0 +1,24 @@
+#Option: --mao=IRSAVE=o[irload-relax.ir]:RELAX:ASM
+#Compare: --mao=IRLOAD=i[irload-relax.ir]:RELAX:ASM
+#
+# The relaxer looks up the sections by name. Sections that gas did not
+# create itself, .rodata here, get their names from the IR file.
+
+	.text
+	.globl	f
+	.type	f, @function
+f:
+	movl	table(,%rdi,4), %eax
+	testl	%eax, %eax
+	je	.L2
+	addl	$1, %eax
+.L2:
+	ret
+	.size	f, .-f
+	.section	.rodata
+	.align 4
+	.type	table, @object
+	.size	table, 8
+table:
+	.long	.L2-f
+	.long	2
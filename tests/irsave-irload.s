@@ -0,0 +1,32 @@
+#Option: --mao=IRSAVE=o[irload.ir]:ASM
+#Compare: --mao=IRLOAD=i[irload.ir]:ASM
+#grep cmpl 1
+#
+# The IR saved by IRSAVE loads back to the same assembly, including
+# the labels and the size expressions that refer to them.
+
+	.file	"irload.c"
+	.text
+	.p2align 4,,15
+	.globl	f
+	.type	f, @function
+f:
+.LFB0:
+	xorl	%eax, %eax
+	cmpl	$10, %edi
+	jle	.L2
+	movl	%edi, %eax
+	addl	$1, %eax
+.L2:
+	movl	%eax, counter(%rip)
+	ret
+.LFE0:
+	.size	f, .-f
+	.section	.rodata
+	.align 4
+	.type	table, @object
+	.size	table, 8
+table:
+	.long	.L2-f
+	.long	.LFE0-.LFB0
+	.comm	counter,4,4
@@ -0,0 +1,45 @@
+#Option: --mao=PASSMAN=threads[4]:ADD2INC:REDTEST:ASM
+#Compare: --mao=ADD2INC:REDTEST:ASM
+#
+# The threaded pass manager has to give the same output as a serial
+# run, including the "# id:" comments. func2 and func4 have no .size
+# directive, so the redundant test at their end is the last entry of
+# the function. It is only unlinked after the threads are done.
+
+.globl func1, func2, func3, func4, func5
+.type	func1, @function
+.type	func2, @function
+.type	func3, @function
+.type	func4, @function
+.type	func5, @function
+
+func1:
+ add    $1, %eax
+ andl   $7, %eax
+ testl  %eax, %eax
+ je     .L1
+ addl   $1, %ebx
+.L1:
+ ret
+.size func1, .-func1
+
+func2:
+ addq   $1, %rax
+ orl    $3, %ecx
+ testl  %ecx, %ecx
+func3:
+ xorl   %edx, %edx
+ testl  %edx, %edx
+ jne    .L3
+ subl   $1, %edx
+.L3:
+ ret
+.size func3, .-func3
+
+func4:
+ andq   $15, %rsi
+ testq  %rsi, %rsi
+func5:
+ add    $1, %r8d
+ ret
+.size func5, .-func5
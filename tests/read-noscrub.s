@@ -0,0 +1,21 @@
+#Option: --mao=READ=scrub[0]:ASM
+#Compare: --mao=ASM
+#grep addl 1
+#grep movl 2
+#
+# Compiler generated input reads the same with and without the scrubber.
+
+	.file	"noscrub.c"
+	.text
+	.p2align 4,,15
+	.globl	f
+	.type	f, @function
+f:
+.LFB0:
+	movl	%edi, %eax
+	addl	$1, %eax
+	movl	%eax, counter(%rip)
+	ret
+.LFE0:
+	.size	f, .-f
+	.comm	counter,4,4
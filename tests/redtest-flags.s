@@ -0,0 +1,53 @@
+#Option: --mao=REDTEST=trace[1]
+#grep Found 1
+#
+# Only the test in drop is redundant. In keep_carry, jb reads the
+# carry flag test clears. In keep_rep, jb reads it too, since repe
+# cmpsb leaves the flags alone when %rcx is 0. In keep_not, not sets
+# no flags but writes the tested register. In drop, the walk passes
+# lea, which neither sets flags nor writes the register.
+
+	.text
+	.globl	keep_carry
+	.type	keep_carry, @function
+keep_carry:
+	subl	$1, %r15d
+	testl	%r15d, %r15d
+	jb	.L1
+	movl	%r15d, %eax
+.L1:
+	ret
+	.size	keep_carry, .-keep_carry
+	.globl	keep_rep
+	.type	keep_rep, @function
+keep_rep:
+	subl	$1, %r15d
+	testl	%r15d, %r15d
+	repe cmpsb
+	jb	.L4
+	movl	%r15d, %eax
+.L4:
+	ret
+	.size	keep_rep, .-keep_rep
+	.globl	keep_not
+	.type	keep_not, @function
+keep_not:
+	subl	$1, %r15d
+	notl	%r15d
+	testl	%r15d, %r15d
+	je	.L2
+	movl	%r15d, %eax
+.L2:
+	ret
+	.size	keep_not, .-keep_not
+	.globl	drop
+	.type	drop, @function
+drop:
+	subl	$1, %r15d
+	leal	4(%rax), %ebx
+	testl	%r15d, %r15d
+	je	.L3
+	movl	%r15d, %eax
+.L3:
+	ret
+	.size	drop, .-drop
@@ -12,6 +12,15 @@ mao exists and is exeutable in the same directory as the script.
 Format for special comments in assembly file to be tested:
 #Option:  <Options to pass to mao>
 #grep <Pattern> <Expected Number Of Matches>
+#Compare: <Options for a second run of mao, which must give the same output>
+#Client:  <Options for a run through a MAO server, which must give the same
+           output>
+#File:    <Output file of mao, next to the assembly file, which is appended
+           to the output and removed>
+#Setup:   <Options for a run of mao before the checked one, whose output is
+           ignored>
+#Clean:   <File or directory next to the assembly file, which is removed
+           before and after the test>
 
 Plugins can be tested using the following syntax in the assembly file:
 #Plugin: <plugin> co
@@ -19,13 +28,24 @@ Plugins can be tested using the following syntax in the assembly file:
 # Sample:
 #Option:  --mao=RELAX=stat[1]
 #grep MaoRelax.*foo.*2 1
+
+# Sample, checking that the threaded pass manager gives the serial output:
+#Option:  --mao=PASSMAN=threads[4]:ADD2INC:ASM
+#Compare: --mao=ADD2INC:ASM
+
+# Sample, checking that mao-client gives the output of mao:
+#Option:  --mao=ADD2INC:ASM
+#Client:  --mao=ADD2INC:ASM
 """
 
 import os
 import re
+import shutil
 import subprocess
 import sys
 import getopt
+import tempfile
+import time
 
 class RunError(Exception):
   def __init__(self, returncode, command, root):
@@ -49,8 +69,12 @@ def _RunCheck(command, stdin=None, stdout=None, stderr=None, env=None):
 
 # Runs mao on the inputfile. and return the output from both
 # standard error and standard output as a big string.
+# The command may be a list, e.g. mao-client and the socket of a server.
 def RunMao(maocommand, inputfile, options, plugin, target, library_ext):
-  cmd = [maocommand]
+  if isinstance(maocommand, list):
+    cmd = list(maocommand)
+  else:
+    cmd = [maocommand]
   cmd.append('--mao=-s') # load plugins by default
   if plugin:
     cmd.append('--mao=--plugin=../bin/' + plugin + '-' + target + library_ext)
@@ -60,6 +84,26 @@ def RunMao(maocommand, inputfile, options, plugin, target, library_ext):
   output = _RunCheck(cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
   return output
 
+# Starts a MAO server, runs mao-client on the inputfile through it, and
+# returns the output like RunMao. The server gets a private socket
+# directory and is stopped afterwards.
+def RunClient(maocommand, clientcommand, inputfile, options, plugin, target,
+              library_ext):
+  directory = tempfile.mkdtemp()
+  socket_path = os.path.join(directory, 'mao.socket')
+  server = subprocess.Popen([maocommand, '--mao-server=' + socket_path])
+  try:
+    for _ in range(100):
+      if os.path.exists(socket_path):
+        break
+      time.sleep(0.1)
+    return RunMao([clientcommand, socket_path], inputfile, options, plugin,
+                  target, library_ext)
+  finally:
+    server.kill()
+    server.wait()
+    shutil.rmtree(directory)
+
 # Reads the input file and returns a list of patterns to grep for, and
 # the expected number of matches. [(pattern, num_matches), ....]
 def GetPatterns(inputfile):
@@ -80,14 +124,54 @@ def GetNumberOfMatches(pattern, text):
   else:
     return len(matches)
 
+# Reads the input file and returns the values of all the lines with the
+# directive, e.g. the names of the output files for '#File'.
+def GetDirectives(inputfile, directive):
+  f = open(inputfile, 'r')
+  values = []
+  for line in f:
+    match = re.search(directive + r': (.*)', line)
+    if match:
+      values.append(match.group(1).strip())
+  return values
+
+# Removes the files and directories of the #Clean lines.
+def Clean(inputfile):
+  for name in GetDirectives(inputfile, '#Clean'):
+    path = os.path.join(os.path.dirname(inputfile), name)
+    if os.path.isdir(path):
+      shutil.rmtree(path)
+    elif os.path.exists(path):
+      os.remove(path)
+
+# Appends the output files of the run to output and removes them.
+# Returns the new output, and the names of the files that are missing.
+def AddOutputFiles(inputfile, files, output):
+  missing = []
+  for name in files:
+    path = os.path.join(os.path.dirname(inputfile), name)
+    if not os.path.exists(path):
+      missing.append(name)
+      continue
+    f = open(path, 'r')
+    output += f.read()
+    f.close()
+    os.remove(path)
+  return (output, missing)
+
 # Reads the options specified in the input file
 # and returns them as a string. If no options
-# are found, None is returned.
+# are found, None is returned. The options of
+# the comparison run and of the client run are
+# returned as well, or None if the file has no
+# #Compare or #Client line.
 def GetOptions(inputfile):
   # Get the patterns to search for
   f = open(inputfile, 'r')
   plugin = None
   options = None
+  compare = None
+  client = None
   for line in f:
     match = re.search(r'#Option: (.*)', line)
     if match:
@@ -95,7 +179,13 @@ def GetOptions(inputfile):
     match = re.search(r'#Plugin: (.*)', line)
     if match:
       plugin = match.group(1).strip()
-  return (options, plugin)
+    match = re.search(r'#Compare: (.*)', line)
+    if match:
+      compare = match.group(1).strip()
+    match = re.search(r'#Client: (.*)', line)
+    if match:
+      client = match.group(1).strip()
+  return (options, plugin, compare, client)
 
 def main(argv):
   # Check for -f <filename> options
@@ -122,25 +212,36 @@ def main(argv):
   if not os.access(mao_cmd, os.X_OK):
     print 'ERROR: %(mao)s is not execuable.' % {'mao': mao_cmd}
     sys.exit(1)
+  client_cmd = os.path.join(os.path.dirname(argv[0]), '..', 'bin',
+                            'mao-client-' + target)
 
   # Loop over input filenames
   for inputfile in args:
-    (options, plugin) = GetOptions(inputfile)
+    (options, plugin, compare, client) = GetOptions(inputfile)
     # Make sure we find the mao options
     if options == None:
       print 'Unable to find options in input file: %(file)s' % \
           {'file' : inputfile}
       continue
 
+    Clean(inputfile)
+    for setup in GetDirectives(inputfile, '#Setup'):
+      RunMao(mao_cmd, inputfile, setup, plugin, target, library_ext)
+
     # Run mao and get the output in mao_output
     mao_output = RunMao(mao_cmd, inputfile, options, plugin, target,
                         library_ext)
+    (mao_output, missing) = AddOutputFiles(inputfile,
+                                           GetDirectives(inputfile, '#File'),
+                                           mao_output)
 
     # Run pattern checker
     num_patterns = 0
     num_patterns_passed = 0
     patterns = GetPatterns(inputfile)
     error_msgs = []
+    for name in missing:
+      error_msgs.append('Missing output file ' + name)
     for pattern in patterns:
       num_patterns += 1
       num_matches = GetNumberOfMatches(pattern[0], mao_output)
@@ -150,6 +251,29 @@ def main(argv):
       else:
         num_patterns_passed += 1
 
+    # Run mao again with the options to compare with
+    if compare:
+      num_patterns += 1
+      compare_output = RunMao(mao_cmd, inputfile, compare, plugin, target,
+                              library_ext)
+      if compare_output != mao_output:
+        error_msgs.append('Output differs from the one with ' + compare)
+      else:
+        num_patterns_passed += 1
+
+    # Run mao through a server with the options to compare with
+    if client:
+      num_patterns += 1
+      client_output = RunClient(mao_cmd, client_cmd, inputfile, client,
+                                plugin, target, library_ext)
+      if client_output != mao_output:
+        error_msgs.append('Output differs from the one of mao-client with ' +
+                          client)
+      else:
+        num_patterns_passed += 1
+
+    Clean(inputfile)
+
     # Print out the status line:
     print '%(f)-20s' % {'f' : os.path.basename(inputfile)},
     if len(error_msgs) == 0:
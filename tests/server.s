@@ -0,0 +1,14 @@
+#Option: --mao=ADD2INC:ASM
+#Client: --mao=ADD2INC:ASM
+#grep inc 1
+#
+# A run through a MAO server gives the output of a run of mao.
+
+	.text
+	.globl	f
+	.type	f, @function
+f:
+	movl	%edi, %eax
+	addl	$1, %eax
+	ret
+	.size	f, .-f
@@ -0,0 +1,43 @@
+#Option: --mao=STREAM=o[/dev/stdout]+source_info[0]:ADD2INC:REDTEST
+#Compare: --mao=ADD2INC:REDTEST:ASM=source_info[0]
+#grep inc 2
+#
+# Streaming gives the output of a run on the whole unit. The entry ids
+# differ by design, so the source info comments are left out. g has no
+# .size directive and goes through the passes at the end.
+
+	.file	"stream.c"
+	.text
+	.p2align 4,,15
+	.globl	f
+	.type	f, @function
+f:
+	movl	%edi, %eax
+	addl	$1, %eax
+	ret
+	.size	f, .-f
+	.data
+	.align 4
+	.type	counter, @object
+	.size	counter, 4
+counter:
+	.long	1
+	.text
+	.p2align 4,,15
+	.globl	h
+	.type	h, @function
+h:
+	subl	$1, %edi
+	testl	%edi, %edi
+	je	.L3
+	movl	%edi, counter(%rip)
+.L3:
+	ret
+	.size	h, .-h
+	.globl	g
+	.type	g, @function
+g:
+	addl	$1, %esi
+	movl	%esi, %eax
+	testl	%eax, %eax
+	ret
@@ -0,0 +1,47 @@
+#Option: --mao=TESTDF=liveness[0]+reachingdef[0]+dominators[1]
+#grep (?m)^  bb3: idom: 2, frontier: bb5$ 1
+#grep (?m)^  bb4: idom: 2, frontier: bb5$ 1
+#grep (?m)^  bb5: idom: 2, frontier:$ 1
+#grep (?m)^  bb3: idom: 5, frontier: bb2$ 1
+#grep (?m)^  bb3: idom: 2, frontier: bb3$ 1
+#grep (?m)^  bb4: idom: 3, frontier: bb3$ 2
+#grep (?m)^  bb5: idom: 3, frontier:$ 1
+#grep (?m)^  bb3: idom: 5, frontier: bb3$ 1
+#
+# The dominator and post-dominator trees of a diamond and of a loop.
+# bb0 and bb1 are the source and the sink, the other blocks are
+# numbered as the CFG builder creates them.
+#
+# diamond: bb2 branches to bb3 (.L2) and bb4, which join in bb5 (.L3).
+# Both arms have the join in their frontier, and are post-dominated by
+# it, with the branch in their post-dominance frontier.
+#
+# loop: bb2 jumps to the header bb3 (.L6), which loops back through
+# bb4 (.L5) and exits to bb5. The header is in its own frontier and in
+# the one of bb4, in both trees.
+
+	.text
+	.globl	diamond
+	.type	diamond, @function
+diamond:
+	testl	%edi, %edi
+	je	.L2
+	movl	$1, %eax
+	jmp	.L3
+.L2:
+	movl	$2, %eax
+.L3:
+	ret
+	.size	diamond, .-diamond
+	.globl	loop
+	.type	loop, @function
+loop:
+	xorl	%eax, %eax
+	jmp	.L6
+.L5:
+	addl	$1, %eax
+.L6:
+	cmpl	%edi, %eax
+	jl	.L5
+	ret
+	.size	loop, .-loop
@@ -0,0 +1,18 @@
+#Option: --mao=TESTDF=liveness[0]+reachingdef[0]+dominators[1]
+#grep post-dominator tree 1
+#grep unreachable 0
+#
+# The block of the tail call to other has no successors. It is
+# post-dominated by the sink like the return, so no block is
+# unreachable in either tree.
+
+	.text
+	.globl	tail
+	.type	tail, @function
+tail:
+	testl	%edi, %edi
+	je	.L1
+	jmp	other
+.L1:
+	ret
+	.size	tail, .-tail